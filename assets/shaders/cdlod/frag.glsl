@@ -7,6 +7,8 @@ layout(location = 0) out vec4 outColor;
 layout(location = 0) in vec4 fragColour;
 layout(location = 1) in vec3 fragTexCoord;
 layout(location = 2) in vec2 fragHeightmapCoord;
+layout(location = 3) flat in uint fragMaterials;
+layout(location = 4) in vec2 fragSplatCoord;
 layout(set = 1, binding = 2) uniform sampler2DArray texSampler;
 
 layout(push_constant) uniform TerrainUBO {
@@ -16,27 +18,61 @@ layout(push_constant) uniform TerrainUBO {
     vec2 meshMorphConstants;// x = mesh size (number of cells inline) / 2, y = 2 / mesh size
     vec3 cameraOrigin;
     uint debugMode;
+    vec2 splatOffset;// Splat map texel = (world + splatOffset) * splatScale
+    vec2 splatScale;
 } terrain;
 
-layout(set = 2, binding = 3) uniform sampler2D splatMap;
+layout(set = 2, binding = 3) uniform sampler2D splatAtlas;
 layout(set = 2, binding = 4) uniform sampler2D normalMap;
+layout(set = 2, binding = 5) uniform usampler2D splatPageTable;
 
 const vec3 lightVector = vec3(-0.3698, 0.0925, 0.9245);
 
+// Matches TerrainPainter::PageSize, pages have a 1 texel border on top of this
+const float splatPageSize = 128;
+const float splatPageStride = splatPageSize + 2;
+
+vec4 sampleSplat(vec2 texel) {
+    ivec2 pages = textureSize(splatPageTable, 0);
+    ivec2 page = clamp(ivec2(floor(texel / splatPageSize)), ivec2(0), pages - 1);
+
+    // Pages which were never painted are only the first texture
+    uint slot = texelFetch(splatPageTable, page, 0).r;
+    if (slot == 0) {
+        return vec4(1, 0, 0, 0);
+    }
+
+    vec2 atlasSize = vec2(textureSize(splatAtlas, 0));
+    uint pagesPerRow = uint(atlasSize.x / splatPageStride);
+    vec2 pageOrigin = vec2((slot - 1) % pagesPerRow, (slot - 1) / pagesPerRow) * splatPageStride;
+
+    vec2 withinPage = clamp(texel - vec2(page) * splatPageSize, vec2(0), vec2(splatPageSize));
+    return texture(splatAtlas, (pageOrigin + 1 + withinPage) / atlasSize);
+}
+
 void main() {
     if (terrain.debugMode == 2) {
-        outColor = texture(splatMap, fragHeightmapCoord);
+        outColor = sampleSplat(fragSplatCoord);
     } else if (terrain.debugMode == 3) {
         outColor = texture(normalMap, fragHeightmapCoord.xy);
+    } else if (terrain.debugMode == 4) {
+        // Number of textures sampled, from green for one to red for all five
+        float count = float(bitCount(fragMaterials));
+        outColor = vec4(mix(vec3(0, 1, 0), vec3(1, 0, 0), (count - 1) / 4), 1);
     } else {
-        vec4 tex1 = texture(texSampler, vec3(fragTexCoord.xy, 0));
-        vec4 tex2 = texture(texSampler, vec3(fragTexCoord.xy, 1));
-        vec4 tex3 = texture(texSampler, vec3(fragTexCoord.xy, 2));
-        vec4 tex4 = texture(texSampler, vec3(fragTexCoord.xy, 3));
-        vec4 tex5 = texture(texSampler, vec3(fragTexCoord.xy, 4));
-
-        vec4 splat = texture(splatMap, fragHeightmapCoord.xy);
-        outColor = tex1 * splat.r + tex2 * splat.g + tex3 * splat.b + tex4 * splat.a + tex5 * (1 - (splat.r + splat.g + splat.b + splat.a));
+        vec4 splat = sampleSplat(fragSplatCoord);
+        float weights[5] = float[](splat.r, splat.g, splat.b, splat.a, 1 - (splat.r + splat.g + splat.b + splat.a));
+
+        // Only textures used in this node are sampled. Gradients are taken outside the branch, where they are defined.
+        vec2 dx = dFdx(fragTexCoord.xy);
+        vec2 dy = dFdy(fragTexCoord.xy);
+
+        outColor = vec4(0);
+        for (int layer = 0; layer < 5; ++layer) {
+            if ((fragMaterials & (1u << layer)) != 0) {
+                outColor += textureGrad(texSampler, vec3(fragTexCoord.xy, layer), dx, dy) * weights[layer];
+            }
+        }
         outColor *= fragColour;
 
         // Lighting
@@ -19,6 +19,8 @@ layout(push_constant) uniform TerrainUBO {
     vec2 meshMorphConstants;// x = mesh size (number of cells inline) / 2, y = 2 / mesh size
     vec3 cameraOrigin;
     uint debugMode;
+    vec2 splatOffset;// Splat map texel = (world + splatOffset) * splatScale
+    vec2 splatScale;
 } terrain;
 
 
@@ -29,12 +31,14 @@ layout(location = 3) in vec2 inTexCoord;
 
 layout(location = 4) in vec2 meshOffset;
 layout(location = 5) in float meshScale;
-layout(location = 6) in uint meshTextureIndex;
+layout(location = 6) in uint meshMaterials;
 layout(location = 7) in vec2 meshMorphRange;// x = morphStart, y = morphDist (end - start)
 
 layout(location = 0) out vec4 fragColour;
 layout(location = 1) out vec3 fragTexCoord;
 layout(location = 2) out vec2 fragHeightmapCoord;
+layout(location = 3) flat out uint fragMaterials;
+layout(location = 4) out vec2 fragSplatCoord;
 
 vec2 morphVertex(vec2 meshVertexCoord, vec2 worldVertexCoord, float morph) {
     vec2 fracPart = (fract(meshVertexCoord * terrain.meshMorphConstants.x) * terrain.meshMorphConstants.y) * meshScale;
@@ -61,8 +65,8 @@ void main() {
 
     vertexPos2D = morphVertex(inPosition.xy, vertexPos2D, morph);
 
-    // After morph, recalculate height
-    height = sampleHeight(vertexPos2D);
+    // After morph, recalculate height. z is only used to drop skirt vertices below the surface
+    height = sampleHeight(vertexPos2D) + inPosition.z * meshScale;
     vertexPos = vec3(vertexPos2D, height);
 
     // Transform into screen space
@@ -70,7 +74,9 @@ void main() {
 
     vec2 texCoord = ((vertexPos2D / terrain.halfSize) + vec2(0.5, 0.5));
     fragHeightmapCoord = texCoord;
-    fragTexCoord = vec3(texCoord* 10, meshTextureIndex);
+    fragTexCoord = vec3(texCoord* 10, 0);
+    fragMaterials = meshMaterials;
+    fragSplatCoord = (vertexPos2D + terrain.splatOffset) * terrain.splatScale;
 
     // Debug features
     if (terrain.debugMode == DM_RANGES) {
@@ -5,21 +5,30 @@
 layout (local_size_x = 16, local_size_y = 16) in;
 layout (binding = 0, r16) uniform readonly image2D heightmap;
 layout (binding = 1, rgba8) uniform image2D normalMap;
-layout (push_constant) uniform Elevation {
+layout (push_constant) uniform NormalRegion {
     float min;
     float max;
-} elevation;
+    // Only the normals in this region of pixels are rebuilt
+    ivec2 offset;
+    ivec2 size;
+} region;
 
 void main() {
-    float range = elevation.max - elevation.min;
+    ivec2 local = ivec2(gl_GlobalInvocationID.xy);
+    if (local.x >= region.size.x || local.y >= region.size.y) {
+        return;
+    }
 
-    vec3 origin = vec3(gl_GlobalInvocationID.xy, 0);
-    vec3 right = vec3(gl_GlobalInvocationID.x + 1, gl_GlobalInvocationID.y, 0);
-    vec3 down = vec3(gl_GlobalInvocationID.x, gl_GlobalInvocationID.y + 1, 0);
+    ivec2 pixel = region.offset + local;
+    float range = region.max - region.min;
 
-    float height = imageLoad(heightmap, ivec2(gl_GlobalInvocationID.xy)).r * range + elevation.min;
-    float heightR = imageLoad(heightmap, ivec2(gl_GlobalInvocationID.x + 1, gl_GlobalInvocationID.y)).r * range + elevation.min;
-    float heightD = imageLoad(heightmap, ivec2(gl_GlobalInvocationID.x, gl_GlobalInvocationID.y + 1)).r * range + elevation.min;
+    vec3 origin = vec3(pixel, 0);
+    vec3 right = vec3(pixel.x + 1, pixel.y, 0);
+    vec3 down = vec3(pixel.x, pixel.y + 1, 0);
+
+    float height = imageLoad(heightmap, pixel).r * range + region.min;
+    float heightR = imageLoad(heightmap, ivec2(pixel.x + 1, pixel.y)).r * range + region.min;
+    float heightD = imageLoad(heightmap, ivec2(pixel.x, pixel.y + 1)).r * range + region.min;
 
     // Compute a normal
     origin.z = height;
@@ -28,5 +37,5 @@ void main() {
 
     vec3 normal = normalize(cross(right - origin, down - origin));
 
-    imageStore(normalMap, ivec2(gl_GlobalInvocationID.xy), vec4(normal, 0));
-}
\ No newline at end of file
+    imageStore(normalMap, pixel, vec4(normal, 0));
+}
@@ -3,20 +3,34 @@
 #extension GL_ARB_separate_shader_objects : enable
 
 #define E 2.71828
+// Pages are this many texels along each side, including a 1 texel border. Matches TerrainPainter::PageStride
+#define PAGE_STRIDE 130
 
 layout (local_size_x = 16, local_size_y = 16) in;
-layout (binding = 0, rgba8) uniform image2D splatMap;
+layout (binding = 0, rgba8) uniform image2D splatAtlas;
 layout (push_constant) uniform Brush {
     vec2 origin;
     float radius;
     int texture;
     float opacity;
     float hardness;
+    ivec2 pageTexel;
+    ivec2 atlasTexel;
+    int mapSize;
 } brush;
 
 void main() {
-    vec4 splat = imageLoad(splatMap, ivec2(gl_GlobalInvocationID.xy));
-    vec2 toOrigin = gl_GlobalInvocationID.xy - brush.origin;
+    ivec2 local = ivec2(gl_GlobalInvocationID.xy);
+    if (local.x >= PAGE_STRIDE || local.y >= PAGE_STRIDE) {
+        return;
+    }
+
+    // Borders past the edge of the map repeat the edge, like a clamped sampler would
+    ivec2 texel = clamp(brush.pageTexel + local, ivec2(0), ivec2(brush.mapSize - 1));
+    ivec2 atlasTexel = brush.atlasTexel + local;
+
+    vec4 splat = imageLoad(splatAtlas, atlasTexel);
+    vec2 toOrigin = texel - brush.origin;
 
     float dist = length(toOrigin);
     vec4 outputSplat;
@@ -56,5 +70,5 @@ void main() {
         outputSplat = splat;
     }
 
-    imageStore(splatMap, ivec2(gl_GlobalInvocationID.xy), outputSplat);
+    imageStore(splatAtlas, atlasTexel, outputSplat);
 }
\ No newline at end of file
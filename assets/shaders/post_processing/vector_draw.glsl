@@ -33,8 +33,6 @@ struct VectorElement {
 #define SP_OUTSIDE 1
 #define SP_CENTER 2
 
-#define MAX_ELEMENTS 100
-
 layout (constant_id = 0) const bool use2DMode = false;
 
 layout (input_attachment_index = 0, binding = 0) uniform subpassInput inputColor;
@@ -45,13 +43,20 @@ layout (location = 0) out vec4 outColor;
 layout (binding = 2) uniform Camera {
     mat4 inverseViewProj;
     vec2 viewport;
+    uint tileSize;
+    uint tilesX;
 } camera;
 
-layout (binding = 3) uniform ElementBinding {
-    VectorElement elements[MAX_ELEMENTS];
-    uint count;
+layout (std430, binding = 3) readonly buffer ElementBinding {
+    VectorElement elements[];
 } elements;
 
+// Elements that can reach each square tile of the screen. The first tile count + 1 values are where the indices of
+// each tile start, the indices of tile t run up to the start of tile t + 1
+layout (std430, binding = 4) readonly buffer TileBinding {
+    uint data[];
+} tiles;
+
 vec3 getCurrentWorldPos() {
     if (!use2DMode) {
         vec2 ndcSpace = ((gl_FragCoord.xy / camera.viewport) * 2) - vec2(1, 1);
@@ -298,9 +303,12 @@ void main() {
     existingColor.a = 1;
     vec2 pos = getCurrentWorldPos().xy;
 
+    uvec2 tilePos = uvec2(gl_FragCoord.xy) / camera.tileSize;
+    uint tile = tilePos.y * camera.tilesX + tilePos.x;
+
     vec4 result = existingColor;
-    for (uint i = 0; i < elements.count; ++i) {
-        VectorElement element = elements.elements[i];
+    for (uint i = tiles.data[tile]; i < tiles.data[tile + 1]; ++i) {
+        VectorElement element = elements.elements[tiles.data[i]];
         element.fill.rgb *= element.fill.a;
         element.stroke.rgb *= element.stroke.a;
 
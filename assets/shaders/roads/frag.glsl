@@ -0,0 +1,20 @@
+#version 450
+#pragma shader_stage(fragment)
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) out vec4 outColor;
+
+layout(location = 0) in vec4 fragColour;
+layout(location = 1) in vec3 fragTexCoord;
+layout(location = 2) in vec3 fragNormal;
+layout(set = 1, binding = 2) uniform sampler2DArray texSampler;
+
+const vec3 lightVector = vec3(-0.3698, 0.0925, 0.9245);
+
+void main() {
+    outColor = texture(texSampler, fragTexCoord) * fragColour;
+
+    // Lighting
+    float diffuse = clamp(dot(normalize(fragNormal), lightVector), 0, 1);
+    outColor *= diffuse;
+}
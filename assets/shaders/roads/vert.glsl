@@ -0,0 +1,30 @@
+#version 450
+#pragma shader_stage(vertex)
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform CameraUBO {
+    mat4 view;
+    mat4 proj;
+} cam;
+
+layout(push_constant) uniform RoadUBO {
+    vec3 chunkOrigin;
+    uint textureIndex;
+} road;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in vec2 inTexCoord;
+
+layout(location = 0) out vec4 fragColour;
+layout(location = 1) out vec3 fragTexCoord;
+layout(location = 2) out vec3 fragNormal;
+
+void main() {
+    gl_Position = cam.proj * cam.view * vec4(inPosition + road.chunkOrigin, 1.0);
+
+    fragColour = inColor;
+    fragTexCoord = vec3(inTexCoord, road.textureIndex);
+    fragNormal = inNormal;
+}
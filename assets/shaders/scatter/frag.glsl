@@ -0,0 +1,17 @@
+#version 450
+#pragma shader_stage(fragment)
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) out vec4 outColor;
+
+layout(location = 0) in vec4 fragColour;
+layout(location = 1) in vec3 fragNormal;
+
+const vec3 lightVector = vec3(-0.3698, 0.0925, 0.9245);
+// Keeps faces turned away from the light from going black
+const float ambient = 0.3;
+
+void main() {
+    float diffuse = clamp(dot(normalize(fragNormal), lightVector), 0, 1);
+    outColor = vec4(fragColour.rgb * (ambient + (1 - ambient) * diffuse), fragColour.a);
+}
@@ -0,0 +1,37 @@
+#version 450
+#pragma shader_stage(vertex)
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform CameraUBO {
+    mat4 view;
+    mat4 proj;
+} cam;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in vec2 inTexCoord;
+
+// Per instance
+layout(location = 4) in vec3 instancePosition;
+layout(location = 5) in float instanceScale;
+layout(location = 6) in float instanceRotation;// Around z
+
+layout(location = 0) out vec4 fragColour;
+layout(location = 1) out vec3 fragNormal;
+
+void main() {
+    float s = sin(instanceRotation);
+    float c = cos(instanceRotation);
+    mat3 rotation = mat3(
+        c, s, 0,
+        -s, c, 0,
+        0, 0, 1
+    );
+
+    vec3 worldPosition = rotation * inPosition * instanceScale + instancePosition;
+    gl_Position = cam.proj * cam.view * vec4(worldPosition, 1.0);
+
+    fragColour = inColor;
+    fragNormal = rotation * inNormal;
+}
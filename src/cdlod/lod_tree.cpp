@@ -1,10 +1,15 @@
 #include "lod_tree.hpp"
-#include <deque>
+#include <array>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <tech-core/shapes/bounding_sphere.hpp>
 #include <tech-core/debug.hpp>
 #include "../utils/instance_buffer.hpp"
 #include "../utils/instance_buffer.inl"
+#include "../utils/profiler.hpp"
+#include "../terrain_painter.hpp"
+#include "tin_cache.hpp"
 
 namespace Terrain::CDLOD {
 
@@ -45,6 +50,27 @@ uint32_t constexpr fast2Pow(uint32_t power) {
     return result;
 }
 
+/**
+ * Orders the 4 children of a node by their distance to the origin.
+ * The child containing the origin comes first, then the child across the nearest split line,
+ * then the other neighbour, and finally the diagonally opposite child.
+ */
+std::array<uint32_t, 4> calculateChildOrder(const glm::vec3 &origin, float centerX, float centerY) {
+    uint32_t nearest = 0;
+    if (origin.x >= centerX) {
+        nearest |= 0b10;
+    }
+    if (origin.y >= centerY) {
+        nearest |= 0b01;
+    }
+
+    if (std::abs(origin.x - centerX) < std::abs(origin.y - centerY)) {
+        return { nearest, nearest ^ 0b10, nearest ^ 0b01, nearest ^ 0b11 };
+    } else {
+        return { nearest, nearest ^ 0b01, nearest ^ 0b10, nearest ^ 0b11 };
+    }
+}
+
 LODTree::LODTree(uint32_t maxDepth, uint32_t nodeSize, const glm::vec2 &center)
     : maxDepth(maxDepth), nodeSize(nodeSize), nodes(calculateTotalNodeCount(maxDepth) + 1), ranges(maxDepth + 1) {
     generateRanges();
@@ -61,10 +87,16 @@ LODTree::LODTree(uint32_t maxDepth, uint32_t nodeSize, const glm::vec2 &center)
 
 void LODTree::walkTree(
     const glm::vec3 &origin, const Engine::Frustum &frustum, InstanceBuffer<MeshInstanceData> &fullTiles,
-    InstanceBuffer<MeshInstanceData> &halfTiles
+    InstanceBuffer<MeshInstanceData> &halfTiles, TinSelection *tin
 ) {
+    PROFILE_ZONE("LODTree::walkTree");
+
     fullTiles.clear();
     halfTiles.clear();
+    if (tin) {
+        tin->tiles.clear();
+        tin->selected.clear();
+    }
 
     // generate the range spheres
     Engine::BoundingSphere rangeSpheres[maxDepth + 1];
@@ -77,6 +109,8 @@ void LODTree::walkTree(
         size_t id;
         uint32_t level;
         Engine::BoundingBox bounds;
+        // Nodes outside the range of the next level are queued so they are emitted in walk order
+        bool selectAsHalf;
     };
 
     // start walking the tree from the top to the bottom
@@ -85,19 +119,29 @@ void LODTree::walkTree(
         offset.x, offset.y, rootData.minZ, offset.x + size.x, offset.y + size.y, rootData.maxZ
     );
 
-    std::deque<PendingNode> toProcessNext;
+    // Depth first walk, visiting the children nearest to the origin first. Since the children of a node never
+    // overlap, this emits the tiles roughly front to back which lets the depth test reject hidden fragments early.
+    std::vector<PendingNode> toProcessNext;
+    toProcessNext.reserve(maxDepth * 4 + 1);
     toProcessNext.push_back(
         {
             1,
             maxDepth,
-            rootBounds
+            rootBounds,
+            false
         }
     );
 
-
     while (!toProcessNext.empty()) {
-        auto node = toProcessNext.front();
-        toProcessNext.pop_front();
+        auto node = toProcessNext.back();
+        toProcessNext.pop_back();
+
+        if (node.selectAsHalf) {
+            markNodeVisible(
+                node.id, node.level, { node.bounds.xMin, node.bounds.yMin }, ranges[node.level + 1], halfTiles, tin
+            );
+            continue;
+        }
 
         // compute node bounding box
         if (!node.bounds.intersects(frustum)) {
@@ -106,15 +150,14 @@ void LODTree::walkTree(
         }
 
         if (node.level == 0) {
-            markNodeVisible({ node.bounds.xMin, node.bounds.yMin }, 1, ranges[0], fullTiles);
+            markNodeVisible(node.id, 0, { node.bounds.xMin, node.bounds.yMin }, ranges[0], fullTiles, tin);
             continue;
         }
 
         if (!node.bounds.intersects(rangeSpheres[node.level - 1])) {
             // we aren't in range of a more detailed level, so do not walk the children
             markNodeVisible(
-                { node.bounds.xMin, node.bounds.yMin }, static_cast<float>(fast2Pow(node.level)),
-                ranges[node.level], fullTiles
+                node.id, node.level, { node.bounds.xMin, node.bounds.yMin }, ranges[node.level], fullTiles, tin
             );
             continue;
         }
@@ -122,7 +165,11 @@ void LODTree::walkTree(
         auto centerX = (node.bounds.xMin + node.bounds.xMax) / 2.0f;
         auto centerY = (node.bounds.yMin + node.bounds.yMax) / 2.0f;
 
-        for (uint32_t child = 0; child < 4; ++child) {
+        auto childOrder = calculateChildOrder(origin, centerX, centerY);
+
+        // Pushed furthest first so that the nearest child is processed next
+        for (auto it = childOrder.rbegin(); it != childOrder.rend(); ++it) {
+            auto child = *it;
             auto id = calculateChildId(node.id, child);
 
             auto childData = nodes[id];
@@ -148,27 +195,50 @@ void LODTree::walkTree(
                 childBounds.yMax = centerY;
             }
 
-            if (childBounds.intersects(rangeSpheres[node.level - 1])) {
-                toProcessNext.push_back({ id, node.level - 1, childBounds });
-            } else {
-                markNodeVisible(
-                    { childBounds.xMin, childBounds.yMin }, static_cast<float>(fast2Pow(node.level - 1)),
-                    ranges[node.level], halfTiles
-                );
-            }
+            toProcessNext.push_back(
+                {
+                    id,
+                    node.level - 1,
+                    childBounds,
+                    !childBounds.intersects(rangeSpheres[node.level - 1])
+                }
+            );
         }
     }
 
     fullTiles.flush();
     halfTiles.flush();
+    if (tin) {
+        tin->tiles.flush();
+    }
 }
 
 void LODTree::markNodeVisible(
-    const glm::vec2 &offset, float scale, const Range &range, InstanceBuffer<MeshInstanceData> &dest
+    size_t id, uint32_t level, const glm::vec2 &offset, const Range &range, InstanceBuffer<MeshInstanceData> &dest,
+    TinSelection *tin
 ) {
+    auto scale = static_cast<float>(fast2Pow(level));
+    auto nodeWorldSize = scale * nodeSize;
+
+    // The fragment shader skips textures not in the mask
+    uint32_t materials = SplatTiles::AllMaterials;
+    if (painter) {
+        materials = painter->getMaterialMask(offset, offset + nodeWorldSize);
+    }
+
+    if (tin && level >= tin->minimumLevel) {
+        auto tile = tin->cache.request(id, offset, nodeWorldSize);
+
+        // TINs are not aligned to the grid so they cannot be morphed. Their skirts cover the cracks instead.
+        if (tile && tin->tiles.push({ offset, nodeWorldSize, materials, { std::numeric_limits<float>::max(), 1 } })) {
+            tin->selected.push_back(tile);
+            return;
+        }
+    }
+
     dest.push(
         {
-            offset, scale * nodeSize, 0,
+            offset, nodeWorldSize, materials,
             { range.transitionStart, static_cast<float>(range.range) - range.transitionStart }
         }
     );
@@ -193,6 +263,8 @@ void LODTree::generateRanges() {
 }
 
 void LODTree::computeHeights(Heightmap *heightmap, const glm::ivec2 &min, const glm::ivec2 &max) {
+    PROFILE_ZONE("LODTree::computeHeights");
+
     auto gridSize = fast2Pow(maxDepth);
     auto gridSizeFloat = static_cast<float>(gridSize);
 
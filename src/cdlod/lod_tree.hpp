@@ -10,9 +10,13 @@
 // Forward
 template<typename T>
 class InstanceBuffer;
+class TerrainPainter;
 
 namespace Terrain::CDLOD {
 
+// Forward
+struct TinSelection;
+
 class LODTree {
 public:
     explicit LODTree(uint32_t maxDepth, uint32_t nodeSize, const glm::vec2 &center);
@@ -35,13 +39,22 @@ public:
 
     Engine::BoundingBox getTerrainBounds() const;
 
+    /**
+     * Selects the nodes to draw.
+     * @param tin When provided, coarse nodes with a TIN available are placed in the TIN selection instead
+     */
     void walkTree(
         const glm::vec3 &origin, const Engine::Frustum &frustum, InstanceBuffer<MeshInstanceData> &fullTiles,
-        InstanceBuffer<MeshInstanceData> &halfTiles
+        InstanceBuffer<MeshInstanceData> &halfTiles, TinSelection *tin = nullptr
     );
 
     void computeHeights(Heightmap *, const glm::ivec2 &min, const glm::ivec2 &max);
 
+    /**
+     * Source of the textures used within each node. Without one, every node samples every texture.
+     */
+    void setTerrainPainter(const TerrainPainter *terrainPainter) { painter = terrainPainter; }
+
 private:
     struct Range {
         uint32_t range;
@@ -49,6 +62,7 @@ private:
     };
 
     Heightmap *heightmap { nullptr };
+    const TerrainPainter *painter { nullptr };
 
     uint32_t maxDepth { 0 };
     uint32_t nodeSize { 0 };
@@ -61,8 +75,10 @@ private:
 
     void generateRanges();
 
-    void
-    markNodeVisible(const glm::vec2 &offset, float scale, const Range &range, InstanceBuffer<MeshInstanceData> &dest);
+    void markNodeVisible(
+        size_t id, uint32_t level, const glm::vec2 &offset, const Range &range, InstanceBuffer<MeshInstanceData> &dest,
+        TinSelection *tin
+    );
 
     void doMinMax(
         uint32_t id, uint32_t level, const glm::uvec2 &min, const glm::uvec2 &max,
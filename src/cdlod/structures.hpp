@@ -8,7 +8,7 @@ namespace Terrain::CDLOD {
 struct MeshInstanceData {
     glm::vec2 translate;
     float scale;
-    uint32_t textureIndex;
+    uint32_t materialMask; // Bit per splat map texture present in the node
     glm::vec2 morphRange; // x = morphStart, y = morphDist (end - start)
 
     static vk::VertexInputBindingDescription getBindingDescription() {
@@ -37,7 +37,7 @@ struct MeshInstanceData {
                 6,
                 1,
                 vk::Format::eR32Uint,
-                offsetof(MeshInstanceData, textureIndex)
+                offsetof(MeshInstanceData, materialMask)
             },
             vk::VertexInputAttributeDescription {
                 7,
@@ -56,6 +56,8 @@ struct TerrainUniform {
     alignas(8) glm::vec2 terrainMorphConstants;
     alignas(16) glm::vec3 cameraOrigin;
     alignas(4) uint32_t debugMode;
+    alignas(8) glm::vec2 splatOffset;
+    alignas(8) glm::vec2 splatScale;
 };
 
 struct NodeData {
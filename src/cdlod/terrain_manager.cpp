@@ -4,10 +4,13 @@
 #include <tech-core/pipeline.hpp>
 #include <tech-core/texture/manager.hpp>
 #include <vector>
+#include <chrono>
 #include <iostream>
 #include "../utils/instance_buffer.inl"
+#include "../utils/profiler.hpp"
 #include <imgui.h>
 #include <array>
+#include <limits>
 
 namespace Terrain::CDLOD {
 
@@ -16,21 +19,30 @@ std::array<const char *, 7> meshSizeNames = { "256", "128", "64", "32", "16", "8
 
 const Engine::Subsystem::SubsystemID<TerrainManager> TerrainManager::ID;
 
+// Ray samples looked up together, the ones after a hit are wasted so this stays small
+const uint32_t RaySampleBatch = 32;
+
 void TerrainManager::setMeshSize(uint32_t size) {
     meshSize = size;
     terrainUniform.terrainMorphConstants = { static_cast<float>(meshSize) * 0.5f, 2 / static_cast<float>(meshSize) };
-    regenerateMeshes();
+    selectMeshes();
+    tinCache->setMeshSize(meshSize);
 }
 
 void TerrainManager::setMaxLodLevels(uint32_t levels) {
     maxLodLevels = levels;
     generateLodTree();
+    resetTinCache();
 }
 
 void TerrainManager::setCamera(Engine::Camera *camera) {
     this->camera = camera;
 }
 
+void TerrainManager::setEnabled(bool enable) {
+    enabled = enable;
+}
+
 void TerrainManager::setWireframe(bool enable) {
     wireframe = enable;
 }
@@ -39,76 +51,21 @@ void TerrainManager::setDebugMode(uint32_t mode) {
     terrainUniform.debugMode = mode % (getDebugModeCount() + 1);
 }
 
-void TerrainManager::regenerateMeshes() {
-    if (terrainMesh) {
-        engine->removeMesh(terrainMeshName);
-    }
-
-    if (terrainHalfResolutionMesh) {
-        engine->removeMesh(terrainHalfMeshName);
-    }
-
-    auto halfRes = meshSize >> 1;
-    std::sprintf(terrainMeshName, "cdlod-mesh-%d", meshSize);
-    std::sprintf(terrainHalfMeshName, "cdlod-mesh-%d", halfRes);
-
-    terrainMesh = generateMesh(meshSize, terrainMeshName);
-    terrainHalfResolutionMesh = generateMesh(halfRes, terrainHalfMeshName);
-}
-
-Engine::StaticMesh *TerrainManager::generateMesh(uint32_t size, const char *name) {
-    auto totalVertices = (size + 1) * (size + 1);
-    auto totalIndices = size * size * 6;
-
-    auto sizeFloat = static_cast<float>(size);
-
-    std::vector<Engine::Vertex> vertices(totalVertices);
-    std::vector<uint16_t> indices(totalIndices);
-
-    float scale = 1 / sizeFloat;
-
-    // produce the vertices
-    for (uint32_t row = 0; row < size + 1; ++row) {
-        for (uint32_t column = 0; column < size + 1; ++column) {
-            auto index = column + row * (size + 1);
-
-            vertices[index] = Engine::Vertex {
-                { static_cast<float>(column) * scale, static_cast<float>(row) * scale, 0.0f },
-                { 0, 0, 1 },
-                { 1, 1, 1, 1 },
-                { static_cast<float>(column) * scale, static_cast<float>(row) * scale }
-            };
-        }
-    }
-
-    // produce the triangles
-    uint32_t startIndex = 0;
-    for (uint32_t row = 0; row < size; ++row) {
-        for (uint32_t column = 0; column < size; ++column) {
-            auto index = column + row * (size + 1);
-            auto indexRight = (column + 1) + row * (size + 1);
-            auto indexDown = column + (row + 1) * (size + 1);
-            auto indexDownRight = (column + 1) + (row + 1) * (size + 1);
-
-            indices[startIndex + 0] = index;
-            indices[startIndex + 1] = indexRight;
-            indices[startIndex + 2] = indexDownRight;
-            indices[startIndex + 3] = index;
-            indices[startIndex + 4] = indexDownRight;
-            indices[startIndex + 5] = indexDown;
-
-            startIndex += 6;
-        }
+void TerrainManager::selectMeshes() {
+    if (!gridMeshes) {
+        // Covers every mesh size along with its half resolution mesh
+        gridMeshes = std::make_unique<GridMeshPool>(
+            *engine, "cdlod-grid-meshes", meshSizes.back() >> 1, meshSizes.front()
+        );
     }
 
-    return engine->createStaticMesh<Engine::Vertex>(name)
-        .withVertices(vertices)
-        .withIndices(indices)
-        .build();
+    fullResRange = gridMeshes->getRange(meshSize);
+    halfResRange = gridMeshes->getRange(meshSize >> 1);
 }
 
 void TerrainManager::generateLodTree() {
     lodTree = std::make_unique<LODTree>(maxLodLevels - 1, 32, glm::vec3 { 0.0f, 0.0f, 0.0f });
+    lodTree->setTerrainPainter(painter);
 }
 
 void TerrainManager::generateInstanceBuffer() {
@@ -117,6 +74,12 @@ void TerrainManager::generateInstanceBuffer() {
 
     fullResTiles = std::make_unique<InstanceBuffer<MeshInstanceData>>(capacity, *engine);
     halfResTiles = std::make_unique<InstanceBuffer<MeshInstanceData>>(capacity, *engine);
+    tinTiles = std::make_unique<InstanceBuffer<MeshInstanceData>>(capacity, *engine);
+}
+
+void TerrainManager::resetTinCache() {
+    // Node ids and bounds change with the tree so nothing cached can be reused
+    tinCache->setHeightmap(heightmap, lodTree->getTerrainOffset(), lodTree->getTerrainSize());
 }
 
 void TerrainManager::initialiseResources(
@@ -143,10 +106,13 @@ void TerrainManager::initialiseResources(
     );
     textureSampler = engine.getMaterialManager().getSamplerById(textureSamplerId);
 
-    regenerateMeshes();
+    selectMeshes();
     generateLodTree();
     generateInstanceBuffer();
 
+    tinCache = std::make_unique<TinCache>(engine, ThreadPool::getShared());
+    tinCache->setMeshSize(meshSize);
+
     terrainUniform.terrainMorphConstants = { static_cast<float>(meshSize) * 0.5f, 2 / static_cast<float>(meshSize) };
 }
 
@@ -183,11 +149,16 @@ void TerrainManager::initialiseSwapChainResources(
 
     if (painter) {
         builder.bindSampledImage(
-            2, 3, painter->getSplatMap(), vk::ShaderStageFlagBits::eFragment, vk::ImageLayout::eGeneral,
+            2, 3, painter->getSplatAtlas(), vk::ShaderStageFlagBits::eFragment, vk::ImageLayout::eGeneral,
+            heightmapSampler
+        );
+        builder.bindSampledImage(
+            2, 5, painter->getPageTable(), vk::ShaderStageFlagBits::eFragment, vk::ImageLayout::eGeneral,
             heightmapSampler
         );
     } else {
         builder.bindSampledImage(2, 3, vk::ShaderStageFlagBits::eFragment, vk::ImageLayout::eGeneral, heightmapSampler);
+        builder.bindSampledImage(2, 5, vk::ShaderStageFlagBits::eFragment, vk::ImageLayout::eGeneral, heightmapSampler);
     }
 
     pipeline = builder.build();
@@ -199,6 +170,11 @@ void TerrainManager::cleanupResources(vk::Device device, Engine::RenderEngine &e
 
     fullResTiles.reset();
     halfResTiles.reset();
+    tinTiles.reset();
+
+    tinCache.reset();
+
+    gridMeshes.reset();
 }
 
 void TerrainManager::cleanupSwapChainResources(vk::Device device, Engine::RenderEngine &engine) {
@@ -207,6 +183,10 @@ void TerrainManager::cleanupSwapChainResources(vk::Device device, Engine::Render
 }
 
 void TerrainManager::writeFrameCommands(vk::CommandBuffer commandBuffer, uint32_t activeImage) {
+    if (!enabled) {
+        return;
+    }
+
     Engine::Pipeline *currentPipeline;
     if (wireframe) {
         currentPipeline = pipelineWireframe.get();
@@ -223,11 +203,22 @@ void TerrainManager::writeFrameCommands(vk::CommandBuffer commandBuffer, uint32_
     currentPipeline->push(
         commandBuffer, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, terrainUniform
     );
+    auto &gridMesh = gridMeshes->getMesh();
     if (renderFullRes) {
-        fullResTiles->draw(commandBuffer, *terrainMesh);
+        fullResTiles->draw(
+            commandBuffer, gridMesh, fullResRange->firstIndex, fullResRange->indexCount, fullResRange->vertexOffset
+        );
     }
     if (renderHalfRes) {
-        halfResTiles->draw(commandBuffer, *terrainHalfResolutionMesh);
+        halfResTiles->draw(
+            commandBuffer, gridMesh, halfResRange->firstIndex, halfResRange->indexCount, halfResRange->vertexOffset
+        );
+    }
+    if (!selectedTinTiles.empty()) {
+        tinTiles->bind(commandBuffer);
+        for (uint32_t index = 0; index < selectedTinTiles.size(); ++index) {
+            tinTiles->drawInstance(commandBuffer, *selectedTinTiles[index]->mesh, index);
+        }
     }
 }
 
@@ -236,20 +227,54 @@ void TerrainManager::afterFrame(uint32_t activeImage) {
 }
 
 void TerrainManager::prepareFrame(uint32_t activeImage) {
+    if (!enabled) {
+        statistics = {};
+        return;
+    }
+
     if (textureArray == 0xFFFFFFFF) {
         auto texture = engine->getTextureManager().getTexture("green");
         textureArray = texture->arrayId;
     }
 
-    lodTree->walkTree(
-        camera->getPosition(), camera->getFrustum(), *fullResTiles, *halfResTiles
-    );
+    auto selectionStart = std::chrono::high_resolution_clock::now();
+
+    if (useTinTiles) {
+        tinCache->update();
+
+        TinSelection tinSelection { *tinCache, tinMinimumLevel, *tinTiles, selectedTinTiles };
+        lodTree->walkTree(
+            camera->getPosition(), camera->getFrustum(), *fullResTiles, *halfResTiles, &tinSelection
+        );
+    } else {
+        selectedTinTiles.clear();
+        lodTree->walkTree(
+            camera->getPosition(), camera->getFrustum(), *fullResTiles, *halfResTiles
+        );
+    }
+
+    std::chrono::duration<double> selectionTime = std::chrono::high_resolution_clock::now() - selectionStart;
 
     terrainUniform.cameraOrigin = camera->getPosition();
+
+    auto halfRes = meshSize >> 1;
+    statistics.selectionTime = selectionTime.count();
+    statistics.instances = fullResTiles->size() + halfResTiles->size() + selectedTinTiles.size();
+    statistics.triangles = static_cast<uint64_t>(fullResTiles->size()) * meshSize * meshSize * 2
+        + static_cast<uint64_t>(halfResTiles->size()) * halfRes * halfRes * 2;
+    for (auto tile : selectedTinTiles) {
+        statistics.triangles += tile->triangleCount;
+    }
+    statistics.memoryUsage = lodTree->getTotalNodes() * sizeof(NodeData)
+        + (fullResTiles->capacity() + halfResTiles->capacity() + tinTiles->capacity()) * sizeof(MeshInstanceData)
+        + gridMeshes->getMemoryUsage()
+        + tinCache->getMemoryUsage();
+    statistics.textureMemoryUsage = heightmap ? heightmap->getTextureMemoryUsage() : 0;
 }
 
 void TerrainManager::setHeightmap(Heightmap &heightmap) {
     this->heightmap = &heightmap;
+    resetTinCache();
     invalidateHeightmap({}, { heightmap.getWidth(), heightmap.getHeight() });
 
     pipeline->bindImage(2, 1, heightmap.getImageTemp());
@@ -264,17 +289,30 @@ void TerrainManager::setHeightmap(Heightmap &heightmap) {
 
 void TerrainManager::setTerrainPainter(TerrainPainter &terrainPainter) {
     painter = &terrainPainter;
-    pipeline->bindImage(2, 3, painter->getSplatMap());
-    pipelineWireframe->bindImage(2, 3, painter->getSplatMap());
+    lodTree->setTerrainPainter(painter);
+    pipeline->bindImage(2, 3, painter->getSplatAtlas());
+    pipeline->bindImage(2, 5, painter->getPageTable());
+    pipelineWireframe->bindImage(2, 3, painter->getSplatAtlas());
+    pipelineWireframe->bindImage(2, 5, painter->getPageTable());
+
+    terrainUniform.splatOffset = painter->getSplatOffset();
+    terrainUniform.splatScale = painter->getSplatScale();
 }
 
 void TerrainManager::invalidateHeightmap(const glm::ivec2 &min, const glm::ivec2 &max) {
     // recalculate min and max heights within the area for each node
     lodTree->computeHeights(heightmap, min, max);
+
+    auto &size = lodTree->getTerrainSize();
+    auto &offset = lodTree->getTerrainOffset();
+    glm::vec2 heightmapSize { heightmap->getWidth(), heightmap->getHeight() };
+    tinCache->invalidate(
+        glm::vec2(min) / heightmapSize * size + offset, glm::vec2(max) / heightmapSize * size + offset
+    );
 }
 
 void TerrainManager::drawGUI() {
-    ImGui::Combo("Debug Mode", reinterpret_cast<int *>(&terrainUniform.debugMode), "None\0Range\0Splat Map\0Normals\0");
+    ImGui::Combo("Debug Mode", reinterpret_cast<int *>(&terrainUniform.debugMode), "None\0Range\0Splat Map\0Normals\0Materials\0");
 
     ImGui::Spacing();
     if (ImGui::Combo("Mesh Size", &meshSizeIndex, meshSizeNames.data(), meshSizeNames.size())) {
@@ -297,6 +335,27 @@ void TerrainManager::drawGUI() {
     ImGui::Indent();
     ImGui::Checkbox("Render HR", &renderHalfRes);
     ImGui::Unindent();
+
+    ImGui::Spacing();
+
+    ImGui::Checkbox("Simplify distant tiles", &useTinTiles);
+    if (useTinTiles) {
+        ImGui::Indent();
+        ImGui::SliderInt(
+            "From level", reinterpret_cast<int *>(&tinMinimumLevel), 1, static_cast<int>(maxLodLevels - 1)
+        );
+
+        auto maxError = tinCache->getMaxError();
+        if (ImGui::SliderFloat("Max error", &maxError, 0.1f, 16.0f, "%.1f")) {
+            tinCache->setMaxError(maxError);
+        }
+
+        ImGui::Text("Simplified tiles: %i", static_cast<int>(selectedTinTiles.size()));
+        ImGui::Text(
+            "Cached: %i (%i building)", static_cast<int>(tinCache->getCachedCount()), tinCache->getPendingCount()
+        );
+        ImGui::Unindent();
+    }
 }
 
 float TerrainManager::getHeightAt(float x, float y) const {
@@ -309,42 +368,136 @@ float TerrainManager::getHeightAt(float x, float y) const {
 
 std::optional<glm::vec3>
 TerrainManager::raycastTerrain(const glm::vec3 &origin, const glm::vec3 &direction) const {
+    TerrainRaycast ray;
+    ray.origin = origin;
+    ray.direction = direction;
+
+    raycastTerrain(ray);
+    return ray.hit;
+}
+
+void TerrainManager::raycastTerrain(TerrainRaycast &ray) const {
+    PROFILE_ZONE("TerrainManager::raycastTerrain");
+
+    ray.hit = {};
+    ray.sampleCount = 0;
+    ray.lastSample = 0;
+
     auto box = getTerrainBounds();
 
-    glm::vec3 enter, exit;
-    if (!box.intersectsRay(origin, direction, enter, exit)) {
-        return {};
+    glm::vec3 exit;
+    ray.entersTerrain = box.intersectsRay(ray.origin, ray.direction, ray.enter, exit);
+    if (!ray.entersTerrain) {
+        return;
     }
 
+    float maxDist = glm::length(exit - ray.enter);
+
+    auto xScale = box.width() / static_cast<float>(heightmap->getWidth());
+    auto yScale = box.height() / static_cast<float>(heightmap->getHeight());
+
+    ray.step = std::min(xScale, yScale);
+    ray.sampleCount = static_cast<uint32_t>(std::ceil(maxDist / ray.step));
+
+    marchRay(ray, 0);
+}
+
+bool TerrainManager::updateRaycast(TerrainRaycast &ray, const glm::ivec2 &min, const glm::ivec2 &max) const {
+    if (!ray.entersTerrain || min.x > max.x || min.y > max.y) {
+        return false;
+    }
+
+    // Without samples there is nothing to march, and sampleCount - 1 below would wrap around
+    if (ray.sampleCount == 0) {
+        ray.hit = {};
+        ray.lastSample = 0;
+        return false;
+    }
+
+    PROFILE_ZONE("TerrainManager::updateRaycast");
+
+    auto size = lodTree->getTerrainSize();
+    auto offset = lodTree->getTerrainOffset();
+    glm::vec2 pixelSize(size.x / heightmap->getWidth(), size.y / heightmap->getHeight());
+
+    // Heights are interpolated from the next pixel along as well
+    auto regionMin = (glm::vec2(min) - 1.0f) * pixelSize + offset;
+    auto regionMax = (glm::vec2(max) + 1.0f) * pixelSize + offset;
+
+    // Clip the part of the ray which was marched against the region
+    auto lastSample = std::min(ray.lastSample, ray.sampleCount - 1);
+    float near = 0;
+    float far = static_cast<float>(lastSample) * ray.step;
+    for (int axis = 0; axis < 2; ++axis) {
+        auto start = ray.enter[axis];
+        auto direction = ray.direction[axis];
+        if (std::abs(direction) < std::numeric_limits<float>::epsilon()) {
+            if (start < regionMin[axis] || start > regionMax[axis]) {
+                return false;
+            }
+            continue;
+        }
+
+        auto t1 = (regionMin[axis] - start) / direction;
+        auto t2 = (regionMax[axis] - start) / direction;
+        near = std::max(near, std::min(t1, t2));
+        far = std::min(far, std::max(t1, t2));
+    }
+
+    if (near > far) {
+        // Every sample up to the hit is where it was, so the hit is too
+        return false;
+    }
+
+    // Samples before the region are still above the terrain
+    marchRay(ray, static_cast<uint32_t>(std::floor(near / ray.step)));
+    return true;
+}
+
+void TerrainManager::marchRay(TerrainRaycast &ray, uint32_t firstSample) const {
     // Adjust into heightmap space
     auto size = lodTree->getTerrainSize();
     auto offset = lodTree->getTerrainOffset();
     glm::vec2 heightmapScale(1 / size.x * heightmap->getWidth(), 1 / size.y * heightmap->getHeight());
 
-    float maxDist = glm::length(exit - enter);
+    auto sampler = heightmap->getSampler();
+    std::array<glm::vec2, RaySampleBatch> coords;
+    std::array<float, RaySampleBatch> heights;
 
-    auto xScale = box.width() / static_cast<float>(heightmap->getWidth());
-    auto yScale = box.height() / static_cast<float>(heightmap->getHeight());
+    ray.hit = {};
+    for (auto batchStart = firstSample; batchStart < ray.sampleCount; batchStart += RaySampleBatch) {
+        auto count = std::min(RaySampleBatch, ray.sampleCount - batchStart);
 
-    auto step = std::min(xScale, yScale);
+        for (uint32_t index = 0; index < count; ++index) {
+            auto coord = ray.enter + ray.direction * (static_cast<float>(batchStart + index) * ray.step);
+            coords[index] = (glm::vec2(coord.x, coord.y) - offset) * heightmapScale;
+        }
 
-    for (float dist = 0.0f; dist < maxDist; dist += step) {
-        auto coord = enter + direction * dist;
-        glm::vec2 coordHM = (glm::vec2(coord.x, coord.y) - offset) * heightmapScale;
+        sampler.getHeightsAt({ coords.data(), count }, { heights.data(), count });
 
-        float height = heightmap->getHeightAt(coordHM.x, coordHM.y);
+        for (uint32_t index = 0; index < count; ++index) {
+            auto sample = batchStart + index;
+            auto coord = ray.enter + ray.direction * (static_cast<float>(sample) * ray.step);
 
-        if (height >= coord.z) {
-            coord.z = height;
-            return coord;
+            if (heights[index] >= coord.z) {
+                coord.z = heights[index];
+                ray.hit = coord;
+                ray.lastSample = sample;
+                return;
+            }
         }
     }
 
-    return {};
+    ray.lastSample = ray.sampleCount;
 }
 
 void TerrainManager::writeBarriers(vk::CommandBuffer commandBuffer) {
-    painter->getSplatMap()->transition(commandBuffer, vk::ImageLayout::eGeneral, true);
+    if (!enabled) {
+        return;
+    }
+
+    painter->getSplatAtlas()->transition(commandBuffer, vk::ImageLayout::eGeneral, true);
+    painter->getPageTable()->transition(commandBuffer, vk::ImageLayout::eGeneral, true);
     heightmap->getNormalMap()->transition(commandBuffer, vk::ImageLayout::eGeneral, true);
 }
 
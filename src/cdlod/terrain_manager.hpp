@@ -8,12 +8,32 @@
 
 #include "../heightmap.hpp"
 #include "lod_tree.hpp"
+#include "tin_cache.hpp"
 #include "../utils/instance_buffer.hpp"
 #include "../terrain_painter.hpp"
+#include "../terrain_statistics.hpp"
+#include "../utils/thread_pool.hpp"
+#include "../utils/grid_mesh_pool.hpp"
 
 namespace Terrain::CDLOD {
 namespace _E = Engine;
 
+/**
+ * A ray marched through the heightmap, kept so it can be resumed when part of the heightmap changes
+ */
+struct TerrainRaycast {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    std::optional<glm::vec3> hit;
+
+    bool entersTerrain { false };
+    glm::vec3 enter;
+    float step { 0 };
+    uint32_t sampleCount { 0 };
+    // The sample the hit was found at, sampleCount when it missed
+    uint32_t lastSample { 0 };
+};
+
 class TerrainManager : public Engine::Subsystem::Subsystem {
 public:
     static const Engine::Subsystem::SubsystemID<TerrainManager> ID;
@@ -24,6 +44,10 @@ public:
 
     void invalidateHeightmap(const glm::ivec2 &min, const glm::ivec2 &max);
 
+    void setEnabled(bool);
+
+    bool isEnabled() const { return enabled; }
+
     uint32_t getMeshSize() const { return meshSize; }
 
     void setMeshSize(uint32_t);
@@ -42,8 +66,12 @@ public:
 
     uint32_t getDebugModeCount() { return 1; }
 
+    const FrameStatistics &getStatistics() const { return statistics; }
+
     const glm::vec2 &getTerrainSize() const { return lodTree->getTerrainSize(); };
 
+    const glm::vec2 &getTerrainOffset() const { return lodTree->getTerrainOffset(); };
+
     Engine::BoundingBox getTerrainBounds() const { return lodTree->getTerrainBounds(); };
 
     float getHeightAt(const glm::vec2 &coords) const { return getHeightAt(coords.x, coords.y); };
@@ -54,6 +82,19 @@ public:
     std::optional<glm::vec3>
     raycastTerrain(const glm::vec3 &origin, const glm::vec3 &direction) const;
 
+    /**
+     * Marches the origin and direction of the ray through the heightmap
+     */
+    void raycastTerrain(TerrainRaycast &ray) const;
+
+    /**
+     * Brings the result of an earlier raycast up to date after a region of the heightmap changed.
+     * Only the part of the ray from where it first crosses the region is marched again.
+     * @param min The changed region in heightmap coordinates
+     * @return true if any of the ray was marched again
+     */
+    bool updateRaycast(TerrainRaycast &ray, const glm::ivec2 &min, const glm::ivec2 &max) const;
+
     void drawGUI();
 
     // For engine use
@@ -72,12 +113,13 @@ private:
     Heightmap *heightmap { nullptr };
     TerrainPainter *painter { nullptr };
 
+    bool enabled { true };
     bool wireframe { false };
 
-    Engine::StaticMesh *terrainMesh { nullptr };
-    char terrainMeshName[32];
-    Engine::StaticMesh *terrainHalfResolutionMesh { nullptr };
-    char terrainHalfMeshName[32];
+    // Every mesh size is kept in the pool so changing size only changes the ranges
+    std::unique_ptr<GridMeshPool> gridMeshes;
+    const GridMeshPool::Range *fullResRange { nullptr };
+    const GridMeshPool::Range *halfResRange { nullptr };
     uint32_t meshSize { 32 };
     int meshSizeIndex { 3 };
 
@@ -85,6 +127,7 @@ private:
     std::unique_ptr<LODTree> lodTree;
 
     TerrainUniform terrainUniform;
+    FrameStatistics statistics;
 
     // Mesh Instance Buffer
     float instanceBufferLoadFactor { 0.5f };
@@ -93,6 +136,13 @@ private:
     bool renderFullRes { true };
     bool renderHalfRes { true };
 
+    // Simplified meshes for distant nodes
+    bool useTinTiles { false };
+    uint32_t tinMinimumLevel { 3 };
+    std::unique_ptr<TinCache> tinCache;
+    std::unique_ptr<InstanceBuffer<MeshInstanceData>> tinTiles;
+    std::vector<const TinCache::Tile *> selectedTinTiles;
+
     vk::Sampler heightmapSampler;
     uint32_t textureSamplerId { 0 };
     vk::Sampler textureSampler;
@@ -105,12 +155,15 @@ private:
 
     uint32_t textureArray { 0xFFFFFFFF };
 
-    void regenerateMeshes();
-    Engine::StaticMesh *generateMesh(uint32_t size, const char *name);
+    void selectMeshes();
 
     void generateLodTree();
 
     void generateInstanceBuffer();
+
+    void resetTinCache();
+
+    void marchRay(TerrainRaycast &ray, uint32_t firstSample) const;
 };
 
 }
@@ -0,0 +1,399 @@
+#include "tin_cache.hpp"
+#include <algorithm>
+#include <cmath>
+#include "../utils/profiler.hpp"
+
+namespace Terrain::CDLOD {
+
+// Number of frames a TIN can go unrequested before it is evicted
+const uint32_t maximumUnusedFrames = 300;
+
+namespace Internal {
+
+/**
+ * Right-triangulated irregular network over a (tileSize + 1)^2 grid of heights.
+ * Every triangle in the hierarchy is a right isosceles triangle which is split along its hypotenuse. The error of a
+ * split point includes the errors of every split below it, so selecting by error never produces T-junctions.
+ */
+class RightTriangulation {
+public:
+    RightTriangulation(const std::vector<float> &heights, uint32_t tileSize)
+        : heights(heights), tileSize(tileSize), gridSize(tileSize + 1), errors(gridSize * gridSize, 0.0f) {
+        computeErrors();
+    }
+
+    void extract(float maxError, std::vector<glm::uvec2> &vertices, std::vector<uint32_t> &indices) {
+        std::vector<uint32_t> vertexIds(gridSize * gridSize, 0);
+
+        this->maxError = maxError;
+        this->vertexIds = &vertexIds;
+        this->vertices = &vertices;
+        this->indices = &indices;
+
+        extractTriangle(0, 0, tileSize, tileSize, tileSize, 0);
+        extractTriangle(tileSize, tileSize, 0, 0, 0, tileSize);
+    }
+
+private:
+    const std::vector<float> &heights;
+    uint32_t tileSize;
+    uint32_t gridSize;
+    std::vector<float> errors;
+
+    // Extraction state
+    float maxError { 0 };
+    std::vector<uint32_t> *vertexIds { nullptr };
+    std::vector<glm::uvec2> *vertices { nullptr };
+    std::vector<uint32_t> *indices { nullptr };
+
+    void computeErrors() {
+        auto triangleCount = tileSize * tileSize * 2 - 2;
+        auto parentCount = triangleCount - tileSize * tileSize;
+
+        // Visit the triangles from the smallest to the largest so child errors are known before their parents
+        for (int64_t index = triangleCount - 1; index >= 0; --index) {
+            auto id = static_cast<uint32_t>(index + 2);
+
+            uint32_t ax = 0, ay = 0, bx = 0, by = 0, cx = 0, cy = 0;
+            if (id & 1) {
+                bx = by = cx = tileSize;
+            } else {
+                ax = ay = cy = tileSize;
+            }
+
+            while ((id >>= 1) > 1) {
+                auto mx = (ax + bx) >> 1;
+                auto my = (ay + by) >> 1;
+
+                if (id & 1) {
+                    bx = ax;
+                    by = ay;
+                    ax = cx;
+                    ay = cy;
+                } else {
+                    ax = bx;
+                    ay = by;
+                    bx = cx;
+                    by = cy;
+                }
+                cx = mx;
+                cy = my;
+            }
+
+            auto mx = (ax + bx) >> 1;
+            auto my = (ay + by) >> 1;
+
+            auto interpolated = (heights[ay * gridSize + ax] + heights[by * gridSize + bx]) / 2;
+            auto middle = my * gridSize + mx;
+            auto error = std::max(errors[middle], std::abs(interpolated - heights[middle]));
+
+            if (static_cast<uint32_t>(index) < parentCount) {
+                // The apex of the triangle, used to locate the split points of the children
+                auto apexX = mx + my - ay;
+                auto apexY = my + ax - mx;
+
+                auto left = ((ay + apexY) >> 1) * gridSize + ((ax + apexX) >> 1);
+                auto right = ((by + apexY) >> 1) * gridSize + ((bx + apexX) >> 1);
+                error = std::max({ error, errors[left], errors[right] });
+            }
+
+            errors[middle] = error;
+        }
+    }
+
+    void extractTriangle(uint32_t ax, uint32_t ay, uint32_t bx, uint32_t by, uint32_t cx, uint32_t cy) {
+        auto mx = (ax + bx) >> 1;
+        auto my = (ay + by) >> 1;
+
+        auto legLength = (ax > cx ? ax - cx : cx - ax) + (ay > cy ? ay - cy : cy - ay);
+        if (legLength > 1 && errors[my * gridSize + mx] > maxError) {
+            extractTriangle(cx, cy, ax, ay, mx, my);
+            extractTriangle(bx, by, cx, cy, mx, my);
+            return;
+        }
+
+        auto a = vertexFor(ax, ay);
+        auto b = vertexFor(bx, by);
+        auto c = vertexFor(cx, cy);
+
+        // Keep the same winding as the grid mesh
+        auto cross = (static_cast<int32_t>(bx) - static_cast<int32_t>(ax)) *
+            (static_cast<int32_t>(cy) - static_cast<int32_t>(ay)) -
+            (static_cast<int32_t>(by) - static_cast<int32_t>(ay)) *
+                (static_cast<int32_t>(cx) - static_cast<int32_t>(ax));
+
+        indices->push_back(a);
+        if (cross >= 0) {
+            indices->push_back(b);
+            indices->push_back(c);
+        } else {
+            indices->push_back(c);
+            indices->push_back(b);
+        }
+    }
+
+    uint32_t vertexFor(uint32_t x, uint32_t y) {
+        auto &id = (*vertexIds)[y * gridSize + x];
+        if (id == 0) {
+            vertices->emplace_back(x, y);
+            id = static_cast<uint32_t>(vertices->size());
+        }
+
+        return id - 1;
+    }
+};
+
+bool isBorderEdge(const glm::uvec2 &a, const glm::uvec2 &b, uint32_t tileSize) {
+    return (a.x == b.x && (a.x == 0 || a.x == tileSize)) || (a.y == b.y && (a.y == 0 || a.y == tileSize));
+}
+
+}
+
+TinCache::TinCache(Engine::RenderEngine &engine, ThreadPool &workers)
+    : engine(engine), workers(workers) {}
+
+TinCache::~TinCache() {
+    // Builds reference the cache, they must not outlive it
+    workers.wait();
+    clear();
+}
+
+void TinCache::setHeightmap(Heightmap *heightmap, const glm::vec2 &worldOffset, const glm::vec2 &worldSize) {
+    this->heightmap = heightmap;
+    this->worldOffset = worldOffset;
+    this->worldSize = worldSize;
+    clear();
+}
+
+void TinCache::setMeshSize(uint32_t size) {
+    if (meshSize == size) {
+        return;
+    }
+
+    meshSize = size;
+    clear();
+}
+
+void TinCache::setMaxError(float error) {
+    maxError = error;
+
+    // Keep the current TINs on screen until their replacements are ready
+    for (auto &pair : entries) {
+        pair.second.stale = true;
+    }
+}
+
+void TinCache::clear() {
+    for (auto &pair : entries) {
+        removeEntry(pair.second);
+    }
+    entries.clear();
+}
+
+const TinCache::Tile *TinCache::request(size_t nodeId, const glm::vec2 &worldMin, float nodeSize) {
+    if (!heightmap) {
+        return nullptr;
+    }
+
+    auto &entry = entries[nodeId];
+    entry.lastUsedFrame = frame;
+
+    if (entry.stale && !entry.building) {
+        entry.worldMin = worldMin;
+        entry.size = nodeSize;
+        queueBuild(nodeId, entry);
+    }
+
+    if (!entry.tile.mesh) {
+        return nullptr;
+    }
+
+    return &entry.tile;
+}
+
+void TinCache::invalidate(const glm::vec2 &worldMin, const glm::vec2 &worldMax) {
+    for (auto &pair : entries) {
+        auto &entry = pair.second;
+        if (
+            entry.worldMin.x <= worldMax.x && entry.worldMin.x + entry.size >= worldMin.x &&
+                entry.worldMin.y <= worldMax.y && entry.worldMin.y + entry.size >= worldMin.y
+            ) {
+            entry.stale = true;
+            // A build in progress used the old heights
+            entry.building = false;
+        }
+    }
+}
+
+void TinCache::update() {
+    ++frame;
+
+    std::vector<BuildResult> finished;
+    {
+        std::lock_guard<std::mutex> lock(resultLock);
+        finished.swap(results);
+    }
+
+    for (auto &result : finished) {
+        auto it = entries.find(result.nodeId);
+        if (it == entries.end() || it->second.generation != result.generation) {
+            // Superseded by a newer build
+            continue;
+        }
+
+        auto &entry = it->second;
+        entry.building = false;
+
+        if (!entry.tile.mesh) {
+            entry.meshName = "cdlod-tin-" + std::to_string(result.nodeId);
+            entry.tile.mesh = engine.createDynamicMesh<Engine::Vertex>(entry.meshName)
+                .withGrowing(result.vertices.size(), result.indices.size())
+                .withShinking(result.vertices.size() * sizeof(Engine::Vertex))
+                .withMaximumVertexCapacity((meshSize + 1) * (meshSize + 1) * 2)
+                .withMaximumIndexCapacity(meshSize * meshSize * 6 + meshSize * 4 * 12)
+                .withInitialVertexCapacity(result.vertices.size())
+                .withInitialIndexCapacity(result.indices.size())
+                .build();
+        }
+
+        entry.tile.mesh->replaceAll(result.vertices, result.indices);
+        entry.tile.vertexCount = static_cast<uint32_t>(result.vertices.size());
+        entry.tile.triangleCount = static_cast<uint32_t>(result.indices.size() / 3);
+    }
+
+    // Evict anything which has not been looked at for a while
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (frame - it->second.lastUsedFrame > maximumUnusedFrames) {
+            removeEntry(it->second);
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+uint32_t TinCache::getPendingCount() const {
+    uint32_t count = 0;
+    for (auto &pair : entries) {
+        if (pair.second.building) {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+size_t TinCache::getMemoryUsage() const {
+    size_t total = 0;
+    for (auto &pair : entries) {
+        auto &tile = pair.second.tile;
+        total += tile.vertexCount * sizeof(Engine::Vertex) + tile.triangleCount * 3 * sizeof(uint32_t);
+    }
+
+    return total;
+}
+
+void TinCache::queueBuild(size_t nodeId, Entry &entry) {
+    entry.stale = false;
+    entry.building = true;
+    entry.generation = nextGeneration++;
+
+    auto generation = entry.generation;
+    auto nodeSize = entry.size;
+    auto tileSize = meshSize;
+    auto error = maxError;
+    auto gridSize = tileSize + 1;
+    auto cellSize = nodeSize / static_cast<float>(tileSize);
+
+    // The heights are sampled here as the heightmap is written on the render thread, the build only gets the copy
+    std::vector<glm::vec2> coords(gridSize * gridSize);
+    for (uint32_t y = 0; y < gridSize; ++y) {
+        for (uint32_t x = 0; x < gridSize; ++x) {
+            auto worldX = entry.worldMin.x + static_cast<float>(x) * cellSize;
+            auto worldY = entry.worldMin.y + static_cast<float>(y) * cellSize;
+
+            coords[y * gridSize + x] = {
+                (worldX - worldOffset.x) / worldSize.x * heightmap->getWidth(),
+                (worldY - worldOffset.y) / worldSize.y * heightmap->getHeight()
+            };
+        }
+    }
+
+    // Clamped to the edges of the heightmap
+    std::vector<float> heights(coords.size());
+    heightmap->getHeightsAt(coords, heights);
+
+    workers.submit(
+        [this, nodeId, generation, nodeSize, tileSize, error, cellSize, heights = std::move(heights)]() {
+            PROFILE_ZONE("TinCache::build");
+
+            std::vector<glm::uvec2> points;
+            std::vector<uint32_t> triangles;
+            Internal::RightTriangulation triangulation(heights, tileSize);
+            triangulation.extract(error, points, triangles);
+
+            BuildResult result { nodeId, generation };
+
+            auto scale = 1 / static_cast<float>(tileSize);
+            result.vertices.reserve(points.size() * 2);
+            for (auto &point : points) {
+                auto u = static_cast<float>(point.x) * scale;
+                auto v = static_cast<float>(point.y) * scale;
+
+                result.vertices.push_back(
+                    {
+                        { u, v, 0.0f },
+                        { 0, 0, 1 },
+                        { 1, 1, 1, 1 },
+                        { u, v }
+                    }
+                );
+            }
+
+            result.indices = triangles;
+
+            // Hang a skirt below every edge on the border of the node. z is in node units, the shader scales it.
+            auto skirtDepth = -std::max(error * 2, cellSize) / nodeSize;
+            for (size_t index = 0; index < triangles.size(); index += 3) {
+                for (uint32_t edge = 0; edge < 3; ++edge) {
+                    auto first = triangles[index + edge];
+                    auto second = triangles[index + (edge + 1) % 3];
+
+                    if (!Internal::isBorderEdge(points[first], points[second], tileSize)) {
+                        continue;
+                    }
+
+                    auto lowFirst = static_cast<uint32_t>(result.vertices.size());
+                    auto lowSecond = lowFirst + 1;
+
+                    auto low = result.vertices[first];
+                    low.pos.z = skirtDepth;
+                    result.vertices.push_back(low);
+                    low = result.vertices[second];
+                    low.pos.z = skirtDepth;
+                    result.vertices.push_back(low);
+
+                    // Both faces so the skirt is visible from either side of the crack
+                    result.indices.insert(
+                        result.indices.end(), {
+                            first, lowFirst, second, second, lowFirst, lowSecond,
+                            first, second, lowFirst, second, lowSecond, lowFirst
+                        }
+                    );
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(resultLock);
+            results.push_back(std::move(result));
+        }
+    );
+}
+
+void TinCache::removeEntry(Entry &entry) {
+    if (entry.tile.mesh) {
+        engine.removeMesh(entry.meshName);
+        entry.tile.mesh = nullptr;
+    }
+}
+
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <tech-core/mesh.hpp>
+#include <tech-core/engine.hpp>
+#include <tech-core/vertex.hpp>
+
+#include "structures.hpp"
+#include "../heightmap.hpp"
+#include "../utils/thread_pool.hpp"
+
+// Forward
+template<typename T>
+class InstanceBuffer;
+
+namespace Terrain::CDLOD {
+
+/**
+ * Caches a simplified triangulation (TIN) of the terrain for each coarse LOD node.
+ * The TIN is a right-triangulated irregular network over the node's grid: triangles are only split where the terrain
+ * deviates from them by more than the error bound, so flat areas collapse into a few large triangles.
+ * Vertices only carry their position within the node, heights are still sampled in the vertex shader.
+ * A skirt is hung below the edges of each TIN to hide the cracks against neighbouring grid tiles.
+ *
+ * Builds run on the worker threads, the meshes are created and uploaded on the render thread in update().
+ */
+class TinCache {
+public:
+    struct Tile {
+        Engine::DynamicMesh<Engine::Vertex> *mesh { nullptr };
+        uint32_t triangleCount { 0 };
+        uint32_t vertexCount { 0 };
+    };
+
+    TinCache(Engine::RenderEngine &engine, ThreadPool &workers);
+    ~TinCache();
+
+    void setHeightmap(Heightmap *heightmap, const glm::vec2 &worldOffset, const glm::vec2 &worldSize);
+
+    uint32_t getMeshSize() const { return meshSize; }
+
+    void setMeshSize(uint32_t size);
+
+    float getMaxError() const { return maxError; }
+
+    void setMaxError(float error);
+
+    /**
+     * Drops every cached TIN
+     */
+    void clear();
+
+    /**
+     * Gets the TIN for a node, queuing a build if it is missing or out of date.
+     * An out of date TIN is still returned while it is rebuilt as the heights are sampled on the GPU anyway.
+     * @return The tile, or nullptr if nothing has been built for the node yet
+     */
+    const Tile *request(size_t nodeId, const glm::vec2 &worldMin, float nodeSize);
+
+    /**
+     * Marks every TIN overlapping the world region as out of date
+     */
+    void invalidate(const glm::vec2 &worldMin, const glm::vec2 &worldMax);
+
+    /**
+     * Uploads finished builds and evicts TINs which have not been requested recently.
+     * Must be called on the render thread.
+     */
+    void update();
+
+    size_t getCachedCount() const { return entries.size(); }
+
+    uint32_t getPendingCount() const;
+
+    size_t getMemoryUsage() const;
+
+private:
+    struct Entry {
+        Tile tile;
+        std::string meshName;
+        glm::vec2 worldMin;
+        float size { 0 };
+        uint32_t generation { 0 };
+        uint32_t lastUsedFrame { 0 };
+        bool stale { true };
+        bool building { false };
+    };
+
+    struct BuildResult {
+        size_t nodeId;
+        uint32_t generation;
+        std::vector<Engine::Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    Engine::RenderEngine &engine;
+    ThreadPool &workers;
+
+    Heightmap *heightmap { nullptr };
+    glm::vec2 worldOffset { 0, 0 };
+    glm::vec2 worldSize { 0, 0 };
+
+    uint32_t meshSize { 32 };
+    float maxError { 1.0f };
+
+    std::unordered_map<size_t, Entry> entries;
+    uint32_t nextGeneration { 1 };
+    uint32_t frame { 0 };
+
+    std::mutex resultLock;
+    std::vector<BuildResult> results;
+
+    void queueBuild(size_t nodeId, Entry &entry);
+    void removeEntry(Entry &entry);
+};
+
+/**
+ * Where LODTree::walkTree places nodes which are drawn with a TIN instead of the regular grid
+ */
+struct TinSelection {
+    TinCache &cache;
+    // Nodes at this level and above use their TIN
+    uint32_t minimumLevel;
+    InstanceBuffer<MeshInstanceData> &tiles;
+    // The tile for each instance in tiles
+    std::vector<const TinCache::Tile *> &selected;
+};
+
+}
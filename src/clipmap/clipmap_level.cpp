@@ -0,0 +1,110 @@
+#include "clipmap_level.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Terrain::Clipmap {
+
+ClipmapLevel::ClipmapLevel(uint32_t level, float blockSize, uint32_t blocksPerSide, uint32_t samplesPerBlock)
+    : level(level), blockSize(blockSize), blocksPerSide(blocksPerSide), samplesPerBlock(samplesPerBlock) {
+    cellSize = blockSize / static_cast<float>(samplesPerBlock);
+    cellsPerSide = static_cast<int32_t>(blocksPerSide * samplesPerBlock + 1);
+    heights.resize(cellsPerSide * cellsPerSide);
+}
+
+glm::vec2 ClipmapLevel::getWorldMin() const {
+    return glm::vec2(origin) * cellSize;
+}
+
+uint32_t ClipmapLevel::moveTo(const glm::vec2 &worldMin, const HeightSampler &sampler) {
+    glm::ivec2 newOrigin {
+        static_cast<int32_t>(std::round(worldMin.x / cellSize)),
+        static_cast<int32_t>(std::round(worldMin.y / cellSize))
+    };
+
+    if (hasData && newOrigin == origin) {
+        return 0;
+    }
+
+    auto oldOrigin = origin;
+    auto hadData = hasData;
+    auto delta = glm::abs(newOrigin - oldOrigin);
+
+    origin = newOrigin;
+    hasData = true;
+
+    uint32_t updated = 0;
+    if (!hadData || delta.x >= cellsPerSide || delta.y >= cellsPerSide) {
+        // Nothing can be reused
+        for (int32_t y = origin.y; y < origin.y + cellsPerSide; ++y) {
+            for (int32_t x = origin.x; x < origin.x + cellsPerSide; ++x) {
+                sample(x, y, sampler);
+            }
+        }
+
+        return cellsPerSide * cellsPerSide;
+    }
+
+    // Only sample the cells which were not within the old region
+    for (int32_t y = origin.y; y < origin.y + cellsPerSide; ++y) {
+        bool rowIsNew = (y < oldOrigin.y || y >= oldOrigin.y + cellsPerSide);
+
+        for (int32_t x = origin.x; x < origin.x + cellsPerSide; ++x) {
+            if (rowIsNew || x < oldOrigin.x || x >= oldOrigin.x + cellsPerSide) {
+                sample(x, y, sampler);
+                ++updated;
+            }
+        }
+    }
+
+    return updated;
+}
+
+void ClipmapLevel::invalidate(const glm::vec2 &worldMin, const glm::vec2 &worldMax, const HeightSampler &sampler) {
+    if (!hasData) {
+        return;
+    }
+
+    auto minX = std::max(static_cast<int32_t>(std::floor(worldMin.x / cellSize)), origin.x);
+    auto minY = std::max(static_cast<int32_t>(std::floor(worldMin.y / cellSize)), origin.y);
+    auto maxX = std::min(static_cast<int32_t>(std::ceil(worldMax.x / cellSize)), origin.x + cellsPerSide - 1);
+    auto maxY = std::min(static_cast<int32_t>(std::ceil(worldMax.y / cellSize)), origin.y + cellsPerSide - 1);
+
+    for (int32_t y = minY; y <= maxY; ++y) {
+        for (int32_t x = minX; x <= maxX; ++x) {
+            sample(x, y, sampler);
+        }
+    }
+}
+
+void ClipmapLevel::getBlockHeightRange(uint32_t blockX, uint32_t blockY, float &minimum, float &maximum) const {
+    auto startX = origin.x + static_cast<int32_t>(blockX * samplesPerBlock);
+    auto startY = origin.y + static_cast<int32_t>(blockY * samplesPerBlock);
+
+    minimum = std::numeric_limits<float>::max();
+    maximum = std::numeric_limits<float>::lowest();
+
+    for (int32_t y = startY; y <= startY + static_cast<int32_t>(samplesPerBlock); ++y) {
+        for (int32_t x = startX; x <= startX + static_cast<int32_t>(samplesPerBlock); ++x) {
+            auto height = heights[wrap(x) + wrap(y) * cellsPerSide];
+            minimum = std::min(minimum, height);
+            maximum = std::max(maximum, height);
+        }
+    }
+}
+
+uint32_t ClipmapLevel::wrap(int32_t cell) const {
+    auto wrapped = cell % cellsPerSide;
+    if (wrapped < 0) {
+        wrapped += cellsPerSide;
+    }
+    return static_cast<uint32_t>(wrapped);
+}
+
+void ClipmapLevel::sample(int32_t cellX, int32_t cellY, const HeightSampler &sampler) {
+    heights[wrap(cellX) + wrap(cellY) * cellsPerSide] = sampler(
+        static_cast<float>(cellX) * cellSize, static_cast<float>(cellY) * cellSize
+    );
+}
+
+}
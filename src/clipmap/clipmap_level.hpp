@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <functional>
+#include <vector>
+
+namespace Terrain::Clipmap {
+
+typedef std::function<float(float x, float y)> HeightSampler;
+
+/**
+ * A single ring of the clipmap.
+ * The heights covered by the level are cached in a toroidal grid. When the level scrolls only the rows and columns
+ * which have come into view are resampled, the rest of the cache is reused in place by wrapping the addressing.
+ * The cache is on the CPU and only gives the height range of each block for culling, it is not uploaded.
+ */
+class ClipmapLevel {
+public:
+    ClipmapLevel(uint32_t level, float blockSize, uint32_t blocksPerSide, uint32_t samplesPerBlock);
+
+    uint32_t getLevel() const { return level; }
+
+    float getBlockSize() const { return blockSize; }
+
+    uint32_t getBlocksPerSide() const { return blocksPerSide; }
+
+    /**
+     * The world coordinates of the minimum corner of the level
+     */
+    glm::vec2 getWorldMin() const;
+
+    /**
+     * Scrolls the level so its minimum corner is at the given world position.
+     * The position must be aligned to the block size of this level.
+     * @return The number of heights that needed to be resampled
+     */
+    uint32_t moveTo(const glm::vec2 &worldMin, const HeightSampler &sampler);
+
+    /**
+     * Resamples any cached heights within the world region
+     */
+    void invalidate(const glm::vec2 &worldMin, const glm::vec2 &worldMax, const HeightSampler &sampler);
+
+    void getBlockHeightRange(uint32_t blockX, uint32_t blockY, float &minimum, float &maximum) const;
+
+    size_t getMemoryUsage() const { return heights.size() * sizeof(float); }
+
+private:
+    uint32_t level;
+    float blockSize;
+    uint32_t blocksPerSide;
+    uint32_t samplesPerBlock;
+
+    float cellSize;
+    int32_t cellsPerSide;
+
+    // Global cell coordinate of the minimum corner
+    glm::ivec2 origin { 0, 0 };
+    bool hasData { false };
+
+    std::vector<float> heights;
+
+    uint32_t wrap(int32_t cell) const;
+    void sample(int32_t cellX, int32_t cellY, const HeightSampler &sampler);
+};
+
+}
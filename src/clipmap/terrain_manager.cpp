@@ -0,0 +1,421 @@
+#include "terrain_manager.hpp"
+#include <tech-core/vertex.hpp>
+#include <tech-core/camera.hpp>
+#include <tech-core/pipeline.hpp>
+#include <tech-core/texture/manager.hpp>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+#include "../utils/instance_buffer.inl"
+#include "../utils/grid_mesh.hpp"
+#include <imgui.h>
+#include <array>
+
+namespace Terrain::Clipmap {
+
+std::array<uint32_t, 7> meshSizes = { 256, 128, 64, 32, 16, 8, 4 };
+std::array<const char *, 7> meshSizeNames = { "256", "128", "64", "32", "16", "8", "4" };
+
+const Engine::Subsystem::SubsystemID<TerrainManager> TerrainManager::ID;
+
+void TerrainManager::setCamera(Engine::Camera *camera) {
+    this->camera = camera;
+}
+
+void TerrainManager::setEnabled(bool enable) {
+    enabled = enable;
+}
+
+void TerrainManager::setWireframe(bool enable) {
+    wireframe = enable;
+}
+
+void TerrainManager::setDebugMode(uint32_t mode) {
+    terrainUniform.debugMode = mode % 2;
+}
+
+void TerrainManager::setMeshSize(uint32_t size) {
+    meshSize = size;
+    terrainUniform.terrainMorphConstants = { static_cast<float>(meshSize) * 0.5f, 2 / static_cast<float>(meshSize) };
+    regenerateMesh();
+}
+
+void TerrainManager::setLevelCount(uint32_t count) {
+    levelCount = count;
+    generateLevels();
+    generateInstanceBuffer();
+}
+
+void TerrainManager::setWorldSize(const glm::vec2 &size) {
+    worldSize = size;
+    worldOffset = -size / 2.0f;
+    generateLevels();
+}
+
+void TerrainManager::regenerateMesh() {
+    if (blockMesh) {
+        engine->removeMesh(blockMeshName);
+    }
+
+    std::sprintf(blockMeshName, "clipmap-mesh-%d", meshSize);
+
+    std::vector<Engine::Vertex> vertices;
+    std::vector<uint16_t> indices;
+    generateGridMesh(meshSize, vertices, indices);
+
+    blockMesh = engine->createStaticMesh<Engine::Vertex>(blockMeshName)
+        .withVertices(vertices)
+        .withIndices(indices)
+        .build();
+}
+
+void TerrainManager::generateLevels() {
+    levels.clear();
+    levels.reserve(levelCount);
+
+    float blockSize = baseBlockSize;
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        levels.emplace_back(level, blockSize, blocksPerSide, samplesPerBlock);
+        blockSize *= 2;
+    }
+}
+
+void TerrainManager::generateInstanceBuffer() {
+    // Every block of every level is the worst case
+    auto capacity = levelCount * blocksPerSide * blocksPerSide;
+
+    tiles = std::make_unique<InstanceBuffer<CDLOD::MeshInstanceData>>(capacity, *engine);
+}
+
+void TerrainManager::initialiseResources(
+    vk::Device device, vk::PhysicalDevice physicalDevice, Engine::RenderEngine &engine
+) {
+    this->engine = &engine;
+    this->device = device;
+
+    vk::SamplerCreateInfo samplerCreateInfo(
+        {}, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear,
+        vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge
+    );
+    samplerCreateInfo.setAnisotropyEnable(VK_FALSE);
+    heightmapSampler = device.createSampler(samplerCreateInfo);
+
+    textureSamplerId = engine.getMaterialManager().createSampler(
+        {
+            vk::Filter::eLinear,
+            vk::Filter::eLinear,
+            vk::SamplerMipmapMode::eLinear,
+            true
+        }
+    );
+    textureSampler = engine.getMaterialManager().getSamplerById(textureSamplerId);
+
+    regenerateMesh();
+    generateLevels();
+    generateInstanceBuffer();
+
+    terrainUniform.terrainMorphConstants = { static_cast<float>(meshSize) * 0.5f, 2 / static_cast<float>(meshSize) };
+}
+
+void TerrainManager::initialiseSwapChainResources(
+    vk::Device device, Engine::RenderEngine &engine, uint32_t swapChainImages
+) {
+    auto builder = engine.createPipeline()
+        .withVertexShader("assets/shaders/cdlod/vert.spv")
+        .withFragmentShader("assets/shaders/cdlod/frag.spv")
+        .withGeometryType(Engine::PipelineGeometryType::Polygons)
+        .withVertexAttributeDescriptions(Engine::Vertex::getAttributeDescriptions())
+        .withVertexBindingDescription(Engine::Vertex::getBindingDescription())
+        .withVertexAttributeDescriptions(CDLOD::MeshInstanceData::getAttributeDescriptions())
+        .withVertexBindingDescription(CDLOD::MeshInstanceData::getBindingDescription())
+        .withPushConstants<CDLOD::TerrainUniform>(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment)
+        .bindCamera(0, 0)
+        .bindTextures(1, 2);
+
+    if (heightmap) {
+        builder.bindSampledImage(
+            2, 1, heightmap->getImageTemp(), vk::ShaderStageFlagBits::eVertex, vk::ImageLayout::eGeneral,
+            heightmapSampler
+        );
+        builder.bindSampledImage(
+            2, 4, heightmap->getNormalMap(), vk::ShaderStageFlagBits::eFragment, vk::ImageLayout::eGeneral,
+            heightmapSampler
+        );
+    } else {
+        builder.bindSampledImage(2, 1, vk::ShaderStageFlagBits::eVertex, vk::ImageLayout::eGeneral, heightmapSampler);
+        builder.bindSampledImage(2, 4, vk::ShaderStageFlagBits::eFragment, vk::ImageLayout::eGeneral, heightmapSampler);
+    }
+
+    if (painter) {
+        builder.bindSampledImage(
+            2, 3, painter->getSplatAtlas(), vk::ShaderStageFlagBits::eFragment, vk::ImageLayout::eGeneral,
+            heightmapSampler
+        );
+        builder.bindSampledImage(
+            2, 5, painter->getPageTable(), vk::ShaderStageFlagBits::eFragment, vk::ImageLayout::eGeneral,
+            heightmapSampler
+        );
+    } else {
+        builder.bindSampledImage(2, 3, vk::ShaderStageFlagBits::eFragment, vk::ImageLayout::eGeneral, heightmapSampler);
+        builder.bindSampledImage(2, 5, vk::ShaderStageFlagBits::eFragment, vk::ImageLayout::eGeneral, heightmapSampler);
+    }
+
+    pipeline = builder.build();
+    pipelineWireframe = builder.withFillMode(Engine::FillMode::Wireframe).build();
+}
+
+void TerrainManager::cleanupResources(vk::Device device, Engine::RenderEngine &engine) {
+    device.destroy(heightmapSampler);
+
+    tiles.reset();
+}
+
+void TerrainManager::cleanupSwapChainResources(vk::Device device, Engine::RenderEngine &engine) {
+    pipeline.reset();
+    pipelineWireframe.reset();
+}
+
+void TerrainManager::writeFrameCommands(vk::CommandBuffer commandBuffer, uint32_t activeImage) {
+    if (!enabled) {
+        return;
+    }
+
+    Engine::Pipeline *currentPipeline;
+    if (wireframe) {
+        currentPipeline = pipelineWireframe.get();
+    } else {
+        currentPipeline = pipeline.get();
+    }
+
+    currentPipeline->bind(commandBuffer, activeImage);
+
+    auto binding = engine->getTextureManager().getBinding(textureArray, textureSamplerId, textureSampler);
+    currentPipeline->bindDescriptorSets(commandBuffer, 1, 1, &binding, 0, nullptr);
+
+    currentPipeline->push(
+        commandBuffer, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, terrainUniform
+    );
+
+    tiles->draw(commandBuffer, *blockMesh);
+}
+
+void TerrainManager::prepareFrame(uint32_t activeImage) {
+    if (!enabled) {
+        statistics = {};
+        return;
+    }
+
+    if (textureArray == 0xFFFFFFFF) {
+        auto texture = engine->getTextureManager().getTexture("green");
+        textureArray = texture->arrayId;
+    }
+
+    auto selectionStart = std::chrono::high_resolution_clock::now();
+
+    auto origin = camera->getPosition();
+    updateLevels({ origin.x, origin.y });
+    selectTiles(origin, camera->getFrustum());
+
+    std::chrono::duration<double> selectionTime = std::chrono::high_resolution_clock::now() - selectionStart;
+
+    terrainUniform.cameraOrigin = origin;
+
+    statistics.selectionTime = selectionTime.count();
+    statistics.instances = tiles->size();
+    statistics.triangles = static_cast<uint64_t>(tiles->size()) * meshSize * meshSize * 2;
+    statistics.memoryUsage = tiles->capacity() * sizeof(CDLOD::MeshInstanceData)
+        + (meshSize + 1) * (meshSize + 1) * sizeof(Engine::Vertex)
+        + meshSize * meshSize * 6 * sizeof(uint16_t);
+    for (auto &level : levels) {
+        statistics.memoryUsage += level.getMemoryUsage();
+    }
+    // There are no textures per level, the shaders sample the whole heightmap
+    statistics.textureMemoryUsage = heightmap ? heightmap->getTextureMemoryUsage() : 0;
+}
+
+void TerrainManager::writeBarriers(vk::CommandBuffer commandBuffer) {
+    if (!enabled) {
+        return;
+    }
+
+    painter->getSplatAtlas()->transition(commandBuffer, vk::ImageLayout::eGeneral, true);
+    painter->getPageTable()->transition(commandBuffer, vk::ImageLayout::eGeneral, true);
+    heightmap->getNormalMap()->transition(commandBuffer, vk::ImageLayout::eGeneral, true);
+}
+
+void TerrainManager::setHeightmap(Heightmap &heightmap) {
+    this->heightmap = &heightmap;
+
+    pipeline->bindImage(2, 1, heightmap.getImageTemp());
+    pipeline->bindImage(2, 4, heightmap.getNormalMap());
+    pipelineWireframe->bindImage(2, 1, heightmap.getImageTemp());
+    pipelineWireframe->bindImage(2, 4, heightmap.getNormalMap());
+
+    terrainUniform.heightOffset = heightmap.getMinElevation();
+    terrainUniform.heightScale = heightmap.getMaxElevation() - heightmap.getMinElevation();
+    terrainUniform.terrainHalfSize = { heightmap.getWidth() / 2.0f, heightmap.getHeight() / 2.0f };
+
+    // Cached heights are from the old heightmap
+    generateLevels();
+}
+
+void TerrainManager::setTerrainPainter(TerrainPainter &terrainPainter) {
+    painter = &terrainPainter;
+    pipeline->bindImage(2, 3, painter->getSplatAtlas());
+    pipeline->bindImage(2, 5, painter->getPageTable());
+    pipelineWireframe->bindImage(2, 3, painter->getSplatAtlas());
+    pipelineWireframe->bindImage(2, 5, painter->getPageTable());
+
+    terrainUniform.splatOffset = painter->getSplatOffset();
+    terrainUniform.splatScale = painter->getSplatScale();
+}
+
+void TerrainManager::invalidateHeightmap(const glm::ivec2 &min, const glm::ivec2 &max) {
+    if (!heightmap) {
+        return;
+    }
+
+    glm::vec2 heightmapSize { heightmap->getWidth(), heightmap->getHeight() };
+    auto worldMin = glm::vec2(min) / heightmapSize * worldSize + worldOffset;
+    auto worldMax = glm::vec2(max) / heightmapSize * worldSize + worldOffset;
+
+    auto sampler = [this](float x, float y) { return sampleHeight(x, y); };
+    for (auto &level : levels) {
+        level.invalidate(worldMin, worldMax, sampler);
+    }
+}
+
+void TerrainManager::drawGUI() {
+    if (ImGui::Combo("Block Mesh Size", &meshSizeIndex, meshSizeNames.data(), meshSizeNames.size())) {
+        setMeshSize(meshSizes[meshSizeIndex]);
+    }
+
+    if (ImGui::SliderInt("Levels", reinterpret_cast<int *>(&levelCount), 2, 10)) {
+        setLevelCount(levelCount);
+    }
+
+    ImGui::Spacing();
+
+    ImGui::Text("Tiles: %i", tiles->size());
+    ImGui::Text("Heights resampled: %u", samplesUpdated);
+}
+
+float TerrainManager::sampleHeight(float x, float y) const {
+    if (!heightmap || worldSize.x <= 0 || worldSize.y <= 0) {
+        return 0;
+    }
+
+    auto maxX = static_cast<float>(heightmap->getWidth() - 1);
+    auto maxY = static_cast<float>(heightmap->getHeight() - 1);
+
+    auto heightmapX = std::clamp((x - worldOffset.x) / worldSize.x * heightmap->getWidth(), 0.0f, maxX);
+    auto heightmapY = std::clamp((y - worldOffset.y) / worldSize.y * heightmap->getHeight(), 0.0f, maxY);
+
+    return heightmap->getHeightAt(heightmapX, heightmapY);
+}
+
+void TerrainManager::updateLevels(const glm::vec2 &center) {
+    auto sampler = [this](float x, float y) { return sampleHeight(x, y); };
+
+    samplesUpdated = 0;
+    for (auto &level : levels) {
+        auto blockSize = level.getBlockSize();
+
+        // Snapping to twice the block size keeps the hole left for the finer level aligned with whole blocks
+        auto snap = blockSize * 2;
+        glm::vec2 levelCenter = glm::round(center / snap) * snap;
+        auto halfExtent = blockSize * static_cast<float>(blocksPerSide) / 2;
+
+        samplesUpdated += level.moveTo(levelCenter - halfExtent, sampler);
+    }
+}
+
+void TerrainManager::selectTiles(const glm::vec3 &origin, const Engine::Frustum &frustum) {
+    struct Candidate {
+        glm::vec2 min;
+        float distance;
+    };
+
+    tiles->clear();
+
+    std::vector<Candidate> candidates;
+    candidates.reserve(blocksPerSide * blocksPerSide);
+
+    glm::vec2 origin2D { origin.x, origin.y };
+    auto worldMax = worldOffset + worldSize;
+
+    // Finest level first so that the tiles are drawn roughly front to back
+    for (uint32_t index = 0; index < levels.size(); ++index) {
+        auto &level = levels[index];
+        auto blockSize = level.getBlockSize();
+        auto levelMin = level.getWorldMin();
+
+        glm::ivec2 holeMin { -1, -1 };
+        glm::ivec2 holeMax { -1, -1 };
+        if (index > 0) {
+            holeMin = glm::ivec2(glm::round((levels[index - 1].getWorldMin() - levelMin) / blockSize));
+            holeMax = holeMin + static_cast<int32_t>(blocksPerSide / 2);
+        }
+
+        // The camera is always at least this far inside the level, so morphing into the next level has to finish
+        // before reaching it
+        auto coverage = (static_cast<float>(blocksPerSide) / 2 - 1) * blockSize;
+        glm::vec2 morphRange;
+        if (index + 1 < levels.size()) {
+            morphRange = { coverage * 0.6f, coverage * 0.4f };
+        } else {
+            morphRange = { std::numeric_limits<float>::max(), 1 };
+        }
+
+        auto blockCount = static_cast<int32_t>(blocksPerSide);
+
+        candidates.clear();
+        for (int32_t blockY = 0; blockY < blockCount; ++blockY) {
+            for (int32_t blockX = 0; blockX < blockCount; ++blockX) {
+                if (blockX >= holeMin.x && blockX < holeMax.x && blockY >= holeMin.y && blockY < holeMax.y) {
+                    continue;
+                }
+
+                glm::vec2 blockMin = levelMin + glm::vec2(blockX, blockY) * blockSize;
+                if (blockMin.x >= worldMax.x || blockMin.y >= worldMax.y ||
+                    blockMin.x + blockSize <= worldOffset.x || blockMin.y + blockSize <= worldOffset.y) {
+                    continue;
+                }
+
+                float minZ, maxZ;
+                level.getBlockHeightRange(blockX, blockY, minZ, maxZ);
+
+                Engine::BoundingBox bounds(
+                    blockMin.x, blockMin.y, minZ, blockMin.x + blockSize, blockMin.y + blockSize, maxZ
+                );
+                if (!bounds.intersects(frustum)) {
+                    continue;
+                }
+
+                auto blockCenter = blockMin + blockSize / 2;
+                candidates.push_back({ blockMin, glm::length(blockCenter - origin2D) });
+            }
+        }
+
+        std::sort(
+            candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+                return a.distance < b.distance;
+            }
+        );
+
+        for (auto &candidate : candidates) {
+            // The fragment shader skips textures not in the mask
+            uint32_t materials = SplatTiles::AllMaterials;
+            if (painter) {
+                materials = painter->getMaterialMask(candidate.min, candidate.min + blockSize);
+            }
+
+            tiles->push({ candidate.min, blockSize, materials, morphRange });
+        }
+    }
+
+    tiles->flush();
+}
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <optional>
+
+#include <tech-core/mesh.hpp>
+#include <tech-core/engine.hpp>
+#include <tech-core/subsystem/base.hpp>
+#include <tech-core/shapes/bounding_box.hpp>
+#include <tech-core/shapes/frustum.hpp>
+
+#include "../heightmap.hpp"
+#include "../cdlod/structures.hpp"
+#include "../utils/instance_buffer.hpp"
+#include "../terrain_painter.hpp"
+#include "../terrain_statistics.hpp"
+#include "clipmap_level.hpp"
+
+namespace Terrain::Clipmap {
+namespace _E = Engine;
+
+/**
+ * Nested geometry clipmaps.
+ * Each level is a square of blocks centred on the camera with each level having twice the block size of the
+ * previous. The finer level covers the hole in the middle of the coarser level. Tiles are drawn with the same
+ * instanced grid and shaders as the CDLOD terrain, so morphing handles the transition between levels.
+ * Sharing those shaders means the vertices sample the full heightmap texture rather than a texture per level. Only the
+ * heights each level keeps on the CPU for culling are updated toroidally.
+ */
+class TerrainManager : public Engine::Subsystem::Subsystem {
+public:
+    static const Engine::Subsystem::SubsystemID<TerrainManager> ID;
+
+    void setCamera(Engine::Camera *);
+    void setHeightmap(Heightmap &);
+    void setTerrainPainter(TerrainPainter &);
+    void setWorldSize(const glm::vec2 &size);
+
+    void invalidateHeightmap(const glm::ivec2 &min, const glm::ivec2 &max);
+
+    void setEnabled(bool);
+
+    bool isEnabled() const { return enabled; }
+
+    uint32_t getMeshSize() const { return meshSize; }
+
+    void setMeshSize(uint32_t);
+
+    uint32_t getLevelCount() const { return levelCount; }
+
+    void setLevelCount(uint32_t);
+
+    void setWireframe(bool);
+
+    bool getWireframe() const { return wireframe; }
+
+    void setDebugMode(uint32_t mode);
+
+    uint32_t getDebugMode() const { return terrainUniform.debugMode; }
+
+    const FrameStatistics &getStatistics() const { return statistics; }
+
+    void drawGUI();
+
+    // For engine use
+    void initialiseResources(vk::Device device, vk::PhysicalDevice physicalDevice, _E::RenderEngine &engine);
+    void initialiseSwapChainResources(vk::Device device, _E::RenderEngine &engine, uint32_t swapChainImages);
+    void cleanupResources(vk::Device device, _E::RenderEngine &engine);
+    void cleanupSwapChainResources(vk::Device device, _E::RenderEngine &engine);
+    void writeFrameCommands(vk::CommandBuffer commandBuffer, uint32_t activeImage);
+    void prepareFrame(uint32_t activeImage) override;
+    void writeBarriers(vk::CommandBuffer commandBuffer) override;
+
+private:
+    Engine::RenderEngine *engine { nullptr };
+    Engine::Camera *camera { nullptr };
+    Heightmap *heightmap { nullptr };
+    TerrainPainter *painter { nullptr };
+
+    bool enabled { true };
+    bool wireframe { false };
+
+    Engine::StaticMesh *blockMesh { nullptr };
+    char blockMeshName[32];
+    uint32_t meshSize { 32 };
+    int meshSizeIndex { 3 };
+
+    // Size of a block in the finest level
+    float baseBlockSize { 16 };
+    uint32_t blocksPerSide { 8 };
+    uint32_t samplesPerBlock { 8 };
+    uint32_t levelCount { 7 };
+    std::vector<ClipmapLevel> levels;
+    uint32_t samplesUpdated { 0 };
+
+    glm::vec2 worldSize { 0, 0 };
+    glm::vec2 worldOffset { 0, 0 };
+
+    CDLOD::TerrainUniform terrainUniform;
+    FrameStatistics statistics;
+
+    std::unique_ptr<InstanceBuffer<CDLOD::MeshInstanceData>> tiles;
+
+    vk::Sampler heightmapSampler;
+    uint32_t textureSamplerId { 0 };
+    vk::Sampler textureSampler;
+
+    // Render state
+    vk::Device device;
+    std::unique_ptr<_E::Pipeline> pipeline;
+    std::unique_ptr<_E::Pipeline> pipelineWireframe;
+
+    uint32_t textureArray { 0xFFFFFFFF };
+
+    void regenerateMesh();
+    void generateLevels();
+    void generateInstanceBuffer();
+
+    float sampleHeight(float x, float y) const;
+    void updateLevels(const glm::vec2 &center);
+    void selectTiles(const glm::vec3 &origin, const Engine::Frustum &frustum);
+};
+
+}
@@ -1,65 +1,159 @@
 #include "road.hpp"
 #include "../node/edge.hpp"
-#include <tech-core/shapes/bounding_box.hpp>
-#include <tech-core/engine.hpp>
-#include <sstream>
+#include "../road_corridor.hpp"
+#include "../utils/profiler.hpp"
+#include <algorithm>
+#include <limits>
+#include <utility>
 
 #define GLM_ENABLE_EXPERIMENTAL
 
 #include <glm/gtx/norm.hpp>
 
-uint32_t RoadMesh::nextIndex = 0;
-
-struct ConstructionVertex {
-    Engine::Vertex v;
-    float offset;
-    glm::vec3 originalPos;
+// Limits the size of the mesh on extreme curves, beyond this the error is no longer bounded
+const uint32_t MaxSlices = 2048;
+
+namespace {
+
+// Working space for building. Kept per thread so it is only allocated once
+struct BuildScratch {
+    // Offsets along the edge to cut the template at
+    std::vector<float> slices;
+    // Where each vertex ends up on the edge
+    std::vector<float> offsets;
+    std::vector<glm::vec3> points;
+    std::vector<glm::vec3> tangents;
+    // Heightmap coordinates and heights of the points when draping
+    std::vector<glm::vec2> coords;
+    std::vector<float> heights;
 };
 
-struct Triangle {
-    uint32_t i1;
-    uint32_t i2;
-    uint32_t i3;
-};
+thread_local BuildScratch scratch;
 
-RoadMesh::RoadMesh(Engine::RenderEngine &engine, Engine::Model &templateModel, std::shared_ptr<Nodes::Edge> edge)
-    : engine(engine), templateMesh(templateModel), edge(std::move(edge)) {
+}
 
-    auto index = nextIndex++;
+void RoadMesh::invalidate() {
+    isModified = true;
 
-    std::ostringstream s;
-    s << "road-" << index;
-    meshName = s.str();
+    for (auto &level : levels) {
+        level.vertices.clear();
+        level.indices.clear();
+        level.pendingGeneration = 0;
+        level.built = false;
+    }
 }
 
-RoadMesh::~RoadMesh() {
-    engine.removeMesh(meshName);
+void RoadMesh::startBuild(uint32_t level, uint32_t generation) {
+    isModified = false;
+    levels[level].pendingGeneration = generation;
 }
 
-void RoadMesh::invalidate() {
-    isModified = true;
-    // TODO: We dont always want to do this immediately
-    generate();
+bool RoadMesh::finishBuild(
+    uint32_t level, uint32_t generation, const glm::vec3 &origin, std::vector<Engine::Vertex> &&vertices,
+    std::vector<uint32_t> &&indices
+) {
+    auto &cached = levels[level];
+    if (cached.pendingGeneration != generation) {
+        return false;
+    }
+
+    cached.vertices = std::move(vertices);
+    cached.indices = std::move(indices);
+    cached.pendingGeneration = 0;
+    cached.built = true;
+    this->origin = origin;
+    return true;
+}
+
+/**
+ * The distance along the edge after which the mesh can no longer be straight between slices.
+ * A straight section of length s across a curve of curvature k is s^2 k / 8 from it at most. Vertices to the side of
+ * the centre line are on a wider curve, which adds (1 + halfWidth k).
+ */
+float sliceStep(const Nodes::Edge &edge, float offset, float halfWidth, float maxError) {
+    auto curvature = edge.getCurvatureAt(offset);
+    if (curvature <= 0) {
+        return std::numeric_limits<float>::max();
+    }
+
+    return std::sqrt(8 * maxError / (curvature * (1 + halfWidth * curvature)));
+}
+
+/**
+ * Picks where to cut the template across the edge so that it is within maxError of the curve
+ */
+void computeSlices(const Nodes::Edge &edge, float halfWidth, float maxError, std::vector<float> &slices) {
+    slices.clear();
+    if (edge.isStraight()) {
+        return;
+    }
+
+    auto length = edge.getLength();
+    float offset = 0;
+    while (slices.size() < MaxSlices) {
+        // Curvature changes along the edge, use whichever end of the step is tighter
+        auto step = sliceStep(edge, offset, halfWidth, maxError);
+        step = std::min(step, sliceStep(edge, std::min(offset + step, length), halfWidth, maxError));
+
+        offset += step;
+        if (offset >= length) {
+            break;
+        }
+        slices.push_back(offset);
+    }
 }
 
-glm::vec3 transformVertex(const glm::vec3 &vertex, float offset, const Nodes::Edge &edge) {
-    glm::vec3 tangent = edge.getTangentAt(offset);
-    glm::vec3 biTangent { tangent.y, -tangent.x, 0 };
-    glm::vec3 origin = edge.getPointAt(offset) - edge.getStart();
-    glm::vec3 normal { 0, 0, 1 };
+/**
+ * Adds a vertex where the line between two vertices crosses the slice.
+ * Always interpolated from the lower index so that triangles sharing the line make the exact same vertex.
+ */
+uint32_t splitAt(std::vector<Engine::Vertex> &vertices, uint32_t a, uint32_t b, float slice) {
+    if (a > b) {
+        std::swap(a, b);
+    }
 
-    return origin + (biTangent * vertex.x) + (normal * vertex.z);
+    auto v1 = vertices[a];
+    auto v2 = vertices[b];
+    auto t = (slice - v1.pos.y) / (v2.pos.y - v1.pos.y);
+
+    auto index = static_cast<uint32_t>(vertices.size());
+    vertices.push_back(
+        {
+            glm::mix(v1.pos, v2.pos, t),
+            glm::mix(v1.normal, v2.normal, t),
+            glm::mix(v1.color, v2.color, t),
+            glm::mix(v1.texCoord, v2.texCoord, t)
+        }
+    );
+
+    // Exactly on the slice, the slabs either side must agree
+    vertices.back().pos.y = slice;
+    return index;
 }
 
-void RoadMesh::generate() {
-    std::vector<ConstructionVertex> vertices;
-    std::vector<Triangle> triangles;
+/**
+ * The range of slices strictly between the lowest and highest of the three offsets
+ */
+std::pair<uint32_t, uint32_t> findCrossingSlices(const std::vector<float> &slices, float y1, float y2, float y3) {
+    auto first = std::upper_bound(slices.begin(), slices.end(), std::min({ y1, y2, y3 }));
+    auto last = std::lower_bound(first, slices.end(), std::max({ y1, y2, y3 }));
+    return { first - slices.begin(), last - slices.begin() };
+}
 
-    auto length = edge->getLength();
+void addFan(std::vector<uint32_t> &indices, const uint32_t *polygon, uint32_t count) {
+    for (uint32_t i = 2; i < count; ++i) {
+        indices.insert(indices.end(), { polygon[0], polygon[i - 1], polygon[i] });
+    }
+}
 
-    // Models must be Y aligned. +Y will be used down the spline
-    auto bounds = templateMesh.getBounds();
-    auto templateLength = bounds.depth();
+void RoadMesh::build(
+    const Nodes::Edge &edge, const RoadTemplate &roadTemplate, float maxError, std::vector<Engine::Vertex> &vertices,
+    std::vector<uint32_t> &indices, const RoadTerrain *terrain
+) {
+    PROFILE_ZONE("RoadMesh::build");
+
+    auto length = edge.getLength();
+    auto templateLength = roadTemplate.getLength();
 
     int tileCount = std::max(std::floor(length / templateLength), 1.0f);
 
@@ -73,182 +167,138 @@ void RoadMesh::generate() {
     }
     stretch = length / (tileCount * templateLength);
 
-    for (int tile = 0; tile < tileCount; ++tile) {
-        float offset = tile * templateLength * stretch;
+    auto &positions = roadTemplate.getPositions();
+    auto &normals = roadTemplate.getNormals();
+    auto &colors = roadTemplate.getColors();
+    auto &texCoords = roadTemplate.getTexCoords();
+    auto &templateIndices = roadTemplate.getIndices();
 
-        for (auto &subModel : templateMesh.getSubModelNames()) {
-            std::vector<Engine::Vertex> subModelVertices;
-            std::vector<uint32_t> subModelIndices;
+    auto halfWidth = std::max(std::abs(roadTemplate.getMin().x), std::abs(roadTemplate.getMax().x));
+    auto &slices = scratch.slices;
+    computeSlices(edge, halfWidth, maxError, slices);
 
-            templateMesh.getMeshData(subModel, subModelVertices, subModelIndices);
-            uint32_t triangleCount = subModelIndices.size() / 3;
-
-            uint32_t startVertex = vertices.size();
-            uint32_t startIndex = triangles.size();
-            vertices.resize(vertices.size() + subModelVertices.size());
-            triangles.resize(triangles.size() + triangleCount);
-
-            for (auto i = 0; i < subModelVertices.size(); ++i) {
-                auto vertex = subModelVertices[i];
-                float y = vertex.pos.y * stretch + offset;
-
-                vertex.pos = transformVertex(vertex.pos, y, *edge);
-
-                vertices[startVertex + i] = {
-                    vertex,
-                    y,
-                    subModelVertices[i].pos
-                };
-            }
-
-            for (auto i = 0; i < triangleCount; ++i) {
-                triangles[startIndex + i] = {
-                    subModelIndices[i * 3 + 0] + startVertex,
-                    subModelIndices[i * 3 + 1] + startVertex,
-                    subModelIndices[i * 3 + 2] + startVertex,
-                };
-            }
+    // Every slice crossing a triangle adds at most 2 vertices and 2 triangles, count them to size the output
+    size_t crossings = 0;
+    for (int tile = 0; tile < tileCount; ++tile) {
+        float offset = tile * templateLength * stretch;
+        for (size_t i = 0; i < templateIndices.size(); i += 3) {
+            auto [first, last] = findCrossingSlices(
+                slices,
+                positions[templateIndices[i + 0]].y * stretch + offset,
+                positions[templateIndices[i + 1]].y * stretch + offset,
+                positions[templateIndices[i + 2]].y * stretch + offset
+            );
+            crossings += last - first;
         }
     }
 
-    // See if there is a need to subdivide
-
-    // Squared error distance from desired vs actual
-    const float subdivideThreshold = std::pow(0.1f, 2.0f);
-
-    uint32_t index = 0;
-    int maxSubdivisions = 1000;
-    while (index < triangles.size() && maxSubdivisions > 0) {
-        auto &triangle = triangles[index];
-
-        auto &v1 = vertices[triangle.i1];
-        auto &v2 = vertices[triangle.i2];
-        auto &v3 = vertices[triangle.i3];
-
-        auto mid1 = (v1.originalPos + v2.originalPos) / 2.0f;
-        auto actual1 = (v1.v.pos + v2.v.pos) / 2.0f;
-        auto midOffset1 = (v1.offset + v2.offset) / 2.0f;
-
-        auto mid2 = (v1.originalPos + v3.originalPos) / 2.0f;
-        auto actual2 = (v1.v.pos + v3.v.pos) / 2.0f;
-        auto midOffset2 = (v1.offset + v3.offset) / 2.0f;
-
-        auto mid3 = (v2.originalPos + v3.originalPos) / 2.0f;
-        auto actual3 = (v2.v.pos + v3.v.pos) / 2.0f;
-        auto midOffset3 = (v2.offset + v3.offset) / 2.0f;
+    vertices.clear();
+    vertices.reserve(tileCount * roadTemplate.getVertexCount() + crossings * 2);
+    indices.clear();
+    indices.reserve(tileCount * roadTemplate.getIndexCount() + crossings * 6);
 
-        auto desired1 = transformVertex(mid1, midOffset1, *edge);
-        auto desired2 = transformVertex(mid2, midOffset2, *edge);
-        auto desired3 = transformVertex(mid3, midOffset3, *edge);
-
-        auto diff1 = glm::length2(desired1 - actual1);
-        auto diff2 = glm::length2(desired2 - actual2);
-        auto diff3 = glm::length2(desired3 - actual3);
+    // Vertices are positioned in the template space (x, offset along the edge, z) until they are all placed
+    for (int tile = 0; tile < tileCount; ++tile) {
+        float offset = tile * templateLength * stretch;
+        auto startVertex = static_cast<uint32_t>(vertices.size());
 
-        if (diff1 > subdivideThreshold || diff2 > subdivideThreshold || diff3 > subdivideThreshold) {
-            uint32_t best = 0;
+        for (size_t i = 0; i < positions.size(); ++i) {
+            glm::vec3 position { positions[i].x, positions[i].y * stretch + offset, positions[i].z };
+            vertices.push_back({ position, normals[i], colors[i], texCoords[i] });
+        }
 
-            if (diff2 > diff1) {
-                best = 1;
-            }
-            if (diff3 > diff1 && diff3 > diff2) {
-                best = 2;
+        for (size_t i = 0; i < templateIndices.size(); i += 3) {
+            uint32_t triangle[3] {
+                templateIndices[i + 0] + startVertex,
+                templateIndices[i + 1] + startVertex,
+                templateIndices[i + 2] + startVertex
+            };
+
+            auto [first, last] = findCrossingSlices(
+                slices, vertices[triangle[0]].pos.y, vertices[triangle[1]].pos.y, vertices[triangle[2]].pos.y
+            );
+            if (first == last) {
+                indices.insert(indices.end(), triangle, triangle + 3);
+                continue;
             }
 
-            ConstructionVertex newVertex {};
-
-            Triangle t1 {};
-            Triangle t2 {};
-
-            if (best == 0) {
-                newVertex.offset = midOffset1;
-                newVertex.originalPos = mid1;
-                newVertex.v.pos = desired1;
-                newVertex.v.normal = (v1.v.normal + v2.v.normal) / 2.0f;
-                newVertex.v.color = (v1.v.color + v2.v.color) / 2.0f;
-                newVertex.v.texCoord = (v1.v.texCoord + v2.v.texCoord) / 2.0f;
-
-                t1.i1 = triangle.i3;
-                t1.i2 = triangle.i1;
-                t2.i1 = triangle.i2;
-                t2.i2 = triangle.i3;
-            } else if (best == 1) {
-                newVertex.offset = midOffset2;
-                newVertex.originalPos = mid2;
-                newVertex.v.pos = desired2;
-                newVertex.v.normal = (v1.v.normal + v3.v.normal) / 2.0f;
-                newVertex.v.color = (v1.v.color + v3.v.color) / 2.0f;
-                newVertex.v.texCoord = (v1.v.texCoord + v3.v.texCoord) / 2.0f;
-
-                t1.i1 = triangle.i2;
-                t1.i2 = triangle.i3;
-                t2.i1 = triangle.i1;
-                t2.i2 = triangle.i2;
-            } else {
-                newVertex.offset = midOffset3;
-                newVertex.originalPos = mid3;
-                newVertex.v.pos = desired3;
-                newVertex.v.normal = (v2.v.normal + v3.v.normal) / 2.0f;
-                newVertex.v.color = (v2.v.color + v3.v.color) / 2.0f;
-                newVertex.v.texCoord = (v2.v.texCoord + v3.v.texCoord) / 2.0f;
-
-                t1.i1 = triangle.i3;
-                t1.i2 = triangle.i1;
-                t2.i1 = triangle.i1;
-                t2.i2 = triangle.i2;
+            // Cut off the part below each slice in turn. A triangle cut by parallel lines is at most 5 sided
+            uint32_t polygon[5] { triangle[0], triangle[1], triangle[2] };
+            uint32_t count = 3;
+
+            for (auto sliceIndex = first; sliceIndex < last; ++sliceIndex) {
+                auto slice = slices[sliceIndex];
+
+                uint32_t below[5];
+                uint32_t above[5];
+                uint32_t belowCount = 0;
+                uint32_t aboveCount = 0;
+
+                for (uint32_t corner = 0; corner < count; ++corner) {
+                    auto current = polygon[corner];
+                    auto next = polygon[(corner + 1) % count];
+                    auto currentY = vertices[current].pos.y;
+                    auto nextY = vertices[next].pos.y;
+
+                    if (currentY <= slice) {
+                        below[belowCount++] = current;
+                    }
+                    if (currentY >= slice) {
+                        above[aboveCount++] = current;
+                    }
+
+                    if ((currentY < slice && nextY > slice) || (currentY > slice && nextY < slice)) {
+                        auto split = splitAt(vertices, current, next, slice);
+                        below[belowCount++] = split;
+                        above[aboveCount++] = split;
+                    }
+                }
+
+                addFan(indices, below, belowCount);
+                std::copy(above, above + aboveCount, polygon);
+                count = aboveCount;
             }
 
-            uint32_t newVertexIndex = vertices.size();
-            t1.i3 = newVertexIndex;
-            t2.i3 = newVertexIndex;
-
-            vertices.push_back(newVertex);
-            // Replace current triangle with t1
-            triangles[index] = t1;
-            triangles.push_back(t2);
-
-            --maxSubdivisions;
-        } else {
-            ++index;
+            addFan(indices, polygon, count);
         }
     }
 
-    if (!mesh) {
-        uint32_t totalVertices = 0;
-        uint32_t totalIndices = 0;
-        for (auto &subModel : templateMesh.getSubModelNames()) {
-            std::vector<Engine::Vertex> subModelVertices;
-            std::vector<uint32_t> subModelIndices;
+    // Now bend everything along the edge in one go
+    auto &offsets = scratch.offsets;
+    auto &points = scratch.points;
+    auto &tangents = scratch.tangents;
+    offsets.resize(vertices.size());
+    points.resize(vertices.size());
+    tangents.resize(vertices.size());
 
-            templateMesh.getMeshData(subModel, subModelVertices, subModelIndices);
-            totalVertices += subModelVertices.size();
-            totalIndices += subModelIndices.size();
-        }
-
-        mesh = engine.createDynamicMesh<Engine::Vertex>(meshName)
-            .withGrowing(totalVertices, totalIndices)
-            .withShinking(totalVertices * sizeof(Engine::Vertex))
-            .withMaximumVertexCapacity(1000000)
-            .withMaximumIndexCapacity(1000000)
-            .withInitialVertexCapacity(vertices.size())
-            .withInitialIndexCapacity(triangles.size() * 3)
-            .build();
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        offsets[i] = vertices[i].pos.y;
     }
 
-    std::vector<Engine::Vertex> finalVertices(vertices.size());
-    std::vector<uint32_t> finalIndices(triangles.size() * 3);
+    edge.getPointsAt(offsets, points, tangents);
 
-    for (uint32_t index = 0; index < vertices.size(); ++index) {
-        finalVertices[index] = vertices[index].v;
-    }
+    if (terrain) {
+        auto &coords = scratch.coords;
+        auto &heights = scratch.heights;
+        coords.resize(vertices.size());
+        heights.resize(vertices.size());
 
-    for (uint32_t index = 0; index < triangles.size(); ++index) {
-        auto &triangle = triangles[index];
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            coords[i] = terrain->toHeightmap(glm::vec2(points[i]));
+        }
 
-        finalIndices[index * 3 + 0] = triangle.i1;
-        finalIndices[index * 3 + 1] = triangle.i2;
-        finalIndices[index * 3 + 2] = triangle.i3;
+        // The points walk along the edge so the batch reads neighbouring pixels
+        terrain->sampler.getHeightsAt(coords, heights);
+
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            points[i].z = heights[i];
+        }
     }
 
-    mesh->replaceAll(finalVertices, finalIndices);
+    auto start = edge.getStart();
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        auto &position = vertices[i].pos;
+        glm::vec3 biTangent { tangents[i].y, -tangents[i].x, 0 };
+        position = points[i] - start + biTangent * position.x + glm::vec3 { 0, 0, position.z };
+    }
 }
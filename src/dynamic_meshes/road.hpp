@@ -1,30 +1,105 @@
 #pragma once
 
 #include "../node/forward.hpp"
+#include "road_template.hpp"
 #include <tech-core/model.hpp>
-#include <tech-core/mesh.hpp>
+#include <array>
 #include <memory>
+#include <vector>
+
+struct RoadTerrain;
 
 class RoadMesh {
 public:
-    RoadMesh(Engine::RenderEngine &, Engine::Model &, std::shared_ptr<Nodes::Edge>);
-    ~RoadMesh();
+    static const uint32_t LevelCount = 3;
+    // The drawn level before anything has been drawn
+    static const uint32_t NoLevel = LevelCount;
 
-    bool getIsModified() const { return isModified; }
+    explicit RoadMesh(Nodes::EdgeId id)
+        : id(id) {}
 
-    const Engine::DynamicMesh<Engine::Vertex> *getMesh() const { return mesh; }
+    Nodes::EdgeId getId() const { return id; }
 
+    bool getIsModified() const { return isModified; }
+
+    /**
+     * Marks the mesh as needing to be built again and drops every cached level. Nothing is done until a build is
+     * started, the drawn mesh stays until a new build replaces it.
+     */
     void invalidate();
-    void generate();
+
+    /**
+     * Called when a build of a level from the current state of the edge is started.
+     * Only the result of the latest build of each level is kept, anything older is stale.
+     */
+    void startBuild(uint32_t level, uint32_t generation);
+
+    bool isBuilding(uint32_t level) const { return levels[level].pendingGeneration != 0; }
+
+    /**
+     * Caches the result of a build.
+     * @return False if the build was stale and has been ignored
+     */
+    bool finishBuild(
+        uint32_t level, uint32_t generation, const glm::vec3 &origin, std::vector<Engine::Vertex> &&vertices,
+        std::vector<uint32_t> &&indices
+    );
+
+    bool isBuilt(uint32_t level) const { return levels[level].built; }
+
+    const std::vector<Engine::Vertex> &getVertices(uint32_t level) const { return levels[level].vertices; }
+
+    const std::vector<uint32_t> &getIndices(uint32_t level) const { return levels[level].indices; }
+
+    /**
+     * The start of the edge the cached levels were built from, they are relative to it
+     */
+    const glm::vec3 &getOrigin() const { return origin; }
+
+    uint32_t getDrawnLevel() const { return drawnLevel; }
+
+    void setDrawnLevel(uint32_t level) { drawnLevel = level; }
+
+    /**
+     * A sphere around the whole road, from the last time a build was started
+     */
+    void setBounds(const glm::vec3 &centre, float radius) {
+        this->centre = centre;
+        this->radius = radius;
+    }
+
+    const glm::vec3 &getCentre() const { return centre; }
+
+    float getRadius() const { return radius; }
+
+    /**
+     * Builds the vertices and indices of the road along the edge, replacing the contents of both.
+     * The template is cut across the edge at offsets chosen from the curvature so the mesh stays within maxError of
+     * the curve, then bent along it.
+     * This only reads the edge and the template so it can run on any thread, pass it a copy of the edge.
+     * Given the terrain, the road is draped on it: the centre line follows the terrain height instead of the nodes,
+     * and the template keeps its shape across the road.
+     */
+    static void build(
+        const Nodes::Edge &edge, const RoadTemplate &roadTemplate, float maxError,
+        std::vector<Engine::Vertex> &vertices, std::vector<uint32_t> &indices, const RoadTerrain *terrain = nullptr
+    );
 
 private:
-    Engine::RenderEngine &engine;
-    std::shared_ptr<Nodes::Edge> edge;
-    Engine::Model &templateMesh;
+    struct Level {
+        std::vector<Engine::Vertex> vertices;
+        std::vector<uint32_t> indices;
+        // 0 when no build is running
+        uint32_t pendingGeneration { 0 };
+        bool built { false };
+    };
 
-    std::string meshName;
-    Engine::DynamicMesh<Engine::Vertex> *mesh { nullptr };
+    Nodes::EdgeId id;
     bool isModified { false };
+    std::array<Level, LevelCount> levels;
+    uint32_t drawnLevel { NoLevel };
+    glm::vec3 origin { 0, 0, 0 };
 
-    static uint32_t nextIndex;
-};
\ No newline at end of file
+    glm::vec3 centre { 0, 0, 0 };
+    float radius { 0 };
+};
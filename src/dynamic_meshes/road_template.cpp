@@ -0,0 +1,178 @@
+#include "road_template.hpp"
+#include <tech-core/shapes/bounding_box.hpp>
+#include <limits>
+#include <map>
+#include <optional>
+#include <tuple>
+
+RoadTemplate::RoadTemplate(Engine::Model &model) {
+    std::vector<Engine::Vertex> subModelVertices;
+    std::vector<uint32_t> subModelIndices;
+
+    for (auto &subModel : model.getSubModelNames()) {
+        subModelVertices.clear();
+        subModelIndices.clear();
+        model.getMeshData(subModel, subModelVertices, subModelIndices);
+
+        auto startVertex = static_cast<uint32_t>(positions.size());
+        for (auto &vertex : subModelVertices) {
+            positions.push_back(vertex.pos);
+            normals.push_back(vertex.normal);
+            colors.push_back(vertex.color);
+            texCoords.push_back(vertex.texCoord);
+        }
+
+        for (auto index : subModelIndices) {
+            indices.push_back(index + startVertex);
+        }
+    }
+
+    updateBounds();
+    length = model.getBounds().depth();
+}
+
+RoadTemplate RoadTemplate::simplify(float cellSize) const {
+    RoadTemplate simplified;
+    simplified.length = length;
+
+    struct Cluster {
+        glm::vec3 position { 0, 0, 0 };
+        glm::vec3 normal { 0, 0, 0 };
+        glm::vec3 color { 0, 0, 0 };
+        glm::vec2 texCoord { 0, 0 };
+        uint32_t count { 0 };
+        // Set when one of the vertices is on an end of the tile
+        std::optional<float> end;
+    };
+
+    auto tolerance = length * 1e-4f;
+    std::map<std::tuple<int32_t, int32_t, int32_t>, uint32_t> cellClusters;
+    std::vector<Cluster> clusters;
+    std::vector<uint32_t> remap(positions.size());
+
+    for (size_t i = 0; i < positions.size(); ++i) {
+        auto &position = positions[i];
+
+        // The ends get their own cells so nothing is pulled off them, or onto them
+        std::optional<float> end;
+        int32_t cellY;
+        if (position.y <= min.y + tolerance) {
+            end = min.y;
+            cellY = std::numeric_limits<int32_t>::min();
+        } else if (position.y >= max.y - tolerance) {
+            end = max.y;
+            cellY = std::numeric_limits<int32_t>::max();
+        } else {
+            cellY = static_cast<int32_t>(std::floor(position.y / cellSize));
+        }
+
+        std::tuple<int32_t, int32_t, int32_t> cell {
+            static_cast<int32_t>(std::floor(position.x / cellSize)),
+            cellY,
+            static_cast<int32_t>(std::floor(position.z / cellSize))
+        };
+
+        auto [it, inserted] = cellClusters.try_emplace(cell, static_cast<uint32_t>(clusters.size()));
+        if (inserted) {
+            clusters.emplace_back();
+        }
+
+        auto &cluster = clusters[it->second];
+        cluster.position += position;
+        cluster.normal += normals[i];
+        cluster.color += colors[i];
+        cluster.texCoord += texCoords[i];
+        cluster.end = end;
+        ++cluster.count;
+
+        remap[i] = it->second;
+    }
+
+    for (auto &cluster : clusters) {
+        auto scale = 1.0f / static_cast<float>(cluster.count);
+        auto position = cluster.position * scale;
+        if (cluster.end) {
+            position.y = *cluster.end;
+        }
+
+        simplified.positions.push_back(position);
+        simplified.normals.push_back(glm::normalize(cluster.normal));
+        simplified.colors.push_back(cluster.color * scale);
+        simplified.texCoords.push_back(cluster.texCoord * scale);
+    }
+
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        auto a = remap[indices[i + 0]];
+        auto b = remap[indices[i + 1]];
+        auto c = remap[indices[i + 2]];
+
+        if (a != b && b != c && a != c) {
+            simplified.indices.insert(simplified.indices.end(), { a, b, c });
+        }
+    }
+
+    simplified.updateBounds();
+    return simplified;
+}
+
+RoadTemplate RoadTemplate::makeRibbon() const {
+    RoadTemplate ribbon;
+    ribbon.length = length;
+
+    glm::vec2 corners[] {
+        { min.x, min.y },
+        { max.x, min.y },
+        { min.x, max.y },
+        { max.x, max.y },
+    };
+
+    for (auto &corner : corners) {
+        // Take the look of the template from whichever vertex is closest to the corner
+        size_t closest = 0;
+        float closestDistance = std::numeric_limits<float>::max();
+        for (size_t i = 0; i < positions.size(); ++i) {
+            auto offset = glm::vec2(positions[i]) - corner;
+            auto distance = glm::dot(offset, offset);
+            if (distance < closestDistance) {
+                closest = i;
+                closestDistance = distance;
+            }
+        }
+
+        ribbon.positions.emplace_back(corner, max.z);
+        ribbon.normals.emplace_back(0, 0, 1);
+        ribbon.colors.push_back(colors[closest]);
+        ribbon.texCoords.push_back(texCoords[closest]);
+    }
+
+    // Wind the same way as the upward facing triangles of the template
+    float winding = 0;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        auto &a = positions[indices[i + 0]];
+        auto normal = glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a);
+        if (normals[indices[i]].z > 0) {
+            winding += normal.z;
+        }
+    }
+
+    if (winding >= 0) {
+        ribbon.indices = { 0, 1, 2, 1, 3, 2 };
+    } else {
+        ribbon.indices = { 0, 2, 1, 1, 2, 3 };
+    }
+    ribbon.updateBounds();
+    return ribbon;
+}
+
+void RoadTemplate::updateBounds() {
+    if (positions.empty()) {
+        return;
+    }
+
+    min = glm::vec3(std::numeric_limits<float>::max());
+    max = glm::vec3(std::numeric_limits<float>::lowest());
+    for (auto &position : positions) {
+        min = glm::min(min, position);
+        max = glm::max(max, position);
+    }
+}
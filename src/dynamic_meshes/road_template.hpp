@@ -0,0 +1,65 @@
+#pragma once
+
+#include <tech-core/model.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+/**
+ * A road model flattened into separate attribute arrays, built once and shared by every road mesh using it.
+ * Sub-models are merged so the indices refer to the merged vertices.
+ * Models must be Y aligned, +Y runs down the edge.
+ */
+class RoadTemplate {
+public:
+    explicit RoadTemplate(Engine::Model &model);
+
+    /**
+     * A coarser copy made by merging the vertices which fall in the same cell of a grid, dropping the triangles which
+     * collapse. Vertices on the ends of the tile stay on the ends so that tiles still meet.
+     */
+    RoadTemplate simplify(float cellSize) const;
+
+    /**
+     * A single flat quad over the full width of the template at the height of its top
+     */
+    RoadTemplate makeRibbon() const;
+
+    size_t getVertexCount() const { return positions.size(); }
+
+    size_t getIndexCount() const { return indices.size(); }
+
+    const std::vector<glm::vec3> &getPositions() const { return positions; }
+
+    const std::vector<glm::vec3> &getNormals() const { return normals; }
+
+    const std::vector<glm::vec3> &getColors() const { return colors; }
+
+    const std::vector<glm::vec2> &getTexCoords() const { return texCoords; }
+
+    const std::vector<uint32_t> &getIndices() const { return indices; }
+
+    const glm::vec3 &getMin() const { return min; }
+
+    const glm::vec3 &getMax() const { return max; }
+
+    /**
+     * The length of one tile of the template along the edge
+     */
+    float getLength() const { return length; }
+
+private:
+    RoadTemplate() = default;
+
+    void updateBounds();
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec3> colors;
+    std::vector<glm::vec2> texCoords;
+    std::vector<uint32_t> indices;
+
+    glm::vec3 min { 0, 0, 0 };
+    glm::vec3 max { 0, 0, 0 };
+    float length { 0 };
+};
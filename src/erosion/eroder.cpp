@@ -0,0 +1,159 @@
+#include "eroder.hpp"
+#include "hydraulic.hpp"
+#include "thermal.hpp"
+#include "../utils/profiler.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace Erosion {
+
+// Smaller tiles give more to share between the workers, but each droplet near an edge is more likely to be cut short
+const int32_t MinTileSize = 64;
+const uint32_t HydraulicRounds = 4;
+// Rows of the region are split into about this many bands per worker for thermal erosion
+const int32_t BandsPerThread = 4;
+
+namespace Internal {
+
+uint64_t makeSeed(uint32_t seed, uint32_t round, uint32_t tile) {
+    return static_cast<uint64_t>(tile) * 0xD6E8FEB86659FD93ull ^ (static_cast<uint64_t>(seed) << 32 | round);
+}
+
+}
+
+Eroder::Eroder(uint32_t threadCount)
+    : ownedWorkers(std::make_unique<ThreadPool>(threadCount)), workers(*ownedWorkers) {}
+
+Eroder::Eroder(ThreadPool &workers)
+    : workers(workers) {}
+
+void Eroder::erodeHydraulic(
+    const HeightGrid &grid, const Bounds &region, uint64_t dropletCount, uint32_t seed,
+    const HydraulicSettings &settings
+) {
+    PROFILE_ZONE("Eroder::erodeHydraulic");
+
+    auto regionSize = region.end - region.start;
+    if (regionSize.x <= 0 || regionSize.y <= 0 || dropletCount == 0) {
+        return;
+    }
+
+    DropletSimulator simulator(settings);
+    auto reach = simulator.getReach();
+    auto tileSize = std::max(MinTileSize, reach * 2);
+    glm::ivec2 tiles = (regionSize + tileSize - 1) / tileSize;
+
+    // Droplets are shared out by area, what is left over from rounding down goes to the first tiles
+    auto area = static_cast<uint64_t>(regionSize.x) * static_cast<uint64_t>(regionSize.y);
+    std::vector<uint64_t> tileDroplets(static_cast<size_t>(tiles.x) * tiles.y);
+    std::vector<Bounds> tileSpawns(tileDroplets.size());
+    uint64_t shared = 0;
+
+    for (int32_t y = 0; y < tiles.y; ++y) {
+        for (int32_t x = 0; x < tiles.x; ++x) {
+            auto index = x + y * tiles.x;
+            auto start = region.start + glm::ivec2 { x, y } * tileSize;
+            auto end = glm::min(start + tileSize, region.end);
+            tileSpawns[index] = { start, end };
+
+            auto tileArea = static_cast<uint64_t>(end.x - start.x) * static_cast<uint64_t>(end.y - start.y);
+            tileDroplets[index] = dropletCount * tileArea / area;
+            shared += tileDroplets[index];
+        }
+    }
+    for (size_t index = 0; shared < dropletCount; ++index, ++shared) {
+        ++tileDroplets[index];
+    }
+
+    std::vector<std::function<void()>> batch;
+    for (uint32_t round = 0; round < HydraulicRounds; ++round) {
+        for (int32_t pass = 0; pass < 4; ++pass) {
+            for (int32_t y = pass / 2; y < tiles.y; y += 2) {
+                for (int32_t x = pass % 2; x < tiles.x; x += 2) {
+                    auto index = static_cast<uint32_t>(x + y * tiles.x);
+                    auto total = tileDroplets[index];
+                    auto count = static_cast<uint32_t>(total / HydraulicRounds + (round < total % HydraulicRounds));
+                    if (count == 0) {
+                        continue;
+                    }
+
+                    auto spawn = tileSpawns[index];
+                    Bounds limits {
+                        glm::max(spawn.start - reach, region.start),
+                        glm::min(spawn.end + reach, region.end)
+                    };
+
+                    batch.push_back(
+                        [&grid, &simulator, spawn, limits, count, seed, round, index]() {
+                            Random random(Internal::makeSeed(seed, round, index));
+                            simulator.simulate(grid, spawn, limits, count, random);
+                        }
+                    );
+                }
+            }
+
+            // Tiles in the next pass overlap these ones
+            workers.run(std::move(batch));
+            batch.clear();
+        }
+    }
+}
+
+void Eroder::relaxThermal(const HeightGrid &grid, const Bounds &region, const ThermalSettings &settings) {
+    PROFILE_ZONE("Eroder::relaxThermal");
+
+    auto size = region.end - region.start;
+    if (size.x <= 0 || size.y <= 0 || settings.iterations == 0) {
+        return;
+    }
+
+    auto area = static_cast<size_t>(size.x) * size.y;
+    currentHeights.resize(area);
+    nextHeights.resize(area);
+    fractions.resize(area);
+
+    for (int32_t y = 0; y < size.y; ++y) {
+        auto *row = &grid.at(region.start.x, region.start.y + y);
+        std::memcpy(&currentHeights[y * size.x], row, size.x * sizeof(float));
+    }
+
+    auto bandCount = static_cast<int32_t>(getThreadCount()) * BandsPerThread;
+    auto bandSize = std::max((size.y + bandCount - 1) / bandCount, 1);
+
+    for (uint32_t iteration = 0; iteration < settings.iterations; ++iteration) {
+        auto *heights = currentHeights.data();
+        auto *output = nextHeights.data();
+        auto *outflow = fractions.data();
+
+        std::vector<std::function<void()>> batch;
+        for (int32_t firstRow = 0; firstRow < size.y; firstRow += bandSize) {
+            auto endRow = std::min(firstRow + bandSize, size.y);
+            batch.push_back(
+                [heights, outflow, size, firstRow, endRow, &settings]() {
+                    Thermal::findOutflow(heights, size, firstRow, endRow, settings, outflow);
+                }
+            );
+        }
+        workers.run(std::move(batch));
+
+        batch.clear();
+        for (int32_t firstRow = 0; firstRow < size.y; firstRow += bandSize) {
+            auto endRow = std::min(firstRow + bandSize, size.y);
+            batch.push_back(
+                [heights, outflow, output, size, firstRow, endRow, &settings]() {
+                    Thermal::moveMaterial(heights, outflow, size, firstRow, endRow, settings, output);
+                }
+            );
+        }
+        workers.run(std::move(batch));
+
+        std::swap(currentHeights, nextHeights);
+    }
+
+    for (int32_t y = 0; y < size.y; ++y) {
+        auto *row = &grid.at(region.start.x, region.start.y + y);
+        std::memcpy(row, &currentHeights[y * size.x], size.x * sizeof(float));
+    }
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "structures.hpp"
+#include "../utils/thread_pool.hpp"
+#include <memory>
+#include <vector>
+
+namespace Erosion {
+
+/**
+ * Erodes heights on the CPU using a pool of workers. The results only depend on the heights, the region, the settings
+ * and the seed, never on the number of workers or the order they finish in.
+ *
+ * Hydraulic erosion splits the region into square tiles, each with its own droplets and random sequence. A droplet
+ * can change heights up to its reach away from its tile, so tiles are at least twice the reach across and worked on
+ * in four passes, a checkerboard of every other tile in each direction, so that no two tiles in a pass can touch the
+ * same pixels. The droplets of each tile are spread over several rounds of the four passes so that neighbouring
+ * tiles take turns rather than one finishing before the other starts.
+ *
+ * Thermal erosion works a band of rows per job, each iteration reading the heights from the one before.
+ */
+class Eroder {
+public:
+    /**
+     * @param threadCount The number of workers. 0 will use one less than the number of hardware threads
+     */
+    explicit Eroder(uint32_t threadCount = 0);
+
+    /**
+     * Uses workers shared with others, which must outlive the eroder
+     */
+    explicit Eroder(ThreadPool &workers);
+
+    uint32_t getThreadCount() const { return workers.getThreadCount(); }
+
+    /**
+     * Erosion can be started on the workers too, the work it shares out is run by the waiting thread as well
+     */
+    ThreadPool &getWorkers() { return workers; }
+
+    /**
+     * Drops droplets at random over the region, only heights inside it are changed. Blocks until they have all run.
+     */
+    void erodeHydraulic(
+        const HeightGrid &grid, const Bounds &region, uint64_t dropletCount, uint32_t seed,
+        const HydraulicSettings &settings
+    );
+
+    /**
+     * Only heights inside the region are changed and nothing slides across its edges. Blocks until done.
+     */
+    void relaxThermal(const HeightGrid &grid, const Bounds &region, const ThermalSettings &settings);
+
+private:
+    // Only when the eroder has its own
+    std::unique_ptr<ThreadPool> ownedWorkers;
+    ThreadPool &workers;
+
+    // Region sized working space for thermal erosion
+    std::vector<float> currentHeights;
+    std::vector<float> nextHeights;
+    std::vector<float> fractions;
+};
+
+}
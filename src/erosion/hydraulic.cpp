@@ -0,0 +1,149 @@
+#include "hydraulic.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Erosion {
+
+namespace Internal {
+
+struct Surface {
+    float height;
+    glm::vec2 gradient;
+};
+
+/**
+ * Bilinear height and gradient at a point inside the pixel, the pixel after it in both directions must exist
+ */
+Surface sampleSurface(const HeightGrid &grid, const glm::ivec2 &pixel, const glm::vec2 &offset) {
+    auto topLeft = grid.at(pixel.x, pixel.y);
+    auto topRight = grid.at(pixel.x + 1, pixel.y);
+    auto bottomLeft = grid.at(pixel.x, pixel.y + 1);
+    auto bottomRight = grid.at(pixel.x + 1, pixel.y + 1);
+
+    glm::vec2 gradient {
+        (topRight - topLeft) * (1 - offset.y) + (bottomRight - bottomLeft) * offset.y,
+        (bottomLeft - topLeft) * (1 - offset.x) + (bottomRight - topRight) * offset.x
+    };
+
+    auto height = topLeft * (1 - offset.x) * (1 - offset.y) + topRight * offset.x * (1 - offset.y) +
+        bottomLeft * (1 - offset.x) * offset.y + bottomRight * offset.x * offset.y;
+
+    return { height, gradient };
+}
+
+void deposit(const HeightGrid &grid, const glm::ivec2 &pixel, const glm::vec2 &offset, float amount) {
+    grid.at(pixel.x, pixel.y) += amount * (1 - offset.x) * (1 - offset.y);
+    grid.at(pixel.x + 1, pixel.y) += amount * offset.x * (1 - offset.y);
+    grid.at(pixel.x, pixel.y + 1) += amount * (1 - offset.x) * offset.y;
+    grid.at(pixel.x + 1, pixel.y + 1) += amount * offset.x * offset.y;
+}
+
+}
+
+DropletSimulator::DropletSimulator(const HydraulicSettings &settings)
+    : settings(settings) {
+
+    auto radius = static_cast<int32_t>(settings.radius);
+    margin = static_cast<float>(std::max(radius, 1));
+
+    // Weights fall off towards the edge, at a radius of 0 only the droplet's pixel is worn away
+    float total = 0;
+    for (int32_t y = -radius; y <= radius; ++y) {
+        for (int32_t x = -radius; x <= radius; ++x) {
+            auto distance = std::sqrt(static_cast<float>(x * x + y * y));
+            if (distance > static_cast<float>(radius)) {
+                continue;
+            }
+
+            auto weight = 1 - distance / static_cast<float>(radius + 1);
+            brushOffsets.push_back({ x, y });
+            brushWeights.push_back(weight);
+            total += weight;
+        }
+    }
+
+    for (auto &weight : brushWeights) {
+        weight /= total;
+    }
+}
+
+int32_t DropletSimulator::getReach() const {
+    return static_cast<int32_t>(settings.maxSteps) + static_cast<int32_t>(margin) + 1;
+}
+
+void DropletSimulator::simulate(
+    const HeightGrid &grid, const Bounds &spawn, const Bounds &limits, uint32_t count, Random &random
+) const {
+    glm::vec2 start(spawn.start);
+    glm::vec2 end(spawn.end);
+
+    for (uint32_t index = 0; index < count; ++index) {
+        // Both are drawn every time so the sequence does not depend on where droplets land
+        auto x = random.range(start.x, end.x);
+        auto y = random.range(start.y, end.y);
+        drop(grid, limits, { x, y });
+    }
+}
+
+void DropletSimulator::drop(const HeightGrid &grid, const Bounds &limits, glm::vec2 position) const {
+    glm::vec2 direction { 0, 0 };
+    float speed = 1;
+    float water = 1;
+    float sediment = 0;
+
+    if (!limits.contains(position, margin)) {
+        return;
+    }
+
+    for (uint32_t step = 0; step < settings.maxSteps; ++step) {
+        glm::ivec2 pixel(glm::floor(position));
+        auto offset = position - glm::vec2(pixel);
+        auto surface = Internal::sampleSurface(grid, pixel, offset);
+
+        direction = direction * settings.inertia - surface.gradient * (1 - settings.inertia);
+        auto length = glm::length(direction);
+        if (length == 0) {
+            // Nowhere to go on flat ground
+            break;
+        }
+        direction /= length;
+
+        auto next = position + direction;
+        if (!limits.contains(next, margin)) {
+            break;
+        }
+
+        glm::ivec2 nextPixel(glm::floor(next));
+        auto heightChange =
+            Internal::sampleSurface(grid, nextPixel, next - glm::vec2(nextPixel)).height - surface.height;
+        auto carry = std::max(-heightChange * speed * water * settings.capacity, settings.minCapacity);
+
+        if (sediment > carry || heightChange > 0) {
+            // Uphill the droplet fills in the hole behind it, otherwise it drops what it can no longer carry
+            auto amount = heightChange > 0
+                ? std::min(heightChange, sediment)
+                : (sediment - carry) * settings.depositionRate;
+            sediment -= amount;
+            Internal::deposit(grid, pixel, offset, amount);
+        } else {
+            // Never dig deeper than the ground it is running down to
+            auto amount = std::min((carry - sediment) * settings.erosionRate, -heightChange);
+            sediment += amount;
+
+            for (size_t index = 0; index < brushOffsets.size(); ++index) {
+                auto &brushOffset = brushOffsets[index];
+                grid.at(pixel.x + brushOffset.x, pixel.y + brushOffset.y) -= amount * brushWeights[index];
+            }
+        }
+
+        speed = std::sqrt(std::max(speed * speed - heightChange * settings.gravity, 0.0f));
+        water *= 1 - settings.evaporation;
+        position = next;
+    }
+
+    // Whatever is still carried settles where the droplet stopped, so no material is lost
+    glm::ivec2 pixel(glm::floor(position));
+    Internal::deposit(grid, pixel, position - glm::vec2(pixel), sediment);
+}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "structures.hpp"
+#include "../utils/random.hpp"
+#include <vector>
+
+namespace Erosion {
+
+/**
+ * Runs droplets over the heights one after another. Each droplet rolls downhill, wearing away the ground and
+ * picking up sediment while it speeds up, then dropping it again as it slows down or evaporates.
+ * Only reads the settings after construction, so one simulator can be shared by every thread.
+ */
+class DropletSimulator {
+public:
+    explicit DropletSimulator(const HydraulicSettings &settings);
+
+    /**
+     * The furthest a droplet can change heights from where it started
+     */
+    int32_t getReach() const;
+
+    /**
+     * Drops the droplets at random points in the spawn area. A droplet stops before it would change anything
+     * outside of the limits, so areas with separate limits can be eroded at the same time.
+     */
+    void simulate(
+        const HeightGrid &grid, const Bounds &spawn, const Bounds &limits, uint32_t count, Random &random
+    ) const;
+
+private:
+    HydraulicSettings settings;
+    // Distance a droplet has to keep from the limits
+    float margin;
+    // Pixels worn away around a droplet, relative to its pixel. The weights add up to 1
+    std::vector<glm::ivec2> brushOffsets;
+    std::vector<float> brushWeights;
+
+    void drop(const HeightGrid &grid, const Bounds &limits, glm::vec2 position) const;
+};
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+namespace Erosion {
+
+/**
+ * Heights stored a row at a time, eroded in place. Heights and settings share the same units, distances are in pixels.
+ */
+struct HeightGrid {
+    float *heights;
+    uint32_t width;
+    uint32_t height;
+
+    float &at(int32_t x, int32_t y) const { return heights[x + y * static_cast<int32_t>(width)]; }
+};
+
+/**
+ * Part of a grid, from start up to but not including end
+ */
+struct Bounds {
+    glm::ivec2 start;
+    glm::ivec2 end;
+
+    bool contains(const glm::vec2 &point, float margin) const {
+        return point.x >= static_cast<float>(start.x) + margin && point.y >= static_cast<float>(start.y) + margin &&
+            point.x < static_cast<float>(end.x) - margin && point.y < static_cast<float>(end.y) - margin;
+    }
+};
+
+struct HydraulicSettings {
+    // How much of its previous direction a droplet keeps each step. At 0 it follows the slope exactly
+    float inertia { 0.05f };
+    // Sediment carried per unit of height lost, speed and water
+    float capacity { 4 };
+    // Stops droplets on flat ground from depositing everything at once
+    float minCapacity { 0.01f };
+    // Fractions of the difference from capacity picked up or put down each step
+    float erosionRate { 0.3f };
+    float depositionRate { 0.3f };
+    float evaporation { 0.01f };
+    float gravity { 4 };
+    // Droplets move a pixel each step, so this limits how far they travel
+    uint32_t maxSteps { 30 };
+    // Pixels around a droplet worn away as it moves
+    uint32_t radius { 3 };
+};
+
+struct ThermalSettings {
+    // Steepest stable difference in height between pixels side by side, diagonals allow more by their distance
+    float talus { 1.5f };
+    // Fraction of the material above the talus moved each iteration
+    float rate { 0.5f };
+    uint32_t iterations { 10 };
+};
+
+}
@@ -0,0 +1,134 @@
+#include "thermal.hpp"
+#include <algorithm>
+#include <type_traits>
+
+namespace Erosion::Thermal {
+
+namespace Internal {
+
+const int32_t NeighbourCount = 8;
+const int32_t NeighbourX[NeighbourCount] { -1, 0, 1, -1, 1, -1, 0, 1 };
+const int32_t NeighbourY[NeighbourCount] { -1, -1, -1, 0, 0, 1, 1, 1 };
+const float NeighbourDistances[NeighbourCount] {
+    1.41421356f, 1, 1.41421356f,
+    1, 1,
+    1.41421356f, 1, 1.41421356f
+};
+
+/**
+ * Pixels on the edge of the region check which neighbours exist, the rest skip it
+ */
+template<bool Edge>
+bool hasNeighbour(glm::ivec2 size, int32_t x, int32_t y, int32_t neighbour) {
+    if constexpr (Edge) {
+        auto otherX = x + NeighbourX[neighbour];
+        auto otherY = y + NeighbourY[neighbour];
+        return otherX >= 0 && otherY >= 0 && otherX < size.x && otherY < size.y;
+    } else {
+        return true;
+    }
+}
+
+template<bool Edge>
+float outflowAt(const float *heights, glm::ivec2 size, int32_t x, int32_t y, float talus, float rate) {
+    auto index = x + y * size.x;
+    auto height = heights[index];
+    float total = 0;
+    float steepest = 0;
+
+    for (int32_t neighbour = 0; neighbour < NeighbourCount; ++neighbour) {
+        if (!hasNeighbour<Edge>(size, x, y, neighbour)) {
+            continue;
+        }
+
+        auto other = heights[index + NeighbourX[neighbour] + NeighbourY[neighbour] * size.x];
+        auto excess = std::max(height - other - talus * NeighbourDistances[neighbour], 0.0f);
+        total += excess;
+        steepest = std::max(steepest, excess);
+    }
+
+    // Moving half of the steepest excess at most levels that pair out rather than flipping it over
+    return total > 0 ? rate * steepest / 2 / total : 0;
+}
+
+template<bool Edge>
+float heightAfter(const float *heights, const float *fractions, glm::ivec2 size, int32_t x, int32_t y, float talus) {
+    auto index = x + y * size.x;
+    auto height = heights[index];
+    float moved = 0;
+
+    // Gathered from both sides so every pixel is only written by its own row
+    for (int32_t neighbour = 0; neighbour < NeighbourCount; ++neighbour) {
+        if (!hasNeighbour<Edge>(size, x, y, neighbour)) {
+            continue;
+        }
+
+        auto otherIndex = index + NeighbourX[neighbour] + NeighbourY[neighbour] * size.x;
+        auto difference = height - heights[otherIndex];
+        auto limit = talus * NeighbourDistances[neighbour];
+
+        moved += std::max(-difference - limit, 0.0f) * fractions[otherIndex];
+        moved -= std::max(difference - limit, 0.0f) * fractions[index];
+    }
+
+    return height + moved;
+}
+
+/**
+ * Calls the function with each pixel of the rows, using the version without neighbour checks away from the edges
+ */
+template<typename Function>
+void forEachPixel(glm::ivec2 size, int32_t firstRow, int32_t endRow, Function &&function) {
+    for (int32_t y = firstRow; y < endRow; ++y) {
+        if (y == 0 || y == size.y - 1 || size.x < 3) {
+            for (int32_t x = 0; x < size.x; ++x) {
+                function(std::true_type {}, x, y);
+            }
+            continue;
+        }
+
+        function(std::true_type {}, 0, y);
+        for (int32_t x = 1; x < size.x - 1; ++x) {
+            function(std::false_type {}, x, y);
+        }
+        function(std::true_type {}, size.x - 1, y);
+    }
+}
+
+}
+
+void findOutflow(
+    const float *heights, const glm::ivec2 &size, int32_t firstRow, int32_t endRow, const ThermalSettings &settings,
+    float *fractions
+) {
+    // Copied so the compiler knows writing the output cannot change them
+    auto regionSize = size;
+    auto talus = settings.talus;
+    auto rate = settings.rate;
+
+    Internal::forEachPixel(
+        regionSize, firstRow, endRow,
+        [=](auto edge, int32_t x, int32_t y) {
+            fractions[x + y * regionSize.x] =
+                Internal::outflowAt<decltype(edge)::value>(heights, regionSize, x, y, talus, rate);
+        }
+    );
+}
+
+void moveMaterial(
+    const float *heights, const float *fractions, const glm::ivec2 &size, int32_t firstRow, int32_t endRow,
+    const ThermalSettings &settings, float *output
+) {
+    auto regionSize = size;
+    auto talus = settings.talus;
+
+    Internal::forEachPixel(
+        regionSize, firstRow, endRow,
+        [=](auto edge, int32_t x, int32_t y) {
+            output[x + y * regionSize.x] =
+                Internal::heightAfter<decltype(edge)::value>(heights, fractions, regionSize, x, y, talus);
+        }
+    );
+}
+
+}
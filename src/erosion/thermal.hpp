@@ -0,0 +1,29 @@
+#pragma once
+
+#include "structures.hpp"
+
+/**
+ * Thermal erosion moves material from pixels steeper than the talus down to their lower neighbours, like loose rock
+ * sliding down a slope. Each iteration only reads the heights from before it, so any set of rows can be worked on
+ * at the same time and the result does not depend on the order.
+ * Heights are stored a row at a time in a region of the given size, nothing moves across its edges.
+ */
+namespace Erosion::Thermal {
+
+/**
+ * Works out the fraction of each pixel's excess over the talus it passes to each neighbour
+ */
+void findOutflow(
+    const float *heights, const glm::ivec2 &size, int32_t firstRow, int32_t endRow, const ThermalSettings &settings,
+    float *fractions
+);
+
+/**
+ * Writes the heights after every pixel has passed on its outflow
+ */
+void moveMaterial(
+    const float *heights, const float *fractions, const glm::ivec2 &size, int32_t firstRow, int32_t endRow,
+    const ThermalSettings &settings, float *output
+);
+
+}
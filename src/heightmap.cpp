@@ -1,14 +1,19 @@
 #include "heightmap.hpp"
+#include "erosion/eroder.hpp"
+#include "utils/thread_pool.hpp"
 #include <tech-core/engine.hpp>
 #include <tech-core/task.hpp>
 #include <tech-core/compute.hpp>
 #include <stb_image.h>
+#include <algorithm>
 
 const float HEIGHTMAP_SCALE = 65535.0f;
 
-struct Elevation {
-    float min;
-    float max;
+struct NormalRegion {
+    float minElevation;
+    float maxElevation;
+    glm::ivec2 offset;
+    glm::ivec2 size;
 };
 
 enum class ShaderTerraformMode : uint32_t {
@@ -68,6 +73,11 @@ Heightmap::Heightmap(const char *filename, Engine::RenderEngine &engine)
 }
 
 Heightmap::~Heightmap() {
+    // Erosion writes its result back into the heightmap
+    if (eroder) {
+        eroder->getWorkers().wait();
+    }
+
     readbackBuffer->unmap();
 }
 
@@ -118,55 +128,75 @@ void Heightmap::transferImage(Engine::RenderEngine &engine, uint16_t *pixelData)
     engine.getTaskManager().submitTask(std::move(task));
 }
 
+void Heightmap::transferRegion(const glm::ivec2 &start, const glm::ivec2 &size, const uint16_t *pixelData) {
+    auto task = engine.getTaskManager().createTask();
+    vk::DeviceSize pixelSize = static_cast<vk::DeviceSize>(size.x) * size.y * sizeof(uint16_t);
+    auto stagingBuffer = engine.getBufferManager().aquireStaging(pixelSize);
+    stagingBuffer->copyIn(pixelData);
+
+    task->execute(
+        [this, &stagingBuffer, start, size](vk::CommandBuffer buffer) {
+            vk::BufferImageCopy region(
+                0, 0, 0,
+                { vk::ImageAspectFlagBits::eColor, 0, 0, 1 },
+                { start.x, start.y, 0 },
+                { static_cast<uint32_t>(size.x), static_cast<uint32_t>(size.y), 1 }
+            );
+
+            bitmapImage->transition(buffer, vk::ImageLayout::eTransferDstOptimal);
+            buffer.copyBufferToImage(
+                *stagingBuffer->bufferArray(), bitmapImage->image(), vk::ImageLayout::eTransferDstOptimal, 1, &region
+            );
+            bitmapImage->transition(buffer, vk::ImageLayout::eGeneral);
+        }
+    );
+
+    task->freeWhenDone(std::move(stagingBuffer));
+
+    engine.getTaskManager().submitTask(std::move(task));
+}
+
 float Heightmap::getHeightAt(float x, float y) const {
     if (x < 0 || y < 0 || x > width || y > height) {
         return std::numeric_limits<float>::infinity();
     }
 
-    auto xLow = static_cast<uint32_t>(x);
-    auto yLow = static_cast<uint32_t>(y);
-    auto xFrac = x - static_cast<float>(xLow);
-    auto yFrac = y - static_cast<float>(yLow);
-
-    // Sample 4 values
-    float minXminY = getHeightAt(xLow, yLow);
-    float maxXminY;
-    float minXmaxY;
-    float maxXmaxY;
-
-    if (xLow + 1 < width) {
-        maxXminY = getHeightAt(xLow + 1, yLow);
-    } else {
-        maxXminY = minXminY;
-    }
-    if (yLow + 1 < height) {
-        minXmaxY = getHeightAt(xLow, yLow + 1);
-        if (xLow + 1 < width) {
-            maxXmaxY = getHeightAt(xLow + 1, yLow + 1);
-        } else {
-            maxXmaxY = minXmaxY;
-        }
-    } else {
-        minXmaxY = minXminY;
-        maxXmaxY = maxXminY;
-    }
+    return getSampler().getHeightAt(x, y);
+}
 
-    // Interpolate
-    float y1 = minXminY * (1 - xFrac) + maxXminY * xFrac;
-    float y2 = minXmaxY * (1 - xFrac) + maxXmaxY * xFrac;
+float Heightmap::getHeightAt(uint32_t x, uint32_t y) const {
+    return getSampler().getHeightAt(x, y);
+}
 
-    return y1 * (1 - yFrac) + y2 * yFrac;
+void Heightmap::getHeightsAt(std::span<const glm::vec2> coords, std::span<float> heights) const {
+    getSampler().getHeightsAt(coords, heights);
 }
 
-float Heightmap::getHeightAt(uint32_t x, uint32_t y) const {
-    auto index = x + y * width;
+void Heightmap::getNormalsAt(std::span<const glm::vec2> coords, std::span<glm::vec3> normals) const {
+    getSampler().getNormalsAt(coords, normals);
+}
 
-    auto newScale = maxElevation - minElevation;
-    return static_cast<float>(bitmap[index]) / HEIGHTMAP_SCALE * newScale + minElevation;
+void Heightmap::getSlopesAt(std::span<const glm::vec2> coords, std::span<float> slopes) const {
+    getSampler().getSlopesAt(coords, slopes);
 }
 
 void Heightmap::updateNormalMap() {
-    normalMapUpdateTask->execute(Elevation { minElevation, maxElevation }, width, height);
+    updateNormalMap({ 0, 0 }, { static_cast<int32_t>(width), static_cast<int32_t>(height) });
+}
+
+void Heightmap::updateNormalMap(const glm::ivec2 &start, const glm::ivec2 &end) {
+    // Each normal also depends on the pixels to its right and below, so the pixels before the region change too
+    auto first = glm::max(start - 1, glm::ivec2(0));
+    auto last = glm::min(end, glm::ivec2(static_cast<int32_t>(width), static_cast<int32_t>(height)));
+    if (last.x <= first.x || last.y <= first.y) {
+        return;
+    }
+
+    auto size = last - first;
+    normalMapUpdateTask->execute(
+        NormalRegion { minElevation, maxElevation, first, size }, static_cast<uint32_t>(size.x),
+        static_cast<uint32_t>(size.y)
+    );
 }
 
 void Heightmap::initiate() {
@@ -197,7 +227,7 @@ void Heightmap::initiate() {
         .fromFile("assets/shaders/compute/heightmap/regen_normals.spv")
         .withStorageImage(0, Engine::UsageType::Input, bitmapImage)
         .withStorageImage(1, Engine::UsageType::Output, normalImage)
-        .withPushConstant<Elevation>()
+        .withPushConstant<NormalRegion>()
         .withWorkgroups(16, 16)
         .build();
 
@@ -222,21 +252,11 @@ void Heightmap::terraform(TerraformMode mode, const glm::vec2 &pos, float radius
         width,
         height
     );
-    normalMapUpdateTask->execute(Elevation { minElevation, maxElevation }, width, height);
+    updateNormalMap(glm::ivec2(glm::floor(pos - radius)), glm::ivec2(glm::ceil(pos + radius)) + 1);
 
     brushTask->doAfterExecution(
         [this, pos, radius]() {
-            if (isModified) {
-                invalidateStart.x = std::min(invalidateStart.x, static_cast<int>(std::floor(pos.x - radius)));
-                invalidateStart.y = std::min(invalidateStart.x, static_cast<int>(std::floor(pos.x - radius)));
-                invalidateEnd.x = std::min(invalidateEnd.x, static_cast<int>(std::ceil(pos.x + radius)));
-                invalidateEnd.y = std::min(invalidateEnd.x, static_cast<int>(std::ceil(pos.x + radius)));
-            } else {
-                glm::vec2 offset { radius, radius };
-                invalidateStart = glm::floor(pos - offset);
-                invalidateEnd = glm::ceil(pos + offset);
-                isModified = true;
-            }
+            markChanged(pos, radius);
         }
     );
 }
@@ -250,21 +270,160 @@ void Heightmap::terraformTo(float level, const glm::vec2 &pos, float radius, flo
         width,
         height
     );
-    normalMapUpdateTask->execute(Elevation { minElevation, maxElevation }, width, height);
+    updateNormalMap(glm::ivec2(glm::floor(pos - radius)), glm::ivec2(glm::ceil(pos + radius)) + 1);
 
     brushTask->doAfterExecution(
         [this, pos, radius]() {
-            if (isModified) {
-                invalidateStart.x = std::min(invalidateStart.x, static_cast<int>(std::floor(pos.x - radius)));
-                invalidateStart.y = std::min(invalidateStart.x, static_cast<int>(std::floor(pos.x - radius)));
-                invalidateEnd.x = std::min(invalidateEnd.x, static_cast<int>(std::ceil(pos.x + radius)));
-                invalidateEnd.y = std::min(invalidateEnd.x, static_cast<int>(std::ceil(pos.x + radius)));
-            } else {
-                glm::vec2 offset { radius, radius };
-                invalidateStart = glm::floor(pos - offset);
-                invalidateEnd = glm::ceil(pos + offset);
-                isModified = true;
+            markChanged(pos, radius);
+        }
+    );
+}
+
+void Heightmap::setHeights(const glm::ivec2 &start, const glm::ivec2 &size, std::span<const float> heights) {
+    stageHeights(start, size, heights);
+    commitHeights();
+}
+
+void Heightmap::stageHeights(const glm::ivec2 &start, const glm::ivec2 &size, std::span<const float> heights) {
+    if (size.x <= 0 || size.y <= 0) {
+        return;
+    }
+
+    auto range = maxElevation - minElevation;
+    for (int32_t y = 0; y < size.y; ++y) {
+        auto *row = bitmap + start.x + (start.y + y) * width;
+        for (int32_t x = 0; x < size.x; ++x) {
+            auto value = std::round((heights[x + y * size.x] - minElevation) / range * HEIGHTMAP_SCALE);
+            row[x] = static_cast<uint16_t>(std::clamp(value, 0.0f, HEIGHTMAP_SCALE));
+        }
+    }
+
+    if (hasStaged) {
+        stagedStart = glm::min(stagedStart, start);
+        stagedEnd = glm::max(stagedEnd, start + size);
+    } else {
+        stagedStart = start;
+        stagedEnd = start + size;
+        hasStaged = true;
+    }
+}
+
+void Heightmap::commitHeights() {
+    if (!hasStaged) {
+        return;
+    }
+    hasStaged = false;
+
+    // The CPU copy already has the heights, only the image needs them
+    auto size = stagedEnd - stagedStart;
+    std::vector<uint16_t> pixels(static_cast<size_t>(size.x) * size.y);
+    for (int32_t y = 0; y < size.y; ++y) {
+        auto *row = bitmap + stagedStart.x + (stagedStart.y + y) * width;
+        std::copy_n(row, size.x, pixels.data() + static_cast<size_t>(y) * size.x);
+    }
+
+    transferRegion(stagedStart, size, pixels.data());
+    updateNormalMap(stagedStart, stagedEnd);
+
+    markChanged(stagedStart, stagedEnd);
+}
+
+void Heightmap::erode(const glm::vec2 &pos, float radius, uint32_t droplets) {
+    if (droplets == 0) {
+        return;
+    }
+
+    if (!erosionRunning) {
+        startErosion({ pos, radius, droplets });
+        return;
+    }
+
+    // Follow the brush with everything asked for in the meantime
+    if (queuedErosion) {
+        queuedErosion = ErosionDab { pos, std::max(radius, queuedErosion->radius), queuedErosion->droplets + droplets };
+    } else {
+        queuedErosion = ErosionDab { pos, radius, droplets };
+    }
+}
+
+void Heightmap::update() {
+    if (!erosionRunning) {
+        return;
+    }
+
+    std::optional<ErosionResult> result;
+    {
+        std::lock_guard<std::mutex> lock(erosionLock);
+        result.swap(erosionResult);
+    }
+
+    if (!result) {
+        return;
+    }
+
+    erosionRunning = false;
+
+    // Edits made while erosion ran are kept, only the change erosion made is applied on top of them
+    auto heights = std::move(result->change);
+    auto sampler = getSampler();
+    for (int32_t y = 0; y < result->size.y; ++y) {
+        for (int32_t x = 0; x < result->size.x; ++x) {
+            heights[x + y * result->size.x] += sampler.getHeightAt(
+                static_cast<uint32_t>(result->start.x + x), static_cast<uint32_t>(result->start.y + y)
+            );
+        }
+    }
+    setHeights(result->start, result->size, heights);
+
+    if (queuedErosion) {
+        auto dab = *queuedErosion;
+        queuedErosion.reset();
+        startErosion(dab);
+    }
+}
+
+void Heightmap::startErosion(const ErosionDab &dab) {
+    glm::ivec2 start = glm::max(glm::ivec2(glm::floor(dab.pos - dab.radius)), glm::ivec2(0));
+    glm::ivec2 end = glm::min(
+        glm::ivec2(glm::ceil(dab.pos + dab.radius)) + 1,
+        glm::ivec2(static_cast<int32_t>(width), static_cast<int32_t>(height))
+    );
+    if (end.x <= start.x || end.y <= start.y) {
+        return;
+    }
+
+    // The worker gets its own copy of the square, the heightmap is written to on this thread
+    auto size = end - start;
+    std::vector<float> heights(static_cast<size_t>(size.x) * size.y);
+    auto sampler = getSampler();
+    for (int32_t y = 0; y < size.y; ++y) {
+        for (int32_t x = 0; x < size.x; ++x) {
+            heights[x + y * size.x] = sampler.getHeightAt(
+                static_cast<uint32_t>(start.x + x), static_cast<uint32_t>(start.y + y)
+            );
+        }
+    }
+
+    if (!eroder) {
+        eroder = std::make_unique<Erosion::Eroder>(ThreadPool::getShared());
+    }
+
+    erosionRunning = true;
+    eroder->getWorkers().submit(
+        [this, start, size, heights = std::move(heights), droplets = dab.droplets, seed = erosionSeed++,
+            hydraulic = hydraulicSettings, thermal = thermalSettings]() mutable {
+            auto original = heights;
+            Erosion::HeightGrid grid { heights.data(), static_cast<uint32_t>(size.x), static_cast<uint32_t>(size.y) };
+            Erosion::Bounds region { { 0, 0 }, size };
+            eroder->erodeHydraulic(grid, region, droplets, seed, hydraulic);
+            eroder->relaxThermal(grid, region, thermal);
+
+            for (size_t i = 0; i < heights.size(); ++i) {
+                heights[i] -= original[i];
             }
+
+            std::lock_guard<std::mutex> lock(erosionLock);
+            erosionResult = ErosionResult { start, size, std::move(heights) };
         }
     );
 }
@@ -274,3 +433,21 @@ void Heightmap::getAndClearInvalidationRegion(glm::ivec2 &min, glm::ivec2 &max)
     max = invalidateEnd;
     isModified = false;
 }
+
+void Heightmap::markChanged(const glm::vec2 &pos, float radius) {
+    glm::vec2 offset { radius, radius };
+    markChanged(glm::ivec2(glm::floor(pos - offset)), glm::ivec2(glm::ceil(pos + offset)));
+}
+
+void Heightmap::markChanged(const glm::ivec2 &start, const glm::ivec2 &end) {
+    if (isModified) {
+        invalidateStart = glm::min(invalidateStart, start);
+        invalidateEnd = glm::max(invalidateEnd, end);
+    } else {
+        invalidateStart = start;
+        invalidateEnd = end;
+        isModified = true;
+    }
+
+    history.add(start, end);
+}
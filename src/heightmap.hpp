@@ -2,9 +2,19 @@
 
 #include <vector>
 #include <cstdint>
+#include <mutex>
+#include <optional>
 #include <tech-core/image.hpp>
 #include <tech-core/compute.hpp>
 #include <glm/glm.hpp>
+#include "heightmap_sampler.hpp"
+#include "erosion/structures.hpp"
+#include "utils/change_history.hpp"
+
+namespace Erosion {
+class Eroder;
+}
+
 
 enum class TerraformMode {
     Add,
@@ -31,9 +41,29 @@ public:
 
     std::shared_ptr<Engine::Image> getNormalMap() const { return normalImage; }
 
+    /**
+     * GPU memory of the height and normal textures which the terrain shaders sample
+     */
+    size_t getTextureMemoryUsage() const { return static_cast<size_t>(width) * height * (sizeof(uint16_t) + 4); }
+
     float getHeightAt(uint32_t x, uint32_t y) const;
+    /**
+     * @return infinity outside of the heightmap
+     */
     float getHeightAt(float x, float y) const;
 
+    /**
+     * Samples the CPU copy of the heights, clamping coordinates to the edges
+     */
+    HeightmapSampler getSampler() const { return { bitmap, width, height, minElevation, maxElevation }; }
+
+    /**
+     * Batch versions of getHeightAt, getNormalAt and getSlopeAt on the sampler for many points at once
+     */
+    void getHeightsAt(std::span<const glm::vec2> coords, std::span<float> heights) const;
+    void getNormalsAt(std::span<const glm::vec2> coords, std::span<glm::vec3> normals) const;
+    void getSlopesAt(std::span<const glm::vec2> coords, std::span<float> slopes) const;
+
     void calculateMinMax(
         uint32_t startX, uint32_t endX, uint32_t startY, uint32_t endY, float &minimum, float &maximum
     );
@@ -41,10 +71,56 @@ public:
     void terraform(TerraformMode mode, const glm::vec2 &pos, float radius, float amount, float hardness = 0);
     void terraformTo(float height, const glm::vec2 &pos, float radius, float rate, float hardness = 0);
 
+    /**
+     * Replaces the heights of a region in one go, rather than a dab at a time like the brushes.
+     * The region must be inside the heightmap, heights are stored a row at a time.
+     */
+    void setHeights(const glm::ivec2 &start, const glm::ivec2 &size, std::span<const float> heights);
+
+    /**
+     * Like setHeights but only the CPU copy changes, so later reads already see the heights. Many regions can be
+     * staged and then sent to the GPU together by commitHeights.
+     */
+    void stageHeights(const glm::ivec2 &start, const glm::ivec2 &size, std::span<const float> heights);
+
+    /**
+     * Uploads the region covering everything staged since the last commit
+     */
+    void commitHeights();
+
+    /**
+     * Runs droplets over the square around pos, then lets anything too steep slide down. Only the square changes.
+     * This runs in the background on a copy of the square, the heights change in a later update(). Dabs made while
+     * one is running are merged into the next one.
+     */
+    void erode(const glm::vec2 &pos, float radius, uint32_t droplets);
+
+    /**
+     * Writes back finished erosion and starts the next. Call once per frame on the render thread.
+     */
+    void update();
+
+    Erosion::HydraulicSettings &getHydraulicSettings() { return hydraulicSettings; }
+
+    Erosion::ThermalSettings &getThermalSettings() { return thermalSettings; }
+
     bool getIsModified() const { return isModified; }
 
     void getAndClearInvalidationRegion(glm::ivec2 &min, glm::ivec2 &max);
 
+    /**
+     * Increases every time heights on the CPU side change
+     */
+    uint32_t getVersion() const { return history.getVersion(); }
+
+    /**
+     * Finds the region which changed after the given version, separately from the invalidation region.
+     * @return false when the changes are too old to be known, the whole heightmap has to be assumed changed
+     */
+    bool getChangedSince(uint32_t sinceVersion, glm::ivec2 &min, glm::ivec2 &max) const {
+        return history.getChangedSince(sinceVersion, min, max);
+    }
+
 private:
     Engine::RenderEngine &engine;
     std::unique_ptr<Engine::ComputeTask> normalMapUpdateTask;
@@ -66,10 +142,52 @@ private:
     glm::ivec2 invalidateStart;
     glm::ivec2 invalidateEnd;
 
+    // Covers every region staged since the last commit
+    bool hasStaged { false };
+    glm::ivec2 stagedStart;
+    glm::ivec2 stagedEnd;
+
+    struct ErosionDab {
+        glm::vec2 pos;
+        float radius;
+        uint32_t droplets;
+    };
+
+    struct ErosionResult {
+        glm::ivec2 start;
+        glm::ivec2 size;
+        // How much erosion changed each height, added to whatever the heights are by the time it finishes
+        std::vector<float> change;
+    };
+
+    // Created with the first dab on the shared workers, erosion runs as a job on them too
+    std::unique_ptr<Erosion::Eroder> eroder;
+    Erosion::HydraulicSettings hydraulicSettings;
+    Erosion::ThermalSettings thermalSettings;
+    // Each dab of the erosion brush gets its own droplets
+    uint32_t erosionSeed { 0 };
+
+    // One erosion runs at a time, each on the heights the one before it left
+    bool erosionRunning { false };
+    // Dabs made while erosion was running, merged into one
+    std::optional<ErosionDab> queuedErosion;
+    std::mutex erosionLock;
+    std::optional<ErosionResult> erosionResult;
+
+    ChangeHistory<glm::ivec2> history;
+
     void initiate();
+    void startErosion(const ErosionDab &dab);
+    void markChanged(const glm::vec2 &pos, float radius);
+    void markChanged(const glm::ivec2 &start, const glm::ivec2 &end);
 
     void transferImage(Engine::RenderEngine &, uint16_t *pixelData);
+    void transferRegion(const glm::ivec2 &start, const glm::ivec2 &size, const uint16_t *pixelData);
     void updateNormalMap();
+    /**
+     * Rebuilds the normals affected by heights changing from start up to end
+     */
+    void updateNormalMap(const glm::ivec2 &start, const glm::ivec2 &end);
 };
 
 
@@ -0,0 +1,320 @@
+#include "heightmap_sampler.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#include <immintrin.h>
+#define HEIGHTMAP_SAMPLER_AVX2
+// Also builds the batch loops for AVX2, picked when the program loads. FMA is left out so results stay identical.
+#define HEIGHTMAP_SAMPLER_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define HEIGHTMAP_SAMPLER_CLONES
+#endif
+
+// Matches HEIGHTMAP_SCALE in heightmap.cpp
+const float BitmapScale = 65535.0f;
+// Points worked on together in the batch functions, small enough for everything to stay on the stack
+const uint32_t BlockSize = 64;
+// Fewer points than this are quicker looked up one at a time
+const uint32_t MinimumBatch = 8;
+const float Pi = 3.14159265f;
+
+namespace Internal {
+
+/**
+ * Finds the pixel before the coordinate and how far it is towards the next. The last pixel is reached as the one
+ * before it with a fraction of 1 so the next pixel is always in the heightmap.
+ */
+inline void locate(float coord, uint32_t size, uint32_t &low, float &fraction) {
+    auto last = static_cast<float>(size - 1);
+    // NaN ends up at 0
+    auto clamped = coord > 0 ? std::min(coord, last) : 0.0f;
+
+    // Through int32 as that converts in vector registers
+    low = static_cast<uint32_t>(std::min(static_cast<int32_t>(clamped), static_cast<int32_t>(size - 2)));
+    fraction = clamped - static_cast<float>(low);
+}
+
+inline float toHeight(uint32_t raw, float minElevation, float elevationRange) {
+    return static_cast<float>(raw) / BitmapScale * elevationRange + minElevation;
+}
+
+inline float bilinear(float a, float b, float c, float d, float fractionX, float fractionY) {
+    float top = a * (1 - fractionX) + b * fractionX;
+    float bottom = c * (1 - fractionX) + d * fractionX;
+
+    return top * (1 - fractionY) + bottom * fractionY;
+}
+
+inline glm::vec3 normalize(float x, float y, float z) {
+    auto length = std::sqrt(x * x + y * y + z * z);
+    return { x / length, y / length, z / length };
+}
+
+/**
+ * regen_normals.glsl takes cross(right - origin, down - origin) which comes down to this
+ */
+inline glm::vec3 pixelNormal(float origin, float right, float down) {
+    return normalize(-(right - origin), -(down - origin), 1);
+}
+
+inline glm::vec3 blendNormals(
+    const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, const glm::vec3 &d, float fractionX, float fractionY
+) {
+    return normalize(
+        bilinear(a.x, b.x, c.x, d.x, fractionX, fractionY),
+        bilinear(a.y, b.y, c.y, d.y, fractionX, fractionY),
+        bilinear(a.z, b.z, c.z, d.z, fractionX, fractionY)
+    );
+}
+
+inline float toSlope(const glm::vec3 &normal) {
+    return std::acos(std::min(normal.z, 1.0f)) * 180 / Pi;
+}
+
+#ifdef HEIGHTMAP_SAMPLER_AVX2
+bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+/**
+ * Gathers 8 pairs at a time
+ * @return The number of pairs gathered, the rest are left for the caller
+ */
+__attribute__((target("avx2")))
+uint32_t gatherPairsAvx2(
+    const uint16_t *bitmap, const int32_t *indices, uint32_t count, float minElevation, float elevationRange,
+    float *first, float *second
+) {
+    auto scale = _mm256_set1_ps(BitmapScale);
+    auto range = _mm256_set1_ps(elevationRange);
+    auto minimum = _mm256_set1_ps(minElevation);
+    auto lowHalf = _mm256_set1_epi32(0xFFFF);
+
+    uint32_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        auto offsets = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices + index));
+        // Both pixels of a pair come from one 32 bit load, the first in the low half
+        auto pairs = _mm256_i32gather_epi32(reinterpret_cast<const int *>(bitmap), offsets, 2);
+
+        // The same operations in the same order as toHeight so the results are identical
+        auto firstRaw = _mm256_cvtepi32_ps(_mm256_and_si256(pairs, lowHalf));
+        auto secondRaw = _mm256_cvtepi32_ps(_mm256_srli_epi32(pairs, 16));
+        _mm256_storeu_ps(
+            first + index, _mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(firstRaw, scale), range), minimum)
+        );
+        _mm256_storeu_ps(
+            second + index, _mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(secondRaw, scale), range), minimum)
+        );
+    }
+
+    return index;
+}
+#endif
+
+/**
+ * Reads the heights of the pixel at each index and the one after it
+ */
+void gatherPairs(
+    const uint16_t *bitmap, const int32_t *indices, uint32_t count, float minElevation, float elevationRange,
+    float *first, float *second
+) {
+    uint32_t index = 0;
+#ifdef HEIGHTMAP_SAMPLER_AVX2
+    if (hasAvx2()) {
+        index = gatherPairsAvx2(bitmap, indices, count, minElevation, elevationRange, first, second);
+    }
+#endif
+
+    for (; index < count; ++index) {
+        first[index] = toHeight(bitmap[indices[index]], minElevation, elevationRange);
+        second[index] = toHeight(bitmap[indices[index] + 1], minElevation, elevationRange);
+    }
+}
+
+HEIGHTMAP_SAMPLER_CLONES
+void heightBlock(
+    const uint16_t *bitmap, uint32_t width, uint32_t height, float minElevation, float elevationRange,
+    const glm::vec2 *coords, uint32_t count, float *heights
+) {
+    int32_t top[BlockSize], bottom[BlockSize];
+    float fractionX[BlockSize], fractionY[BlockSize];
+    float a[BlockSize], b[BlockSize], c[BlockSize], d[BlockSize];
+
+    for (uint32_t index = 0; index < count; ++index) {
+        uint32_t pixelX, pixelY;
+        locate(coords[index].x, width, pixelX, fractionX[index]);
+        locate(coords[index].y, height, pixelY, fractionY[index]);
+
+        top[index] = static_cast<int32_t>(pixelX + pixelY * width);
+        bottom[index] = top[index] + static_cast<int32_t>(width);
+    }
+
+    gatherPairs(bitmap, top, count, minElevation, elevationRange, a, b);
+    gatherPairs(bitmap, bottom, count, minElevation, elevationRange, c, d);
+
+    for (uint32_t index = 0; index < count; ++index) {
+        heights[index] = bilinear(a[index], b[index], c[index], d[index], fractionX[index], fractionY[index]);
+    }
+}
+
+HEIGHTMAP_SAMPLER_CLONES
+void normalBlock(
+    const uint16_t *bitmap, uint32_t width, uint32_t height, float minElevation, float elevationRange,
+    const glm::vec2 *coords, uint32_t count, glm::vec3 *normals
+) {
+    // The four pixel normals need a 3x3 square of heights less its far corner, the third row and column are clamped
+    int32_t rows[3][BlockSize], lastColumns[2][BlockSize];
+    float fractionX[BlockSize], fractionY[BlockSize];
+    float heights[3][3][BlockSize];
+    float unused[BlockSize];
+
+    for (uint32_t index = 0; index < count; ++index) {
+        uint32_t pixelX, pixelY;
+        locate(coords[index].x, width, pixelX, fractionX[index]);
+        locate(coords[index].y, height, pixelY, fractionY[index]);
+
+        auto lastX = std::min(pixelX + 2, width - 1);
+        auto lastY = std::min(pixelY + 2, height - 1);
+
+        rows[0][index] = static_cast<int32_t>(pixelX + pixelY * width);
+        rows[1][index] = rows[0][index] + static_cast<int32_t>(width);
+        rows[2][index] = static_cast<int32_t>(pixelX + lastY * width);
+        // As the second of a pair so the load stays inside the heightmap
+        lastColumns[0][index] = static_cast<int32_t>(lastX - 1 + pixelY * width);
+        lastColumns[1][index] = lastColumns[0][index] + static_cast<int32_t>(width);
+    }
+
+    for (uint32_t row = 0; row < 3; ++row) {
+        gatherPairs(bitmap, rows[row], count, minElevation, elevationRange, heights[row][0], heights[row][1]);
+    }
+    for (uint32_t row = 0; row < 2; ++row) {
+        gatherPairs(bitmap, lastColumns[row], count, minElevation, elevationRange, unused, heights[row][2]);
+    }
+
+    for (uint32_t index = 0; index < count; ++index) {
+        auto topLeft = pixelNormal(heights[0][0][index], heights[0][1][index], heights[1][0][index]);
+        auto topRight = pixelNormal(heights[0][1][index], heights[0][2][index], heights[1][1][index]);
+        auto bottomLeft = pixelNormal(heights[1][0][index], heights[1][1][index], heights[2][0][index]);
+        auto bottomRight = pixelNormal(heights[1][1][index], heights[1][2][index], heights[2][1][index]);
+
+        normals[index] = blendNormals(topLeft, topRight, bottomLeft, bottomRight, fractionX[index], fractionY[index]);
+    }
+}
+
+}
+
+HeightmapSampler::HeightmapSampler(
+    const uint16_t *bitmap, uint32_t width, uint32_t height, float minElevation, float maxElevation
+) : bitmap(bitmap), width(width), height(height), minElevation(minElevation),
+    elevationRange(maxElevation - minElevation) {}
+
+HeightmapSampler HeightmapSampler::copyRegion(
+    const glm::ivec2 &start, const glm::ivec2 &size, std::vector<uint16_t> &pixels
+) const {
+    pixels.resize(static_cast<size_t>(size.x) * size.y);
+    for (int32_t y = 0; y < size.y; ++y) {
+        auto *row = bitmap + start.x + static_cast<size_t>(start.y + y) * width;
+        std::copy_n(row, size.x, pixels.data() + static_cast<size_t>(y) * size.x);
+    }
+
+    // Keeps the elevation exactly as it was so the copy gives the same heights
+    auto copy = *this;
+    copy.bitmap = pixels.data();
+    copy.width = static_cast<uint32_t>(size.x);
+    copy.height = static_cast<uint32_t>(size.y);
+    return copy;
+}
+
+float HeightmapSampler::getHeightAt(uint32_t x, uint32_t y) const {
+    return Internal::toHeight(bitmap[x + y * width], minElevation, elevationRange);
+}
+
+float HeightmapSampler::getHeightAt(float x, float y) const {
+    uint32_t pixelX, pixelY;
+    float fractionX, fractionY;
+    Internal::locate(x, width, pixelX, fractionX);
+    Internal::locate(y, height, pixelY, fractionY);
+
+    return Internal::bilinear(
+        getHeightAt(pixelX, pixelY), getHeightAt(pixelX + 1, pixelY),
+        getHeightAt(pixelX, pixelY + 1), getHeightAt(pixelX + 1, pixelY + 1),
+        fractionX, fractionY
+    );
+}
+
+glm::vec3 HeightmapSampler::getNormalAt(uint32_t x, uint32_t y) const {
+    return Internal::pixelNormal(
+        getHeightAt(x, y), getHeightAt(std::min(x + 1, width - 1), y), getHeightAt(x, std::min(y + 1, height - 1))
+    );
+}
+
+glm::vec3 HeightmapSampler::getNormalAt(float x, float y) const {
+    uint32_t pixelX, pixelY;
+    float fractionX, fractionY;
+    Internal::locate(x, width, pixelX, fractionX);
+    Internal::locate(y, height, pixelY, fractionY);
+
+    return Internal::blendNormals(
+        getNormalAt(pixelX, pixelY), getNormalAt(pixelX + 1, pixelY),
+        getNormalAt(pixelX, pixelY + 1), getNormalAt(pixelX + 1, pixelY + 1),
+        fractionX, fractionY
+    );
+}
+
+float HeightmapSampler::getSlopeAt(float x, float y) const {
+    return Internal::toSlope(getNormalAt(x, y));
+}
+
+void HeightmapSampler::getHeightsAt(std::span<const glm::vec2> coords, std::span<float> heights) const {
+    if (coords.size() < MinimumBatch) {
+        for (size_t index = 0; index < coords.size(); ++index) {
+            heights[index] = getHeightAt(coords[index].x, coords[index].y);
+        }
+        return;
+    }
+
+    for (size_t start = 0; start < coords.size(); start += BlockSize) {
+        auto count = static_cast<uint32_t>(std::min<size_t>(BlockSize, coords.size() - start));
+        Internal::heightBlock(
+            bitmap, width, height, minElevation, elevationRange, &coords[start], count, &heights[start]
+        );
+    }
+}
+
+void HeightmapSampler::getNormalsAt(std::span<const glm::vec2> coords, std::span<glm::vec3> normals) const {
+    if (coords.size() < MinimumBatch) {
+        for (size_t index = 0; index < coords.size(); ++index) {
+            normals[index] = getNormalAt(coords[index].x, coords[index].y);
+        }
+        return;
+    }
+
+    for (size_t start = 0; start < coords.size(); start += BlockSize) {
+        auto count = static_cast<uint32_t>(std::min<size_t>(BlockSize, coords.size() - start));
+        Internal::normalBlock(
+            bitmap, width, height, minElevation, elevationRange, &coords[start], count, &normals[start]
+        );
+    }
+}
+
+void HeightmapSampler::getSlopesAt(std::span<const glm::vec2> coords, std::span<float> slopes) const {
+    if (coords.size() < MinimumBatch) {
+        for (size_t index = 0; index < coords.size(); ++index) {
+            slopes[index] = getSlopeAt(coords[index].x, coords[index].y);
+        }
+        return;
+    }
+
+    glm::vec3 normals[BlockSize];
+
+    for (size_t start = 0; start < coords.size(); start += BlockSize) {
+        auto count = static_cast<uint32_t>(std::min<size_t>(BlockSize, coords.size() - start));
+        Internal::normalBlock(bitmap, width, height, minElevation, elevationRange, &coords[start], count, normals);
+
+        for (uint32_t index = 0; index < count; ++index) {
+            slopes[start + index] = Internal::toSlope(normals[index]);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * Reads heights, normals and slopes from the CPU copy of a heightmap. Coordinates are in heightmap pixels and are
+ * clamped to the edges, and normals are the ones regen_normals.glsl writes to the normal map, blended between pixels.
+ *
+ * The batch versions give exactly the same results as calling the single versions for each point, but work through
+ * the points in blocks so the pixels are gathered together, with AVX2 gathers when the CPU supports them.
+ * The heightmap needs to be at least 2 pixels along each side.
+ */
+class HeightmapSampler {
+public:
+    HeightmapSampler(
+        const uint16_t *bitmap, uint32_t width, uint32_t height, float minElevation, float maxElevation
+    );
+
+    uint32_t getWidth() const { return width; }
+
+    uint32_t getHeight() const { return height; }
+
+    float getHeightAt(uint32_t x, uint32_t y) const;
+    float getHeightAt(float x, float y) const;
+
+    glm::vec3 getNormalAt(uint32_t x, uint32_t y) const;
+    glm::vec3 getNormalAt(float x, float y) const;
+
+    /**
+     * Degrees away from flat
+     */
+    float getSlopeAt(float x, float y) const;
+
+    /**
+     * The output spans must be at least as long as the coordinates
+     */
+    void getHeightsAt(std::span<const glm::vec2> coords, std::span<float> heights) const;
+    void getNormalsAt(std::span<const glm::vec2> coords, std::span<glm::vec3> normals) const;
+    void getSlopesAt(std::span<const glm::vec2> coords, std::span<float> slopes) const;
+
+    /**
+     * Copies the pixels of a region inside the heightmap so they can be read on another thread
+     * @param pixels Receives the copy and has to outlive the returned sampler, which has the region's first pixel at 0
+     */
+    HeightmapSampler copyRegion(const glm::ivec2 &start, const glm::ivec2 &size, std::vector<uint16_t> &pixels) const;
+
+private:
+    const uint16_t *bitmap;
+    uint32_t width;
+    uint32_t height;
+    float minElevation;
+    float elevationRange;
+};
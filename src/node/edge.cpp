@@ -1,8 +1,13 @@
 #include "edge.hpp"
-#include "node.hpp"
+#include <array>
+#include <cmath>
+#include <limits>
 
 namespace Nodes {
 
+// Number of spans in the arc length table of curves, each is integrated with the 16 point quadrature below
+const uint32_t ArcLengthSegments = 16;
+
 // Values from https://pomax.github.io/bezierinfo/legendre-gauss.html#n16
 constexpr std::array<double, 16> CValues {
     0.1894506104550685,
@@ -42,13 +47,16 @@ constexpr std::array<double, 16> TValues {
     0.9894009349916499
 };
 
-Edge::Edge(std::shared_ptr<Node> start, std::shared_ptr<Node> end, float width)
-    : start(start), end(end), width(width) {
+Edge::Edge(NodeId start, NodeId end, const glm::vec3 &startPosition, const glm::vec3 &endPosition, float width)
+    : width(width), links { { start }, { end } }, startPosition(startPosition), endPosition(endPosition) {
     invalidate();
 }
 
-Edge::Edge(std::shared_ptr<Node> start, std::shared_ptr<Node> end, float width, const glm::vec2 &midpoint)
-    : start(start), end(end), width(width), midpoint(midpoint) {
+Edge::Edge(
+    NodeId start, NodeId end, const glm::vec3 &startPosition, const glm::vec3 &endPosition, float width,
+    const glm::vec2 &midpoint
+) : width(width), links { { start }, { end } }, startPosition(startPosition), endPosition(endPosition),
+    midpoint(midpoint) {
     invalidate();
 }
 
@@ -56,55 +64,240 @@ void Edge::invalidate() {
     updateLength();
 }
 
-glm::vec3 Edge::getStart() const {
-    return start->getPosition();
+EdgeId Edge::getNextEdge(NodeId node) const {
+    if (links[0].node == node) {
+        return links[0].next;
+    }
+    return links[1].next;
+}
+
+glm::vec3 Edge::getPointAt(float offset) const {
+    uint32_t segment = 0;
+    return getPointAtT(getTAt(offset, segment));
 }
 
+glm::vec3 Edge::getTangentAt(float offset) const {
+    auto linearTangent = glm::normalize(getEnd() - getStart());
+    if (isStraight()) {
+        return linearTangent;
+    }
 
-glm::vec3 Edge::getEnd() const {
-    return end->getPosition();
+    uint32_t segment = 0;
+    auto derivative = derivativeAt(getTAt(offset, segment));
+    return glm::normalize(glm::vec3 { derivative, linearTangent.z });
 }
 
-glm::vec3 Edge::getPointAt(float offset) const {
-    auto t = offset / length;
+void Edge::getPointsAt(std::span<const float> offsets, std::span<glm::vec3> points) const {
+    uint32_t segment = 0;
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        points[i] = getPointAtT(getTAt(offsets[i], segment));
+    }
+}
+
+void Edge::getPointsAt(
+    std::span<const float> offsets, std::span<glm::vec3> points, std::span<glm::vec3> tangents
+) const {
+    auto linearTangent = glm::normalize(getEnd() - getStart());
+    if (isStraight()) {
+        uint32_t segment = 0;
+        for (size_t i = 0; i < offsets.size(); ++i) {
+            points[i] = glm::mix(getStart(), getEnd(), getTAt(offsets[i], segment));
+            tangents[i] = linearTangent;
+        }
+        return;
+    }
+
+    glm::vec2 start(getStart());
+    glm::vec2 end(getEnd());
 
+    uint32_t segment = 0;
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        auto t = getTAt(offsets[i], segment);
+        auto z = glm::mix(getStart().z, getEnd().z, t);
+
+        glm::vec2 point = (1 - t) * (1 - t) * start + 2 * (1 - t) * t * (*midpoint) + t * t * end;
+        points[i] = { point, z };
+        tangents[i] = glm::normalize(glm::vec3 { derivativeAt(t), linearTangent.z });
+    }
+}
+
+float Edge::getCurvatureAt(float offset) const {
+    if (isStraight()) {
+        return 0;
+    }
+
+    uint32_t segment = 0;
+    auto derivative = derivativeAt(getTAt(offset, segment));
+    auto secondDerivative = 2.0f * (glm::vec2(getStart()) - 2.0f * (*midpoint) + glm::vec2(getEnd()));
+
+    auto speed = glm::length(derivative);
+    if (speed == 0) {
+        return 0;
+    }
+
+    auto cross = derivative.x * secondDerivative.y - derivative.y * secondDerivative.x;
+    return std::abs(cross) / (speed * speed * speed);
+}
+
+glm::vec3 Edge::getPointAtT(float t) const {
     auto linearPos = glm::mix(getStart(), getEnd(), t);
     if (isStraight()) {
         return linearPos;
-    } else {
-        // FIXME: We should probably use a 3D midpoint position because otherwise the curve exists only in 2D
-        glm::vec2 point =
-            (1 - t) * (1 - t) * glm::vec2(getStart()) + 2 * (1 - t) * t * (*midpoint) + t * t * glm::vec2(getEnd());
-
-        return { point, linearPos.z };
     }
+
+    glm::vec2 point =
+        (1 - t) * (1 - t) * glm::vec2(getStart()) + 2 * (1 - t) * t * (*midpoint) + t * t * glm::vec2(getEnd());
+
+    return { point, linearPos.z };
 }
 
-glm::vec3 Edge::getTangentAt(float offset) const {
-    auto t = offset / length;
-    auto linearTangent = glm::normalize(getEnd() - getStart());
+float Edge::getClosestT(const glm::vec2 &point) const {
+    glm::vec2 start(getStart());
+    glm::vec2 end(getEnd());
+
     if (isStraight()) {
-        return linearTangent;
-    } else {
-        auto derivative = derivativeAt(t);
-        return glm::normalize(glm::vec3 { derivative, linearTangent.z });
+        auto direction = end - start;
+        auto lengthSquared = glm::dot(direction, direction);
+        if (lengthSquared == 0) {
+            return 0;
+        }
+
+        return glm::clamp(glm::dot(point - start, direction) / lengthSquared, 0.0f, 1.0f);
+    }
+
+    // Coarse search followed by a few newton iterations on the squared distance
+    const uint32_t samples = 16;
+    float bestT = 0;
+    float bestDistance = std::numeric_limits<float>::max();
+    for (uint32_t sample = 0; sample <= samples; ++sample) {
+        auto t = static_cast<float>(sample) / samples;
+        auto offset = glm::vec2(getPointAtT(t)) - point;
+        auto distance = glm::dot(offset, offset);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            bestT = t;
+        }
+    }
+
+    auto secondDerivative = 2.0f * (start - 2.0f * (*midpoint) + end);
+    for (uint32_t iteration = 0; iteration < 4; ++iteration) {
+        auto offset = glm::vec2(getPointAtT(bestT)) - point;
+        auto derivative = derivativeAt(bestT);
+
+        auto numerator = glm::dot(offset, derivative);
+        auto denominator = glm::dot(derivative, derivative) + glm::dot(offset, secondDerivative);
+        if (denominator <= 0) {
+            break;
+        }
+
+        bestT = glm::clamp(bestT - numerator / denominator, 0.0f, 1.0f);
     }
+
+    return bestT;
+}
+
+void Edge::getBounds(glm::vec2 &min, glm::vec2 &max) const {
+    glm::vec2 start(getStart());
+    glm::vec2 end(getEnd());
+
+    min = glm::min(start, end);
+    max = glm::max(start, end);
+
+    // A quadratic bezier never leaves the hull of its control points
+    if (midpoint) {
+        min = glm::min(min, *midpoint);
+        max = glm::max(max, *midpoint);
+    }
+
+    auto halfWidth = glm::vec2(width / 2);
+    min -= halfWidth;
+    max += halfWidth;
 }
 
 void Edge::updateLength() {
+    arcLengths.clear();
+
     if (isStraight()) {
         length = glm::length(getEnd() - getStart());
-    } else {
-        length = 0;
-        for (auto i = 0; i < CValues.size(); ++i) {
-            double t = 0.5 * TValues[i] + 0.5;
+        return;
+    }
 
-            auto derivative = derivativeAt(static_cast<float>(t));
-            length += static_cast<float>(CValues[i]) * glm::length(derivative);
+    arcLengths.resize(ArcLengthSegments + 1);
+    arcLengths[0] = { 0, glm::length(derivativeAt(0)) };
+
+    length = 0;
+    for (uint32_t segment = 0; segment < ArcLengthSegments; ++segment) {
+        auto startT = static_cast<float>(segment) / ArcLengthSegments;
+        auto endT = static_cast<float>(segment + 1) / ArcLengthSegments;
+
+        length += getSegmentLength(startT, endT);
+        arcLengths[segment + 1] = { length, glm::length(derivativeAt(endT)) };
+    }
+}
+
+float Edge::getSegmentLength(float startT, float endT) const {
+    double halfRange = 0.5 * (endT - startT);
+    double middle = 0.5 * (endT + startT);
+
+    double sum = 0;
+    for (size_t i = 0; i < CValues.size(); ++i) {
+        auto t = static_cast<float>(middle + halfRange * TValues[i]);
+        sum += CValues[i] * glm::length(derivativeAt(t));
+    }
+
+    return static_cast<float>(sum * halfRange);
+}
+
+float Edge::getTAt(float offset, uint32_t &segment) const {
+    if (isStraight()) {
+        return length > 0 ? offset / length : 0;
+    }
+
+    offset = glm::clamp(offset, 0.0f, length);
+
+    // Usually the same or the next segment when offsets are evaluated in order
+    if (offset < arcLengths[segment].x || offset > arcLengths[segment + 1].x) {
+        if (segment + 2 < arcLengths.size() && offset >= arcLengths[segment + 1].x &&
+            offset <= arcLengths[segment + 2].x) {
+            ++segment;
+        } else {
+            uint32_t low = 0;
+            uint32_t high = ArcLengthSegments - 1;
+            while (low < high) {
+                auto middle = (low + high + 1) / 2;
+                if (arcLengths[middle].x <= offset) {
+                    low = middle;
+                } else {
+                    high = middle - 1;
+                }
+            }
+            segment = low;
         }
+    }
 
-        length *= 0.5;
+    auto &start = arcLengths[segment];
+    auto &end = arcLengths[segment + 1];
+    auto segmentLength = end.x - start.x;
+    auto startT = static_cast<float>(segment) / ArcLengthSegments;
+    if (segmentLength <= 0) {
+        return startT;
     }
+
+    // Cubic hermite through t as a function of arc length. The slope of that is 1 / speed at each end
+    auto u = (offset - start.x) / segmentLength;
+    float v = u;
+    if (start.y > 0 && end.y > 0) {
+        auto tRange = 1.0f / ArcLengthSegments;
+        auto slope1 = segmentLength / (start.y * tRange);
+        auto slope2 = segmentLength / (end.y * tRange);
+
+        auto u2 = u * u;
+        auto u3 = u2 * u;
+        v = (u3 - 2 * u2 + u) * slope1 + (-2 * u3 + 3 * u2) + (u3 - u2) * slope2;
+        v = glm::clamp(v, 0.0f, 1.0f);
+    }
+
+    return startT + v / ArcLengthSegments;
 }
 
 glm::vec2 Edge::derivativeAt(float t) const {
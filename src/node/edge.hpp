@@ -3,14 +3,23 @@
 #include "forward.hpp"
 #include <glm/glm.hpp>
 #include <optional>
-#include <memory>
+#include <span>
+#include <vector>
 
 namespace Nodes {
 
+/**
+ * A road between two nodes. Edges are owned by the Graph and only changed through it.
+ * The node positions are copied into the edge so that evaluating the curve does not need to look up the nodes.
+ */
 class Edge {
 public:
-    Edge(std::shared_ptr<Node> start, std::shared_ptr<Node> end, float width);
-    Edge(std::shared_ptr<Node> start, std::shared_ptr<Node> end, float width, const glm::vec2 &midpoint);
+    Edge() = default;
+    Edge(NodeId start, NodeId end, const glm::vec3 &startPosition, const glm::vec3 &endPosition, float width);
+    Edge(
+        NodeId start, NodeId end, const glm::vec3 &startPosition, const glm::vec3 &endPosition, float width,
+        const glm::vec2 &midpoint
+    );
 
     void invalidate();
 
@@ -18,30 +27,89 @@ public:
 
     std::optional<glm::vec2> getMidpoint() const { return midpoint; };
 
-    std::shared_ptr<Node> getStartNode() const { return start; };
-    glm::vec3 getStart() const;
+    NodeId getStartNode() const { return links[0].node; };
+    glm::vec3 getStart() const { return startPosition; };
 
-    std::shared_ptr<Node> getEndNode() const { return end; };
-    glm::vec3 getEnd() const;
+    NodeId getEndNode() const { return links[1].node; };
+    glm::vec3 getEnd() const { return endPosition; };
+
+    /**
+     * The edge after this one in the list of edges attached to the node
+     */
+    EdgeId getNextEdge(NodeId node) const;
 
     bool isStraight() const { return !midpoint; };
 
     float getLength() const { return length; }
 
+    /**
+     * Offsets are distances along the centre line in XY from the start.
+     * Along curves they are mapped to the curve parameter with a table of arc lengths built when the edge changes.
+     */
     glm::vec3 getPointAt(float length) const;
     glm::vec3 getTangentAt(float length) const;
 
+    /**
+     * Evaluates many offsets at once. Much cheaper than one at a time, especially when the offsets are sorted.
+     * The outputs must be at least as long as the offsets.
+     */
+    void getPointsAt(std::span<const float> offsets, std::span<glm::vec3> points) const;
+    void getPointsAt(std::span<const float> offsets, std::span<glm::vec3> points, std::span<glm::vec3> tangents) const;
+
+    /**
+     * The curvature (1 / radius) of the centre line in XY at the offset. Zero for straight edges.
+     */
+    float getCurvatureAt(float length) const;
+
+    /**
+     * Gets the point at the curve parameter t (0-1) rather than by length
+     */
+    glm::vec3 getPointAtT(float t) const;
+
+    /**
+     * Finds the curve parameter t (0-1) of the point on the centre line closest to the given point in XY
+     */
+    float getClosestT(const glm::vec2 &point) const;
+
+    /**
+     * A conservative box around the edge in XY, including its width
+     */
+    void getBounds(glm::vec2 &min, glm::vec2 &max) const;
+
 private:
+    friend class Graph;
+
+    // How the edge attaches to one of its nodes
+    struct NodeLink {
+        NodeId node;
+        EdgeId next;
+        // The number of units perpendicular to the start is.
+        float shift { 0 };
+        // The number of units along the edge away from the node the start is.
+        float offset { 0 };
+        // In radians counter-clockwise starting from node -> edge direction
+        float angle { 0 };
+    };
+
     float width { 1 };
-    std::shared_ptr<Node> start;
-    std::shared_ptr<Node> end;
+    // Start then end
+    NodeLink links[2];
+    glm::vec3 startPosition { 0, 0, 0 };
+    glm::vec3 endPosition { 0, 0, 0 };
     std::optional<glm::vec2> midpoint;
 
     float length { -1 };
+    // Arc length and speed (arc length per t) at evenly spaced t. Empty for straight edges
+    std::vector<glm::vec2> arcLengths;
 
     // Only use for bezier curves
     glm::vec2 derivativeAt(float t) const;
     void updateLength();
+    float getSegmentLength(float startT, float endT) const;
+    /**
+     * Finds t at the offset. The segment is a hint for where to start looking and is updated to where it was found.
+     */
+    float getTAt(float offset, uint32_t &segment) const;
 };
 
 }
@@ -0,0 +1,313 @@
+#include "edge_index.hpp"
+#include "edge.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Nodes {
+
+// Number of straight segments a curve is split into for intersection tests
+const uint32_t CurveSegments = 16;
+// Crossings this close to the end of both curves are where they are joined
+const float JoinTolerance = 0.01f;
+
+namespace Internal {
+
+float cross(const glm::vec2 &a, const glm::vec2 &b) {
+    return a.x * b.y - a.y * b.x;
+}
+
+bool intersectSegments(
+    const glm::vec2 &start1, const glm::vec2 &end1, const glm::vec2 &start2, const glm::vec2 &end2, float &t1,
+    float &t2
+) {
+    auto direction1 = end1 - start1;
+    auto direction2 = end2 - start2;
+
+    auto denominator = cross(direction1, direction2);
+    if (denominator == 0) {
+        // Parallel
+        return false;
+    }
+
+    auto offset = start2 - start1;
+    t1 = cross(offset, direction2) / denominator;
+    t2 = cross(offset, direction1) / denominator;
+
+    return t1 >= 0 && t1 <= 1 && t2 >= 0 && t2 <= 1;
+}
+
+void flatten(
+    const glm::vec2 &start, const std::optional<glm::vec2> &midpoint, const glm::vec2 &end,
+    std::vector<glm::vec2> &points
+) {
+    points.clear();
+    if (!midpoint) {
+        points.push_back(start);
+        points.push_back(end);
+        return;
+    }
+
+    for (uint32_t segment = 0; segment <= CurveSegments; ++segment) {
+        auto t = static_cast<float>(segment) / CurveSegments;
+        points.push_back((1 - t) * (1 - t) * start + 2 * (1 - t) * t * (*midpoint) + t * t * end);
+    }
+}
+
+bool isNearEnd(const glm::vec2 &point, const glm::vec2 &start, const glm::vec2 &end) {
+    auto toStart = point - start;
+    auto toEnd = point - end;
+    auto toleranceSquared = JoinTolerance * JoinTolerance;
+    return glm::dot(toStart, toStart) < toleranceSquared || glm::dot(toEnd, toEnd) < toleranceSquared;
+}
+
+}
+
+EdgeIndex::EdgeIndex(const SlotMap<Edge> &edges, float cellSize)
+    : edges(edges), cellSize(cellSize), inverseCellSize(1 / cellSize) {
+
+}
+
+void EdgeIndex::insert(EdgeId edge) {
+    if (edge.index < records.size() && records[edge.index].edge == edge) {
+        update(edge);
+        return;
+    }
+
+    if (edge.index >= records.size()) {
+        records.resize(edges.capacity());
+    }
+
+    auto &record = records[edge.index];
+    if (record.edge) {
+        // The slot still holds an edge which was removed from the pool without being removed from here
+        remove(record.edge);
+    }
+
+    record.edge = edge;
+    edges[edge].getBounds(record.min, record.max);
+    record.minCell = cellFor(record.min);
+    record.maxCell = cellFor(record.max);
+
+    ++count;
+    addToCells(edge.index);
+}
+
+void EdgeIndex::remove(EdgeId edge) {
+    if (edge.index >= records.size() || records[edge.index].edge != edge) {
+        return;
+    }
+
+    removeFromCells(edge.index);
+
+    records[edge.index].edge = {};
+    --count;
+}
+
+void EdgeIndex::update(EdgeId edge) {
+    if (edge.index >= records.size() || records[edge.index].edge != edge) {
+        return;
+    }
+
+    auto &record = records[edge.index];
+    edges[edge].getBounds(record.min, record.max);
+
+    auto minCell = cellFor(record.min);
+    auto maxCell = cellFor(record.max);
+    if (minCell == record.minCell && maxCell == record.maxCell) {
+        return;
+    }
+
+    removeFromCells(edge.index);
+    record.minCell = minCell;
+    record.maxCell = maxCell;
+    addToCells(edge.index);
+}
+
+template<typename Callback>
+void EdgeIndex::visitOverlapping(const glm::vec2 &min, const glm::vec2 &max, Callback &&callback) const {
+    auto minCell = cellFor(min);
+    auto maxCell = cellFor(max);
+
+    ++currentQuery;
+
+    for (auto y = minCell.y; y <= maxCell.y; ++y) {
+        for (auto x = minCell.x; x <= maxCell.x; ++x) {
+            auto it = cells.find(makeKey(x, y));
+            if (it == cells.end()) {
+                continue;
+            }
+
+            for (auto slot : it->second) {
+                auto &record = records[slot];
+                if (record.queryStamp == currentQuery) {
+                    continue;
+                }
+                record.queryStamp = currentQuery;
+
+                callback(record);
+            }
+        }
+    }
+}
+
+std::optional<EdgeHit> EdgeIndex::findNearest(const glm::vec3 &point, float maxDistance) const {
+    glm::vec2 point2D { point.x, point.y };
+    glm::vec2 extent { maxDistance, maxDistance };
+
+    std::optional<EdgeHit> best;
+    auto bestDistanceSquared = maxDistance * maxDistance;
+
+    visitOverlapping(
+        point2D - extent, point2D + extent, [&](const Record &record) {
+            // Skip edges whose box is already further away than the best match
+            auto closestInBox = glm::clamp(point2D, record.min, record.max);
+            auto toBox = closestInBox - point2D;
+            if (glm::dot(toBox, toBox) > bestDistanceSquared) {
+                return;
+            }
+
+            auto &edge = edges[record.edge];
+            auto t = edge.getClosestT(point2D);
+            auto onEdge = edge.getPointAtT(t);
+            auto offset = glm::vec2(onEdge) - point2D;
+            auto distanceSquared = glm::dot(offset, offset);
+
+            if (distanceSquared <= bestDistanceSquared) {
+                bestDistanceSquared = distanceSquared;
+                best = EdgeHit { record.edge, t, onEdge, std::sqrt(distanceSquared) };
+            }
+        }
+    );
+
+    return best;
+}
+
+void EdgeIndex::findIntersections(EdgeId edgeId, std::vector<EdgeIntersection> &intersections) const {
+    auto &edge = edges[edgeId];
+    findIntersections(
+        glm::vec2(edge.getStart()), edge.getMidpoint(), glm::vec2(edge.getEnd()), edgeId, intersections
+    );
+}
+
+void EdgeIndex::findIntersections(
+    const glm::vec2 &start, const std::optional<glm::vec2> &midpoint, const glm::vec2 &end,
+    std::vector<EdgeIntersection> &intersections
+) const {
+    findIntersections(start, midpoint, end, {}, intersections);
+}
+
+void EdgeIndex::findIntersections(
+    const glm::vec2 &start, const std::optional<glm::vec2> &midpoint, const glm::vec2 &end, EdgeId ignore,
+    std::vector<EdgeIntersection> &intersections
+) const {
+    intersections.clear();
+
+    auto min = glm::min(start, end);
+    auto max = glm::max(start, end);
+    if (midpoint) {
+        min = glm::min(min, *midpoint);
+        max = glm::max(max, *midpoint);
+    }
+
+    std::vector<glm::vec2> points;
+    std::vector<glm::vec2> otherPoints;
+    Internal::flatten(start, midpoint, end, points);
+
+    auto segments = static_cast<float>(points.size() - 1);
+
+    visitOverlapping(
+        min, max, [&](const Record &record) {
+            if (record.edge == ignore) {
+                return;
+            }
+
+            // Cells are coarse, make sure the boxes actually overlap
+            if (record.min.x > max.x || record.max.x < min.x || record.min.y > max.y || record.max.y < min.y) {
+                return;
+            }
+
+            auto &edge = edges[record.edge];
+            glm::vec2 otherStart(edge.getStart());
+            glm::vec2 otherEnd(edge.getEnd());
+            Internal::flatten(otherStart, edge.getMidpoint(), otherEnd, otherPoints);
+
+            auto otherSegments = static_cast<float>(otherPoints.size() - 1);
+
+            for (size_t segment = 0; segment + 1 < points.size(); ++segment) {
+                for (size_t otherSegment = 0; otherSegment + 1 < otherPoints.size(); ++otherSegment) {
+                    float t, otherT;
+                    if (!Internal::intersectSegments(
+                        points[segment], points[segment + 1], otherPoints[otherSegment],
+                        otherPoints[otherSegment + 1], t, otherT
+                    )) {
+                        continue;
+                    }
+
+                    auto point = glm::mix(points[segment], points[segment + 1], t);
+                    if (
+                        Internal::isNearEnd(point, start, end) &&
+                            Internal::isNearEnd(point, otherStart, otherEnd)
+                        ) {
+                        // Joined at a node
+                        continue;
+                    }
+
+                    intersections.push_back(
+                        {
+                            record.edge,
+                            (static_cast<float>(otherSegment) + otherT) / otherSegments,
+                            (static_cast<float>(segment) + t) / segments,
+                            point
+                        }
+                    );
+                }
+            }
+        }
+    );
+}
+
+glm::ivec2 EdgeIndex::cellFor(const glm::vec2 &position) const {
+    return {
+        static_cast<int32_t>(std::floor(position.x * inverseCellSize)),
+        static_cast<int32_t>(std::floor(position.y * inverseCellSize))
+    };
+}
+
+uint64_t EdgeIndex::makeKey(int32_t x, int32_t y) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+}
+
+void EdgeIndex::addToCells(uint32_t slot) {
+    auto &record = records[slot];
+    for (auto y = record.minCell.y; y <= record.maxCell.y; ++y) {
+        for (auto x = record.minCell.x; x <= record.maxCell.x; ++x) {
+            cells[makeKey(x, y)].push_back(slot);
+        }
+    }
+}
+
+void EdgeIndex::removeFromCells(uint32_t slot) {
+    auto &record = records[slot];
+    for (auto y = record.minCell.y; y <= record.maxCell.y; ++y) {
+        for (auto x = record.minCell.x; x <= record.maxCell.x; ++x) {
+            auto it = cells.find(makeKey(x, y));
+            if (it == cells.end()) {
+                continue;
+            }
+
+            auto &ids = it->second;
+            auto idIt = std::find(ids.begin(), ids.end(), slot);
+            if (idIt != ids.end()) {
+                *idIt = ids.back();
+                ids.pop_back();
+            }
+
+            if (ids.empty()) {
+                cells.erase(it);
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "forward.hpp"
+#include <glm/glm.hpp>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace Nodes {
+
+struct EdgeHit {
+    EdgeId edge;
+    // Curve parameter (0-1) of the closest point
+    float t;
+    glm::vec3 point;
+    float distance;
+};
+
+struct EdgeIntersection {
+    EdgeId edge;
+    // Curve parameter (0-1) on the edge in the index
+    float t;
+    // Curve parameter (0-1) on the curve being tested
+    float otherT;
+    glm::vec2 point;
+};
+
+/**
+ * Indexes edges by their bounding boxes in a uniform grid over XY.
+ * An edge is listed in every cell its box overlaps, the boxes come from the control hull so they are conservative.
+ * Records are kept in a parallel array to the edge pool, indexed by the slot of the edge.
+ */
+class EdgeIndex {
+public:
+    EdgeIndex(const SlotMap<Edge> &edges, float cellSize);
+
+    size_t size() const { return count; }
+
+    void insert(EdgeId edge);
+    void remove(EdgeId edge);
+    /**
+     * Must be called whenever the shape of an edge changes
+     */
+    void update(EdgeId edge);
+
+    /**
+     * Finds the edge with its centre line closest to the point in XY
+     */
+    std::optional<EdgeHit> findNearest(const glm::vec3 &point, float maxDistance) const;
+
+    /**
+     * Finds where an edge crosses others in the index.
+     * Edges which share a node with it are not reported as crossing at that node.
+     */
+    void findIntersections(EdgeId edge, std::vector<EdgeIntersection> &intersections) const;
+
+    /**
+     * Finds where a curve (straight if there is no midpoint) crosses edges in the index
+     */
+    void findIntersections(
+        const glm::vec2 &start, const std::optional<glm::vec2> &midpoint, const glm::vec2 &end,
+        std::vector<EdgeIntersection> &intersections
+    ) const;
+
+private:
+    struct Record {
+        // Null when the slot is not in the index
+        EdgeId edge;
+        glm::vec2 min;
+        glm::vec2 max;
+        glm::ivec2 minCell;
+        glm::ivec2 maxCell;
+        // Prevents an edge spanning several cells from being tested more than once per query
+        mutable uint32_t queryStamp { 0 };
+    };
+
+    const SlotMap<Edge> &edges;
+    float cellSize;
+    float inverseCellSize;
+
+    std::vector<Record> records;
+    size_t count { 0 };
+    // Slot indices of the edges overlapping each cell
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+
+    mutable uint32_t currentQuery { 0 };
+
+    glm::ivec2 cellFor(const glm::vec2 &position) const;
+    static uint64_t makeKey(int32_t x, int32_t y);
+
+    void addToCells(uint32_t slot);
+    void removeFromCells(uint32_t slot);
+
+    template<typename Callback>
+    void visitOverlapping(const glm::vec2 &min, const glm::vec2 &max, Callback &&callback) const;
+
+    void findIntersections(
+        const glm::vec2 &start, const std::optional<glm::vec2> &midpoint, const glm::vec2 &end, EdgeId ignore,
+        std::vector<EdgeIntersection> &intersections
+    ) const;
+};
+
+}
@@ -1,9 +1,14 @@
 #pragma once
 
+#include "../utils/slot_map.hpp"
+
 namespace Nodes {
 
 class Node;
 class Edge;
 class Graph;
 
-}
\ No newline at end of file
+typedef SlotHandle<Node> NodeId;
+typedef SlotHandle<Edge> EdgeId;
+
+}
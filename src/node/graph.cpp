@@ -1,136 +1,291 @@
 #include "graph.hpp"
-#include "edge.hpp"
-#include "node.hpp"
 #include "../theme.hpp"
+#include <algorithm>
 
 namespace Nodes {
 
+// Roughly the size of the radius NodeTool searches so that most queries only touch a few cells
+const float NodeIndexCellSize = 32;
+// Edges are usually much longer than nodes are wide so use bigger cells to keep the number of cells per edge low
+const float EdgeIndexCellSize = 128;
+
 Graph::Graph(Vector::VectorGraphics &graphics, RoadDisplayManager &display)
-    : graphics(graphics), display(display) {
+    : display(&display), graphics(&graphics), nodeIndex(NodeIndexCellSize), edgeIndex(edges, EdgeIndexCellSize) {
 
 }
 
-void Graph::addNode(const std::shared_ptr<Node> &node) {
-    nodes.push_back(node);
-    node->onAdd(*this);
+Graph::Graph()
+    : nodeIndex(NodeIndexCellSize), edgeIndex(edges, EdgeIndexCellSize) {
 
-    auto shape = graphics.addObject<Vector::Circle>(node->getPosition(), node->getRoughRadius());
-    Theme::good(*shape);
-    nodeShapes.emplace(node.get(), shape);
 }
 
-void Graph::removeNode(const std::shared_ptr<Node> &node) {
-    auto it = nodes.begin();
-    while (it != nodes.end()) {
-        if (*it == node) {
-            nodes.erase(it);
+void Graph::reserve(size_t nodeCount, size_t edgeCount) {
+    nodes.reserve(nodeCount);
+    edges.reserve(edgeCount);
+}
 
-            auto shapeIt = nodeShapes.find(node.get());
-            if (shapeIt != nodeShapes.end()) {
-                graphics.removeObject(shapeIt->second);
-                nodeShapes.erase(shapeIt);
-            }
+NodeId Graph::addNode(const glm::vec3 &position) {
+    auto id = nodes.insert(Node(position));
+    nodeIndex.insert(id, position);
 
-            while (node->getEdgeCount() > 0) {
-                auto edge = node->getEdge(0);
-                unlink(edge);
-            }
+    if (graphics) {
+        if (nodeShapes.size() < nodes.capacity()) {
+            nodeShapes.resize(nodes.capacity());
+        }
+
+        auto shape = graphics->addObject<Vector::Circle>(position, Node::DefaultRadius);
+        Theme::good(*shape);
+        nodeShapes[id.index] = shape;
+    }
+
+    return id;
+}
 
+void Graph::removeNode(NodeId id) {
+    // Unlinking the last edge releases the node
+    while (auto *node = nodes.get(id)) {
+        if (!node->isValid()) {
+            releaseNode(id);
             break;
         }
-        ++it;
+
+        unlink(node->getFirstEdge());
+    }
+}
+
+void Graph::releaseNode(NodeId id) {
+    nodeIndex.remove(id);
+
+    if (id.index < nodeShapes.size() && nodeShapes[id.index]) {
+        graphics->removeObject(nodeShapes[id.index]);
+        nodeShapes[id.index].reset();
+    }
+
+    nodes.remove(id);
+}
+
+void Graph::moveNode(NodeId id, const glm::vec3 &position) {
+    auto *node = nodes.get(id);
+    if (!node) {
+        return;
     }
+
+    node->position = position;
+    invalidateNode(id);
 }
 
-void Graph::link(const std::shared_ptr<Node> &start, const std::shared_ptr<Node> &end, float edgeWidth) {
-    auto edge = std::make_shared<Edge>(start, end, edgeWidth);
-    start->addEdge(edge);
-    end->addEdge(edge);
+EdgeId Graph::link(NodeId start, NodeId end, float edgeWidth) {
+    if (start == end || !nodes.contains(start) || !nodes.contains(end)) {
+        return {};
+    }
 
-    edge->invalidate();
+    return addEdge(Edge(start, end, nodes[start].position, nodes[end].position, edgeWidth));
+}
 
-    addEdgeGraphics(edge);
+EdgeId Graph::link(NodeId start, NodeId end, float edgeWidth, const glm::vec2 &midpoint) {
+    if (start == end || !nodes.contains(start) || !nodes.contains(end)) {
+        return {};
+    }
+
+    return addEdge(Edge(start, end, nodes[start].position, nodes[end].position, edgeWidth, midpoint));
 }
 
-void Graph::link(
-    const std::shared_ptr<Node> &start, const std::shared_ptr<Node> &end, float edgeWidth, const glm::vec2 &midpoint
-) {
-    auto edge = std::make_shared<Edge>(start, end, edgeWidth, midpoint);
-    start->addEdge(edge);
-    end->addEdge(edge);
+EdgeId Graph::addEdge(const Edge &edge) {
+    auto id = edges.insert(edge);
+    attach(edge.getStartNode(), id);
+    attach(edge.getEndNode(), id);
+
+    edgeIndex.insert(id);
+
+    if (edgeDirty.size() < edges.capacity()) {
+        edgeDirty.resize(edges.capacity());
+    }
 
-    edge->invalidate();
+    invalidateNode(edge.getStartNode());
+    invalidateNode(edge.getEndNode());
 
-    addEdgeGraphics(edge);
+    // The other edges at the nodes need updating but this one is built from the current positions
+    edgeDirty[id.index] = false;
+
+    if (display) {
+        display->createForEdge(id, edges[id]);
+    }
+    return id;
 }
 
-void Graph::unlink(const std::shared_ptr<Edge> &edge) {
+void Graph::unlink(EdgeId id) {
+    auto *edge = edges.get(id);
+    if (!edge) {
+        return;
+    }
+
     auto start = edge->getStartNode();
     auto end = edge->getEndNode();
 
-    start->removeEdge(edge);
-    end->removeEdge(edge);
+    edgeIndex.remove(id);
 
-    if (!start->isValid()) {
-        removeNode(start);
+    detach(start, id);
+    detach(end, id);
+
+    if (display) {
+        display->remove(id);
     }
-    if (!end->isValid()) {
-        removeNode(end);
+
+    // Its entry in the dirty list is skipped by update
+    edgeDirty[id.index] = false;
+    edges.remove(id);
+
+    if (!nodes[start].isValid()) {
+        releaseNode(start);
+    } else {
+        invalidateNode(start);
     }
 
-    auto objectIt = edgeObjects.find(edge.get());
-    if (objectIt != edgeObjects.end()) {
-        display.remove(objectIt->second);
-        edgeObjects.erase(objectIt);
+    if (!nodes[end].isValid()) {
+        releaseNode(end);
+    } else {
+        invalidateNode(end);
     }
 }
 
-void Graph::addEdgeGraphics(const std::shared_ptr<Edge> &edge) {
-    auto object = display.createForEdge(edge);
-    if (object) {
-        edgeObjects.emplace(edge.get(), object);
-    }
+void Graph::attach(NodeId nodeId, EdgeId edgeId) {
+    auto &node = nodes[nodeId];
+    auto &edge = edges[edgeId];
+
+    // New edges go on the front of the list
+    auto &link = edge.links[edge.links[0].node == nodeId ? 0 : 1];
+    link.next = node.firstEdge;
+    node.firstEdge = edgeId;
+    ++node.edgeCount;
+
+    updateRadius(nodeId);
 }
 
-std::shared_ptr<Node> Graph::getNodeAt(const glm::vec3 &coord) const {
-    for (auto &node : nodes) {
-        auto toNode = coord - node->getPosition();
-        if (glm::length(toNode) < node->getRoughRadius()) {
-            return node;
+void Graph::detach(NodeId nodeId, EdgeId edgeId) {
+    auto &node = nodes[nodeId];
+    auto next = edges[edgeId].getNextEdge(nodeId);
+
+    if (node.firstEdge == edgeId) {
+        node.firstEdge = next;
+    } else {
+        auto previous = node.firstEdge;
+        while (previous) {
+            auto &previousEdge = edges[previous];
+            auto &link = previousEdge.links[previousEdge.links[0].node == nodeId ? 0 : 1];
+            if (link.next == edgeId) {
+                link.next = next;
+                break;
+            }
+            previous = link.next;
         }
     }
 
-    return {};
+    --node.edgeCount;
+    updateRadius(nodeId);
 }
 
-void Graph::getNodesWithin(const glm::vec3 &coord, float radius, std::vector<std::shared_ptr<Node>> &outNodes) const {
+void Graph::updateRadius(NodeId id) {
+    auto &node = nodes[id];
+    if (!node.isValid()) {
+        node.radius = Node::DefaultRadius;
+        return;
+    }
+
+    float size = 0;
+    forEachEdge(
+        id, [&size](EdgeId, const Edge &edge) {
+            size = std::max(size, edge.getWidth());
+        }
+    );
+
+    node.radius = size;
+    largestNodeRadius = std::max(largestNodeRadius, size);
+}
+
+NodeId Graph::getNodeAt(const glm::vec3 &coord) const {
+    NodeId closest;
+    float closestDistanceSquared = 0;
+
+    nodeIndex.query(
+        coord, largestNodeRadius, [&](const auto &entry, float distanceSquared) {
+            auto radius = nodes[entry.item].getRoughRadius();
+            if (distanceSquared < radius * radius && (!closest || distanceSquared < closestDistanceSquared)) {
+                closest = entry.item;
+                closestDistanceSquared = distanceSquared;
+            }
+            return false;
+        }
+    );
+
+    return closest;
+}
+
+void Graph::getNodesWithin(const glm::vec3 &coord, float radius, std::vector<NodeId> &outNodes) const {
     outNodes.clear();
 
-    for (auto &node : nodes) {
-        auto toNode = coord - node->getPosition();
-        if (glm::length(toNode) < radius) {
-            outNodes.push_back(node);
+    nodeIndex.query(
+        coord, radius, [&outNodes](const auto &entry, float) {
+            outNodes.push_back(entry.item);
+            return false;
         }
-    }
+    );
 }
 
-void Graph::invalidateNode(const Node *node) {
-    auto shapeIt = nodeShapes.find(node);
-    if (shapeIt != nodeShapes.end()) {
-        shapeIt->second->setOrigin(node->getPosition());
+std::optional<EdgeHit> Graph::getEdgeNear(const glm::vec3 &coord, float maxDistance) const {
+    return edgeIndex.findNearest(coord, maxDistance);
+}
+
+void Graph::getIntersections(
+    const glm::vec2 &start, const std::optional<glm::vec2> &midpoint, const glm::vec2 &end,
+    std::vector<EdgeIntersection> &intersections
+) const {
+    edgeIndex.findIntersections(start, midpoint, end, intersections);
+}
+
+void Graph::invalidateNode(NodeId id) {
+    auto &node = nodes[id];
+    nodeIndex.move(id, node.position);
+
+    if (id.index < nodeShapes.size() && nodeShapes[id.index]) {
+        nodeShapes[id.index]->setOrigin(node.position);
+    }
+
+    auto edgeId = node.firstEdge;
+    while (edgeId) {
+        auto &edge = edges[edgeId];
+        if (edge.links[0].node == id) {
+            edge.startPosition = node.position;
+        } else {
+            edge.endPosition = node.position;
+        }
+
+        edge.invalidate();
+
+        if (!edgeDirty[edgeId.index]) {
+            edgeDirty[edgeId.index] = true;
+            dirtyEdges.push_back(edgeId);
+        }
+
+        edgeId = edge.getNextEdge(id);
     }
+}
 
-    for (auto index = 0; index < node->getEdgeCount(); ++index) {
-        auto edge = node->getEdge(index);
+void Graph::update() {
+    for (auto id : dirtyEdges) {
+        // Removed or already up to date
+        if (!edges.contains(id) || !edgeDirty[id.index]) {
+            continue;
+        }
 
-        edge->invalidate();
-        display.invalidate(edge);
+        edgeDirty[id.index] = false;
+        edgeIndex.update(id);
 
-        auto objectIt = edgeObjects.find(edge.get());
-        if (objectIt != edgeObjects.end()) {
-            objectIt->second->setPosition(edge->getStart());
+        if (display) {
+            display->invalidate(id);
         }
     }
+
+    dirtyEdges.clear();
 }
 
-}
\ No newline at end of file
+}
@@ -3,44 +3,119 @@
 #include "forward.hpp"
 #include <memory>
 #include <vector>
-#include <unordered_map>
 #include <glm/glm.hpp>
 #include "../vector/vector_graphics.hpp"
 #include "../vector/circle.hpp"
 #include "../road_display_manager.hpp"
+#include "../utils/slot_map.hpp"
+#include "node.hpp"
+#include "edge.hpp"
+#include "spatial_hash.hpp"
+#include "edge_index.hpp"
 
 namespace Nodes {
 
+/**
+ * Owns every node and edge. Both live in slot maps and are referred to by handle, anything else associated with
+ * them (graphics, meshes, index records) is kept in arrays parallel to the pools, indexed by slot.
+ */
 class Graph {
 public:
     Graph(Vector::VectorGraphics &graphics, RoadDisplayManager &display);
-    std::shared_ptr<Node> getNodeAt(const glm::vec3 &coord) const;
-    void getNodesWithin(const glm::vec3 &coord, float radius, std::vector<std::shared_ptr<Node>> &nodes) const;
+    /**
+     * A graph with no visual output, for tools and benchmarks
+     */
+    Graph();
 
-    void addNode(const std::shared_ptr<Node> &node);
-    void removeNode(const std::shared_ptr<Node> &node);
-    void link(const std::shared_ptr<Node> &start, const std::shared_ptr<Node> &end, float edgeWidth);
-    void link(
-        const std::shared_ptr<Node> &start, const std::shared_ptr<Node> &end, float edgeWidth, const glm::vec2 &midpoint
-    );
-    void unlink(const std::shared_ptr<Edge> &edge);
+    size_t getNodeCount() const { return nodes.size(); }
 
-    void invalidateNode(const Node *);
+    size_t getEdgeCount() const { return edges.size(); }
+
+    /**
+     * @return The node or nullptr if it has been removed. Invalidated by adding nodes.
+     */
+    const Node *getNode(NodeId id) const { return nodes.get(id); }
+
+    /**
+     * @return The edge or nullptr if it has been removed. Invalidated by linking nodes.
+     */
+    const Edge *getEdge(EdgeId id) const { return edges.get(id); }
+
+    /**
+     * Calls the callback with (id, edge) for every edge attached to the node
+     */
+    template<typename Callback>
+    void forEachEdge(NodeId node, Callback &&callback) const;
+
+    NodeId getNodeAt(const glm::vec3 &coord) const;
+    void getNodesWithin(const glm::vec3 &coord, float radius, std::vector<NodeId> &nodes) const;
+
+    std::optional<EdgeHit> getEdgeNear(const glm::vec3 &coord, float maxDistance) const;
+    void getIntersections(
+        const glm::vec2 &start, const std::optional<glm::vec2> &midpoint, const glm::vec2 &end,
+        std::vector<EdgeIntersection> &intersections
+    ) const;
+
+    NodeId addNode(const glm::vec3 &position);
+    void removeNode(NodeId node);
+    void moveNode(NodeId node, const glm::vec3 &position);
+
+    /**
+     * @return The new edge, or a null handle if either node is invalid or they are the same node
+     */
+    EdgeId link(NodeId start, NodeId end, float edgeWidth);
+    EdgeId link(NodeId start, NodeId end, float edgeWidth, const glm::vec2 &midpoint);
+    void unlink(EdgeId edge);
+
+    void reserve(size_t nodeCount, size_t edgeCount);
+
+    /**
+     * Applies the changes to edges which moved since the last update. Call once per frame.
+     * Edges are invalidated every time one of their nodes changes, which can be several times a frame while
+     * dragging. Their geometry is kept up to date immediately, the edge index and the road meshes only once here.
+     */
+    void update();
 
 private:
-    RoadDisplayManager &display;
-    Vector::VectorGraphics &graphics;
+    RoadDisplayManager *display { nullptr };
+    Vector::VectorGraphics *graphics { nullptr };
+
+    SlotMap<Node> nodes;
+    SlotMap<Edge> edges;
 
-    std::vector<std::shared_ptr<Node>> nodes;
+    SpatialHash<NodeId> nodeIndex;
+    // The index is searched using this radius when looking for the node at a point
+    float largestNodeRadius { Node::DefaultRadius };
+    EdgeIndex edgeIndex;
 
-    std::unordered_map<const Edge *, std::shared_ptr<Engine::Object>> edgeObjects;
+    // Edges changed since the last update. Flags are parallel to edges
+    std::vector<EdgeId> dirtyEdges;
+    std::vector<bool> edgeDirty;
 
-    // Debug visual output
-    std::unordered_map<const Node *, std::shared_ptr<Vector::Circle>> nodeShapes;
+    // Debug visual output. Parallel to nodes
+    std::vector<std::shared_ptr<Vector::Circle>> nodeShapes;
 
-    void addEdgeGraphics(const std::shared_ptr<Edge> &);
+    EdgeId addEdge(const Edge &edge);
+    void attach(NodeId node, EdgeId edge);
+    void detach(NodeId node, EdgeId edge);
+    void releaseNode(NodeId node);
+    void updateRadius(NodeId node);
+    void invalidateNode(NodeId node);
 };
 
-}
+template<typename Callback>
+void Graph::forEachEdge(NodeId node, Callback &&callback) const {
+    auto *value = nodes.get(node);
+    if (!value) {
+        return;
+    }
 
+    auto id = value->getFirstEdge();
+    while (id) {
+        auto &edge = edges[id];
+        callback(id, edge);
+        id = edge.getNextEdge(node);
+    }
+}
 
+}
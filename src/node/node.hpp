@@ -3,49 +3,39 @@
 #include "forward.hpp"
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
-#include <memory>
-#include <vector>
+#include <cstdint>
 
 namespace Nodes {
 
+/**
+ * A junction in the graph. Nodes are owned by the Graph and only changed through it.
+ * The edges attached to a node form a list threaded through the edges themselves, see Graph::forEachEdge.
+ */
 class Node {
-    struct NodeLink {
-        std::shared_ptr<Edge> edge;
-        // The number of units perpendicular to the start is.
-        float shift { 0 };
-        // The number of units along the edge away from the node the start is.
-        float offset { 0 };
-        // In radians counter-clockwise starting from node -> edge direction
-        float angle { 0 };
-    };
-
 public:
-    explicit Node(glm::vec3 position);
+    // The radius of a node with no edges
+    static constexpr float DefaultRadius = 2.5f;
 
-    void setPosition(const glm::vec3 &);
+    Node() = default;
+    explicit Node(const glm::vec3 &position);
 
     glm::vec3 getPosition() const { return position; };
-    float getRoughRadius() const;
-
-    bool isValid() const;
+    float getRoughRadius() const { return radius; };
 
-    std::shared_ptr<Edge> getEdge(uint32_t) const;
-    uint32_t getEdgeCount() const;
+    bool isValid() const { return edgeCount > 0; };
 
-    void addEdge(const std::shared_ptr<Edge> &edge);
-    void removeEdge(const std::shared_ptr<Edge> &edge);
+    EdgeId getFirstEdge() const { return firstEdge; };
+    uint32_t getEdgeCount() const { return edgeCount; };
 
-    void onAdd(Graph &);
 private:
-    glm::vec3 position;
-    std::vector<NodeLink> edges;
+    friend class Graph;
 
-    Graph *owner { nullptr };
+    glm::vec3 position { 0, 0, 0 };
+    // The widest attached edge. Kept up to date by the graph
+    float radius { DefaultRadius };
 
-    void invalidate();
+    EdgeId firstEdge;
+    uint32_t edgeCount { 0 };
 };
 
 }
-
-
-
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Nodes {
+
+/**
+ * A uniform grid over the XY plane for finding items near a point.
+ * Cells are only allocated once something is placed in them, so the grid is unbounded.
+ * Distances are still measured in 3D so results match a plain distance check.
+ */
+template<typename T>
+class SpatialHash {
+public:
+    struct Entry {
+        T item;
+        glm::vec3 position;
+    };
+
+    explicit SpatialHash(float cellSize) : cellSize(cellSize), inverseCellSize(1 / cellSize) {}
+
+    float getCellSize() const { return cellSize; }
+
+    size_t size() const { return itemCells.size(); }
+
+    void insert(const T &item, const glm::vec3 &position) {
+        auto key = keyFor(position);
+        cells[key].push_back({ item, position });
+        itemCells[item] = key;
+    }
+
+    void remove(const T &item) {
+        auto it = itemCells.find(item);
+        if (it == itemCells.end()) {
+            return;
+        }
+
+        removeFromCell(it->second, item);
+        itemCells.erase(it);
+    }
+
+    /**
+     * Updates the position of an item. Items which are not in the index are ignored.
+     */
+    void move(const T &item, const glm::vec3 &position) {
+        auto it = itemCells.find(item);
+        if (it == itemCells.end()) {
+            return;
+        }
+
+        auto key = keyFor(position);
+        if (key == it->second) {
+            for (auto &entry : cells[key]) {
+                if (entry.item == item) {
+                    entry.position = position;
+                    break;
+                }
+            }
+            return;
+        }
+
+        removeFromCell(it->second, item);
+        cells[key].push_back({ item, position });
+        it->second = key;
+    }
+
+    void clear() {
+        cells.clear();
+        itemCells.clear();
+    }
+
+    /**
+     * Calls the callback with (entry, distanceSquared) for every item within the radius of the point.
+     * Returning true from the callback stops the query.
+     */
+    template<typename Callback>
+    void query(const glm::vec3 &point, float radius, Callback &&callback) const {
+        auto radiusSquared = radius * radius;
+
+        auto minX = cellCoord(point.x - radius);
+        auto maxX = cellCoord(point.x + radius);
+        auto minY = cellCoord(point.y - radius);
+        auto maxY = cellCoord(point.y + radius);
+
+        for (auto y = minY; y <= maxY; ++y) {
+            for (auto x = minX; x <= maxX; ++x) {
+                auto it = cells.find(makeKey(x, y));
+                if (it == cells.end()) {
+                    continue;
+                }
+
+                for (auto &entry : it->second) {
+                    auto offset = entry.position - point;
+                    auto distanceSquared = glm::dot(offset, offset);
+                    if (distanceSquared < radiusSquared) {
+                        if (callback(entry, distanceSquared)) {
+                            return;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    float cellSize;
+    float inverseCellSize;
+
+    std::unordered_map<uint64_t, std::vector<Entry>> cells;
+    std::unordered_map<T, uint64_t> itemCells;
+
+    int32_t cellCoord(float value) const {
+        return static_cast<int32_t>(std::floor(value * inverseCellSize));
+    }
+
+    uint64_t keyFor(const glm::vec3 &position) const {
+        return makeKey(cellCoord(position.x), cellCoord(position.y));
+    }
+
+    static uint64_t makeKey(int32_t x, int32_t y) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+    }
+
+    void removeFromCell(uint64_t key, const T &item) {
+        auto cellIt = cells.find(key);
+        if (cellIt == cells.end()) {
+            return;
+        }
+
+        auto &entries = cellIt->second;
+        for (size_t index = 0; index < entries.size(); ++index) {
+            if (entries[index].item == item) {
+                // Order within a cell does not matter
+                entries[index] = std::move(entries.back());
+                entries.pop_back();
+                break;
+            }
+        }
+
+        if (entries.empty()) {
+            cells.erase(cellIt);
+        }
+    }
+};
+
+}
@@ -0,0 +1,63 @@
+#include "road_corridor.hpp"
+#include "node/edge.hpp"
+#include "utils/profiler.hpp"
+#include <algorithm>
+
+bool RoadCorridor::build(
+    const Nodes::Edge &edge, float halfWidth, const CorridorShape &shape, const RoadTerrain &terrain,
+    glm::ivec2 &start, glm::ivec2 &size, std::vector<float> &heights
+) {
+    PROFILE_ZONE("RoadCorridor::build");
+
+    auto flatWidth = halfWidth + shape.margin;
+    auto reach = flatWidth + shape.shoulderWidth;
+
+    // The bounds already include the width of the edge, which may differ from the road surface
+    glm::vec2 worldMin;
+    glm::vec2 worldMax;
+    edge.getBounds(worldMin, worldMax);
+    worldMin -= glm::vec2(reach);
+    worldMax += glm::vec2(reach);
+
+    glm::ivec2 last {
+        static_cast<int32_t>(terrain.sampler.getWidth()) - 1, static_cast<int32_t>(terrain.sampler.getHeight()) - 1
+    };
+    glm::ivec2 end = glm::min(glm::ivec2(glm::ceil(terrain.toHeightmap(worldMax))), last);
+    start = glm::max(glm::ivec2(glm::floor(terrain.toHeightmap(worldMin))), glm::ivec2(0));
+
+    if (end.x < start.x || end.y < start.y) {
+        size = { 0, 0 };
+        heights.clear();
+        return false;
+    }
+
+    size = end - start + 1;
+    heights.resize(static_cast<size_t>(size.x) * size.y);
+
+    for (int32_t y = 0; y < size.y; ++y) {
+        for (int32_t x = 0; x < size.x; ++x) {
+            glm::ivec2 pixel = start + glm::ivec2 { x, y };
+            auto current = terrain.sampler.getHeightAt(static_cast<uint32_t>(pixel.x), static_cast<uint32_t>(pixel.y));
+            auto &height = heights[x + y * size.x];
+            height = current;
+
+            auto world = terrain.toWorld(glm::vec2(pixel));
+            auto centre = edge.getPointAtT(edge.getClosestT(world));
+            auto distance = glm::distance(glm::vec2(centre), world);
+            if (distance >= reach) {
+                continue;
+            }
+
+            // Smoothstep across the shoulder so the slope does not start or end with a crease
+            float weight = 1;
+            if (distance > flatWidth) {
+                auto across = (distance - flatWidth) / shape.shoulderWidth;
+                weight = 1 - across * across * (3 - 2 * across);
+            }
+
+            height = current + (centre.z - current) * weight;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "node/forward.hpp"
+#include "heightmap_sampler.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+
+/**
+ * The heightmap as it is placed in the world, for fitting roads and terrain to each other
+ */
+struct RoadTerrain {
+    HeightmapSampler sampler;
+    // Where the first pixel is in the world
+    glm::vec2 offset;
+    // Heightmap pixels per world unit
+    glm::vec2 scale;
+
+    glm::vec2 toHeightmap(const glm::vec2 &world) const { return (world - offset) * scale; }
+
+    glm::vec2 toWorld(const glm::vec2 &pixel) const { return pixel / scale + offset; }
+};
+
+struct CorridorShape {
+    // Flattened either side of the road surface
+    float margin { 1 };
+    // Beyond the flat strip the terrain is blended back to its own height over this distance
+    float shoulderWidth { 8 };
+};
+
+/**
+ * Flattens the terrain under an edge to the height of its centre line, cutting into slopes and building up
+ * embankments below it, with shoulders blending back into the surrounding terrain.
+ */
+class RoadCorridor {
+public:
+    /**
+     * Works out the heights of every heightmap pixel around the edge in a single pass over its bounds. Pixels out of
+     * reach of the road keep their current height, so the whole region can be written back.
+     * This only reads the edge and the heightmap so it can run on any thread.
+     * @param halfWidth Half the width of the road surface
+     * @param start Receives the first pixel of the region
+     * @param size Receives the size of the region in pixels, heights are stored a row at a time
+     * @return False when the edge is entirely outside of the heightmap
+     */
+    static bool build(
+        const Nodes::Edge &edge, float halfWidth, const CorridorShape &shape, const RoadTerrain &terrain,
+        glm::ivec2 &start, glm::ivec2 &size, std::vector<float> &heights
+    );
+};
@@ -1,54 +1,420 @@
 #include "road_display_manager.hpp"
+#include "heightmap.hpp"
 #include "node/edge.hpp"
 #include "node/node.hpp"
-#include <tech-core/mesh.hpp>
-#include <tech-core/material.hpp>
+#include "node/graph.hpp"
+#include "road_renderer.hpp"
+#include "utils/profiler.hpp"
+#include <tech-core/camera.hpp>
 #include <tech-core/engine.hpp>
 #include <tech-core/texture/builder.hpp>
+#include <chrono>
+#include <imgui.h>
+
+// Milliseconds per frame spent uploading built road meshes
+const double UploadBudget = 2;
+
+// How far each level may be from the curve it follows
+const float LevelCurveErrors[RoadMesh::LevelCount] { 0.1f, 0.5f, 2.0f };
+// Vertices of the template closer than this are merged for the middle level
+const float SimplifyCellSize = 0.5f;
+// Pixels per world unit at a distance of one, a 90 degree field of view on a 1080 line screen
+const float ProjectionScale = 540;
 
 RoadDisplayManager::RoadDisplayManager(Engine::RenderEngine &engine)
-    : engine(engine), objectSystem(*engine.getSubsystem(Engine::Subsystem::ObjectSubsystem::ID)) {
+    : engine(engine), renderer(*engine.getSubsystem(RoadRenderer::ID)) {
 
     engine.createTexture("road-test")
         .fromFile("assets/textures/RoadTest.png")
         .withMipMode(Engine::MipType::Generate)
         .build();
 
-    roadMaterial = engine.createMaterial({ "road-test", "road-test", "", "", true });
     if (!roadModel.load("assets/models/roads/test2.obj")) {
         throw std::runtime_error("Failed to load road model");
     }
 
-    roadMesh = engine.createStaticMesh<Engine::Vertex>("road-test")
-        .fromModel(roadModel)
-        .build();
+    auto roadTemplate = std::make_unique<RoadTemplate>(roadModel);
+    auto simplified = std::make_unique<RoadTemplate>(roadTemplate->simplify(SimplifyCellSize));
+    auto ribbon = std::make_unique<RoadTemplate>(roadTemplate->makeRibbon());
+
+    // Each level is also off by however much its template differs from the full one
+    auto height = roadTemplate->getMax().z - roadTemplate->getMin().z;
+    levels[0] = { std::move(roadTemplate), LevelCurveErrors[0], LevelCurveErrors[0] };
+    levels[1] = { std::move(simplified), LevelCurveErrors[1], LevelCurveErrors[1] + SimplifyCellSize };
+    levels[2] = { std::move(ribbon), LevelCurveErrors[2], LevelCurveErrors[2] + height };
 }
 
-std::shared_ptr<Engine::Object> RoadDisplayManager::createForEdge(const std::shared_ptr<Nodes::Edge> &edge) {
-    auto mesh = std::make_shared<RoadMesh>(engine, roadModel, edge);
-    edgeMeshes[edge] = mesh;
+RoadDisplayManager::~RoadDisplayManager() {
+    // Mesh builds read the road templates in levels and push into results
+    ThreadPool::getShared().wait();
+}
 
-    mesh->generate();
+void RoadDisplayManager::setCamera(Engine::Camera *camera) {
+    this->camera = camera;
+}
 
-    return objectSystem.createObject()
-        .withPosition(edge->getStart())
-        .withMesh(mesh->getMesh())
-        .withMaterial(roadMaterial)
-        .build();
+void RoadDisplayManager::setTerrain(
+    Heightmap &heightmap, const glm::vec2 &terrainOffset, const glm::vec2 &terrainSize
+) {
+    this->heightmap = &heightmap;
+    this->terrainOffset = terrainOffset;
+    this->terrainSize = terrainSize;
+    heightmapVersion = heightmap.getVersion();
 }
 
-std::shared_ptr<Engine::Object> RoadDisplayManager::createForNode(const std::shared_ptr<Nodes::Node> &node) {
+std::optional<RoadTerrain> RoadDisplayManager::getTerrain() const {
+    if (!heightmap) {
+        return {};
+    }
+
+    glm::vec2 heightmapSize { static_cast<float>(heightmap->getWidth()), static_cast<float>(heightmap->getHeight()) };
+    return RoadTerrain { heightmap->getSampler(), terrainOffset, heightmapSize / terrainSize };
+}
+
+void RoadDisplayManager::conformTerrain(const Nodes::Edge &edge) {
+    auto terrain = getTerrain();
+    if (!terrain) {
+        return;
+    }
+
+    stageCorridor(edge, *terrain);
+    heightmap->commitHeights();
+}
+
+void RoadDisplayManager::stageCorridor(const Nodes::Edge &edge, const RoadTerrain &terrain) {
+    glm::ivec2 start;
+    glm::ivec2 size;
+    std::vector<float> heights;
+    if (RoadCorridor::build(edge, getHalfWidth(), corridorShape, terrain, start, size, heights)) {
+        heightmap->stageHeights(start, size, heights);
+    }
+}
+
+void RoadDisplayManager::createForEdge(Nodes::EdgeId id, const Nodes::Edge &edge) {
+    if (edgeMeshes.size() <= id.index) {
+        edgeMeshes.resize(id.index + 1);
+    }
+
+    // Nothing is drawn until the first build is uploaded
+    edgeMeshes[id.index] = std::make_unique<RoadMesh>(id);
+    auto &mesh = *edgeMeshes[id.index];
+
+    if (conformNewEdges) {
+        conformTerrain(edge);
+    }
+
+    updateBounds(mesh, edge);
+    queueBuild(mesh, selectLevel(mesh), edge);
+}
+
+std::shared_ptr<Engine::Object> RoadDisplayManager::createForNode(Nodes::NodeId id, const Nodes::Node &node) {
     assert(false);
     return nullptr;
 }
 
-void RoadDisplayManager::remove(const std::shared_ptr<Engine::Object> &object) {
-    objectSystem.removeObject(object);
+void RoadDisplayManager::remove(Nodes::EdgeId id) {
+    if (id.index >= edgeMeshes.size()) {
+        return;
+    }
+
+    renderer.removeEdge(id);
+    edgeMeshes[id.index].reset();
+}
+
+void RoadDisplayManager::invalidate(Nodes::EdgeId id) {
+    if (id.index >= edgeMeshes.size() || !edgeMeshes[id.index]) {
+        return;
+    }
+
+    auto &mesh = edgeMeshes[id.index];
+    if (!mesh->getIsModified()) {
+        mesh->invalidate();
+        dirtyEdges.push_back(id);
+    }
+}
+
+void RoadDisplayManager::update(const Nodes::Graph &graph) {
+    PROFILE_ZONE("RoadDisplayManager::update");
+
+    if (conformAllPending) {
+        conformAllPending = false;
+
+        // Each corridor is built on the heights the ones before it left, then they are all uploaded at once
+        auto terrain = getTerrain();
+        if (terrain) {
+            for (auto &mesh : edgeMeshes) {
+                auto *edge = mesh ? graph.getEdge(mesh->getId()) : nullptr;
+                if (edge) {
+                    stageCorridor(*edge, *terrain);
+                }
+            }
+            heightmap->commitHeights();
+        }
+    }
+
+    if (drapeOnTerrain) {
+        invalidateDraped();
+    }
+
+    while (!dirtyEdges.empty()) {
+        auto id = dirtyEdges.front();
+        dirtyEdges.pop_front();
+
+        // Edges removed since they were queued have already released their mesh
+        auto *edge = graph.getEdge(id);
+        if (!edge || id.index >= edgeMeshes.size() || !edgeMeshes[id.index]) {
+            continue;
+        }
+
+        auto &mesh = *edgeMeshes[id.index];
+        updateBounds(mesh, *edge);
+        queueBuild(mesh, selectLevel(mesh), *edge);
+    }
+
+    selectLevels(graph);
+
+    {
+        std::lock_guard<std::mutex> lock(resultLock);
+        for (auto &result : results) {
+            uploads.push_back(std::move(result));
+        }
+        results.clear();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    while (!uploads.empty()) {
+        applyResult(uploads.front());
+        uploads.pop_front();
+        --buildingCount;
+
+        // At least one is always uploaded so that a slow one cannot stall the queue
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() >= UploadBudget) {
+            break;
+        }
+    }
+}
+
+void RoadDisplayManager::invalidateDraped() {
+    if (!heightmap || heightmap->getVersion() == heightmapVersion) {
+        return;
+    }
+
+    glm::ivec2 changedMin;
+    glm::ivec2 changedMax;
+    bool known = heightmap->getChangedSince(heightmapVersion, changedMin, changedMax);
+    heightmapVersion = heightmap->getVersion();
+
+    if (!known) {
+        invalidateAll();
+        return;
+    }
+
+    auto terrain = *getTerrain();
+    auto worldMin = terrain.toWorld(glm::vec2(changedMin));
+    auto worldMax = terrain.toWorld(glm::vec2(changedMax + 1));
+
+    for (auto &mesh : edgeMeshes) {
+        if (!mesh) {
+            continue;
+        }
+
+        // The bounds are a sphere, compare the distance from the changed box in XY
+        glm::vec2 centre(mesh->getCentre());
+        auto closest = glm::clamp(centre, worldMin, worldMax);
+        if (glm::distance(closest, centre) <= mesh->getRadius()) {
+            invalidate(mesh->getId());
+        }
+    }
+}
+
+void RoadDisplayManager::invalidateAll() {
+    for (auto &mesh : edgeMeshes) {
+        if (mesh) {
+            invalidate(mesh->getId());
+        }
+    }
+}
+
+void RoadDisplayManager::selectLevels(const Nodes::Graph &graph) {
+    PROFILE_ZONE("RoadDisplayManager::selectLevels");
+
+    statistics = {};
+
+    for (auto &mesh : edgeMeshes) {
+        if (!mesh) {
+            continue;
+        }
+
+        auto level = selectLevel(*mesh);
+        if (mesh->isBuilt(level)) {
+            if (mesh->getDrawnLevel() != level) {
+                draw(*mesh, level);
+            }
+        } else if (!mesh->isBuilding(level) && !mesh->getIsModified()) {
+            // Levels are only built once they are needed. Modified edges are built from the dirty queue instead
+            auto *edge = graph.getEdge(mesh->getId());
+            if (edge) {
+                queueBuild(*mesh, level, *edge);
+            }
+        }
+
+        auto drawnLevel = mesh->getDrawnLevel();
+        if (drawnLevel != RoadMesh::NoLevel && mesh->isBuilt(drawnLevel)) {
+            auto &levelStatistics = statistics.levels[drawnLevel];
+            ++levelStatistics.edges;
+            levelStatistics.triangles += mesh->getIndices(drawnLevel).size() / 3;
+        }
+
+        for (uint32_t cachedLevel = 0; cachedLevel < RoadMesh::LevelCount; ++cachedLevel) {
+            if (mesh->isBuilt(cachedLevel)) {
+                ++statistics.levels[cachedLevel].cached;
+            }
+        }
+    }
+}
+
+uint32_t RoadDisplayManager::selectLevel(const RoadMesh &mesh) const {
+    if (!camera) {
+        return 0;
+    }
+
+    auto distance = glm::length(camera->getPosition() - mesh.getCentre()) - mesh.getRadius();
+    if (distance <= 0) {
+        return 0;
+    }
+
+    // The coarsest level whose error is too small to see
+    for (uint32_t level = RoadMesh::LevelCount - 1; level > 0; --level) {
+        if (levels[level].screenError * ProjectionScale / distance <= maxScreenError) {
+            return level;
+        }
+    }
+
+    return 0;
+}
+
+float RoadDisplayManager::getHalfWidth() const {
+    auto &roadTemplate = *levels[0].roadTemplate;
+    return std::max(std::abs(roadTemplate.getMin().x), std::abs(roadTemplate.getMax().x));
 }
 
-void RoadDisplayManager::invalidate(const std::shared_ptr<Nodes::Edge> &edge) {
-    auto it = edgeMeshes.find(edge);
-    if (it != edgeMeshes.end()) {
-        it->second->invalidate();
+void RoadDisplayManager::updateBounds(RoadMesh &mesh, const Nodes::Edge &edge) {
+    auto halfWidth = getHalfWidth();
+
+    // Every point is within half the length of the middle, measured along the edge
+    auto halfLength = edge.getLength() / 2;
+    mesh.setBounds(edge.getPointAt(halfLength), halfLength + halfWidth);
+}
+
+void RoadDisplayManager::queueBuild(RoadMesh &mesh, uint32_t level, const Nodes::Edge &edge) {
+    auto id = mesh.getId();
+    auto generation = nextGeneration++;
+    mesh.startBuild(level, generation);
+    ++buildingCount;
+
+    auto &levelOfDetail = levels[level];
+
+    // The heightmap is written on the render thread, so the build gets a copy of the pixels under its bounds
+    auto terrain = drapeOnTerrain ? getTerrain() : std::nullopt;
+    // Shared so the sampler keeps pointing at them however the job is copied
+    std::shared_ptr<std::vector<uint16_t>> pixels;
+    if (terrain) {
+        glm::vec2 centre(mesh.getCentre());
+        glm::ivec2 mapSize(terrain->sampler.getWidth(), terrain->sampler.getHeight());
+
+        // Interpolation reads the next pixel along too. At least 2x2 so edges far off the map clamp the same way
+        auto first = glm::ivec2(glm::floor(terrain->toHeightmap(centre - mesh.getRadius()))) - 1;
+        auto last = glm::ivec2(glm::ceil(terrain->toHeightmap(centre + mesh.getRadius()))) + 2;
+        auto start = glm::clamp(first, glm::ivec2(0), mapSize - 2);
+        auto size = glm::clamp(last, start + 2, mapSize) - start;
+
+        pixels = std::make_shared<std::vector<uint16_t>>();
+        terrain = RoadTerrain {
+            terrain->sampler.copyRegion(start, size, *pixels), terrain->toWorld(glm::vec2(start)), terrain->scale
+        };
+    }
+
+    ThreadPool::getShared().submit(
+        [this, id, level, generation, edge, terrain, pixels, &levelOfDetail]() {
+            BuildResult result { id, level, generation, edge.getStart() };
+            RoadMesh::build(
+                edge, *levelOfDetail.roadTemplate, levelOfDetail.curveError, result.vertices, result.indices,
+                terrain ? &*terrain : nullptr
+            );
+
+            std::lock_guard<std::mutex> lock(resultLock);
+            results.push_back(std::move(result));
+        }
+    );
+}
+
+void RoadDisplayManager::applyResult(BuildResult &result) {
+    auto index = result.id.index;
+    if (index >= edgeMeshes.size() || !edgeMeshes[index] || edgeMeshes[index]->getId() != result.id) {
+        // Removed while building
+        return;
+    }
+
+    auto &mesh = *edgeMeshes[index];
+    if (!mesh.finishBuild(
+        result.level, result.generation, result.origin, std::move(result.vertices), std::move(result.indices)
+    )) {
+        // Superseded by a newer build
+        return;
+    }
+
+    // Anything drawn before the edge was modified is out of date, replace it with whatever is built first
+    auto drawnLevel = mesh.getDrawnLevel();
+    if (result.level == selectLevel(mesh) || drawnLevel == RoadMesh::NoLevel || !mesh.isBuilt(drawnLevel)) {
+        draw(mesh, result.level);
+    }
+}
+
+void RoadDisplayManager::draw(RoadMesh &mesh, uint32_t level) {
+    renderer.setEdge(mesh.getId(), mesh.getOrigin(), mesh.getVertices(level), mesh.getIndices(level));
+    mesh.setDrawnLevel(level);
+}
+
+void RoadDisplayManager::drawGUI() {
+    ImGui::Text("Pending builds: %zu", getPendingCount());
+    ImGui::SliderFloat("Max screen error", &maxScreenError, 0.25f, 16, "%.2fpx");
+
+    if (heightmap) {
+        ImGui::Checkbox("Flatten terrain under new roads", &conformNewEdges);
+        ImGui::SliderFloat("Flat margin", &corridorShape.margin, 0, 10, "%.1f");
+        ImGui::SliderFloat("Shoulder width", &corridorShape.shoulderWidth, 0, 50, "%.1f");
+        if (ImGui::Button("Flatten terrain under all roads")) {
+            conformAllPending = true;
+        }
+
+        if (ImGui::Checkbox("Drape roads on terrain", &drapeOnTerrain)) {
+            heightmapVersion = heightmap->getVersion();
+            invalidateAll();
+        }
+    }
+
+    if (ImGui::BeginTable("road-levels", 4, ImGuiTableFlags_Borders)) {
+        ImGui::TableSetupColumn("Level");
+        ImGui::TableSetupColumn("Edges");
+        ImGui::TableSetupColumn("Triangles");
+        ImGui::TableSetupColumn("Cached");
+        ImGui::TableHeadersRow();
+
+        for (uint32_t level = 0; level < RoadMesh::LevelCount; ++level) {
+            auto &levelStatistics = statistics.levels[level];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%u (%.2f)", level, levels[level].screenError);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", levelStatistics.edges);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(levelStatistics.triangles));
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", levelStatistics.cached);
+        }
+
+        ImGui::EndTable();
     }
 }
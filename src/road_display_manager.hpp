@@ -2,31 +2,146 @@
 
 #include "node/forward.hpp"
 #include "dynamic_meshes/road.hpp"
+#include "road_corridor.hpp"
+#include "utils/thread_pool.hpp"
 #include <tech-core/object.hpp>
-#include <tech-core/subsystem/objects.hpp>
 #include <tech-core/forward.hpp>
 #include <tech-core/model.hpp>
+#include <array>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
+class Heightmap;
+class RoadRenderer;
+
+/**
+ * Creates and updates the road meshes for the edges in the graph.
+ * Meshes are built on worker threads from a copy of the edge and handed to the RoadRenderer during update, until a
+ * new build is uploaded the previous mesh stays visible.
+ * Each edge has several levels of detail, from the full template down to a flat ribbon. Every frame the coarsest
+ * level whose error is too small to see from the camera is picked. Levels are built the first time they are picked
+ * and kept until the edge is modified.
+ * Once given the terrain, new roads can flatten the terrain under them and roads can be draped on the terrain, in
+ * which case they are built again whenever the heights under them change.
+ */
 class RoadDisplayManager {
 public:
     explicit RoadDisplayManager(Engine::RenderEngine &);
+    ~RoadDisplayManager();
+
+    void setCamera(Engine::Camera *);
+    void setTerrain(Heightmap &heightmap, const glm::vec2 &terrainOffset, const glm::vec2 &terrainSize);
+
+    /**
+     * Queues the mesh of the edge to be built again. Invalidating an edge that is already queued does nothing.
+     */
+    void invalidate(Nodes::EdgeId id);
+
+    /**
+     * Starts builds for the queued edges, picks the level of detail of every edge and uploads finished builds until
+     * the time budget runs out.
+     * Uploads left over are done in later frames. Call once per frame before rendering.
+     */
+    void update(const Nodes::Graph &graph);
 
-    void invalidate(const std::shared_ptr<Nodes::Edge> &);
+    /**
+     * The number of builds waiting to be started or uploaded
+     */
+    size_t getPendingCount() const { return dirtyEdges.size() + buildingCount; }
 
-    std::shared_ptr<Engine::Object> createForEdge(const std::shared_ptr<Nodes::Edge> &edge);
-    std::shared_ptr<Engine::Object> createForNode(const std::shared_ptr<Nodes::Node> &node);
+    void createForEdge(Nodes::EdgeId id, const Nodes::Edge &edge);
+    std::shared_ptr<Engine::Object> createForNode(Nodes::NodeId id, const Nodes::Node &node);
 
-    void remove(const std::shared_ptr<Engine::Object> &object);
+    void remove(Nodes::EdgeId id);
+
+    /**
+     * Flattens the terrain under the edge to the road, see RoadCorridor
+     */
+    void conformTerrain(const Nodes::Edge &edge);
+
+    void drawGUI();
 private:
+    struct LevelOfDetail {
+        std::unique_ptr<RoadTemplate> roadTemplate;
+        // How far the mesh may be from the curve
+        float curveError;
+        // How far the mesh may be from the full detail road, used to pick the level
+        float screenError;
+    };
+
+    struct BuildResult {
+        Nodes::EdgeId id;
+        uint32_t level;
+        uint32_t generation;
+        // The start of the edge when it was copied, the mesh is relative to it
+        glm::vec3 origin;
+        std::vector<Engine::Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    struct Statistics {
+        struct Level {
+            uint32_t edges { 0 };
+            uint64_t triangles { 0 };
+            // Edges with the level built, drawn or not
+            uint32_t cached { 0 };
+        };
+
+        std::array<Level, RoadMesh::LevelCount> levels;
+    };
+
     Engine::RenderEngine &engine;
-    Engine::Subsystem::ObjectSubsystem &objectSystem;
+    RoadRenderer &renderer;
+    Engine::Camera *camera { nullptr };
+    Heightmap *heightmap { nullptr };
+    glm::vec2 terrainOffset { 0, 0 };
+    glm::vec2 terrainSize { 1, 1 };
+
+    CorridorShape corridorShape;
+    // Flatten the terrain under edges as they are created. Moving nodes leaves the terrain alone, otherwise dragging
+    // would carve out every position the edge passed through
+    bool conformNewEdges { false };
+    // Set from the GUI, every edge is conformed during the next update
+    bool conformAllPending { false };
+    bool drapeOnTerrain { false };
+    // The heightmap version the draped meshes were last checked against
+    uint32_t heightmapVersion { 0 };
 
     Engine::Model roadModel;
-    std::unordered_map<std::shared_ptr<Nodes::Edge>, std::shared_ptr<RoadMesh>> edgeMeshes;
+    // The templates are shared by every road mesh
+    std::array<LevelOfDetail, RoadMesh::LevelCount> levels;
+    // In pixels
+    float maxScreenError { 1 };
+    // Parallel to the edges in the graph
+    std::vector<std::unique_ptr<RoadMesh>> edgeMeshes;
+    // In the order they were invalidated. RoadMesh::getIsModified tells if an edge is already queued
+    std::deque<Nodes::EdgeId> dirtyEdges;
+
+    uint32_t nextGeneration { 1 };
+    size_t buildingCount { 0 };
+    // Finished builds which did not fit in the time budget
+    std::deque<BuildResult> uploads;
+
+    std::mutex resultLock;
+    std::vector<BuildResult> results;
+
+    Statistics statistics;
 
-    // Temporary shared one just to get us going
-    Engine::StaticMesh *roadMesh { nullptr };
-    Engine::Material *roadMaterial { nullptr };
+    std::optional<RoadTerrain> getTerrain() const;
+    void stageCorridor(const Nodes::Edge &edge, const RoadTerrain &terrain);
+    void invalidateDraped();
+    void invalidateAll();
+    void selectLevels(const Nodes::Graph &graph);
+    uint32_t selectLevel(const RoadMesh &mesh) const;
+    // Of the full detail road surface
+    float getHalfWidth() const;
+    void updateBounds(RoadMesh &mesh, const Nodes::Edge &edge);
+    void queueBuild(RoadMesh &mesh, uint32_t level, const Nodes::Edge &edge);
+    void applyResult(BuildResult &result);
+    void draw(RoadMesh &mesh, uint32_t level);
 };
 
 
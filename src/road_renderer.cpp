@@ -0,0 +1,616 @@
+#include "road_renderer.hpp"
+#include "utils/profiler.hpp"
+#include "utils/thread_pool.hpp"
+#include <tech-core/buffer.hpp>
+#include <tech-core/camera.hpp>
+#include <tech-core/pipeline.hpp>
+#include <tech-core/material.hpp>
+#include <tech-core/shapes/bounding_box.hpp>
+#include <tech-core/texture/manager.hpp>
+#include <imgui.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const Engine::Subsystem::SubsystemID<RoadRenderer> RoadRenderer::ID;
+
+// Roads are grouped by where their edge starts into squares this size
+const float ChunkSize = 256;
+const uint32_t InitialVertexCapacity = 8192;
+const uint32_t InitialIndexCapacity = 32768;
+// Chunks where more than this portion of the used part of the buffers is free are compacted
+const float CompactThreshold = 0.5f;
+// Holes in chunks smaller than this are cheap enough to draw
+const uint32_t MinimumCompactIndices = 3 * 1024;
+
+glm::ivec2 getCell(const glm::vec3 &position) {
+    return {
+        static_cast<int32_t>(std::floor(position.x / ChunkSize)),
+        static_cast<int32_t>(std::floor(position.y / ChunkSize))
+    };
+}
+
+uint64_t makeChunkKey(const glm::ivec2 &cell) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(cell.x)) << 32) | static_cast<uint32_t>(cell.y);
+}
+
+/**
+ * Every edge keeps at least one vertex and triangle so an empty mesh still has a range to be moved around by
+ */
+uint32_t getVertexCapacity(uint32_t vertexCount) {
+    return std::max(vertexCount, 1u);
+}
+
+uint32_t getIndexCapacity(uint32_t indexCount) {
+    // Whole triangles so the rest can be filled with degenerate ones
+    return std::max((indexCount + 2) / 3, 1u) * 3;
+}
+
+void RoadRenderer::setCamera(Engine::Camera *camera) {
+    this->camera = camera;
+}
+
+void RoadRenderer::setWireframe(bool enable) {
+    wireframe = enable;
+}
+
+void RoadRenderer::initialiseResources(
+    vk::Device device, vk::PhysicalDevice physicalDevice, Engine::RenderEngine &engine
+) {
+    this->engine = &engine;
+
+    textureSamplerId = engine.getMaterialManager().createSampler(
+        {
+            vk::Filter::eLinear,
+            vk::Filter::eLinear,
+            vk::SamplerMipmapMode::eLinear,
+            true
+        }
+    );
+    textureSampler = engine.getMaterialManager().getSamplerById(textureSamplerId);
+}
+
+void RoadRenderer::initialiseSwapChainResources(
+    vk::Device device, Engine::RenderEngine &engine, uint32_t swapChainImages
+) {
+    this->swapChainImages = swapChainImages;
+
+    auto builder = engine.createPipeline()
+        .withVertexShader("assets/shaders/roads/vert.spv")
+        .withFragmentShader("assets/shaders/roads/frag.spv")
+        .withGeometryType(Engine::PipelineGeometryType::Polygons)
+        .withVertexAttributeDescriptions(Engine::Vertex::getAttributeDescriptions())
+        .withVertexBindingDescription(Engine::Vertex::getBindingDescription())
+        .withPushConstants<RoadUniform>(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment)
+        .bindCamera(0, 0)
+        .bindTextures(1, 2);
+
+    pipeline = builder.build();
+    pipelineWireframe = builder.withFillMode(Engine::FillMode::Wireframe).build();
+}
+
+void RoadRenderer::cleanupResources(vk::Device device, Engine::RenderEngine &engine) {
+    for (auto &pair : chunks) {
+        pair.second->vertexBuffer->unmap();
+        pair.second->indexBuffer->unmap();
+    }
+
+    chunks.clear();
+    edges.clear();
+    retired.clear();
+    retiredRanges.clear();
+    compaction.reset();
+}
+
+void RoadRenderer::cleanupSwapChainResources(vk::Device device, Engine::RenderEngine &engine) {
+    pipeline.reset();
+    pipelineWireframe.reset();
+}
+
+void RoadRenderer::setEdge(
+    Nodes::EdgeId id, const glm::vec3 &origin, const std::vector<Engine::Vertex> &vertices,
+    const std::vector<uint32_t> &indices
+) {
+    PROFILE_ZONE("RoadRenderer::setEdge");
+
+    if (edges.size() <= id.index) {
+        edges.resize(id.index + 1);
+    }
+
+    auto &record = edges[id.index];
+
+    // Even when the mesh would fit, the old ranges may be drawn by frames still in flight
+    release(record);
+    record.id = id;
+
+    allocate(getChunk(origin), record, vertices.size(), indices.size());
+    write(record, origin, vertices, indices);
+}
+
+void RoadRenderer::removeEdge(Nodes::EdgeId id) {
+    if (id.index >= edges.size() || edges[id.index].id != id) {
+        return;
+    }
+
+    release(edges[id.index]);
+}
+
+RoadRenderer::Chunk &RoadRenderer::getChunk(const glm::vec3 &position) {
+    auto cell = getCell(position);
+
+    auto &chunk = chunks[makeChunkKey(cell)];
+    if (!chunk) {
+        chunk = std::make_unique<Chunk>();
+        chunk->cell = cell;
+        chunk->origin = { glm::vec2(cell) * ChunkSize, 0 };
+        rebuild(*chunk, InitialVertexCapacity, InitialIndexCapacity);
+    }
+
+    return *chunk;
+}
+
+void RoadRenderer::allocate(Chunk &chunk, EdgeRecord &record, uint32_t vertexCount, uint32_t indexCount) {
+    auto vertexCapacity = getVertexCapacity(vertexCount);
+    auto indexCapacity = getIndexCapacity(indexCount);
+
+    while (true) {
+        auto firstVertex = chunk.vertexRanges.allocate(vertexCapacity);
+        auto firstIndex = chunk.indexRanges.allocate(indexCapacity);
+
+        if (firstVertex && firstIndex) {
+            record.chunk = &chunk;
+            record.chunkSlot = static_cast<uint32_t>(chunk.edges.size());
+            record.firstVertex = *firstVertex;
+            record.vertexCapacity = vertexCapacity;
+            record.vertexCount = 0;
+            record.firstIndex = *firstIndex;
+            record.indexCapacity = indexCapacity;
+            record.indexCount = 0;
+            record.mesh.reset();
+
+            // The range may never have been written. Free ranges are not drawn, so no frame in flight reads it
+            std::fill_n(chunk.indices + record.firstIndex, indexCapacity, 0);
+            chunk.indexBuffer->flushRange(record.firstIndex * sizeof(uint32_t), indexCapacity * sizeof(uint32_t));
+
+            chunk.edges.push_back(record.id);
+            chunk.drawRangesChanged = true;
+            ++chunk.edits;
+            return;
+        }
+
+        if (firstVertex) {
+            chunk.vertexRanges.free(*firstVertex, vertexCapacity);
+        }
+        if (firstIndex) {
+            chunk.indexRanges.free(*firstIndex, indexCapacity);
+        }
+
+        // Rebuilding packs the chunk, growing it if that is not enough. Retired ranges are dropped by the rebuild
+        // but still counted here, which only leaves more room.
+        auto newVertexCapacity = chunk.vertexRanges.getCapacity();
+        while (newVertexCapacity < chunk.vertexRanges.getUsed() + vertexCapacity) {
+            newVertexCapacity *= 2;
+        }
+
+        auto newIndexCapacity = chunk.indexRanges.getCapacity();
+        while (newIndexCapacity < chunk.indexRanges.getUsed() + indexCapacity) {
+            newIndexCapacity *= 2;
+        }
+
+        rebuild(chunk, newVertexCapacity, newIndexCapacity);
+    }
+}
+
+void RoadRenderer::release(EdgeRecord &record) {
+    if (!record.chunk) {
+        return;
+    }
+
+    auto &chunk = *record.chunk;
+
+    // Later frames stop drawing the ranges, the ones in flight still read them so they are left as they are
+    retiredRanges.push_back(
+        {
+            makeChunkKey(chunk.cell), chunk.generation, record.firstVertex, record.vertexCapacity, record.firstIndex,
+            record.indexCapacity, frame + swapChainImages + 1
+        }
+    );
+
+    auto last = chunk.edges.back();
+    chunk.edges[record.chunkSlot] = last;
+    edges[last.index].chunkSlot = record.chunkSlot;
+    chunk.edges.pop_back();
+    chunk.drawRangesChanged = true;
+    ++chunk.edits;
+
+    record.chunk = nullptr;
+    record.vertexCapacity = 0;
+    record.indexCapacity = 0;
+    record.vertexCount = 0;
+    record.indexCount = 0;
+    record.mesh.reset();
+
+    if (chunk.edges.empty()) {
+        chunk.vertexBuffer->unmap();
+        chunk.indexBuffer->unmap();
+        retired.push_back(
+            { std::move(chunk.vertexBuffer), std::move(chunk.indexBuffer), frame + swapChainImages + 1 }
+        );
+        chunks.erase(makeChunkKey(chunk.cell));
+    }
+}
+
+void RoadRenderer::write(
+    EdgeRecord &record, const glm::vec3 &origin, const std::vector<Engine::Vertex> &vertices,
+    const std::vector<uint32_t> &indices
+) {
+    auto &chunk = *record.chunk;
+    auto offset = origin - chunk.origin;
+
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(std::numeric_limits<float>::lowest());
+
+    auto mesh = std::make_shared<EdgeMesh>();
+    mesh->vertices = vertices;
+    mesh->indices = indices;
+    for (auto &vertex : mesh->vertices) {
+        vertex.pos += offset;
+        min = glm::min(min, vertex.pos);
+        max = glm::max(max, vertex.pos);
+    }
+
+    std::copy(mesh->vertices.begin(), mesh->vertices.end(), chunk.vertices + record.firstVertex);
+
+    auto *outIndices = chunk.indices + record.firstIndex;
+    for (size_t i = 0; i < indices.size(); ++i) {
+        outIndices[i] = indices[i] + record.firstVertex;
+    }
+
+    // The rest of the range was filled when it was allocated
+    chunk.vertexBuffer->flushRange(
+        record.firstVertex * sizeof(Engine::Vertex), vertices.size() * sizeof(Engine::Vertex)
+    );
+    chunk.indexBuffer->flushRange(record.firstIndex * sizeof(uint32_t), indices.size() * sizeof(uint32_t));
+
+    record.vertexCount = vertices.size();
+    record.indexCount = indices.size();
+    record.mesh = std::move(mesh);
+
+    if (!vertices.empty()) {
+        record.min = min + chunk.origin;
+        record.max = max + chunk.origin;
+        chunk.min = glm::min(chunk.min, record.min);
+        chunk.max = glm::max(chunk.max, record.max);
+    }
+}
+
+void RoadRenderer::rebuild(Chunk &chunk, uint32_t vertexCapacity, uint32_t indexCapacity) {
+    PROFILE_ZONE("RoadRenderer::rebuild");
+
+    std::vector<std::shared_ptr<const EdgeMesh>> meshes;
+    meshes.reserve(chunk.edges.size());
+    for (auto id : chunk.edges) {
+        meshes.push_back(edges[id.index].mesh);
+    }
+
+    std::vector<Engine::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    pack(meshes, vertices, indices);
+    replaceBuffers(chunk, vertexCapacity, indexCapacity, vertices, indices);
+}
+
+void RoadRenderer::pack(
+    const std::vector<std::shared_ptr<const EdgeMesh>> &meshes, std::vector<Engine::Vertex> &vertices,
+    std::vector<uint32_t> &indices
+) {
+    for (auto &mesh : meshes) {
+        auto firstVertex = static_cast<uint32_t>(vertices.size());
+        auto firstIndex = indices.size();
+
+        // Edges which were allocated but not written yet have no mesh
+        if (mesh) {
+            vertices.insert(vertices.end(), mesh->vertices.begin(), mesh->vertices.end());
+            for (auto index : mesh->indices) {
+                indices.push_back(index + firstVertex);
+            }
+        }
+
+        auto vertexCount = static_cast<uint32_t>(vertices.size()) - firstVertex;
+        auto indexCount = static_cast<uint32_t>(indices.size() - firstIndex);
+        vertices.resize(firstVertex + getVertexCapacity(vertexCount));
+        indices.resize(firstIndex + getIndexCapacity(indexCount), 0);
+    }
+}
+
+void RoadRenderer::replaceBuffers(
+    Chunk &chunk, uint32_t vertexCapacity, uint32_t indexCapacity, const std::vector<Engine::Vertex> &vertices,
+    const std::vector<uint32_t> &indices
+) {
+    auto vertexBuffer = engine->getBufferManager().aquire(
+        vertexCapacity * sizeof(Engine::Vertex), vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryUsage::eCPUToGPU
+    );
+    auto indexBuffer = engine->getBufferManager().aquire(
+        indexCapacity * sizeof(uint32_t), vk::BufferUsageFlagBits::eIndexBuffer, vk::MemoryUsage::eCPUToGPU
+    );
+
+    Engine::Vertex *mappedVertices;
+    uint32_t *mappedIndices;
+    vertexBuffer->map(reinterpret_cast<void **>(&mappedVertices));
+    indexBuffer->map(reinterpret_cast<void **>(&mappedIndices));
+
+    // Written in one go, the buffers are only ever written to
+    std::copy(vertices.begin(), vertices.end(), mappedVertices);
+    std::copy(indices.begin(), indices.end(), mappedIndices);
+    vertexBuffer->flushRange(0, vertices.size() * sizeof(Engine::Vertex));
+    indexBuffer->flushRange(0, indices.size() * sizeof(uint32_t));
+
+    RangeAllocator vertexRanges(vertexCapacity);
+    RangeAllocator indexRanges(indexCapacity);
+
+    chunk.min = glm::vec3(std::numeric_limits<float>::max());
+    chunk.max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    // The space is empty, so this gives the same ranges the meshes were packed into
+    for (auto id : chunk.edges) {
+        auto &record = edges[id.index];
+
+        record.vertexCapacity = getVertexCapacity(record.vertexCount);
+        record.indexCapacity = getIndexCapacity(record.indexCount);
+        record.firstVertex = *vertexRanges.allocate(record.vertexCapacity);
+        record.firstIndex = *indexRanges.allocate(record.indexCapacity);
+
+        if (record.vertexCount > 0) {
+            chunk.min = glm::min(chunk.min, record.min);
+            chunk.max = glm::max(chunk.max, record.max);
+        }
+    }
+
+    if (chunk.vertexBuffer) {
+        chunk.vertexBuffer->unmap();
+        chunk.indexBuffer->unmap();
+        retired.push_back(
+            { std::move(chunk.vertexBuffer), std::move(chunk.indexBuffer), frame + swapChainImages + 1 }
+        );
+        ++statistics.rebuilds;
+    }
+
+    chunk.vertexBuffer = std::move(vertexBuffer);
+    chunk.indexBuffer = std::move(indexBuffer);
+    chunk.vertices = mappedVertices;
+    chunk.indices = mappedIndices;
+    chunk.vertexRanges = vertexRanges;
+    chunk.indexRanges = indexRanges;
+    chunk.generation = nextChunkGeneration++;
+    chunk.drawRangesChanged = true;
+}
+
+void RoadRenderer::freeRetiredRanges() {
+    retiredRanges.erase(
+        std::remove_if(
+            retiredRanges.begin(), retiredRanges.end(), [this](const RetiredRanges &ranges) {
+                if (ranges.releaseFrame > frame) {
+                    return false;
+                }
+
+                auto it = chunks.find(ranges.chunkKey);
+                if (it != chunks.end() && it->second->generation == ranges.chunkGeneration) {
+                    auto &chunk = *it->second;
+                    chunk.vertexRanges.free(ranges.firstVertex, ranges.vertexCapacity);
+                    chunk.indexRanges.free(ranges.firstIndex, ranges.indexCapacity);
+                }
+                return true;
+            }
+        ),
+        retiredRanges.end()
+    );
+}
+
+void RoadRenderer::finishCompaction() {
+    if (!compaction) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(compaction->lock);
+        if (!compaction->done) {
+            return;
+        }
+    }
+
+    // Edges changed while it was packed are in different ranges now, the chunk is tried again later
+    auto it = chunks.find(compaction->chunkKey);
+    if (it != chunks.end() && it->second->generation == compaction->chunkGeneration
+        && it->second->edits == compaction->chunkEdits) {
+        auto &chunk = *it->second;
+        replaceBuffers(
+            chunk, chunk.vertexRanges.getCapacity(), chunk.indexRanges.getCapacity(), compaction->vertices,
+            compaction->indices
+        );
+    }
+
+    compaction.reset();
+}
+
+void RoadRenderer::compact() {
+    if (compaction) {
+        return;
+    }
+
+    // One chunk at a time, so the cost is spread out
+    for (auto &pair : chunks) {
+        auto &chunk = *pair.second;
+        auto &indexRanges = chunk.indexRanges;
+
+        if (indexRanges.getEnd() < MinimumCompactIndices || indexRanges.getFragmentation() <= CompactThreshold) {
+            continue;
+        }
+
+        compaction = std::make_shared<Compaction>();
+        compaction->chunkKey = pair.first;
+        compaction->chunkGeneration = chunk.generation;
+        compaction->chunkEdits = chunk.edits;
+
+        std::vector<std::shared_ptr<const EdgeMesh>> meshes;
+        meshes.reserve(chunk.edges.size());
+        for (auto id : chunk.edges) {
+            meshes.push_back(edges[id.index].mesh);
+        }
+
+        ThreadPool::getShared().submit(
+            [compaction = compaction, meshes = std::move(meshes)]() {
+                PROFILE_ZONE("RoadRenderer::compact");
+
+                std::vector<Engine::Vertex> vertices;
+                std::vector<uint32_t> indices;
+                pack(meshes, vertices, indices);
+
+                std::lock_guard<std::mutex> lock(compaction->lock);
+                compaction->vertices = std::move(vertices);
+                compaction->indices = std::move(indices);
+                compaction->done = true;
+            }
+        );
+        return;
+    }
+}
+
+void RoadRenderer::updateDrawRanges(Chunk &chunk) {
+    if (!chunk.drawRangesChanged) {
+        return;
+    }
+    chunk.drawRangesChanged = false;
+
+    chunk.drawRanges.clear();
+    for (auto id : chunk.edges) {
+        auto &record = edges[id.index];
+        chunk.drawRanges.emplace_back(record.firstIndex, record.indexCapacity);
+    }
+
+    std::sort(
+        chunk.drawRanges.begin(), chunk.drawRanges.end(), [](const glm::uvec2 &a, const glm::uvec2 &b) {
+            return a.x < b.x;
+        }
+    );
+
+    // Neighbouring ranges are drawn together
+    size_t runs = 0;
+    for (auto &range : chunk.drawRanges) {
+        if (runs > 0 && chunk.drawRanges[runs - 1].x + chunk.drawRanges[runs - 1].y == range.x) {
+            chunk.drawRanges[runs - 1].y += range.y;
+        } else {
+            chunk.drawRanges[runs++] = range;
+        }
+    }
+    chunk.drawRanges.resize(runs);
+}
+
+void RoadRenderer::prepareFrame(uint32_t activeImage) {
+    PROFILE_ZONE("RoadRenderer::prepareFrame");
+
+    ++frame;
+
+    retired.erase(
+        std::remove_if(
+            retired.begin(), retired.end(), [this](const RetiredBuffers &buffers) {
+                return buffers.releaseFrame <= frame;
+            }
+        ),
+        retired.end()
+    );
+
+    freeRetiredRanges();
+    finishCompaction();
+    compact();
+
+    if (!texture) {
+        texture = engine->getTextureManager().getTexture("road-test");
+    }
+
+    statistics.chunks = chunks.size();
+    statistics.drawnChunks = 0;
+    statistics.drawCalls = 0;
+    statistics.drawnTriangles = 0;
+    statistics.degenerateTriangles = 0;
+    statistics.memoryUsage = 0;
+
+    for (auto &pair : chunks) {
+        auto &chunk = *pair.second;
+        statistics.memoryUsage += chunk.vertexRanges.getCapacity() * sizeof(Engine::Vertex)
+            + chunk.indexRanges.getCapacity() * sizeof(uint32_t);
+
+        chunk.visible = false;
+        if (!camera || chunk.min.x > chunk.max.x) {
+            continue;
+        }
+
+        Engine::BoundingBox bounds(chunk.min.x, chunk.min.y, chunk.min.z, chunk.max.x, chunk.max.y, chunk.max.z);
+        if (!bounds.intersects(camera->getFrustum())) {
+            continue;
+        }
+
+        chunk.visible = true;
+        updateDrawRanges(chunk);
+
+        uint32_t indexCount = 0;
+        for (auto id : chunk.edges) {
+            indexCount += edges[id.index].indexCount;
+        }
+
+        uint32_t drawnIndices = 0;
+        for (auto &range : chunk.drawRanges) {
+            drawnIndices += range.y;
+        }
+
+        ++statistics.drawnChunks;
+        statistics.drawCalls += chunk.drawRanges.size();
+        statistics.drawnTriangles += drawnIndices / 3;
+        statistics.degenerateTriangles += (drawnIndices - indexCount) / 3;
+    }
+}
+
+void RoadRenderer::writeFrameCommands(vk::CommandBuffer commandBuffer, uint32_t activeImage) {
+    if (!texture || statistics.drawnChunks == 0) {
+        return;
+    }
+
+    Engine::Pipeline *currentPipeline;
+    if (wireframe) {
+        currentPipeline = pipelineWireframe.get();
+    } else {
+        currentPipeline = pipeline.get();
+    }
+
+    currentPipeline->bind(commandBuffer, activeImage);
+
+    auto binding = engine->getTextureManager().getBinding(texture->arrayId, textureSamplerId, textureSampler);
+    currentPipeline->bindDescriptorSets(commandBuffer, 1, 1, &binding, 0, nullptr);
+
+    for (auto &pair : chunks) {
+        auto &chunk = *pair.second;
+        if (!chunk.visible) {
+            continue;
+        }
+
+        vk::DeviceSize offset = 0;
+        commandBuffer.bindVertexBuffers(0, 1, chunk.vertexBuffer->bufferArray(), &offset);
+        commandBuffer.bindIndexBuffer(*chunk.indexBuffer->bufferArray(), 0, vk::IndexType::eUint32);
+
+        RoadUniform uniform { chunk.origin, texture->arraySlot };
+        currentPipeline->push(commandBuffer, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, uniform);
+
+        for (auto &range : chunk.drawRanges) {
+            commandBuffer.drawIndexed(range.y, 1, range.x, 0, 0);
+        }
+    }
+}
+
+void RoadRenderer::drawGUI() {
+    ImGui::Text("Chunks: %u (%u drawn)", statistics.chunks, statistics.drawnChunks);
+    ImGui::Text("Draw calls: %u", statistics.drawCalls);
+    ImGui::Text(
+        "Triangles: %llu (%llu padding)", static_cast<unsigned long long>(statistics.drawnTriangles),
+        static_cast<unsigned long long>(statistics.degenerateTriangles)
+    );
+    ImGui::Text("Memory: %.2fMB", static_cast<double>(statistics.memoryUsage) / (1024 * 1024));
+    ImGui::Text("Rebuilds: %u", statistics.rebuilds);
+}
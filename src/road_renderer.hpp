@@ -0,0 +1,209 @@
+#pragma once
+
+#include "node/forward.hpp"
+#include "utils/range_allocator.hpp"
+#include <tech-core/engine.hpp>
+#include <tech-core/model.hpp>
+#include <tech-core/subsystem/base.hpp>
+#include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct RoadUniform {
+    alignas(16) glm::vec3 chunkOrigin;
+    alignas(4) uint32_t textureIndex;
+};
+
+/**
+ * Draws the road meshes of every edge.
+ * Roads are grouped into square chunks by where their edge starts. Each chunk has one vertex and one index buffer
+ * which the edges are given ranges of, and is drawn when its bounds are in view with a call for each run of ranges
+ * that are in use. The end of each edge's index range is filled with degenerate triangles.
+ * Frames in flight may still be drawing the ranges an edge had, so a changed mesh is always written to new ranges and
+ * the old ones are left alone until those frames are done.
+ * Chunks are rebuilt into new buffers when they run out of room, or packed on the workers when too much of them is
+ * holes. Both are done from a copy of each edge's mesh kept on the CPU, the buffers are never read back.
+ */
+class RoadRenderer : public Engine::Subsystem::Subsystem {
+public:
+    static const Engine::Subsystem::SubsystemID<RoadRenderer> ID;
+
+    void setCamera(Engine::Camera *);
+
+    void setWireframe(bool);
+
+    bool getWireframe() const { return wireframe; }
+
+    /**
+     * Sets the mesh of an edge, replacing what it had before. Vertices are relative to the origin.
+     */
+    void setEdge(
+        Nodes::EdgeId id, const glm::vec3 &origin, const std::vector<Engine::Vertex> &vertices,
+        const std::vector<uint32_t> &indices
+    );
+    void removeEdge(Nodes::EdgeId id);
+
+    void drawGUI();
+
+    // For engine use
+    void initialiseResources(vk::Device device, vk::PhysicalDevice physicalDevice, Engine::RenderEngine &engine);
+    void initialiseSwapChainResources(vk::Device device, Engine::RenderEngine &engine, uint32_t swapChainImages);
+    void cleanupResources(vk::Device device, Engine::RenderEngine &engine);
+    void cleanupSwapChainResources(vk::Device device, Engine::RenderEngine &engine);
+    void writeFrameCommands(vk::CommandBuffer commandBuffer, uint32_t activeImage);
+    void prepareFrame(uint32_t activeImage) override;
+
+private:
+    // What an edge has in its chunk. Shared with compactions so they do not need a copy
+    struct EdgeMesh {
+        // Relative to the chunk
+        std::vector<Engine::Vertex> vertices;
+        // Relative to the first vertex of the edge
+        std::vector<uint32_t> indices;
+    };
+
+    struct Chunk {
+        glm::ivec2 cell;
+        // Vertices are stored relative to this
+        glm::vec3 origin;
+
+        std::unique_ptr<Engine::Buffer> vertexBuffer;
+        std::unique_ptr<Engine::Buffer> indexBuffer;
+        // Perpetually mapped from the buffers
+        Engine::Vertex *vertices { nullptr };
+        uint32_t *indices { nullptr };
+
+        RangeAllocator vertexRanges { 0 };
+        RangeAllocator indexRanges { 0 };
+
+        // The edges in the chunk, in no particular order
+        std::vector<Nodes::EdgeId> edges;
+        // Only grows until the chunk is rebuilt
+        glm::vec3 min { 0, 0, 0 };
+        glm::vec3 max { 0, 0, 0 };
+
+        // Changes whenever the chunk gets new buffers, and with them new ranges
+        uint32_t generation { 0 };
+        // Counts changes to the edges, a compaction started before one is out of date
+        uint32_t edits { 0 };
+
+        // The first index and count of each run of ranges in use, found again when the edges change
+        std::vector<glm::uvec2> drawRanges;
+        bool drawRangesChanged { true };
+
+        bool visible { false };
+    };
+
+    struct EdgeRecord {
+        Nodes::EdgeId id;
+        Chunk *chunk { nullptr };
+        // Where the edge is in the chunk's edges
+        uint32_t chunkSlot { 0 };
+
+        uint32_t firstVertex { 0 };
+        uint32_t vertexCapacity { 0 };
+        uint32_t vertexCount { 0 };
+        uint32_t firstIndex { 0 };
+        uint32_t indexCapacity { 0 };
+        uint32_t indexCount { 0 };
+
+        glm::vec3 min { 0, 0, 0 };
+        glm::vec3 max { 0, 0, 0 };
+
+        std::shared_ptr<const EdgeMesh> mesh;
+    };
+
+    // Buffers replaced by a rebuild, kept until the frames which may use them are done
+    struct RetiredBuffers {
+        std::unique_ptr<Engine::Buffer> vertexBuffer;
+        std::unique_ptr<Engine::Buffer> indexBuffer;
+        uint32_t releaseFrame;
+    };
+
+    // Ranges left by an edge, freed once the frames which may draw them are done
+    struct RetiredRanges {
+        uint64_t chunkKey;
+        // Ranges from before the chunk was rebuilt are gone with the old buffers
+        uint32_t chunkGeneration;
+        uint32_t firstVertex;
+        uint32_t vertexCapacity;
+        uint32_t firstIndex;
+        uint32_t indexCapacity;
+        uint32_t releaseFrame;
+    };
+
+    // A chunk being packed on the workers
+    struct Compaction {
+        uint64_t chunkKey;
+        uint32_t chunkGeneration;
+        uint32_t chunkEdits;
+
+        std::mutex lock;
+        bool done { false };
+        std::vector<Engine::Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    struct Statistics {
+        uint32_t chunks { 0 };
+        uint32_t drawnChunks { 0 };
+        uint32_t drawCalls { 0 };
+        uint64_t drawnTriangles { 0 };
+        // Triangles drawn which only pad out the ranges of edges
+        uint64_t degenerateTriangles { 0 };
+        size_t memoryUsage { 0 };
+        uint32_t rebuilds { 0 };
+    };
+
+    Engine::RenderEngine *engine { nullptr };
+    Engine::Camera *camera { nullptr };
+    bool wireframe { false };
+
+    std::unordered_map<uint64_t, std::unique_ptr<Chunk>> chunks;
+    // Parallel to the edges in the graph
+    std::vector<EdgeRecord> edges;
+
+    std::vector<RetiredBuffers> retired;
+    std::vector<RetiredRanges> retiredRanges;
+    uint32_t frame { 0 };
+    uint32_t nextChunkGeneration { 0 };
+    uint32_t swapChainImages { 0 };
+    // Shared with the job so it can finish after the renderer is gone
+    std::shared_ptr<Compaction> compaction;
+
+    Statistics statistics;
+
+    // Render state
+    std::unique_ptr<Engine::Pipeline> pipeline;
+    std::unique_ptr<Engine::Pipeline> pipelineWireframe;
+    uint32_t textureSamplerId { 0 };
+    vk::Sampler textureSampler;
+    const Engine::Texture *texture { nullptr };
+
+    Chunk &getChunk(const glm::vec3 &position);
+    void allocate(Chunk &chunk, EdgeRecord &record, uint32_t vertexCount, uint32_t indexCount);
+    void release(EdgeRecord &record);
+    void write(
+        EdgeRecord &record, const glm::vec3 &origin, const std::vector<Engine::Vertex> &vertices,
+        const std::vector<uint32_t> &indices
+    );
+    void rebuild(Chunk &chunk, uint32_t vertexCapacity, uint32_t indexCapacity);
+    void replaceBuffers(
+        Chunk &chunk, uint32_t vertexCapacity, uint32_t indexCapacity, const std::vector<Engine::Vertex> &vertices,
+        const std::vector<uint32_t> &indices
+    );
+    void freeRetiredRanges();
+    void finishCompaction();
+    void compact();
+    void updateDrawRanges(Chunk &chunk);
+
+    /**
+     * Lays the meshes out one after the other, the way a rebuild gives them ranges
+     */
+    static void pack(
+        const std::vector<std::shared_ptr<const EdgeMesh>> &meshes, std::vector<Engine::Vertex> &vertices,
+        std::vector<uint32_t> &indices
+    );
+};
@@ -0,0 +1,142 @@
+#include "generator.hpp"
+#include "meshes.hpp"
+#include "../utils/random.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Scatter {
+
+const float Pi = 3.14159265f;
+
+namespace Internal {
+
+uint64_t makeSeed(const glm::ivec2 &cell, uint32_t rule, uint32_t seed) {
+    auto x = static_cast<uint64_t>(static_cast<uint32_t>(cell.x));
+    auto y = static_cast<uint64_t>(static_cast<uint32_t>(cell.y));
+    return (x << 32 | y) * 0xD6E8FEB86659FD93ull ^ (static_cast<uint64_t>(seed) << 32 | rule);
+}
+
+float sampleHeight(const ChunkSource &source, const glm::vec2 &world) {
+    auto pixel = (world - source.heightmapOffset) * source.heightmapScale - glm::vec2(source.heightsMin);
+    pixel = glm::clamp(
+        pixel, glm::vec2(0, 0),
+        glm::vec2(static_cast<float>(source.heightsWidth - 1), static_cast<float>(source.heightsHeight - 1))
+    );
+
+    auto x = std::min(static_cast<uint32_t>(pixel.x), source.heightsWidth - 2);
+    auto y = std::min(static_cast<uint32_t>(pixel.y), source.heightsHeight - 2);
+    auto fractionX = pixel.x - static_cast<float>(x);
+    auto fractionY = pixel.y - static_cast<float>(y);
+
+    auto *row = &source.heights[x + y * source.heightsWidth];
+    auto top = row[0] + (row[1] - row[0]) * fractionX;
+    row += source.heightsWidth;
+    auto bottom = row[0] + (row[1] - row[0]) * fractionX;
+
+    return top + (bottom - top) * fractionY;
+}
+
+bool inRange(float value, float min, float max) {
+    return value >= min && value <= max;
+}
+
+}
+
+std::array<float, SplatTiles::MaterialCount> getMaterialWeights(const uint8_t *texel) {
+    std::array<float, SplatTiles::MaterialCount> weights {};
+
+    float total = 0;
+    for (uint32_t channel = 0; channel < 4; ++channel) {
+        weights[channel] = static_cast<float>(texel[channel]) / 255.0f;
+        total += weights[channel];
+    }
+    // The last texture takes what is left over, like the terrain shader
+    weights[4] = std::max(1 - total, 0.0f);
+
+    return weights;
+}
+
+float getSlope(const ChunkSource &source, const glm::ivec2 &pixel) {
+    auto last = glm::ivec2(source.heightsWidth - 1, source.heightsHeight - 1);
+    auto local = glm::clamp(pixel - source.heightsMin, glm::ivec2(0, 0), last - 1);
+
+    auto index = local.x + local.y * static_cast<int32_t>(source.heightsWidth);
+    auto height = source.heights[index];
+    auto right = source.heights[index + 1] - height;
+    auto down = source.heights[index + source.heightsWidth] - height;
+
+    // regen_normals.glsl gives normalize(-right, -down, 1)
+    return std::atan(std::sqrt(right * right + down * down)) * 180 / Pi;
+}
+
+void generateChunk(
+    const ChunkSource &source, const glm::ivec2 &cell, const std::vector<Rule> &rules, uint32_t seed,
+    ChunkInstances &output
+) {
+    for (auto &instances : output.instances) {
+        instances.clear();
+    }
+    output.minZ = std::numeric_limits<float>::max();
+    output.maxZ = std::numeric_limits<float>::lowest();
+    output.maxRadius = 0;
+
+    auto lastSplat = glm::ivec2(source.splatWidth - 1, source.splatHeight - 1);
+
+    for (uint32_t ruleIndex = 0; ruleIndex < rules.size(); ++ruleIndex) {
+        auto &rule = rules[ruleIndex];
+        Random random(Internal::makeSeed(cell, ruleIndex, seed));
+
+        // Round the expected count randomly so low densities still average out across chunks
+        auto expected = rule.density * source.size * source.size;
+        auto candidates = static_cast<uint32_t>(expected);
+        if (random.unit() < expected - static_cast<float>(candidates)) {
+            ++candidates;
+        }
+
+        auto &instances = output.instances[static_cast<uint32_t>(rule.mesh)];
+        for (uint32_t candidate = 0; candidate < candidates; ++candidate) {
+            // Everything is drawn for every candidate so rejections do not shift the sequence for the rest
+            glm::vec2 position {
+                source.worldMin.x + random.unit() * source.size, source.worldMin.y + random.unit() * source.size
+            };
+            auto chance = random.unit();
+            auto scale = random.range(rule.minScale, rule.maxScale);
+            auto rotation = random.unit() * 2 * Pi;
+
+            auto splatTexel = glm::clamp(
+                glm::ivec2(glm::floor((position + source.splatOffset) * source.splatScale)) - source.splatMin,
+                glm::ivec2(0, 0), lastSplat
+            );
+            auto weights = getMaterialWeights(
+                &source.splat[(splatTexel.x + splatTexel.y * source.splatWidth) * 4]
+            );
+
+            float probability = 0;
+            for (uint32_t material = 0; material < SplatTiles::MaterialCount; ++material) {
+                probability += weights[material] * rule.materials[material];
+            }
+            if (chance >= probability) {
+                continue;
+            }
+
+            auto height = Internal::sampleHeight(source, position);
+            if (!Internal::inRange(height, rule.minHeight, rule.maxHeight)) {
+                continue;
+            }
+
+            auto pixel = glm::ivec2(glm::floor((position - source.heightmapOffset) * source.heightmapScale));
+            auto slope = getSlope(source, pixel);
+            if (!Internal::inRange(slope, rule.minSlope, rule.maxSlope)) {
+                continue;
+            }
+
+            instances.push_back({ { position, height }, scale, rotation });
+            output.minZ = std::min(output.minZ, height);
+            output.maxZ = std::max(output.maxZ, height + scale * getMeshHeight(rule.mesh));
+            output.maxRadius = std::max(output.maxRadius, scale * getMeshRadius(rule.mesh));
+        }
+    }
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "structures.hpp"
+#include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace Scatter {
+
+/**
+ * Copies of the terrain data around a chunk, taken on the render thread so the chunk can be generated on a worker
+ */
+struct ChunkSource {
+    glm::vec2 worldMin { 0, 0 };
+    float size { 0 };
+
+    // Heightmap pixel coordinates are (world - heightmapOffset) * heightmapScale
+    glm::vec2 heightmapOffset { 0, 0 };
+    glm::vec2 heightmapScale { 1, 1 };
+    // Heights covering the chunk and one pixel past it on every side, first is at heightsMin
+    glm::ivec2 heightsMin { 0, 0 };
+    uint32_t heightsWidth { 0 };
+    uint32_t heightsHeight { 0 };
+    std::vector<float> heights;
+
+    // Splat map texel coordinates are (world + splatOffset) * splatScale
+    glm::vec2 splatOffset { 0, 0 };
+    glm::vec2 splatScale { 1, 1 };
+    // RGBA texels covering the chunk, first is at splatMin
+    glm::ivec2 splatMin { 0, 0 };
+    uint32_t splatWidth { 0 };
+    uint32_t splatHeight { 0 };
+    std::vector<uint8_t> splat;
+};
+
+struct ChunkInstances {
+    std::array<std::vector<Instance>, MeshTypeCount> instances;
+    // Heights covered by the instance meshes
+    float minZ { 0 };
+    float maxZ { 0 };
+    // How far the meshes can reach outside the chunk
+    float maxRadius { 0 };
+};
+
+/**
+ * Places instances of every rule in the chunk.
+ * Candidates are drawn from a random sequence seeded by the cell and rule so a chunk always comes out the same for
+ * the same terrain, and each is kept with the chance its rule gives the terrain under it.
+ */
+void generateChunk(
+    const ChunkSource &source, const glm::ivec2 &cell, const std::vector<Rule> &rules, uint32_t seed,
+    ChunkInstances &output
+);
+
+/**
+ * Weights of each splat map texture at the texel, summing to 1
+ */
+std::array<float, SplatTiles::MaterialCount> getMaterialWeights(const uint8_t *texel);
+
+/**
+ * Slope in degrees of the terrain at the heightmap pixel, using the same normal as the normal map
+ */
+float getSlope(const ChunkSource &source, const glm::ivec2 &pixel);
+
+}
@@ -0,0 +1,182 @@
+#include "meshes.hpp"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+namespace Scatter {
+
+const float Pi = 3.14159265f;
+
+const uint32_t TrunkSides = 6;
+const float TrunkRadius = 0.4f;
+const float TrunkHeight = 3;
+// Sunk into the ground so it does not float on slopes
+const float TrunkDepth = 0.5f;
+const uint32_t CanopySides = 8;
+const float TreeRadius = 2.5f;
+const float TreeHeight = 9;
+
+const float RockRadius = 1.1f;
+const float RockFlatten = 0.6f;
+const float RockDepth = 0.2f;
+
+namespace Internal {
+
+/**
+ * Adds a flat shaded triangle, wound to face away from the inside point
+ */
+void addTriangle(
+    glm::vec3 a, glm::vec3 b, glm::vec3 c, const glm::vec3 &inside, const glm::vec4 &colour,
+    std::vector<Engine::Vertex> &vertices, std::vector<uint16_t> &indices
+) {
+    auto normal = glm::normalize(glm::cross(b - a, c - a));
+    if (glm::dot(normal, (a + b + c) / 3.0f - inside) < 0) {
+        std::swap(b, c);
+        normal = -normal;
+    }
+
+    auto first = static_cast<uint16_t>(vertices.size());
+    for (auto &position : { a, b, c }) {
+        vertices.push_back({ position, normal, colour, { 0, 0 } });
+    }
+    indices.insert(indices.end(), { first, static_cast<uint16_t>(first + 1), static_cast<uint16_t>(first + 2) });
+}
+
+glm::vec3 onCircle(uint32_t index, uint32_t sides, float radius, float z) {
+    auto angle = static_cast<float>(index) / static_cast<float>(sides) * 2 * Pi;
+    return { std::cos(angle) * radius, std::sin(angle) * radius, z };
+}
+
+void addCone(
+    float radius, float baseZ, float apexZ, const glm::vec4 &colour, std::vector<Engine::Vertex> &vertices,
+    std::vector<uint16_t> &indices
+) {
+    glm::vec3 apex { 0, 0, apexZ };
+    glm::vec3 base { 0, 0, baseZ };
+
+    for (uint32_t side = 0; side < CanopySides; ++side) {
+        auto a = onCircle(side, CanopySides, radius, baseZ);
+        auto b = onCircle(side + 1, CanopySides, radius, baseZ);
+
+        addTriangle(a, b, apex, base, colour, vertices, indices);
+        addTriangle(a, b, base, base + glm::vec3(0, 0, 1), colour, vertices, indices);
+    }
+}
+
+void generateTree(std::vector<Engine::Vertex> &vertices, std::vector<uint16_t> &indices) {
+    glm::vec4 bark { 0.4f, 0.26f, 0.13f, 1 };
+    glm::vec4 lowerLeaves { 0.13f, 0.36f, 0.13f, 1 };
+    glm::vec4 upperLeaves { 0.18f, 0.45f, 0.16f, 1 };
+
+    for (uint32_t side = 0; side < TrunkSides; ++side) {
+        auto bottomA = onCircle(side, TrunkSides, TrunkRadius, -TrunkDepth);
+        auto bottomB = onCircle(side + 1, TrunkSides, TrunkRadius, -TrunkDepth);
+        auto topA = onCircle(side, TrunkSides, TrunkRadius, TrunkHeight);
+        auto topB = onCircle(side + 1, TrunkSides, TrunkRadius, TrunkHeight);
+        glm::vec3 inside { 0, 0, TrunkHeight / 2 };
+
+        addTriangle(bottomA, bottomB, topB, inside, bark, vertices, indices);
+        addTriangle(bottomA, topB, topA, inside, bark, vertices, indices);
+    }
+
+    addCone(TreeRadius, 2, 7, lowerLeaves, vertices, indices);
+    addCone(TreeRadius * 0.7f, 4.5f, TreeHeight, upperLeaves, vertices, indices);
+}
+
+/**
+ * A once subdivided icosahedron with every corner pushed in or out a little, squashed onto the ground
+ */
+void generateRock(std::vector<Engine::Vertex> &vertices, std::vector<uint16_t> &indices) {
+    auto t = (1 + std::sqrt(5.0f)) / 2;
+    std::vector<glm::vec3> corners {
+        { -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+        { 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+        { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 }
+    };
+    std::vector<glm::uvec3> faces {
+        { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+        { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+        { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+        { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+    };
+
+    // Shared midpoints keep the surface closed
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> midpoints;
+    auto midpoint = [&corners, &midpoints](uint32_t a, uint32_t b) {
+        auto key = std::make_pair(std::min(a, b), std::max(a, b));
+        auto it = midpoints.find(key);
+        if (it != midpoints.end()) {
+            return it->second;
+        }
+
+        corners.push_back((corners[a] + corners[b]) / 2.0f);
+        auto index = static_cast<uint32_t>(corners.size() - 1);
+        midpoints[key] = index;
+        return index;
+    };
+
+    std::vector<glm::uvec3> subdivided;
+    for (auto &face : faces) {
+        auto ab = midpoint(face.x, face.y);
+        auto bc = midpoint(face.y, face.z);
+        auto ca = midpoint(face.z, face.x);
+        subdivided.insert(
+            subdivided.end(), { { face.x, ab, ca }, { face.y, bc, ab }, { face.z, ca, bc }, { ab, bc, ca } }
+        );
+    }
+
+    for (uint32_t index = 0; index < corners.size(); ++index) {
+        // Fixed jitter so every rock is the same mesh
+        auto jitter = std::sin(static_cast<float>(index) * 12.9898f) * 43758.5453f;
+        jitter -= std::floor(jitter);
+
+        auto &corner = corners[index];
+        corner = glm::normalize(corner) * (0.75f + 0.35f * jitter);
+        corner.z = corner.z * RockFlatten + RockFlatten - RockDepth;
+    }
+
+    glm::vec4 stone { 0.5f, 0.5f, 0.48f, 1 };
+    glm::vec3 centre { 0, 0, RockFlatten - RockDepth };
+    for (auto &face : subdivided) {
+        addTriangle(corners[face.x], corners[face.y], corners[face.z], centre, stone, vertices, indices);
+    }
+}
+
+}
+
+void generateMesh(MeshType type, std::vector<Engine::Vertex> &vertices, std::vector<uint16_t> &indices) {
+    vertices.clear();
+    indices.clear();
+
+    switch (type) {
+        case MeshType::Tree:
+            Internal::generateTree(vertices, indices);
+            break;
+        case MeshType::Rock:
+            Internal::generateRock(vertices, indices);
+            break;
+    }
+}
+
+float getMeshHeight(MeshType type) {
+    switch (type) {
+        case MeshType::Tree:
+            return TreeHeight;
+        case MeshType::Rock:
+        default:
+            return RockRadius * RockFlatten * 2 - RockDepth;
+    }
+}
+
+float getMeshRadius(MeshType type) {
+    switch (type) {
+        case MeshType::Tree:
+            return TreeRadius;
+        case MeshType::Rock:
+        default:
+            return RockRadius;
+    }
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "structures.hpp"
+#include <tech-core/vertex.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace Scatter {
+
+/**
+ * Produces the low poly mesh for a scattered object, standing on the origin with z up at a scale of 1.
+ * Faces are flat shaded and coloured through the vertices so no textures are needed.
+ */
+void generateMesh(MeshType type, std::vector<Engine::Vertex> &vertices, std::vector<uint16_t> &indices);
+
+/**
+ * Top of the mesh above the origin at a scale of 1
+ */
+float getMeshHeight(MeshType type);
+
+/**
+ * Furthest the mesh reaches from its axis at a scale of 1
+ */
+float getMeshRadius(MeshType type);
+
+}
@@ -0,0 +1,484 @@
+#include "scatter_manager.hpp"
+#include "meshes.hpp"
+#include "../utils/instance_buffer.hpp"
+#include "../utils/instance_buffer.inl"
+#include "../utils/profiler.hpp"
+#include <tech-core/camera.hpp>
+#include <tech-core/mesh.hpp>
+#include <tech-core/pipeline.hpp>
+#include <tech-core/shapes/bounding_box.hpp>
+#include <imgui.h>
+#include <algorithm>
+#include <cmath>
+
+namespace Scatter {
+
+const Engine::Subsystem::SubsystemID<ScatterManager> ScatterManager::ID;
+
+const float ChunkSize = 64;
+// Instances each mesh can have in range
+const uint32_t InstanceCapacity = 1 << 20;
+// Chunks being generated at once, more would only delay the nearest ones when the camera moves
+const uint32_t MaxPendingBuilds = 32;
+// Number of frames a chunk can be out of range before it is evicted
+const uint32_t MaximumUnusedFrames = 300;
+
+const char *MeshNames[MeshTypeCount] { "scatter-tree", "scatter-rock" };
+
+uint64_t makeChunkKey(const glm::ivec2 &cell) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(cell.x)) << 32) | static_cast<uint32_t>(cell.y);
+}
+
+void ScatterManager::setCamera(Engine::Camera *camera) {
+    this->camera = camera;
+}
+
+void ScatterManager::setTerrain(
+    const Heightmap &heightmap, const TerrainPainter &painter, const glm::vec2 &worldOffset,
+    const glm::vec2 &worldSize
+) {
+    this->heightmap = &heightmap;
+    this->painter = &painter;
+    this->worldOffset = worldOffset;
+    this->worldSize = worldSize;
+
+    heightmapVersion = heightmap.getVersion();
+    painterVersion = painter.getVersion();
+    invalidateAll();
+}
+
+void ScatterManager::setRules(const std::vector<Rule> &rules) {
+    this->rules = rules;
+    invalidateAll();
+}
+
+void ScatterManager::setEnabled(bool enable) {
+    enabled = enable;
+}
+
+void ScatterManager::setWireframe(bool enable) {
+    wireframe = enable;
+}
+
+void ScatterManager::initialiseResources(
+    vk::Device device, vk::PhysicalDevice physicalDevice, Engine::RenderEngine &engine
+) {
+    this->engine = &engine;
+
+    std::vector<Engine::Vertex> vertices;
+    std::vector<uint16_t> indices;
+    for (uint32_t type = 0; type < MeshTypeCount; ++type) {
+        generateMesh(static_cast<MeshType>(type), vertices, indices);
+        meshes[type] = engine.createStaticMesh<Engine::Vertex>(MeshNames[type])
+            .withVertices(vertices)
+            .withIndices(indices)
+            .build();
+
+        meshInstances[type].buffer = std::make_unique<InstanceBuffer<Instance>>(InstanceCapacity, engine);
+        meshInstances[type].ranges = RangeAllocator(InstanceCapacity);
+    }
+}
+
+void ScatterManager::initialiseSwapChainResources(
+    vk::Device device, Engine::RenderEngine &engine, uint32_t swapChainImages
+) {
+    this->swapChainImages = swapChainImages;
+
+    auto builder = engine.createPipeline()
+        .withVertexShader("assets/shaders/scatter/vert.spv")
+        .withFragmentShader("assets/shaders/scatter/frag.spv")
+        .withGeometryType(Engine::PipelineGeometryType::Polygons)
+        .withVertexAttributeDescriptions(Engine::Vertex::getAttributeDescriptions())
+        .withVertexBindingDescription(Engine::Vertex::getBindingDescription())
+        .withVertexAttributeDescriptions(Instance::getAttributeDescriptions())
+        .withVertexBindingDescription(Instance::getBindingDescription())
+        .bindCamera(0, 0);
+
+    pipeline = builder.build();
+    pipelineWireframe = builder.withFillMode(Engine::FillMode::Wireframe).build();
+}
+
+void ScatterManager::cleanupResources(vk::Device device, Engine::RenderEngine &engine) {
+    // Builds write to the results, they must finish first
+    ThreadPool::getShared().wait();
+    results.clear();
+    pendingBuilds = 0;
+    chunks.clear();
+    retiredSlots.clear();
+
+    for (uint32_t type = 0; type < MeshTypeCount; ++type) {
+        meshInstances[type] = {};
+
+        if (meshes[type]) {
+            engine.removeMesh(MeshNames[type]);
+            meshes[type] = nullptr;
+        }
+    }
+}
+
+void ScatterManager::cleanupSwapChainResources(vk::Device device, Engine::RenderEngine &engine) {
+    pipeline.reset();
+    pipelineWireframe.reset();
+}
+
+void ScatterManager::invalidate(const glm::vec2 &worldMin, const glm::vec2 &worldMax) {
+    for (auto &pair : chunks) {
+        auto &chunk = pair.second;
+        auto chunkMin = glm::vec2(chunk.cell) * ChunkSize;
+        if (
+            chunkMin.x <= worldMax.x && chunkMin.x + ChunkSize >= worldMin.x &&
+                chunkMin.y <= worldMax.y && chunkMin.y + ChunkSize >= worldMin.y
+            ) {
+            chunk.stale = true;
+            // A build in progress used the old terrain
+            chunk.building = false;
+        }
+    }
+}
+
+void ScatterManager::invalidateAll() {
+    for (auto &pair : chunks) {
+        pair.second.stale = true;
+        pair.second.building = false;
+    }
+}
+
+void ScatterManager::checkForEdits() {
+    glm::ivec2 pixelMin, pixelMax;
+    if (!heightmap->getChangedSince(heightmapVersion, pixelMin, pixelMax)) {
+        invalidateAll();
+    } else if (pixelMin.x <= pixelMax.x && pixelMin.y <= pixelMax.y) {
+        auto pixelSize = worldSize / glm::vec2(heightmap->getWidth(), heightmap->getHeight());
+
+        // Slopes use the pixels either side
+        invalidate(
+            glm::vec2(pixelMin - 1) * pixelSize + worldOffset, glm::vec2(pixelMax + 1) * pixelSize + worldOffset
+        );
+    }
+    heightmapVersion = heightmap->getVersion();
+
+    glm::vec2 paintMin, paintMax;
+    if (!painter->getChangedSince(painterVersion, paintMin, paintMax)) {
+        invalidateAll();
+    } else if (paintMin.x <= paintMax.x && paintMin.y <= paintMax.y) {
+        auto texelSize = 1.0f / painter->getSplatScale();
+        invalidate(paintMin - texelSize, paintMax + texelSize);
+    }
+    painterVersion = painter->getVersion();
+}
+
+void ScatterManager::applyResults() {
+    std::vector<BuildResult> finished;
+    {
+        std::lock_guard<std::mutex> lock(resultLock);
+        finished.swap(results);
+    }
+
+    for (auto &result : finished) {
+        --pendingBuilds;
+
+        auto it = chunks.find(result.key);
+        if (it == chunks.end() || it->second.generation != result.generation || !it->second.building) {
+            // Evicted or superseded by a newer build
+            continue;
+        }
+
+        auto &chunk = it->second;
+        chunk.building = false;
+        chunk.generated = true;
+        chunk.instances = std::move(result.instances);
+        chunk.instancesGeneration = result.generation;
+        ++statistics.generated;
+    }
+}
+
+void ScatterManager::queueBuild(uint64_t key, Chunk &chunk) {
+    chunk.stale = false;
+    chunk.building = true;
+    chunk.generation = nextGeneration++;
+    ++pendingBuilds;
+
+    // The heightmap and splat map are only safe to read on the render thread so the build gets copies
+    ChunkSource source;
+    source.worldMin = glm::vec2(chunk.cell) * ChunkSize;
+    source.size = ChunkSize;
+
+    source.heightmapOffset = worldOffset;
+    source.heightmapScale = glm::vec2(heightmap->getWidth(), heightmap->getHeight()) / worldSize;
+    auto heightsMin = glm::ivec2(glm::floor((source.worldMin - worldOffset) * source.heightmapScale)) - 1;
+    auto heightsMax = glm::ivec2(glm::ceil((source.worldMin + ChunkSize - worldOffset) * source.heightmapScale)) + 1;
+    source.heightsMin = heightsMin;
+    source.heightsWidth = heightsMax.x - heightsMin.x + 1;
+    source.heightsHeight = heightsMax.y - heightsMin.y + 1;
+
+    // Whole pixels, past the edges repeat the edge
+    std::vector<glm::vec2> pixels(source.heightsWidth * source.heightsHeight);
+    for (uint32_t y = 0; y < source.heightsHeight; ++y) {
+        for (uint32_t x = 0; x < source.heightsWidth; ++x) {
+            pixels[x + y * source.heightsWidth] = glm::vec2(heightsMin + glm::ivec2(x, y));
+        }
+    }
+    source.heights.resize(pixels.size());
+    heightmap->getHeightsAt(pixels, source.heights);
+
+    source.splatOffset = painter->getSplatOffset();
+    source.splatScale = painter->getSplatScale();
+    auto splatMin = glm::ivec2(glm::floor((source.worldMin + source.splatOffset) * source.splatScale));
+    auto splatMax = glm::ivec2(glm::floor((source.worldMin + ChunkSize + source.splatOffset) * source.splatScale));
+    source.splatMin = splatMin;
+    source.splatWidth = splatMax.x - splatMin.x + 1;
+    source.splatHeight = splatMax.y - splatMin.y + 1;
+    painter->getSplatTiles().read(splatMin, source.splatWidth, source.splatHeight, source.splat);
+
+    ThreadPool::getShared().submit(
+        [this, key, generation = chunk.generation, cell = chunk.cell, source = std::move(source), rules = rules,
+            seed = seed]() {
+            PROFILE_ZONE("ScatterManager::generate");
+
+            BuildResult result { key, generation };
+            generateChunk(source, cell, rules, seed, result.instances);
+
+            std::lock_guard<std::mutex> lock(resultLock);
+            results.push_back(std::move(result));
+        }
+    );
+}
+
+void ScatterManager::retireSlot(uint32_t type, const InstanceSlot &slot) {
+    retiredSlots.push_back({ type, slot.first, slot.count, frame + swapChainImages + 1 });
+}
+
+void ScatterManager::freeRetiredSlots() {
+    retiredSlots.erase(
+        std::remove_if(
+            retiredSlots.begin(), retiredSlots.end(), [this](const RetiredSlot &slot) {
+                if (slot.releaseFrame > frame) {
+                    return false;
+                }
+
+                meshInstances[slot.type].ranges.free(slot.first, slot.count);
+                return true;
+            }
+        ),
+        retiredSlots.end()
+    );
+}
+
+void ScatterManager::prepareFrame(uint32_t activeImage) {
+    PROFILE_ZONE("ScatterManager::prepareFrame");
+
+    ++frame;
+    applyResults();
+    freeRetiredSlots();
+
+    statistics.chunks = chunks.size();
+    statistics.pending = pendingBuilds;
+    statistics.drawnChunks = 0;
+    statistics.drawCalls = 0;
+    statistics.drawnInstances = {};
+    statistics.droppedInstances = 0;
+    statistics.writtenInstances = 0;
+
+    if (!enabled || !camera || !heightmap || !painter) {
+        return;
+    }
+
+    checkForEdits();
+
+    auto origin = glm::vec2(camera->getPosition());
+    auto range = *std::max_element(drawDistances.begin(), drawDistances.end());
+
+    // Only cells on the terrain
+    auto minCell = glm::ivec2(glm::floor(glm::max(origin - range, worldOffset) / ChunkSize));
+    auto maxCell = glm::ivec2(glm::floor((glm::min(origin + range, worldOffset + worldSize) - 0.001f) / ChunkSize));
+
+    struct Candidate {
+        uint64_t key;
+        float distance;
+    };
+    std::vector<Candidate> missing;
+    std::vector<Candidate> nearby;
+    std::vector<Candidate> visible;
+
+    auto &frustum = camera->getFrustum();
+    for (auto y = minCell.y; y <= maxCell.y; ++y) {
+        for (auto x = minCell.x; x <= maxCell.x; ++x) {
+            glm::ivec2 cell { x, y };
+            auto chunkMin = glm::vec2(cell) * ChunkSize;
+            auto distance = glm::length(glm::clamp(origin, chunkMin, chunkMin + ChunkSize) - origin);
+            if (distance > range) {
+                continue;
+            }
+
+            auto key = makeChunkKey(cell);
+            auto &chunk = chunks[key];
+            chunk.cell = cell;
+            chunk.lastUsedFrame = frame;
+
+            if (chunk.stale && !chunk.building) {
+                missing.push_back({ key, distance });
+            }
+
+            // Stale chunks keep showing their old instances until the new ones are ready
+            if (!chunk.generated || chunk.instances.minZ > chunk.instances.maxZ) {
+                continue;
+            }
+            nearby.push_back({ key, distance });
+
+            auto reach = chunk.instances.maxRadius;
+            Engine::BoundingBox bounds(
+                chunkMin.x - reach, chunkMin.y - reach, chunk.instances.minZ,
+                chunkMin.x + ChunkSize + reach, chunkMin.y + ChunkSize + reach, chunk.instances.maxZ
+            );
+            if (bounds.intersects(frustum)) {
+                visible.push_back({ key, distance });
+            }
+        }
+    }
+
+    // Nearest first so what is in front of the camera fills in before the distance
+    std::sort(
+        missing.begin(), missing.end(), [](const Candidate &a, const Candidate &b) {
+            return a.distance < b.distance;
+        }
+    );
+    for (auto &candidate : missing) {
+        if (pendingBuilds >= MaxPendingBuilds) {
+            break;
+        }
+        queueBuild(candidate.key, chunks[candidate.key]);
+    }
+
+    for (uint32_t type = 0; type < MeshTypeCount; ++type) {
+        PROFILE_ZONE("ScatterManager::updateInstances");
+        auto &mesh = meshInstances[type];
+
+        // Chunks keep their slot while in range, so only ones coming into range or generated again are written
+        for (auto &candidate : nearby) {
+            auto &chunk = chunks[candidate.key];
+            auto &instances = chunk.instances.instances[type];
+            if (candidate.distance > drawDistances[type] || instances.empty()) {
+                continue;
+            }
+
+            auto it = mesh.slots.find(candidate.key);
+            if (it != mesh.slots.end() && it->second.generation != chunk.instancesGeneration) {
+                retireSlot(type, it->second);
+                mesh.slots.erase(it);
+                it = mesh.slots.end();
+            }
+
+            if (it == mesh.slots.end()) {
+                auto count = static_cast<uint32_t>(instances.size());
+                auto first = mesh.ranges.allocate(count);
+                if (!first) {
+                    statistics.droppedInstances += count;
+                    continue;
+                }
+
+                mesh.buffer->write(*first, instances.data(), count);
+                statistics.writtenInstances += count;
+                it = mesh.slots.emplace(candidate.key, InstanceSlot { *first, count, chunk.instancesGeneration }).first;
+            }
+            it->second.lastUsedFrame = frame;
+        }
+        mesh.buffer->flush();
+
+        for (auto it = mesh.slots.begin(); it != mesh.slots.end();) {
+            if (it->second.lastUsedFrame != frame) {
+                retireSlot(type, it->second);
+                it = mesh.slots.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        mesh.drawRanges.clear();
+        for (auto &candidate : visible) {
+            auto it = mesh.slots.find(candidate.key);
+            if (candidate.distance <= drawDistances[type] && it != mesh.slots.end()) {
+                mesh.drawRanges.emplace_back(it->second.first, it->second.count);
+            }
+        }
+
+        // Neighbouring slots are drawn together
+        std::sort(
+            mesh.drawRanges.begin(), mesh.drawRanges.end(), [](const glm::uvec2 &a, const glm::uvec2 &b) {
+                return a.x < b.x;
+            }
+        );
+        size_t runs = 0;
+        for (auto &range : mesh.drawRanges) {
+            statistics.drawnInstances[type] += range.y;
+            if (runs > 0 && mesh.drawRanges[runs - 1].x + mesh.drawRanges[runs - 1].y == range.x) {
+                mesh.drawRanges[runs - 1].y += range.y;
+            } else {
+                mesh.drawRanges[runs++] = range;
+            }
+        }
+        mesh.drawRanges.resize(runs);
+        statistics.drawCalls += static_cast<uint32_t>(runs);
+    }
+    statistics.drawnChunks = static_cast<uint32_t>(visible.size());
+
+    // Evict anything which has been out of range for a while
+    for (auto it = chunks.begin(); it != chunks.end();) {
+        if (frame - it->second.lastUsedFrame > MaximumUnusedFrames) {
+            it = chunks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ScatterManager::writeFrameCommands(vk::CommandBuffer commandBuffer, uint32_t activeImage) {
+    if (!enabled) {
+        return;
+    }
+
+    Engine::Pipeline *currentPipeline;
+    if (wireframe) {
+        currentPipeline = pipelineWireframe.get();
+    } else {
+        currentPipeline = pipeline.get();
+    }
+
+    currentPipeline->bind(commandBuffer, activeImage);
+
+    for (uint32_t type = 0; type < MeshTypeCount; ++type) {
+        auto &mesh = meshInstances[type];
+        if (mesh.drawRanges.empty()) {
+            continue;
+        }
+
+        meshes[type]->bind(commandBuffer);
+        mesh.buffer->bind(commandBuffer);
+        for (auto &range : mesh.drawRanges) {
+            mesh.buffer->drawRange(commandBuffer, *meshes[type], range.x, range.y);
+        }
+    }
+}
+
+void ScatterManager::drawGUI() {
+    ImGui::Checkbox("Enabled", &enabled);
+
+    ImGui::SliderFloat("Tree distance", &drawDistances[static_cast<uint32_t>(MeshType::Tree)], 100, 3000);
+    ImGui::SliderFloat("Rock distance", &drawDistances[static_cast<uint32_t>(MeshType::Rock)], 50, 1000);
+
+    if (ImGui::InputScalar("Seed", ImGuiDataType_U32, &seed)) {
+        invalidateAll();
+    }
+
+    ImGui::Text("Chunks: %u (%u drawn, %u generating)", statistics.chunks, statistics.drawnChunks, statistics.pending);
+    ImGui::Text("Draw calls: %u, %u instances written", statistics.drawCalls, statistics.writtenInstances);
+    ImGui::Text(
+        "Instances: %u trees, %u rocks", statistics.drawnInstances[static_cast<uint32_t>(MeshType::Tree)],
+        statistics.drawnInstances[static_cast<uint32_t>(MeshType::Rock)]
+    );
+    if (statistics.droppedInstances > 0) {
+        ImGui::Text("Dropped: %u instances over capacity", statistics.droppedInstances);
+    }
+    ImGui::Text("Chunks generated: %u", statistics.generated);
+}
+
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "generator.hpp"
+#include "structures.hpp"
+#include "../heightmap.hpp"
+#include "../terrain_painter.hpp"
+#include "../utils/range_allocator.hpp"
+#include "../utils/thread_pool.hpp"
+#include <tech-core/engine.hpp>
+#include <tech-core/subsystem/base.hpp>
+#include <glm/glm.hpp>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Forward
+template<typename T>
+class InstanceBuffer;
+
+namespace Scatter {
+
+/**
+ * Scatters trees and rocks over the terrain following rules keyed on the painted textures, slope and height.
+ * The world is split into square chunks which are generated on the worker threads when the camera comes near them,
+ * and generated again when the terrain under them is terraformed or painted. Chunks in range keep a range of an
+ * instance buffer per mesh, which is only written when the chunk comes into range or gets new instances. Each run of
+ * ranges in view is drawn with one call. Ranges given up are left alone until the frames in flight are done with them.
+ */
+class ScatterManager : public Engine::Subsystem::Subsystem {
+public:
+    static const Engine::Subsystem::SubsystemID<ScatterManager> ID;
+
+    void setCamera(Engine::Camera *);
+
+    /**
+     * @param worldOffset World position of the first heightmap pixel
+     * @param worldSize World size covered by the heightmap
+     */
+    void setTerrain(
+        const Heightmap &, const TerrainPainter &, const glm::vec2 &worldOffset, const glm::vec2 &worldSize
+    );
+
+    const std::vector<Rule> &getRules() const { return rules; }
+
+    /**
+     * Replaces the rules, every chunk is generated again
+     */
+    void setRules(const std::vector<Rule> &);
+
+    void setEnabled(bool);
+
+    bool isEnabled() const { return enabled; }
+
+    void setWireframe(bool);
+
+    void drawGUI();
+
+    // For engine use
+    void initialiseResources(vk::Device device, vk::PhysicalDevice physicalDevice, Engine::RenderEngine &engine);
+    void initialiseSwapChainResources(vk::Device device, Engine::RenderEngine &engine, uint32_t swapChainImages);
+    void cleanupResources(vk::Device device, Engine::RenderEngine &engine);
+    void cleanupSwapChainResources(vk::Device device, Engine::RenderEngine &engine);
+    void writeFrameCommands(vk::CommandBuffer commandBuffer, uint32_t activeImage);
+    void prepareFrame(uint32_t activeImage) override;
+
+private:
+    struct Chunk {
+        glm::ivec2 cell;
+        ChunkInstances instances;
+        // Of the latest build, which may not have finished
+        uint32_t generation { 0 };
+        // Of the build the instances came from
+        uint32_t instancesGeneration { 0 };
+        uint32_t lastUsedFrame { 0 };
+        bool generated { false };
+        bool stale { true };
+        bool building { false };
+    };
+
+    struct BuildResult {
+        uint64_t key;
+        uint32_t generation;
+        ChunkInstances instances;
+    };
+
+    // Where the instances of a chunk are in the instance buffer of a mesh
+    struct InstanceSlot {
+        uint32_t first;
+        uint32_t count;
+        // Of the build the instances came from
+        uint32_t generation;
+        uint32_t lastUsedFrame;
+    };
+
+    struct RetiredSlot {
+        uint32_t type;
+        uint32_t first;
+        uint32_t count;
+        uint32_t releaseFrame;
+    };
+
+    struct MeshInstances {
+        std::unique_ptr<InstanceBuffer<Instance>> buffer;
+        RangeAllocator ranges { 0 };
+        std::unordered_map<uint64_t, InstanceSlot> slots;
+        // The first instance and count of each run of slots in view
+        std::vector<glm::uvec2> drawRanges;
+    };
+
+    struct Statistics {
+        uint32_t chunks { 0 };
+        uint32_t drawnChunks { 0 };
+        uint32_t drawCalls { 0 };
+        uint32_t pending { 0 };
+        std::array<uint32_t, MeshTypeCount> drawnInstances {};
+        // Instances which did not fit in the buffers
+        uint32_t droppedInstances { 0 };
+        // Instances copied into the buffers this frame
+        uint32_t writtenInstances { 0 };
+        uint32_t generated { 0 };
+    };
+
+    Engine::RenderEngine *engine { nullptr };
+    Engine::Camera *camera { nullptr };
+    bool enabled { true };
+    bool wireframe { false };
+
+    const Heightmap *heightmap { nullptr };
+    const TerrainPainter *painter { nullptr };
+    glm::vec2 worldOffset { 0, 0 };
+    glm::vec2 worldSize { 0, 0 };
+    uint32_t heightmapVersion { 0 };
+    uint32_t painterVersion { 0 };
+
+    std::vector<Rule> rules;
+    uint32_t seed { 1 };
+    std::array<float, MeshTypeCount> drawDistances { 1500, 400 };
+
+    std::unordered_map<uint64_t, Chunk> chunks;
+    uint32_t nextGeneration { 1 };
+    uint32_t frame { 0 };
+    uint32_t swapChainImages { 0 };
+    uint32_t pendingBuilds { 0 };
+
+    std::mutex resultLock;
+    std::vector<BuildResult> results;
+
+    Statistics statistics;
+
+    // Render state
+    std::array<MeshInstances, MeshTypeCount> meshInstances;
+    std::vector<RetiredSlot> retiredSlots;
+    std::array<Engine::StaticMesh *, MeshTypeCount> meshes {};
+    std::unique_ptr<Engine::Pipeline> pipeline;
+    std::unique_ptr<Engine::Pipeline> pipelineWireframe;
+
+    void invalidate(const glm::vec2 &worldMin, const glm::vec2 &worldMax);
+    void invalidateAll();
+    void checkForEdits();
+    void applyResults();
+    void queueBuild(uint64_t key, Chunk &chunk);
+    void retireSlot(uint32_t type, const InstanceSlot &slot);
+    void freeRetiredSlots();
+};
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "../splat_tiles.hpp"
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+#include <array>
+
+namespace Scatter {
+
+enum class MeshType {
+    Tree,
+    Rock
+};
+
+const uint32_t MeshTypeCount = 2;
+
+/**
+ * Where and how densely one mesh is scattered
+ */
+struct Rule {
+    MeshType mesh { MeshType::Tree };
+    // Instances per square world unit where everything else allows it
+    float density { 0 };
+    // How much each splat map texture allows the rule, from 0 to 1
+    std::array<float, SplatTiles::MaterialCount> materials {};
+    // In degrees
+    float minSlope { 0 };
+    float maxSlope { 90 };
+    float minHeight { -1e9f };
+    float maxHeight { 1e9f };
+    float minScale { 1 };
+    float maxScale { 1 };
+};
+
+struct Instance {
+    glm::vec3 position;
+    float scale;
+    // Around z, in radians
+    float rotation;
+
+    static vk::VertexInputBindingDescription getBindingDescription() {
+        return vk::VertexInputBindingDescription(
+            1,
+            sizeof(Instance),
+            vk::VertexInputRate::eInstance
+        );
+    }
+
+    static std::array<vk::VertexInputAttributeDescription, 3> getAttributeDescriptions() {
+        return {
+            vk::VertexInputAttributeDescription {
+                4,
+                1,
+                vk::Format::eR32G32B32Sfloat,
+                offsetof(Instance, position)
+            },
+            vk::VertexInputAttributeDescription {
+                5,
+                1,
+                vk::Format::eR32Sfloat,
+                offsetof(Instance, scale)
+            },
+            vk::VertexInputAttributeDescription {
+                6,
+                1,
+                vk::Format::eR32Sfloat,
+                offsetof(Instance, rotation)
+            },
+        };
+    }
+};
+
+}
@@ -2,6 +2,7 @@
 #include "tools/painter_tool.hpp"
 #include "tools/terraform_tool.hpp"
 #include "tools/node_tool.hpp"
+#include "utils/profiler.hpp"
 
 #include <tech-core/camera.hpp>
 #include <tech-core/subsystem/debug.hpp>
@@ -23,9 +24,12 @@ void Scene::initialize() {
     // Initialise subsystems for rendering
     engine.addSubsystem(Engine::Subsystem::DebugSubsystem::ID);
     engine.addSubsystem(Terrain::CDLOD::TerrainManager::ID);
+    engine.addSubsystem(Terrain::Clipmap::TerrainManager::ID);
     engine.addSubsystem(Engine::Subsystem::ImGuiSubsystem::ID);
     engine.addSubsystem(Engine::Subsystem::LightSubsystem::ID);
     engine.addSubsystem(Engine::Subsystem::ObjectSubsystem::ID);
+    engine.addSubsystem(RoadRenderer::ID);
+    engine.addSubsystem(Scatter::ScatterManager::ID);
 
 
     // Initialise the engine
@@ -58,20 +62,50 @@ void Scene::initialize() {
     this->debugSubsystem = engine.getSubsystem(Engine::Subsystem::DebugSubsystem::ID);
 
     initializeHeightmap();
+    vectorGraphics->setHeightRange(heightmap->getMinElevation(), heightmap->getMaxElevation());
     painter = std::make_shared<TerrainPainter>(engine);
-    painter->initialize();
 
     // initialize terrain algorithms
     cdlod = engine.getSubsystem(Terrain::CDLOD::TerrainManager::ID);
     cdlod->setCamera(&mainCamera->getCamera());
     cdlod->setHeightmap(*heightmap);
+    painter->setWorldSize(cdlod->getTerrainSize());
     cdlod->setTerrainPainter(*painter);
+    terrainRaycast = std::make_unique<TerrainRaycastCache>(*cdlod, *heightmap);
 
-    painter->setWorldSize(cdlod->getTerrainSize());
+    clipmap = engine.getSubsystem(Terrain::Clipmap::TerrainManager::ID);
+    clipmap->setCamera(&mainCamera->getCamera());
+    clipmap->setWorldSize(cdlod->getTerrainSize());
+    clipmap->setHeightmap(*heightmap);
+    clipmap->setTerrainPainter(*painter);
+
+    setTerrainAlgorithm(TerrainAlgorithm::CDLOD);
+
+    terrainBenchmark = std::make_unique<TerrainBenchmark>(
+        std::vector<TerrainBenchmark::Technique> {
+            {
+                "CDLOD",
+                [this](bool enable) { cdlod->setEnabled(enable); },
+                [this]() -> const Terrain::FrameStatistics & { return cdlod->getStatistics(); }
+            },
+            {
+                "Clipmap",
+                [this](bool enable) { clipmap->setEnabled(enable); },
+                [this]() -> const Terrain::FrameStatistics & { return clipmap->getStatistics(); }
+            }
+        },
+        cdlod->getTerrainSize()
+    );
 
     initTextures();
+    initScatter();
+
+    roadRenderer = engine.getSubsystem(RoadRenderer::ID);
+    roadRenderer->setCamera(&mainCamera->getCamera());
 
     roadDisplay = std::make_unique<RoadDisplayManager>(engine);
+    roadDisplay->setCamera(&mainCamera->getCamera());
+    roadDisplay->setTerrain(*heightmap, cdlod->getTerrainOffset(), cdlod->getTerrainSize());
 
     nodeGraph = std::make_unique<Nodes::Graph>(*vectorGraphics, *roadDisplay);
 
@@ -89,6 +123,8 @@ void Scene::run() {
             break;
         }
 
+        Profiler::beginFrame();
+
         auto frameStart = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double> timeDelta = frameStart - lastFrameStart;
         lastFrameStart = frameStart;
@@ -97,11 +133,24 @@ void Scene::run() {
         averageFPS = averageFPS * AverageFPSFactor + instantFPS * (1 - AverageFPSFactor);
         instantFrameTime = timeDelta.count();
 
+        if (terrainBenchmark->isRunning()) {
+            terrainBenchmark->record(timeDelta.count());
+            if (!terrainBenchmark->isRunning()) {
+                // Finished, restore the selected algorithm
+                setTerrainAlgorithm(terrainAlgorithm);
+            }
+        }
+
+        heightmap->update();
+
         if (heightmap->getIsModified()) {
+            PROFILE_ZONE("Scene::invalidateHeightmap");
+
             glm::ivec2 invalidateMin, invalidateMax;
             heightmap->getAndClearInvalidationRegion(invalidateMin, invalidateMax);
 
             cdlod->invalidateHeightmap(invalidateMin, invalidateMax);
+            clipmap->invalidateHeightmap(invalidateMin, invalidateMax);
 
             // Make sure that camera is not below ground
             if (panRotate != PanRotateState::Panning) {
@@ -114,16 +163,36 @@ void Scene::run() {
             }
         }
 
-        handleControls();
-        handleCameraMovement(timeDelta.count());
+        if (terrainBenchmark->isRunning()) {
+            terrainBenchmark->update(
+                *mainCamera, [this](float x, float y) { return cdlod->getHeightAt(x, y); }
+            );
+        } else {
+            PROFILE_ZONE("Scene::handleControls");
 
-        drawGUI();
+            handleControls();
+            handleCameraMovement(timeDelta.count());
+        }
+
+        {
+            PROFILE_ZONE("Scene::drawGUI");
+            drawGUI();
+        }
 
         // Produce a debug grid
 //        drawGrid();
         drawGizmos();
 
-        engine.render();
+        {
+            PROFILE_ZONE("Scene::updateRoads");
+            nodeGraph->update();
+            roadDisplay->update(*nodeGraph);
+        }
+
+        {
+            PROFILE_ZONE("RenderEngine::render");
+            engine.render();
+        }
         vectorGraphics->update(engine);
     }
 }
@@ -193,9 +262,18 @@ void Scene::handleControls() {
 //    }
     if (this->inputManager->wasPressed(Engine::Key::e2)) {
         cdlod->setWireframe(!cdlod->getWireframe());
+        clipmap->setWireframe(cdlod->getWireframe());
+        roadRenderer->setWireframe(cdlod->getWireframe());
+        scatter->setWireframe(cdlod->getWireframe());
     }
     if (this->inputManager->wasPressed(Engine::Key::e4)) {
         cdlod->setDebugMode(cdlod->getDebugMode() + 1);
+        clipmap->setDebugMode(cdlod->getDebugMode());
+    }
+    if (this->inputManager->wasPressed(Engine::Key::e3)) {
+        if (Profiler::writeChromeTrace("profile.json")) {
+            std::cout << "Wrote profile.json" << std::endl;
+        }
     }
 
     auto mousePos = engine.getInputManager().getMousePos();
@@ -211,7 +289,7 @@ void Scene::handleControls() {
                     MouseButton::Left,
                     *inputManager,
                     mainCamera->getCamera(),
-                    *cdlod,
+                    *terrainRaycast,
                     mousePos
                 }
             );
@@ -222,7 +300,7 @@ void Scene::handleControls() {
                     MouseButton::Right,
                     *inputManager,
                     mainCamera->getCamera(),
-                    *cdlod,
+                    *terrainRaycast,
                     mousePos
                 }
             );
@@ -233,7 +311,7 @@ void Scene::handleControls() {
                     MouseButton::Middle,
                     *inputManager,
                     mainCamera->getCamera(),
-                    *cdlod,
+                    *terrainRaycast,
                     mousePos
                 }
             );
@@ -244,7 +322,7 @@ void Scene::handleControls() {
                     MouseButton::Left,
                     *inputManager,
                     mainCamera->getCamera(),
-                    *cdlod,
+                    *terrainRaycast,
                     mousePos
                 }
             );
@@ -259,7 +337,7 @@ void Scene::handleControls() {
                     MouseButton::Right,
                     *inputManager,
                     mainCamera->getCamera(),
-                    *cdlod,
+                    *terrainRaycast,
                     mousePos
                 }
             );
@@ -274,7 +352,7 @@ void Scene::handleControls() {
                     MouseButton::Middle,
                     *inputManager,
                     mainCamera->getCamera(),
-                    *cdlod,
+                    *terrainRaycast,
                     mousePos
                 }
             );
@@ -289,7 +367,7 @@ void Scene::handleControls() {
                 MouseButton::None,
                 *inputManager,
                 mainCamera->getCamera(),
-                *cdlod,
+                *terrainRaycast,
                 mousePos
             },
             instantFrameTime
@@ -409,7 +487,13 @@ void Scene::handleCameraMovement(double deltaSeconds) {
         hasFixedRay = !hasFixedRay;
     }
 
-    auto hitPos = cdlod->raycastTerrain(pos, dir);
+    std::optional<glm::vec3> hitPos;
+    if (hasFixedRay) {
+        hitPos = cdlod->raycastTerrain(pos, dir);
+    } else {
+        // The same ray the tools use
+        hitPos = terrainRaycast->raycast(pos, dir);
+    }
     if (hitPos) {
         Engine::draw(Engine::BoundingSphere(*hitPos, 1), 0xFFFFFF00);
     }
@@ -553,6 +637,13 @@ void Scene::initializeHeightmap() {
     // heightmap = std::make_unique<Heightmap>(4096, 4096, engine);
 }
 
+void Scene::setTerrainAlgorithm(TerrainAlgorithm algorithm) {
+    terrainAlgorithm = algorithm;
+
+    cdlod->setEnabled(algorithm == TerrainAlgorithm::CDLOD);
+    clipmap->setEnabled(algorithm == TerrainAlgorithm::Clipmap);
+}
+
 void Scene::initTextures() {
     std::vector<const Engine::Texture *> textures;
     textures.push_back(
@@ -589,6 +680,31 @@ void Scene::initTextures() {
     painter->setTextures(textures);
 }
 
+void Scene::initScatter() {
+    scatter = engine.getSubsystem(Scatter::ScatterManager::ID);
+    scatter->setCamera(&mainCamera->getCamera());
+    scatter->setTerrain(*heightmap, *painter, cdlod->getTerrainOffset(), cdlod->getTerrainSize());
+
+    // Materials are in the order of the painter textures: green, cyan, gray, brown and magenta
+    Scatter::Rule trees;
+    trees.mesh = Scatter::MeshType::Tree;
+    trees.density = 0.004f;
+    trees.materials = { 1, 0, 0, 0.3f, 0 };
+    trees.maxSlope = 30;
+    trees.minScale = 0.7f;
+    trees.maxScale = 1.3f;
+
+    Scatter::Rule rocks;
+    rocks.mesh = Scatter::MeshType::Rock;
+    rocks.density = 0.01f;
+    rocks.materials = { 0.05f, 0, 1, 0.3f, 0 };
+    rocks.maxSlope = 60;
+    rocks.minScale = 0.5f;
+    rocks.maxScale = 2;
+
+    scatter->setRules({ trees, rocks });
+}
+
 void Scene::drawGUI() {
     drawOverlayInfo();
 
@@ -596,18 +712,64 @@ void Scene::drawGUI() {
 
     if (ImGui::Checkbox("Wireframe", &wireframe)) {
         cdlod->setWireframe(wireframe);
+        clipmap->setWireframe(wireframe);
         engine.getSubsystem(Engine::Subsystem::ObjectSubsystem::ID)->setWireframe(wireframe);
+        roadRenderer->setWireframe(wireframe);
+        scatter->setWireframe(wireframe);
+    }
+
+    if (ImGui::Combo("Terrain", reinterpret_cast<int *>(&terrainAlgorithm), "CD LOD\0Geometry Clipmap\0")) {
+        setTerrainAlgorithm(terrainAlgorithm);
+    }
+
+    const Terrain::FrameStatistics *statistics;
+    if (terrainAlgorithm == TerrainAlgorithm::Clipmap) {
+        statistics = &clipmap->getStatistics();
+    } else {
+        statistics = &cdlod->getStatistics();
+    }
+
+    ImGui::Text("Selection: %.3fms", statistics->selectionTime * 1000);
+    ImGui::Text("Instances: %u", statistics->instances);
+    ImGui::Text("Triangles: %llu", static_cast<unsigned long long>(statistics->triangles));
+    ImGui::Text("Memory: %.2fMB", static_cast<double>(statistics->memoryUsage) / (1024 * 1024));
+    ImGui::Text(
+        "Cursor raycasts: %u full, %u partial, %u reused", terrainRaycast->getFullCount(),
+        terrainRaycast->getPartialCount(), terrainRaycast->getReusedCount()
+    );
+
+    if (terrainAlgorithm == TerrainAlgorithm::CDLOD) {
+        if (ImGui::CollapsingHeader("CD LOD", ImGuiTreeNodeFlags_DefaultOpen)) {
+            cdlod->drawGUI();
+        }
+    } else {
+        if (ImGui::CollapsingHeader("Geometry Clipmap", ImGuiTreeNodeFlags_DefaultOpen)) {
+            clipmap->drawGUI();
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Terrain Benchmark")) {
+        terrainBenchmark->drawGUI();
+    }
+
+    if (ImGui::CollapsingHeader("Roads")) {
+        roadDisplay->drawGUI();
+        roadRenderer->drawGUI();
+    }
+
+    if (ImGui::CollapsingHeader("Scattering")) {
+        scatter->drawGUI();
     }
 
-    if (ImGui::CollapsingHeader("CD LOD", ImGuiTreeNodeFlags_DefaultOpen)) {
-        cdlod->drawGUI();
+    if (ImGui::CollapsingHeader("Painting")) {
+        painter->drawGui();
     }
 
     ImGui::End();
 
     ImGui::ShowDemoWindow();
 
-    painter->drawGui();
+    Profiler::drawGUI();
 
     // Toolbar
     drawToolbox();
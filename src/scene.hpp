@@ -6,6 +6,8 @@
 #include <optional>
 
 #include "cdlod/terrain_manager.hpp"
+#include "clipmap/terrain_manager.hpp"
+#include "terrain_benchmark.hpp"
 #include <chrono>
 #include "utils/circular_buffer.hpp"
 #include "utils/overhead_camera.hpp"
@@ -15,9 +17,16 @@
 #include "tools/tool_base.hpp"
 #include "node/graph.hpp"
 #include "road_display_manager.hpp"
+#include "road_renderer.hpp"
+#include "scatter/scatter_manager.hpp"
 
 const uint32_t MaxFrameTimePoints = 200;
 
+enum class TerrainAlgorithm : int {
+    CDLOD,
+    Clipmap
+};
+
 enum class PanRotateState {
     None,
     Panning,
@@ -84,6 +93,12 @@ private:
 
     // Various terrain algorithms
     Terrain::CDLOD::TerrainManager *cdlod { nullptr };
+    std::unique_ptr<TerrainRaycastCache> terrainRaycast;
+    Terrain::Clipmap::TerrainManager *clipmap { nullptr };
+    RoadRenderer *roadRenderer { nullptr };
+    Scatter::ScatterManager *scatter { nullptr };
+    TerrainAlgorithm terrainAlgorithm { TerrainAlgorithm::CDLOD };
+    std::unique_ptr<TerrainBenchmark> terrainBenchmark;
 
     // Roads
     std::unique_ptr<Nodes::Graph> nodeGraph;
@@ -94,7 +109,9 @@ private:
     bool isMainCameraRendered() const { return engine.getCamera() == &mainCamera.get()->getCamera(); }
 
     void initializeHeightmap();
+    void setTerrainAlgorithm(TerrainAlgorithm);
     void initTextures();
+    void initScatter();
     void handleControls();
     void handleCameraMovement(double deltaSeconds);
     void drawGrid();
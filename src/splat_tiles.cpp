@@ -0,0 +1,316 @@
+#include "splat_tiles.hpp"
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstring>
+
+// Matches E in paintbrush.glsl
+const float BrushFalloff = 2.71828f;
+
+// The targets for each material in paintbrush.glsl
+const uint8_t MaterialTargets[SplatTiles::MaterialCount][4] {
+    { 255, 0, 0, 0 },
+    { 0, 255, 0, 0 },
+    { 0, 0, 255, 0 },
+    { 0, 0, 0, 255 },
+    { 0, 0, 0, 0 },
+};
+
+SplatTiles::SplatTiles(uint32_t size, uint32_t tileSize, uint32_t pageSize)
+    : size(size), tileSize(tileSize), tilesPerSide((size + tileSize - 1) / tileSize), pageSize(pageSize),
+    pagesPerSide(size / pageSize), pages(pagesPerSide * pagesPerSide) {
+
+    auto levelSize = tilesPerSide;
+    while (true) {
+        levels.emplace_back(levelSize * levelSize, 0);
+        if (levelSize <= 1) {
+            break;
+        }
+        levelSize = (levelSize + 1) / 2;
+    }
+
+    fill(0);
+}
+
+void SplatTiles::fill(uint32_t material) {
+    material = std::min(material, MaterialCount - 1);
+    for (uint32_t y = 0; y < pagesPerSide; ++y) {
+        for (uint32_t x = 0; x < pagesPerSide; ++x) {
+            if (material == 0) {
+                pages[x + y * pagesPerSide].clear();
+                continue;
+            }
+
+            auto &page = allocatePage(x, y);
+            for (size_t pixel = 0; pixel < page.size(); pixel += 4) {
+                std::memcpy(&page[pixel], MaterialTargets[material], 4);
+            }
+        }
+    }
+
+    if (material == 0) {
+        pageCount = 0;
+    }
+
+    auto last = static_cast<int32_t>(size) - 1;
+    updateTiles({ 0, 0 }, { last, last });
+}
+
+void SplatTiles::load(const uint8_t *source) {
+    // Only pages with something other than the first material are kept
+    for (uint32_t pageY = 0; pageY < pagesPerSide; ++pageY) {
+        for (uint32_t pageX = 0; pageX < pagesPerSide; ++pageX) {
+            bool painted = false;
+            for (uint32_t y = pageY * pageSize; y < (pageY + 1) * pageSize && !painted; ++y) {
+                auto *row = &source[(pageX * pageSize + y * size) * 4];
+                for (uint32_t x = 0; x < pageSize; ++x) {
+                    if (std::memcmp(&row[x * 4], MaterialTargets[0], 4) != 0) {
+                        painted = true;
+                        break;
+                    }
+                }
+            }
+
+            auto &page = pages[pageX + pageY * pagesPerSide];
+            if (!painted) {
+                if (!page.empty()) {
+                    page.clear();
+                    --pageCount;
+                }
+                continue;
+            }
+
+            allocatePage(pageX, pageY);
+            for (uint32_t y = 0; y < pageSize; ++y) {
+                std::memcpy(
+                    &page[y * pageSize * 4], &source[(pageX * pageSize + (pageY * pageSize + y) * size) * 4],
+                    pageSize * 4
+                );
+            }
+        }
+    }
+
+    auto last = static_cast<int32_t>(size) - 1;
+    updateTiles({ 0, 0 }, { last, last });
+}
+
+void SplatTiles::paint(const glm::vec2 &origin, float radius, int32_t material, float opacity, float hardness) {
+    if (material < 0 || material >= static_cast<int32_t>(MaterialCount) || radius <= 0) {
+        return;
+    }
+
+    // The shader runs over every pixel, only those within the radius change
+    auto last = static_cast<float>(size - 1);
+    glm::ivec2 minPixel {
+        static_cast<int32_t>(std::clamp(std::floor(origin.x - radius), 0.0f, last)),
+        static_cast<int32_t>(std::clamp(std::floor(origin.y - radius), 0.0f, last))
+    };
+    glm::ivec2 maxPixel {
+        static_cast<int32_t>(std::clamp(std::ceil(origin.x + radius), 0.0f, last)),
+        static_cast<int32_t>(std::clamp(std::ceil(origin.y + radius), 0.0f, last))
+    };
+    if (origin.x + radius < 0 || origin.y + radius < 0 || origin.x - radius > last || origin.y - radius > last) {
+        return;
+    }
+
+    for (auto y = minPixel.y / pageSize; y <= maxPixel.y / pageSize; ++y) {
+        for (auto x = minPixel.x / pageSize; x <= maxPixel.x / pageSize; ++x) {
+            allocatePage(x, y);
+        }
+    }
+
+    auto *target = MaterialTargets[material];
+    for (auto y = minPixel.y; y <= maxPixel.y; ++y) {
+        for (auto x = minPixel.x; x <= maxPixel.x; ++x) {
+            auto dist = glm::length(glm::vec2(x, y) - origin);
+            if (dist >= radius) {
+                continue;
+            }
+
+            float intensity;
+            if (hardness >= 1) {
+                intensity = 1;
+            } else {
+                auto relativeDist = dist / radius;
+                relativeDist = std::max(relativeDist - hardness, 0.0f) / (1 - hardness);
+
+                intensity = -std::pow(relativeDist, BrushFalloff) + 1;
+            }
+            intensity *= opacity;
+
+            auto *pixel = getPixel(x, y);
+            for (int channel = 0; channel < 4; ++channel) {
+                auto current = static_cast<float>(pixel[channel]) / 255;
+                auto goal = static_cast<float>(target[channel]) / 255;
+                auto value = current * (1 - intensity) + goal * intensity;
+                pixel[channel] = static_cast<uint8_t>(std::clamp(std::round(value * 255), 0.0f, 255.0f));
+            }
+        }
+    }
+
+    updateTiles(minPixel, maxPixel);
+}
+
+void SplatTiles::read(const glm::ivec2 &min, uint32_t width, uint32_t height, std::vector<uint8_t> &rgba) const {
+    rgba.resize(width * height * 4);
+
+    auto last = static_cast<int32_t>(size) - 1;
+    for (uint32_t y = 0; y < height; ++y) {
+        auto pixelY = static_cast<uint32_t>(std::clamp(min.y + static_cast<int32_t>(y), 0, last));
+        for (uint32_t x = 0; x < width; ++x) {
+            auto pixelX = static_cast<uint32_t>(std::clamp(min.x + static_cast<int32_t>(x), 0, last));
+
+            auto &page = pages[pixelX / pageSize + (pixelY / pageSize) * pagesPerSide];
+            const uint8_t *pixel = MaterialTargets[0];
+            if (!page.empty()) {
+                pixel = &page[((pixelX % pageSize) + (pixelY % pageSize) * pageSize) * 4];
+            }
+
+            std::memcpy(&rgba[(x + y * width) * 4], pixel, 4);
+        }
+    }
+}
+
+uint32_t SplatTiles::getMask(const glm::vec2 &min, const glm::vec2 &max) const {
+    auto last = static_cast<float>(tilesPerSide - 1);
+    auto scale = 1.0f / static_cast<float>(tileSize);
+    auto minTileX = static_cast<uint32_t>(std::clamp(std::floor(min.x * scale), 0.0f, last));
+    auto minTileY = static_cast<uint32_t>(std::clamp(std::floor(min.y * scale), 0.0f, last));
+    auto maxTileX = static_cast<uint32_t>(std::clamp(std::floor(max.x * scale), 0.0f, last));
+    auto maxTileY = static_cast<uint32_t>(std::clamp(std::floor(max.y * scale), 0.0f, last));
+
+    // Go up until the region covers at most 2x2 cells
+    uint32_t level = 0;
+    auto levelSize = tilesPerSide;
+    while (level + 1 < levels.size() && (maxTileX - minTileX > 1 || maxTileY - minTileY > 1)) {
+        minTileX >>= 1;
+        minTileY >>= 1;
+        maxTileX >>= 1;
+        maxTileY >>= 1;
+        levelSize = (levelSize + 1) / 2;
+        ++level;
+    }
+
+    uint32_t mask = 0;
+    for (auto y = minTileY; y <= maxTileY; ++y) {
+        for (auto x = minTileX; x <= maxTileX; ++x) {
+            mask |= levels[level][x + y * levelSize];
+        }
+    }
+
+    return mask;
+}
+
+float SplatTiles::getAverageMaterials() const {
+    size_t total = 0;
+    for (auto mask : levels[0]) {
+        total += std::bitset<MaterialCount>(mask).count();
+    }
+
+    return static_cast<float>(total) / static_cast<float>(levels[0].size());
+}
+
+void SplatTiles::updateTiles(const glm::ivec2 &minPixel, const glm::ivec2 &maxPixel) {
+    // Tiles include the pixel either side of them, which filtering blends in at their edges
+    auto last = static_cast<int32_t>(tilesPerSide - 1);
+    auto minTileX = std::clamp((minPixel.x - 1) / static_cast<int32_t>(tileSize), 0, last);
+    auto minTileY = std::clamp((minPixel.y - 1) / static_cast<int32_t>(tileSize), 0, last);
+    auto maxTileX = std::clamp((maxPixel.x + 1) / static_cast<int32_t>(tileSize), 0, last);
+    auto maxTileY = std::clamp((maxPixel.y + 1) / static_cast<int32_t>(tileSize), 0, last);
+
+    for (auto y = minTileY; y <= maxTileY; ++y) {
+        for (auto x = minTileX; x <= maxTileX; ++x) {
+            levels[0][x + y * tilesPerSide] = calculateTileMask(x, y);
+        }
+    }
+
+    // Then the levels above them
+    auto levelSize = static_cast<int32_t>(tilesPerSide);
+    for (size_t level = 1; level < levels.size(); ++level) {
+        auto parentSize = (levelSize + 1) / 2;
+        minTileX >>= 1;
+        minTileY >>= 1;
+        maxTileX >>= 1;
+        maxTileY >>= 1;
+
+        auto &children = levels[level - 1];
+        for (auto y = minTileY; y <= maxTileY; ++y) {
+            for (auto x = minTileX; x <= maxTileX; ++x) {
+                uint32_t mask = 0;
+                for (auto childY = y * 2; childY < std::min(y * 2 + 2, levelSize); ++childY) {
+                    for (auto childX = x * 2; childX < std::min(x * 2 + 2, levelSize); ++childX) {
+                        mask |= children[childX + childY * levelSize];
+                    }
+                }
+                levels[level][x + y * parentSize] = mask;
+            }
+        }
+
+        levelSize = parentSize;
+    }
+}
+
+std::vector<uint8_t> &SplatTiles::allocatePage(uint32_t x, uint32_t y) {
+    auto &page = pages[x + y * pagesPerSide];
+    if (page.empty()) {
+        page.resize(pageSize * pageSize * 4);
+        for (size_t pixel = 0; pixel < page.size(); pixel += 4) {
+            std::memcpy(&page[pixel], MaterialTargets[0], 4);
+        }
+        ++pageCount;
+    }
+
+    return page;
+}
+
+uint8_t *SplatTiles::getPixel(uint32_t x, uint32_t y) {
+    auto &page = pages[x / pageSize + (y / pageSize) * pagesPerSide];
+    return &page[((x % pageSize) + (y % pageSize) * pageSize) * 4];
+}
+
+uint32_t SplatTiles::calculateTileMask(uint32_t tileX, uint32_t tileY) const {
+    auto startX = tileX * tileSize;
+    auto startY = tileY * tileSize;
+    auto endX = std::min(startX + tileSize + 1, size);
+    auto endY = std::min(startY + tileSize + 1, size);
+    startX = startX > 0 ? startX - 1 : 0;
+    startY = startY > 0 ? startY - 1 : 0;
+
+    uint32_t mask = 0;
+    for (auto pageY = startY / pageSize; pageY <= (endY - 1) / pageSize; ++pageY) {
+        for (auto pageX = startX / pageSize; pageX <= (endX - 1) / pageSize; ++pageX) {
+            auto &page = pages[pageX + pageY * pagesPerSide];
+            if (page.empty()) {
+                mask |= 1;
+                continue;
+            }
+
+            auto minX = std::max(startX, pageX * pageSize) - pageX * pageSize;
+            auto minY = std::max(startY, pageY * pageSize) - pageY * pageSize;
+            auto maxX = std::min(endX, (pageX + 1) * pageSize) - pageX * pageSize;
+            auto maxY = std::min(endY, (pageY + 1) * pageSize) - pageY * pageSize;
+
+            for (auto y = minY; y < maxY; ++y) {
+                for (auto x = minX; x < maxX; ++x) {
+                    auto *pixel = &page[(x + y * pageSize) * 4];
+                    for (uint32_t channel = 0; channel < 4; ++channel) {
+                        if (pixel[channel] > 0) {
+                            mask |= 1 << channel;
+                        }
+                    }
+
+                    // The last material has whatever weight the channels leave, rounding can make that negative
+                    if (pixel[0] + pixel[1] + pixel[2] + pixel[3] != 255) {
+                        mask |= 1 << 4;
+                    }
+                }
+
+                if (mask == AllMaterials) {
+                    return mask;
+                }
+            }
+        }
+    }
+
+    return mask;
+}
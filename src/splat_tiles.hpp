@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+/**
+ * A CPU copy of the splat map which tracks the materials with any weight in each square tile of it, so the terrain
+ * shader only samples the materials that are there.
+ * Painting follows paintbrush.glsl, including storing 8 bits per channel, so the copy stays in step with the GPU.
+ * The first four materials are the channels of the splat map, the last takes whatever weight is left over.
+ *
+ * Pixels are kept in square pages which only exist once something is painted in them, the rest of the map is only
+ * the first material.
+ */
+class SplatTiles {
+public:
+    static const uint32_t MaterialCount = 5;
+    static const uint32_t AllMaterials = (1 << MaterialCount) - 1;
+
+    /**
+     * @param size Pixels along each side, a multiple of the page size
+     */
+    SplatTiles(uint32_t size, uint32_t tileSize, uint32_t pageSize);
+
+    uint32_t getSize() const { return size; }
+
+    uint32_t getTileSize() const { return tileSize; }
+
+    uint32_t getTilesPerSide() const { return tilesPerSide; }
+
+    uint32_t getPageSize() const { return pageSize; }
+
+    uint32_t getPagesPerSide() const { return pagesPerSide; }
+
+    bool hasPage(uint32_t x, uint32_t y) const { return !pages[x + y * pagesPerSide].empty(); }
+
+    uint32_t getPageCount() const { return pageCount; }
+
+    /**
+     * Sets every pixel to only the material
+     */
+    void fill(uint32_t material);
+    /**
+     * Replaces the copy with RGBA pixels read from a splat map of the same size
+     */
+    void load(const uint8_t *pixels);
+
+    void paint(const glm::vec2 &origin, float radius, int32_t material, float opacity, float hardness);
+
+    /**
+     * Copies RGBA pixels of a region, pixels past the edges repeat the edge
+     */
+    void read(const glm::ivec2 &min, uint32_t width, uint32_t height, std::vector<uint8_t> &rgba) const;
+
+    /**
+     * Bit per material with weight in the tile or the pixels around it which filtering can blend in
+     */
+    uint32_t getTileMask(uint32_t x, uint32_t y) const { return levels[0][x + y * tilesPerSide]; }
+
+    /**
+     * Bit per material which may have weight in the region, in splat map pixels.
+     * Large regions are answered from coarser levels so can include materials from just outside them.
+     */
+    uint32_t getMask(const glm::vec2 &min, const glm::vec2 &max) const;
+
+    /**
+     * Average number of materials in each tile
+     */
+    float getAverageMaterials() const;
+
+private:
+    uint32_t size;
+    uint32_t tileSize;
+    uint32_t tilesPerSide;
+    uint32_t pageSize;
+    uint32_t pagesPerSide;
+
+    // RGBA pixels of each page, empty until painted
+    std::vector<std::vector<uint8_t>> pages;
+    uint32_t pageCount { 0 };
+    // Tile masks, then each level combining 2x2 of the one before until a single mask covers everything
+    std::vector<std::vector<uint32_t>> levels;
+
+    std::vector<uint8_t> &allocatePage(uint32_t x, uint32_t y);
+    uint8_t *getPixel(uint32_t x, uint32_t y);
+
+    void updateTiles(const glm::ivec2 &minPixel, const glm::ivec2 &maxPixel);
+    uint32_t calculateTileMask(uint32_t x, uint32_t y) const;
+};
@@ -0,0 +1,175 @@
+#include "terrain_benchmark.hpp"
+#include <imgui.h>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+TerrainBenchmark::TerrainBenchmark(std::vector<Technique> techniques, const glm::vec2 &terrainSize)
+    : techniques(std::move(techniques)), terrainSize(terrainSize) {
+
+    paths.push_back(
+        {
+            "Orbit",
+            [](float progress, const glm::vec2 &size) {
+                return CameraPose { { 0, 0 }, 400, progress * 360.0f, -30.0f };
+            }
+        }
+    );
+    paths.push_back(
+        {
+            "Low flyover",
+            [](float progress, const glm::vec2 &size) {
+                auto start = size * -0.4f;
+                auto end = size * 0.4f;
+                return CameraPose { glm::mix(start, end, progress), 60, 45.0f, -15.0f };
+            }
+        }
+    );
+    paths.push_back(
+        {
+            "Zoom out",
+            [](float progress, const glm::vec2 &size) {
+                return CameraPose { { 0, 0 }, glm::mix(20.0f, 2000.0f, progress), 30.0f, -60.0f };
+            }
+        }
+    );
+}
+
+void TerrainBenchmark::start() {
+    if (techniques.empty()) {
+        return;
+    }
+
+    results.clear();
+    techniqueIndex = 0;
+    pathIndex = 0;
+    running = true;
+
+    beginRun();
+}
+
+void TerrainBenchmark::beginRun() {
+    for (uint32_t index = 0; index < techniques.size(); ++index) {
+        techniques[index].setEnabled(index == techniqueIndex);
+    }
+
+    frame = 0;
+    current = {};
+    current.technique = techniques[techniqueIndex].name;
+    current.path = paths[pathIndex].name;
+}
+
+void TerrainBenchmark::record(double frameTime) {
+    if (!running) {
+        return;
+    }
+
+    // The first frames after switching are skipped as they include rebuilding caches
+    if (frame > warmupFrames) {
+        auto &statistics = techniques[techniqueIndex].getStatistics();
+
+        ++current.frames;
+        current.averageFrameTime += frameTime;
+        current.averageSelectionTime += statistics.selectionTime;
+        current.maximumSelectionTime = std::max(current.maximumSelectionTime, statistics.selectionTime);
+        current.averageInstances += statistics.instances;
+        current.averageTriangles += static_cast<double>(statistics.triangles);
+        current.peakMemory = std::max(current.peakMemory, statistics.memoryUsage);
+        current.peakTextureMemory = std::max(current.peakTextureMemory, statistics.textureMemoryUsage);
+    }
+
+    if (frame >= framesPerPath + warmupFrames) {
+        finishRun();
+    }
+}
+
+void TerrainBenchmark::finishRun() {
+    if (current.frames > 0) {
+        current.averageFrameTime /= current.frames;
+        current.averageSelectionTime /= current.frames;
+        current.averageInstances /= current.frames;
+        current.averageTriangles /= current.frames;
+    }
+    results.push_back(current);
+
+    ++pathIndex;
+    if (pathIndex >= paths.size()) {
+        pathIndex = 0;
+        ++techniqueIndex;
+    }
+
+    if (techniqueIndex >= techniques.size()) {
+        running = false;
+        printResults();
+        return;
+    }
+
+    beginRun();
+}
+
+void TerrainBenchmark::update(OverheadCamera &camera, const std::function<float(float, float)> &heightAt) {
+    if (!running) {
+        return;
+    }
+
+    float progress = 0;
+    if (frame > warmupFrames) {
+        progress = static_cast<float>(frame - warmupFrames) / static_cast<float>(framesPerPath);
+    }
+
+    auto pose = paths[pathIndex].evaluate(std::min(progress, 1.0f), terrainSize);
+
+    auto height = heightAt(pose.target.x, pose.target.y);
+    if (!std::isnormal(height)) {
+        height = 0;
+    }
+
+    camera.setYaw(pose.yaw);
+    camera.setPitch(pose.pitch);
+    camera.setDistance(pose.distance);
+    camera.setTarget({ pose.target, height + 20 });
+
+    ++frame;
+}
+
+void TerrainBenchmark::drawGUI() {
+    if (running) {
+        ImGui::Text(
+            "Running %s - %s (%u / %u)", techniques[techniqueIndex].name, paths[pathIndex].name, frame,
+            framesPerPath + warmupFrames
+        );
+        return;
+    }
+
+    if (ImGui::Button("Run benchmark")) {
+        start();
+    }
+
+    for (auto &result : results) {
+        ImGui::Text(
+            "%s / %s: %.3fms frame, %.3fms select (max %.3fms), %.0f instances, %.0fk tris, %.1fMB + %.1fMB textures",
+            result.technique.c_str(), result.path.c_str(), result.averageFrameTime * 1000,
+            result.averageSelectionTime * 1000, result.maximumSelectionTime * 1000, result.averageInstances,
+            result.averageTriangles / 1000, static_cast<double>(result.peakMemory) / (1024 * 1024),
+            static_cast<double>(result.peakTextureMemory) / (1024 * 1024)
+        );
+    }
+}
+
+void TerrainBenchmark::printResults() const {
+    std::cout << "Terrain benchmark results" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+
+    for (auto &result : results) {
+        std::cout << " " << result.technique << " / " << result.path << std::endl;
+        std::cout << "  Frames: " << result.frames << std::endl;
+        std::cout << "  Frame time: " << result.averageFrameTime * 1000 << "ms" << std::endl;
+        std::cout << "  Selection time: " << result.averageSelectionTime * 1000 << "ms (max "
+                  << result.maximumSelectionTime * 1000 << "ms)" << std::endl;
+        std::cout << "  Instances: " << result.averageInstances << std::endl;
+        std::cout << "  Triangles: " << result.averageTriangles << std::endl;
+        std::cout << "  Memory: " << result.peakMemory << " bytes" << std::endl;
+        std::cout << "  Sampled textures: " << result.peakTextureMemory << " bytes" << std::endl;
+    }
+}
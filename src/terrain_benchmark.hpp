@@ -0,0 +1,88 @@
+#pragma once
+
+#include "terrain_statistics.hpp"
+#include "utils/overhead_camera.hpp"
+#include <glm/glm.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Flies the camera along a set of scripted paths once for each terrain algorithm and records the per frame
+ * statistics so the algorithms can be compared on the same map.
+ */
+class TerrainBenchmark {
+public:
+    struct Technique {
+        const char *name;
+        std::function<void(bool)> setEnabled;
+        std::function<const Terrain::FrameStatistics &()> getStatistics;
+    };
+
+    struct Result {
+        std::string technique;
+        std::string path;
+        uint32_t frames { 0 };
+        double averageFrameTime { 0 };
+        double averageSelectionTime { 0 };
+        double maximumSelectionTime { 0 };
+        double averageInstances { 0 };
+        double averageTriangles { 0 };
+        size_t peakMemory { 0 };
+        size_t peakTextureMemory { 0 };
+    };
+
+    TerrainBenchmark(std::vector<Technique> techniques, const glm::vec2 &terrainSize);
+
+    void start();
+
+    bool isRunning() const { return running; }
+
+    /**
+     * Records the statistics of the previous frame.
+     * @param frameTime The time the previous frame took in seconds
+     */
+    void record(double frameTime);
+
+    /**
+     * Positions the camera for the next frame along the active path.
+     * @param heightAt Returns the terrain height at the world coordinates
+     */
+    void update(OverheadCamera &camera, const std::function<float(float, float)> &heightAt);
+
+    const std::vector<Result> &getResults() const { return results; }
+
+    void drawGUI();
+
+private:
+    struct CameraPose {
+        glm::vec2 target;
+        float distance;
+        float yaw;
+        float pitch;
+    };
+
+    struct Path {
+        const char *name;
+        std::function<CameraPose(float progress, const glm::vec2 &terrainSize)> evaluate;
+    };
+
+    std::vector<Technique> techniques;
+    std::vector<Path> paths;
+    glm::vec2 terrainSize;
+
+    uint32_t framesPerPath { 600 };
+    uint32_t warmupFrames { 10 };
+
+    bool running { false };
+    uint32_t techniqueIndex { 0 };
+    uint32_t pathIndex { 0 };
+    uint32_t frame { 0 };
+
+    Result current;
+    std::vector<Result> results;
+
+    void beginRun();
+    void finishRun();
+    void printResults() const;
+};
@@ -1,53 +1,31 @@
 #include "terrain_painter.hpp"
 #include <tech-core/texture/common.hpp>
 #include <glm/glm.hpp>
-#include <iostream>
+#include <algorithm>
+#include <cmath>
 #include <imgui.h>
 
+// Keeps the atlas within the 16384 texel images most devices allow
+const uint32_t MaxAtlasPagesPerSide = 16384 / TerrainPainter::PageStride;
+
 struct BrushUniform {
     glm::vec2 origin;
     float radius;
     int32_t texture;
     float opacity;
     float hardness;
+    // Splat map texel at the top left of the page border
+    glm::ivec2 pageTexel;
+    // Atlas texel at the top left of the page border
+    glm::ivec2 atlasTexel;
+    int32_t mapSize;
 };
 
-TerrainPainter::TerrainPainter(Engine::RenderEngine &engine) : engine(engine) {
+TerrainPainter::TerrainPainter(Engine::RenderEngine &engine, float texelsPerUnit)
+    : engine(engine), texelsPerUnit(texelsPerUnit) {
 
 }
 
-void TerrainPainter::initialize() {
-    splatMap = engine.createImage(imageSize, imageSize)
-        .withFormat(vk::Format::eR8G8B8A8Unorm)
-        .withUsage(
-            vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled
-        )
-        .withMemoryUsage(vk::MemoryUsage::eGPUOnly)
-            // .withMipLevels() // TODO: This should make it automatic based on size
-        .build();
-
-    paintBrush = engine.createComputeTask()
-        .fromFile("assets/shaders/compute/painting/paintbrush.spv")
-        .withStorageImage(0, Engine::UsageType::Output, splatMap)
-        .withPushConstant<BrushUniform>()
-        .withWorkgroups(16, 16)
-        .build();
-
-    auto task = engine.getTaskManager().createTask();
-    task->execute(
-        [this](vk::CommandBuffer buffer) {
-            splatMap->transition(buffer, vk::ImageLayout::eTransferDstOptimal);
-
-            vk::ClearColorValue clearTo(std::array<float, 4> { 1.0f, 0.0f, 0.0f, 0.0f });
-            vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
-            buffer.clearColorImage(splatMap->image(), vk::ImageLayout::eTransferDstOptimal, &clearTo, 1, &range);
-            splatMap->transition(buffer, vk::ImageLayout::eGeneral);
-        }
-    );
-
-    engine.getTaskManager().submitTask(std::move(task));
-}
-
 void TerrainPainter::setTextures(const std::vector<const Engine::Texture *> &paintTextures) {
     // Validate that all textures are usable. Unfortunately we have these requirements:
     // - All textures must exist in same array
@@ -82,24 +60,183 @@ void TerrainPainter::setTextures(const std::vector<const Engine::Texture *> &pai
 
 void
 TerrainPainter::paint(const glm::vec2 &origin, float radius, int texturePlaceholder, float opacity, float hardness) {
+    if (!splatTiles) {
+        return;
+    }
+
     auto transformedOrigin = (origin + offset) * scale;
     auto transformedRadius = radius * scale.x;
 
-    paintBrush->execute(
-        BrushUniform { transformedOrigin, transformedRadius, texturePlaceholder, opacity, hardness }, imageSize,
-        imageSize
-    );
+    // Every page with a texel the brush can reach, including through the borders shared with neighbouring pages
+    auto mapSize = static_cast<float>(splatTiles->getSize());
+    if (transformedOrigin.x + transformedRadius < -1 || transformedOrigin.y + transformedRadius < -1 ||
+        transformedOrigin.x - transformedRadius > mapSize || transformedOrigin.y - transformedRadius > mapSize) {
+        return;
+    }
+
+    auto lastPage = static_cast<float>(pagesPerSide - 1);
+    auto pageScale = 1.0f / static_cast<float>(PageSize);
+    auto toPage = [lastPage, pageScale](float texel) {
+        return static_cast<uint32_t>(std::clamp(std::floor(texel * pageScale), 0.0f, lastPage));
+    };
+    glm::uvec2 minPage {
+        toPage(transformedOrigin.x - transformedRadius - 1), toPage(transformedOrigin.y - transformedRadius - 1)
+    };
+    glm::uvec2 maxPage {
+        toPage(transformedOrigin.x + transformedRadius + 1), toPage(transformedOrigin.y + transformedRadius + 1)
+    };
+
+    uint32_t newPages = 0;
+    for (auto y = minPage.y; y <= maxPage.y; ++y) {
+        for (auto x = minPage.x; x <= maxPage.x; ++x) {
+            if (pageSlots[x + y * pagesPerSide] == 0) {
+                ++newPages;
+            }
+        }
+    }
+
+    // Painting only part of the brush would leave the CPU copy out of step
+    if (usedSlots + newPages > atlasPagesPerSide * atlasPagesPerSide) {
+        atlasFull = true;
+        return;
+    }
+
+    if (newPages > 0) {
+        for (auto y = minPage.y; y <= maxPage.y; ++y) {
+            for (auto x = minPage.x; x <= maxPage.x; ++x) {
+                auto &slot = pageSlots[x + y * pagesPerSide];
+                if (slot == 0) {
+                    slot = ++usedSlots;
+                }
+            }
+        }
+
+        uploadPageTable();
+    }
+
+    auto dispatchSize = (PageStride + 15) / 16 * 16;
+    for (auto y = minPage.y; y <= maxPage.y; ++y) {
+        for (auto x = minPage.x; x <= maxPage.x; ++x) {
+            auto slot = static_cast<uint32_t>(pageSlots[x + y * pagesPerSide] - 1);
+            glm::ivec2 pageTexel {
+                static_cast<int32_t>(x * PageSize) - 1,
+                static_cast<int32_t>(y * PageSize) - 1
+            };
+            glm::ivec2 atlasTexel {
+                static_cast<int32_t>((slot % atlasPagesPerSide) * PageStride),
+                static_cast<int32_t>((slot / atlasPagesPerSide) * PageStride)
+            };
+
+            paintBrush->execute(
+                BrushUniform {
+                    transformedOrigin, transformedRadius, texturePlaceholder, opacity, hardness, pageTexel, atlasTexel,
+                    static_cast<int32_t>(splatTiles->getSize())
+                },
+                dispatchSize,
+                dispatchSize
+            );
+        }
+    }
+
+    splatTiles->paint(transformedOrigin, transformedRadius, texturePlaceholder, opacity, hardness);
+    history.add(origin - radius, origin + radius);
 }
 
 void TerrainPainter::paint(const glm::vec2 &origin) {
     paint(origin, activeRadius, activeBrushTexture, activeOpacity, activeHardness);
 }
 
+uint32_t TerrainPainter::getMaterialMask(const glm::vec2 &worldMin, const glm::vec2 &worldMax) const {
+    if (!splatTiles) {
+        return SplatTiles::AllMaterials;
+    }
+
+    return splatTiles->getMask((worldMin + offset) * scale, (worldMax + offset) * scale);
+}
+
 void TerrainPainter::setWorldSize(const glm::vec2 &size) {
-    scale = { imageSize / size.x, imageSize / size.y };
+    pagesPerSide = static_cast<uint32_t>(std::ceil(std::max(size.x, size.y) * texelsPerUnit / PageSize));
+    pagesPerSide = std::max(pagesPerSide, 1u);
+    scale = { texelsPerUnit, texelsPerUnit };
     offset = size / 2.0f;
+
+    // Only worlds too big for one image can run out of room
+    atlasPagesPerSide = std::min(pagesPerSide, MaxAtlasPagesPerSide);
+    splatAtlas = engine.createImage(atlasPagesPerSide * PageStride, atlasPagesPerSide * PageStride)
+        .withFormat(vk::Format::eR8G8B8A8Unorm)
+        .withUsage(
+            vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled
+        )
+        .withMemoryUsage(vk::MemoryUsage::eGPUOnly)
+        .build();
+
+    paintBrush = engine.createComputeTask()
+        .fromFile("assets/shaders/compute/painting/paintbrush.spv")
+        .withStorageImage(0, Engine::UsageType::InputOutput, splatAtlas)
+        .withPushConstant<BrushUniform>()
+        .withWorkgroups(16, 16)
+        .build();
+
+    pageTable = engine.createImage(pagesPerSide, pagesPerSide)
+        .withFormat(vk::Format::eR16Uint)
+        .withUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled)
+        .withMemoryUsage(vk::MemoryUsage::eGPUOnly)
+        .withDestinationStage(vk::PipelineStageFlagBits::eFragmentShader)
+        .build();
+
+    splatTiles = std::make_unique<SplatTiles>(pagesPerSide * PageSize, SplatTileSize, PageSize);
+    clearPages();
+
+    // Everything painted is gone
+    history.reset();
 }
 
-void TerrainPainter::drawGui() {
+void TerrainPainter::clearPages() {
+    pageSlots.assign(pagesPerSide * pagesPerSide, 0);
+    usedSlots = 0;
+    atlasFull = false;
+
+    auto task = engine.getTaskManager().createTask();
+    task->execute(
+        [this](vk::CommandBuffer buffer) {
+            vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+
+            splatAtlas->transition(buffer, vk::ImageLayout::eTransferDstOptimal);
+            vk::ClearColorValue clearAtlas(std::array<float, 4> { 1.0f, 0.0f, 0.0f, 0.0f });
+            buffer.clearColorImage(splatAtlas->image(), vk::ImageLayout::eTransferDstOptimal, &clearAtlas, 1, &range);
+            splatAtlas->transition(buffer, vk::ImageLayout::eGeneral);
+
+            pageTable->transition(buffer, vk::ImageLayout::eTransferDstOptimal);
+            vk::ClearColorValue clearTable(std::array<uint32_t, 4> { 0, 0, 0, 0 });
+            buffer.clearColorImage(pageTable->image(), vk::ImageLayout::eTransferDstOptimal, &clearTable, 1, &range);
+            pageTable->transition(buffer, vk::ImageLayout::eGeneral);
+        }
+    );
+
+    engine.getTaskManager().submitTask(std::move(task));
+}
+
+void TerrainPainter::uploadPageTable() {
+    auto task = engine.getTaskManager().createTask();
+    auto stagingBuffer = engine.getBufferManager().aquireStaging(pageSlots.size() * sizeof(uint16_t));
+    stagingBuffer->copyIn(pageSlots.data());
+
+    task->execute(
+        [this, &stagingBuffer](vk::CommandBuffer buffer) {
+            pageTable->transition(buffer, vk::ImageLayout::eTransferDstOptimal);
+            pageTable->transferIn(buffer, *stagingBuffer);
+            pageTable->transition(buffer, vk::ImageLayout::eGeneral);
+        }
+    );
+
+    task->freeWhenDone(std::move(stagingBuffer));
 
+    engine.getTaskManager().submitTask(std::move(task));
+}
+
+void TerrainPainter::drawGui() {
+    ImGui::Text("Splat pages: %u of %u", usedSlots, atlasPagesPerSide * atlasPagesPerSide);
+    if (atlasFull) {
+        ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), "The splat atlas is full, nothing more can be painted");
+    }
 }
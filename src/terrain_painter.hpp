@@ -5,23 +5,72 @@
 #include <tech-core/compute.hpp>
 #include <glm/fwd.hpp>
 #include <glm/vec2.hpp>
+#include "splat_tiles.hpp"
+#include "utils/change_history.hpp"
 
+/**
+ * Paints textures onto the terrain through a splat map.
+ * The splat map is split into pages which only get space in the atlas image once painted, pages without space are
+ * all the first texture. The page table image holds the atlas slot + 1 of each page, or 0 when it has none.
+ * The atlas is sized for every page of the world, up to the largest image most devices allow.
+ * Pages are stored in the atlas with a 1 texel border copied from their neighbours, so filtering works within a page.
+ */
 class TerrainPainter {
 public:
-    explicit TerrainPainter(Engine::RenderEngine &);
-    void initialize();
+    static const uint32_t SplatTileSize = 32;
+    // Texels along each side of a page, not counting the border
+    static const uint32_t PageSize = 128;
+    static const uint32_t PageStride = PageSize + 2;
+
+    /**
+     * @param texelsPerUnit Splat map texels along each world unit
+     */
+    explicit TerrainPainter(Engine::RenderEngine &, float texelsPerUnit = 1);
     void setTextures(const std::vector<const Engine::Texture *> &);
 
     uint32_t getTextureCount() const { return 5; }
 
     uint32_t getBrushTexture() const { return activeBrushTexture; }
 
+    /**
+     * Sizes the splat map and atlas to cover the world, removing everything painted.
+     * Must be set before the painter is given to a terrain renderer as that binds the page table and atlas.
+     */
     void setWorldSize(const glm::vec2 &size);
 
     void paint(const glm::vec2 &origin, float radius, int texturePlaceholder, float opacity = 1, float hardness = 1);
     void paint(const glm::vec2 &origin);
 
-    std::shared_ptr<Engine::Image> getSplatMap() const { return splatMap; };
+    std::shared_ptr<Engine::Image> getSplatAtlas() const { return splatAtlas; };
+
+    std::shared_ptr<Engine::Image> getPageTable() const { return pageTable; };
+
+    /**
+     * Splat map texel coordinates are (world + offset) * scale
+     */
+    const glm::vec2 &getSplatOffset() const { return offset; }
+
+    const glm::vec2 &getSplatScale() const { return scale; }
+
+    /**
+     * Increases every time something is painted
+     */
+    uint32_t getVersion() const { return history.getVersion(); }
+
+    /**
+     * Finds the world region painted after the given version.
+     * @return false when the changes are too old to be known, everything has to be assumed changed
+     */
+    bool getChangedSince(uint32_t sinceVersion, glm::vec2 &min, glm::vec2 &max) const {
+        return history.getChangedSince(sinceVersion, min, max);
+    }
+
+    /**
+     * Bit per texture which may show anywhere in the world region
+     */
+    uint32_t getMaterialMask(const glm::vec2 &worldMin, const glm::vec2 &worldMax) const;
+
+    const SplatTiles &getSplatTiles() const { return *splatTiles; }
 
     const std::vector<const Engine::Texture *> &getTextures() const { return textures; }
 
@@ -34,14 +83,27 @@ private:
     float activeOpacity { 1 };
     float activeHardness { 1 };
 
-    uint32_t imageSize { 1024 };
-    std::shared_ptr<Engine::Image> splatMap;
+    float texelsPerUnit;
+    // The atlas holds the square of this many pages
+    uint32_t atlasPagesPerSide { 0 };
+    uint32_t pagesPerSide { 0 };
+    std::shared_ptr<Engine::Image> splatAtlas;
+    std::shared_ptr<Engine::Image> pageTable;
     std::unique_ptr<Engine::ComputeTask> paintBrush;
+    std::unique_ptr<SplatTiles> splatTiles;
     glm::vec2 scale { 1, 1 };
     glm::vec2 offset;
 
-    std::vector<const Engine::Texture *> textures;
-};
+    // Atlas slot + 1 of each page, matching the page table image
+    std::vector<uint16_t> pageSlots;
+    uint32_t usedSlots { 0 };
+    // Set when a paint did not fit, shown in the GUI
+    bool atlasFull { false };
 
+    std::vector<const Engine::Texture *> textures;
 
+    ChangeHistory<glm::vec2> history;
 
+    void clearPages();
+    void uploadPageTable();
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace Terrain {
+
+/**
+ * Per frame figures reported by each terrain algorithm so they can be compared against each other.
+ */
+struct FrameStatistics {
+    // CPU time spent selecting and writing out the tiles for the frame, in seconds
+    double selectionTime { 0 };
+    uint32_t instances { 0 };
+    uint64_t triangles { 0 };
+    // Approximate amount of memory held by the algorithm for meshes, instances and caches
+    size_t memoryUsage { 0 };
+    // Textures sampled while drawing which the algorithm does not hold itself, such as the full heightmap
+    size_t textureMemoryUsage { 0 };
+};
+
+}
@@ -1,11 +1,51 @@
 #include "event.hpp"
 #include "../cdlod/terrain_manager.hpp"
 
+TerrainRaycastCache::TerrainRaycastCache(
+    const Terrain::CDLOD::TerrainManager &terrain, const Heightmap &heightmap
+) : terrain(terrain), heightmap(heightmap), ray(std::make_unique<Terrain::CDLOD::TerrainRaycast>()) {
+
+}
+
+TerrainRaycastCache::~TerrainRaycastCache() = default;
+
+std::optional<glm::vec3> TerrainRaycastCache::raycast(const glm::vec3 &origin, const glm::vec3 &direction) {
+    if (!hasResult || ray->origin != origin || ray->direction != direction) {
+        ray->origin = origin;
+        ray->direction = direction;
+        terrain.raycastTerrain(*ray);
+
+        hasResult = true;
+        heightmapVersion = heightmap.getVersion();
+        ++fullCount;
+        return ray->hit;
+    }
+
+    if (heightmapVersion != heightmap.getVersion()) {
+        glm::ivec2 changedMin, changedMax;
+        if (heightmap.getChangedSince(heightmapVersion, changedMin, changedMax)) {
+            if (terrain.updateRaycast(*ray, changedMin, changedMax)) {
+                ++partialCount;
+            } else {
+                ++reusedCount;
+            }
+        } else {
+            terrain.raycastTerrain(*ray);
+            ++fullCount;
+        }
+
+        heightmapVersion = heightmap.getVersion();
+        return ray->hit;
+    }
+
+    ++reusedCount;
+    return ray->hit;
+}
+
 ToolMouseEvent::ToolMouseEvent(
-    MouseButton button, Engine::InputManager &input, const Engine::Camera &camera,
-    const Terrain::CDLOD::TerrainManager &terrain,
+    MouseButton button, Engine::InputManager &input, const Engine::Camera &camera, TerrainRaycastCache &terrain,
     glm::vec2 screenCoords
-) : input(input), button(button), screenCoords(screenCoords) {
+) : input(input), camera(camera), terrain(terrain), button(button), screenCoords(screenCoords) {
 
     left = input.isPressed(Engine::Key::eMouseLeft);
     right = input.isPressed(Engine::Key::eMouseRight);
@@ -14,20 +54,30 @@ ToolMouseEvent::ToolMouseEvent(
     shift = input.isPressed(Engine::Key::eLeftShift) || input.isPressed(Engine::Key::eRightShift);
     control = input.isPressed(Engine::Key::eLeftControl) || input.isPressed(Engine::Key::eRightControl);
     alt = input.isPressed(Engine::Key::eLeftAlt) || input.isPressed(Engine::Key::eRightAlt);
-
-    camera.rayFromCoord(screenCoords, worldPos, worldDir);
-    terrainWorldPos = terrain.raycastTerrain(worldPos, worldDir);
 }
 
+void ToolMouseEvent::resolveRay() const {
+    if (!hasRay) {
+        camera.rayFromCoord(screenCoords, worldPos, worldDir);
+        hasRay = true;
+    }
+}
 
 glm::vec2 ToolMouseEvent::getScreenCoords() const {
     return screenCoords;
 }
 
 glm::vec3 ToolMouseEvent::getWorldCoords() const {
+    resolveRay();
     return worldPos;
 }
 
 std::optional<glm::vec3> ToolMouseEvent::getWorldCoordsAtTerrain() const {
+    if (!hasTerrainPos) {
+        resolveRay();
+        terrainWorldPos = terrain.raycast(worldPos, worldDir);
+        hasTerrainPos = true;
+    }
+
     return terrainWorldPos;
 }
@@ -2,11 +2,46 @@
 
 #include <tech-core/inputmanager.hpp>
 #include <tech-core/camera.hpp>
+#include <memory>
 
 // Forward
 namespace Terrain::CDLOD {
 class TerrainManager;
+struct TerrainRaycast;
 }
+class Heightmap;
+
+/**
+ * Remembers the last terrain raycast so that every event in a frame, and every frame where neither the ray nor the
+ * heightmap changed, share one result.
+ * When only the heightmap changed, just the part of the ray which crosses the change is marched again.
+ */
+class TerrainRaycastCache {
+public:
+    TerrainRaycastCache(const Terrain::CDLOD::TerrainManager &terrain, const Heightmap &heightmap);
+    ~TerrainRaycastCache();
+
+    std::optional<glm::vec3> raycast(const glm::vec3 &origin, const glm::vec3 &direction);
+
+    // Statistics
+    uint32_t getFullCount() const { return fullCount; }
+
+    uint32_t getPartialCount() const { return partialCount; }
+
+    uint32_t getReusedCount() const { return reusedCount; }
+
+private:
+    const Terrain::CDLOD::TerrainManager &terrain;
+    const Heightmap &heightmap;
+
+    bool hasResult { false };
+    uint32_t heightmapVersion { 0 };
+    std::unique_ptr<Terrain::CDLOD::TerrainRaycast> ray;
+
+    uint32_t fullCount { 0 };
+    uint32_t partialCount { 0 };
+    uint32_t reusedCount { 0 };
+};
 
 enum class MouseButton {
     None,
@@ -18,8 +53,7 @@ enum class MouseButton {
 class ToolMouseEvent {
 public:
     ToolMouseEvent(
-        MouseButton button, Engine::InputManager &input, const Engine::Camera &camera,
-        const Terrain::CDLOD::TerrainManager &terrain,
+        MouseButton button, Engine::InputManager &input, const Engine::Camera &camera, TerrainRaycastCache &terrain,
         glm::vec2 screenCoords
     );
 
@@ -44,10 +78,17 @@ public:
 
 private:
     Engine::InputManager &input;
+    const Engine::Camera &camera;
+    TerrainRaycastCache &terrain;
 
     glm::vec2 screenCoords;
-    glm::vec3 worldPos;
-    glm::vec3 worldDir;
-    std::optional<glm::vec3> terrainWorldPos;
-    std::optional<glm::vec2> terrainSurfacePos;
+
+    // Resolved when first asked for, most tools never need the terrain
+    mutable bool hasRay { false };
+    mutable glm::vec3 worldPos;
+    mutable glm::vec3 worldDir;
+    mutable bool hasTerrainPos { false };
+    mutable std::optional<glm::vec3> terrainWorldPos;
+
+    void resolveRay() const;
 };
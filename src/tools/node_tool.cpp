@@ -7,6 +7,9 @@
 #include <imgui.h>
 #include <unordered_set>
 
+// How far from the cursor nodes and edges are highlighted
+const float NearbyDistance = 20;
+
 NodeTool::NodeTool(Vector::VectorGraphics &vectorRenderer, Nodes::Graph &graph)
     : vectorRenderer(vectorRenderer), graph(graph) {
 
@@ -22,14 +25,16 @@ void NodeTool::onMouseDown(const ToolMouseEvent &event) {
             if (state == State::Idle) {
                 startNode = graph.getNodeAt(*coords);
                 if (!startNode) {
-                    startNode = std::make_shared<Nodes::Node>(*coords);
+                    // Not added to the graph until the edge is placed
+                    startPosition = *coords;
                     isNewStartNode = true;
                 } else {
+                    startPosition = graph.getNode(startNode)->getPosition();
                     isNewStartNode = false;
                 }
 
-                glm::vec2 node2dCoord { startNode->getPosition().x, startNode->getPosition().y };
-                startMarker = vectorRenderer.addObject<Vector::Circle>(node2dCoord, startNode->getRoughRadius());
+                glm::vec2 node2dCoord { startPosition.x, startPosition.y };
+                startMarker = vectorRenderer.addObject<Vector::Circle>(node2dCoord, getStartRadius());
                 Theme::normal(*startMarker);
 
                 autoMidpoint = false;
@@ -53,7 +58,7 @@ void NodeTool::onMouseDown(const ToolMouseEvent &event) {
                 vectorRenderer.removeObject(edgeMarker);
 
                 edgeMarker = vectorRenderer.addObject<Vector::BezierCurve>(
-                    glm::vec2 { startNode->getPosition().x, startNode->getPosition().y },
+                    glm::vec2 { startPosition.x, startPosition.y },
                     *midpoint,
                     *midpoint,
                     edgeWidth
@@ -62,23 +67,18 @@ void NodeTool::onMouseDown(const ToolMouseEvent &event) {
 
                 updateMarkers();
             } else if (state == State::PlacingEnd) {
-                bool isNewEndNode;
-                std::shared_ptr<Nodes::Node> endNode;
-
-                endNode = graph.getNodeAt(*coords);
-                if (endNode) {
-                    isNewEndNode = false;
-                } else {
-                    endNode = std::make_shared<Nodes::Node>(*coords);
-                    isNewEndNode = true;
+                auto endNode = graph.getNodeAt(*coords);
+                if (endNode && endNode == startNode) {
+                    // Edges cannot loop back to the node they start from
+                    return;
                 }
 
                 if (isNewStartNode) {
-                    graph.addNode(startNode);
+                    startNode = graph.addNode(startPosition);
                 }
 
-                if (isNewEndNode) {
-                    graph.addNode(endNode);
+                if (!endNode) {
+                    endNode = graph.addNode(*coords);
                 }
 
                 if (midpoint) {
@@ -89,8 +89,7 @@ void NodeTool::onMouseDown(const ToolMouseEvent &event) {
                     graph.link(startNode, endNode, edgeWidth);
 
                     previousSegmentDirection = glm::normalize(
-                        glm::vec2 { coords->x, coords->y } -
-                            glm::vec2(startNode->getPosition().x, startNode->getPosition().y)
+                        glm::vec2 { coords->x, coords->y } - glm::vec2(startPosition.x, startPosition.y)
                     );
                 }
 
@@ -99,9 +98,10 @@ void NodeTool::onMouseDown(const ToolMouseEvent &event) {
 
                 // Now allow chaining
                 startNode = endNode;
+                startPosition = graph.getNode(startNode)->getPosition();
                 isNewStartNode = false;
-                glm::vec2 node2dCoord { startNode->getPosition().x, startNode->getPosition().y };
-                startMarker = vectorRenderer.addObject<Vector::Circle>(node2dCoord, startNode->getRoughRadius());
+                glm::vec2 node2dCoord { startPosition.x, startPosition.y };
+                startMarker = vectorRenderer.addObject<Vector::Circle>(node2dCoord, getStartRadius());
                 Theme::normal(*startMarker);
 
                 autoMidpoint = false;
@@ -116,10 +116,10 @@ void NodeTool::onMouseDown(const ToolMouseEvent &event) {
                 } else if (edgeMode == EdgeMode::Curve) {
                     autoMidpoint = true;
                     state = State::PlacingEnd;
-                    midpoint = { startNode->getPosition().x, startNode->getPosition().y };
+                    midpoint = { startPosition.x, startPosition.y };
 
                     edgeMarker = vectorRenderer.addObject<Vector::BezierCurve>(
-                        glm::vec2 { startNode->getPosition().x, startNode->getPosition().y },
+                        glm::vec2 { startPosition.x, startPosition.y },
                         *midpoint,
                         *midpoint,
                         edgeWidth
@@ -135,11 +135,11 @@ void NodeTool::onMouseDown(const ToolMouseEvent &event) {
                     state = State::PlacingMidpoint;
                     clearMarkers();
 
-                    glm::vec2 start { startNode->getPosition().x, startNode->getPosition().y };
+                    glm::vec2 start { startPosition.x, startPosition.y };
                     edgeMarker = vectorRenderer.addObject<Vector::Line>(start, start, edgeWidth);
                     Theme::informational(*edgeMarker);
 
-                    startMarker = vectorRenderer.addObject<Vector::Circle>(start, startNode->getRoughRadius());
+                    startMarker = vectorRenderer.addObject<Vector::Circle>(start, getStartRadius());
                     Theme::normal(*startMarker);
                     return;
                 }
@@ -177,7 +177,7 @@ void NodeTool::onMouseMove(const ToolMouseEvent &event, double delta) {
     }
 
     if (mode == ToolMode::Place) {
-        if (!startNode) {
+        if (state == State::Idle) {
             return;
         }
 
@@ -197,16 +197,18 @@ void NodeTool::onMouseMove(const ToolMouseEvent &event, double delta) {
                 auto edge = std::static_pointer_cast<Vector::Line>(edgeMarker);
                 edge->setEnd({ coords->x, coords->y });
             }
+
+            updateCrossingMarkers({ coords->x, coords->y });
         }
 
         updateMarkers();
     } else if (mode == ToolMode::Move) {
         if (event.left) {
             if (startNode) {
-                startNode->setPosition(*coords);
-                auto it = nearbyNodeMarkers.find(startNode.get());
+                graph.moveNode(startNode, *coords);
+                auto it = nearbyNodeMarkers.find(startNode);
                 if (it != nearbyNodeMarkers.end()) {
-                    it->second->setOrigin(startNode->getPosition());
+                    it->second->setOrigin(*coords);
                 }
             }
         }
@@ -215,7 +217,7 @@ void NodeTool::onMouseMove(const ToolMouseEvent &event, double delta) {
 
 void NodeTool::onMouseUp(const ToolMouseEvent &event) {
     if (mode == ToolMode::Move && event.button == MouseButton::Left) {
-        startNode.reset();
+        startNode = {};
     }
 }
 
@@ -260,7 +262,7 @@ void NodeTool::drawToolbarTab() {
 void NodeTool::updateMarkers() {
     if (midpoint) {
         // Which direction does it bend?
-        glm::vec2 start { startNode->getPosition().x, startNode->getPosition().y };
+        glm::vec2 start { startPosition.x, startPosition.y };
         glm::vec2 mid = *midpoint;
         glm::vec2 end = std::static_pointer_cast<Vector::BezierCurve>(edgeMarker)->getEnd();
 
@@ -332,7 +334,7 @@ void NodeTool::cancelPlacement() {
     state = State::Idle;
     midpoint = {};
     isNewStartNode = false;
-    startNode.reset();
+    startNode = {};
 
     clearMarkers();
 }
@@ -362,6 +364,8 @@ void NodeTool::clearMarkers() {
         vectorRenderer.removeObject(midMarker.curve);
         midMarker.curve.reset();
     }
+
+    clearCrossingMarkers();
 }
 
 void NodeTool::onDeactivate() {
@@ -370,7 +374,7 @@ void NodeTool::onDeactivate() {
 }
 
 glm::vec2 NodeTool::calculateMidpoint(const glm::vec2 &end) {
-    glm::vec2 start { startNode->getPosition() };
+    glm::vec2 start { startPosition };
     glm::vec2 startToEndNormal = glm::normalize(end - start);
     startToEndNormal = { startToEndNormal.y, -startToEndNormal.x };
 
@@ -390,28 +394,65 @@ glm::vec2 NodeTool::calculateMidpoint(const glm::vec2 &end) {
     return start;
 }
 
+float NodeTool::getStartRadius() const {
+    if (isNewStartNode) {
+        return Nodes::Node::DefaultRadius;
+    }
+
+    return graph.getNode(startNode)->getRoughRadius();
+}
+
 void NodeTool::updateNearbyMarkers(const glm::vec3 &position, bool allowEdges) {
     updateNearbyNodeMarkers(position);
+
+    // Nodes take priority over the edges they are attached to
+    if (allowEdges && !graph.getNodeAt(position)) {
+        updateNearbyEdgeMarker(position);
+    } else if (nearbyEdgeMarker) {
+        vectorRenderer.removeObject(nearbyEdgeMarker);
+        nearbyEdgeMarker.reset();
+    }
+}
+
+void NodeTool::updateNearbyEdgeMarker(const glm::vec3 &position) {
+    auto hit = graph.getEdgeNear(position, NearbyDistance);
+    if (!hit) {
+        if (nearbyEdgeMarker) {
+            vectorRenderer.removeObject(nearbyEdgeMarker);
+            nearbyEdgeMarker.reset();
+        }
+        return;
+    }
+
+    auto radius = graph.getEdge(hit->edge)->getWidth() / 2;
+    if (!nearbyEdgeMarker) {
+        nearbyEdgeMarker = vectorRenderer.addObject<Vector::Circle>(hit->point, radius);
+        Theme::informational(*nearbyEdgeMarker);
+    } else {
+        nearbyEdgeMarker->setOrigin(hit->point);
+        nearbyEdgeMarker->setRadius(radius);
+    }
 }
 
 void NodeTool::updateNearbyNodeMarkers(const glm::vec3 &position) {
-    std::vector<std::shared_ptr<Nodes::Node>> nearby;
+    std::vector<Nodes::NodeId> nearby;
 
-    graph.getNodesWithin(position, 20, nearby);
+    graph.getNodesWithin(position, NearbyDistance, nearby);
 
-    std::unordered_set<const Nodes::Node *> unvisitedNodes(nearbyNodeMarkers.size());
+    std::unordered_set<Nodes::NodeId> unvisitedNodes(nearbyNodeMarkers.size());
     for (auto &pair : nearbyNodeMarkers) {
         unvisitedNodes.insert(pair.first);
     }
 
-    for (auto &node : nearby) {
-        unvisitedNodes.erase(node.get());
+    for (auto id : nearby) {
+        unvisitedNodes.erase(id);
 
-        auto it = nearbyNodeMarkers.find(node.get());
+        auto it = nearbyNodeMarkers.find(id);
         if (it == nearbyNodeMarkers.end()) {
+            auto *node = graph.getNode(id);
             auto marker = vectorRenderer.addObject<Vector::Circle>(node->getPosition(), node->getRoughRadius());
             Theme::normal(*marker);
-            nearbyNodeMarkers.emplace(node.get(), marker);
+            nearbyNodeMarkers.emplace(id, marker);
         }
     }
 
@@ -430,5 +471,39 @@ void NodeTool::clearNearbyMarkers() {
     }
 
     nearbyNodeMarkers.clear();
+
+    if (nearbyEdgeMarker) {
+        vectorRenderer.removeObject(nearbyEdgeMarker);
+        nearbyEdgeMarker.reset();
+    }
+}
+
+void NodeTool::updateCrossingMarkers(const glm::vec2 &end) {
+    std::vector<Nodes::EdgeIntersection> intersections;
+    graph.getIntersections(startPosition, midpoint, end, intersections);
+
+    // Reuse the existing markers where possible
+    while (crossingMarkers.size() > intersections.size()) {
+        vectorRenderer.removeObject(crossingMarkers.back());
+        crossingMarkers.pop_back();
+    }
+
+    for (size_t index = 0; index < intersections.size(); ++index) {
+        if (index < crossingMarkers.size()) {
+            crossingMarkers[index]->setOrigin(intersections[index].point);
+        } else {
+            auto marker = vectorRenderer.addObject<Vector::Circle>(intersections[index].point, edgeWidth / 2);
+            Theme::error(*marker);
+            crossingMarkers.push_back(marker);
+        }
+    }
+}
+
+void NodeTool::clearCrossingMarkers() {
+    for (auto &marker : crossingMarkers) {
+        vectorRenderer.removeObject(marker);
+    }
+
+    crossingMarkers.clear();
 }
 
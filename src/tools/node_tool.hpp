@@ -55,7 +55,9 @@ private:
     ToolMode mode { ToolMode::Idle };
     // TODO: Allow splitting edges with a new node
     State state { State::Idle };
-    std::shared_ptr<Nodes::Node> startNode;
+    // Null until the edge is placed when starting from a new node
+    Nodes::NodeId startNode;
+    glm::vec3 startPosition;
     bool isNewStartNode { false };
     bool autoMidpoint { false };
     std::optional<glm::vec2> midpoint;
@@ -72,16 +74,25 @@ private:
     } midMarker;
 
     // Markers to show nearby nodes you can select
-    std::unordered_map<const Nodes::Node *, std::shared_ptr<Vector::Circle>> nearbyNodeMarkers;
+    std::unordered_map<Nodes::NodeId, std::shared_ptr<Vector::Circle>> nearbyNodeMarkers;
+    // Marks the closest point on the edge under the cursor
+    std::shared_ptr<Vector::Circle> nearbyEdgeMarker;
+    // Marks where the edge being placed crosses existing edges
+    std::vector<std::shared_ptr<Vector::Circle>> crossingMarkers;
 
     void updateMarkers();
     void cancelPlacement();
     void clearMarkers();
     glm::vec2 calculateMidpoint(const glm::vec2 &end);
+    float getStartRadius() const;
 
     void updateNearbyMarkers(const glm::vec3 &position, bool allowEdges);
     void updateNearbyNodeMarkers(const glm::vec3 &position);
+    void updateNearbyEdgeMarker(const glm::vec3 &position);
     void clearNearbyMarkers();
+
+    void updateCrossingMarkers(const glm::vec2 &end);
+    void clearCrossingMarkers();
 };
 
 
@@ -2,6 +2,9 @@
 #include "../scene.hpp"
 #include <imgui.h>
 
+// Droplets per second of erosion for each unit of the amount
+const float DropletsPerAmount = 100;
+
 TerraformTool::TerraformTool(std::shared_ptr<Heightmap> heightmap, Scene &scene)
     : heightmap(std::move(heightmap)), scene(scene) {}
 
@@ -43,6 +46,9 @@ void TerraformTool::onMouseMove(const ToolMouseEvent &event, double delta) {
         case Mode::Level:
             heightmap->terraformTo(targetHeight, *coords, activeRadius, (activeAmount / 50) * delta, activeHardness);
             break;
+        case Mode::Erode:
+            heightmap->erode(*coords, activeRadius, static_cast<uint32_t>(activeAmount * DropletsPerAmount * delta));
+            break;
         default:
             break;
     }
@@ -64,6 +70,11 @@ void TerraformTool::drawToolbarTab() {
         mode = Mode::Level;
         activate();
     }
+    ImGui::SameLine();
+    if (ImGui::Button("Erode", { 96, 48 })) {
+        mode = Mode::Erode;
+        activate();
+    }
 
     // Settings
     ImGui::PushItemWidth(130);
@@ -73,6 +84,13 @@ void TerraformTool::drawToolbarTab() {
     ImGui::SameLine();
     ImGui::SliderFloat("Hardness", &activeHardness, 0, 1, "%.2f");
     ImGui::SameLine();
+
+    if (mode == Mode::Erode) {
+        ImGui::SliderFloat("Erosion rate", &heightmap->getHydraulicSettings().erosionRate, 0.01f, 1, "%.2f");
+        ImGui::SameLine();
+        ImGui::SliderFloat("Talus", &heightmap->getThermalSettings().talus, 0.1f, 5, "%.2f");
+        ImGui::SameLine();
+    }
 }
 
 void TerraformTool::onDeactivate() {
@@ -13,7 +13,8 @@ public:
         Inactive,
         Raise,
         Lower,
-        Level
+        Level,
+        Erode
     };
     TerraformTool(std::shared_ptr<Heightmap> heightmap, Scene &scene);
 
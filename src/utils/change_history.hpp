@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+/**
+ * A version number with the regions changed by the most recent versions, so users can catch up on what changed since
+ * they last looked. Vector is the type the regions are given in, such as glm::ivec2 for pixels.
+ */
+template<typename Vector, uint32_t MaxKept = 32>
+class ChangeHistory {
+public:
+    /**
+     * Increases with every change
+     */
+    uint32_t getVersion() const { return version; }
+
+    void add(const Vector &min, const Vector &max);
+
+    /**
+     * Starts a new version with no history, for when everything changed
+     */
+    void reset();
+
+    /**
+     * Finds the region which changed after the given version. When nothing did, max is less than min.
+     * @return false when the changes are too old to be known, everything has to be assumed changed
+     */
+    bool getChangedSince(uint32_t sinceVersion, Vector &min, Vector &max) const;
+
+private:
+    struct Change {
+        uint32_t version;
+        Vector min;
+        Vector max;
+    };
+
+    uint32_t version { 0 };
+    // The most recent changes, oldest first
+    std::vector<Change> changes;
+};
+
+template<typename Vector, uint32_t MaxKept>
+void ChangeHistory<Vector, MaxKept>::add(const Vector &min, const Vector &max) {
+    ++version;
+    if (changes.size() >= MaxKept) {
+        changes.erase(changes.begin());
+    }
+    changes.push_back({ version, min, max });
+}
+
+template<typename Vector, uint32_t MaxKept>
+void ChangeHistory<Vector, MaxKept>::reset() {
+    ++version;
+    changes.clear();
+}
+
+template<typename Vector, uint32_t MaxKept>
+bool ChangeHistory<Vector, MaxKept>::getChangedSince(uint32_t sinceVersion, Vector &min, Vector &max) const {
+    if (sinceVersion == version) {
+        min = Vector(0);
+        max = Vector(-1);
+        return true;
+    }
+
+    // Versions before the oldest change kept are unknown
+    if (changes.empty() || changes.front().version > sinceVersion + 1) {
+        return false;
+    }
+
+    bool first = true;
+    for (auto &change : changes) {
+        if (change.version <= sinceVersion) {
+            continue;
+        }
+
+        if (first) {
+            min = change.min;
+            max = change.max;
+            first = false;
+        } else {
+            min = glm::min(min, change.min);
+            max = glm::max(max, change.max);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,47 @@
+#include "grid_mesh.hpp"
+
+void generateGridMesh(uint32_t size, std::vector<Engine::Vertex> &vertices, std::vector<uint16_t> &indices) {
+    auto totalVertices = (size + 1) * (size + 1);
+    auto totalIndices = size * size * 6;
+
+    auto sizeFloat = static_cast<float>(size);
+
+    vertices.resize(totalVertices);
+    indices.resize(totalIndices);
+
+    float scale = 1 / sizeFloat;
+
+    // produce the vertices
+    for (uint32_t row = 0; row < size + 1; ++row) {
+        for (uint32_t column = 0; column < size + 1; ++column) {
+            auto index = column + row * (size + 1);
+
+            vertices[index] = Engine::Vertex {
+                { static_cast<float>(column) * scale, static_cast<float>(row) * scale, 0.0f },
+                { 0, 0, 1 },
+                { 1, 1, 1, 1 },
+                { static_cast<float>(column) * scale, static_cast<float>(row) * scale }
+            };
+        }
+    }
+
+    // produce the triangles
+    uint32_t startIndex = 0;
+    for (uint32_t row = 0; row < size; ++row) {
+        for (uint32_t column = 0; column < size; ++column) {
+            auto index = column + row * (size + 1);
+            auto indexRight = (column + 1) + row * (size + 1);
+            auto indexDown = column + (row + 1) * (size + 1);
+            auto indexDownRight = (column + 1) + (row + 1) * (size + 1);
+
+            indices[startIndex + 0] = index;
+            indices[startIndex + 1] = indexRight;
+            indices[startIndex + 2] = indexDownRight;
+            indices[startIndex + 3] = index;
+            indices[startIndex + 4] = indexDownRight;
+            indices[startIndex + 5] = indexDown;
+
+            startIndex += 6;
+        }
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <tech-core/vertex.hpp>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Produces a flat unit grid of size x size cells spanning [0,1] on X and Y.
+ * Used as the instanced tile mesh by the terrain algorithms.
+ */
+void generateGridMesh(uint32_t size, std::vector<Engine::Vertex> &vertices, std::vector<uint16_t> &indices);
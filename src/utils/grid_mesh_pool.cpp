@@ -0,0 +1,48 @@
+#include "grid_mesh_pool.hpp"
+#include "grid_mesh.hpp"
+
+GridMeshPool::GridMeshPool(Engine::RenderEngine &engine, const char *name, uint32_t minimumSize, uint32_t maximumSize)
+    : engine(engine), meshName(name) {
+    std::vector<Engine::Vertex> vertices;
+    std::vector<uint16_t> indices;
+
+    std::vector<Engine::Vertex> sizeVertices;
+    std::vector<uint16_t> sizeIndices;
+
+    for (uint32_t size = minimumSize; size <= maximumSize; size *= 2) {
+        generateGridMesh(size, sizeVertices, sizeIndices);
+
+        ranges.push_back(
+            {
+                size,
+                static_cast<uint32_t>(indices.size()),
+                static_cast<uint32_t>(sizeIndices.size()),
+                static_cast<int32_t>(vertices.size())
+            }
+        );
+
+        vertices.insert(vertices.end(), sizeVertices.begin(), sizeVertices.end());
+        indices.insert(indices.end(), sizeIndices.begin(), sizeIndices.end());
+    }
+
+    memoryUsage = vertices.size() * sizeof(Engine::Vertex) + indices.size() * sizeof(uint16_t);
+
+    mesh = engine.createStaticMesh<Engine::Vertex>(meshName)
+        .withVertices(vertices)
+        .withIndices(indices)
+        .build();
+}
+
+GridMeshPool::~GridMeshPool() {
+    engine.removeMesh(meshName);
+}
+
+const GridMeshPool::Range *GridMeshPool::getRange(uint32_t size) const {
+    for (auto &range : ranges) {
+        if (range.size == size) {
+            return &range;
+        }
+    }
+
+    return nullptr;
+}
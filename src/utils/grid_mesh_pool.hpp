@@ -0,0 +1,46 @@
+#pragma once
+
+#include <tech-core/mesh.hpp>
+#include <tech-core/engine.hpp>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Every power of two grid mesh between a minimum and maximum size, packed into a single static mesh.
+ * Each size occupies its own range of the shared vertex and index buffers so switching between sizes
+ * does not need any allocation or upload.
+ */
+class GridMeshPool {
+public:
+    struct Range {
+        uint32_t size;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        // Indices are relative to the first vertex of the size to keep them within 16 bits
+        int32_t vertexOffset;
+    };
+
+    GridMeshPool(Engine::RenderEngine &engine, const char *name, uint32_t minimumSize, uint32_t maximumSize);
+    ~GridMeshPool();
+
+    GridMeshPool(const GridMeshPool &) = delete;
+    GridMeshPool &operator=(const GridMeshPool &) = delete;
+
+    const Engine::Mesh &getMesh() const { return *mesh; }
+
+    /**
+     * @return The range of the given size, or nullptr if the size is not in the pool
+     */
+    const Range *getRange(uint32_t size) const;
+
+    size_t getMemoryUsage() const { return memoryUsage; }
+
+private:
+    Engine::RenderEngine &engine;
+    std::string meshName;
+    Engine::StaticMesh *mesh { nullptr };
+
+    std::vector<Range> ranges;
+    size_t memoryUsage { 0 };
+};
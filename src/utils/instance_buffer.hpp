@@ -18,6 +18,20 @@ public:
 
     void bind(vk::CommandBuffer);
     void draw(vk::CommandBuffer, const Engine::Mesh &mesh);
+    /**
+     * Draws every instance using a sub range of the mesh
+     */
+    void draw(
+        vk::CommandBuffer, const Engine::Mesh &mesh, uint32_t firstIndex, uint32_t indexCount, int32_t vertexOffset
+    );
+    /**
+     * Draws a single instance with its own mesh. bind() must have been called first.
+     */
+    void drawInstance(vk::CommandBuffer, const Engine::Mesh &mesh, uint32_t index);
+    /**
+     * Draws a range of instances. The mesh and bind() must have been bound first.
+     */
+    void drawRange(vk::CommandBuffer, const Engine::Mesh &mesh, uint32_t firstInstance, uint32_t instanceCount);
 
     uint32_t size() const { return internalSize; }
 
@@ -30,6 +44,11 @@ public:
     bool push(T &&item);
     bool push(const T &item);
     void clear();
+    /**
+     * Writes instances from the index on, for users which give out ranges of the buffer themselves. Leaves the size
+     * alone, so those users draw with drawRange.
+     */
+    void write(uint32_t index, const T *items, uint32_t count);
     void flush();
 private:
     std::unique_ptr<Engine::Buffer> buffer;
@@ -2,6 +2,7 @@
 
 #include <tech-core/engine.hpp>
 #include <tech-core/mesh.hpp>
+#include <algorithm>
 
 template<typename T>
 InstanceBuffer<T>::InstanceBuffer(uint32_t capacity, Engine::RenderEngine &engine): internalCapacity(capacity) {
@@ -37,6 +38,37 @@ void InstanceBuffer<T>::draw(vk::CommandBuffer commandBuffer, const Engine::Mesh
     commandBuffer.drawIndexed(mesh.getIndexCount(), internalSize, 0, 0, 0);
 }
 
+template<typename T>
+void InstanceBuffer<T>::draw(
+    vk::CommandBuffer commandBuffer, const Engine::Mesh &mesh, uint32_t firstIndex, uint32_t indexCount,
+    int32_t vertexOffset
+) {
+    if (internalSize == 0) {
+        return;
+    }
+
+    mesh.bind(commandBuffer);
+    bind(commandBuffer);
+    commandBuffer.drawIndexed(indexCount, internalSize, firstIndex, vertexOffset, 0);
+}
+
+template<typename T>
+void InstanceBuffer<T>::drawInstance(vk::CommandBuffer commandBuffer, const Engine::Mesh &mesh, uint32_t index) {
+    if (index >= internalSize) {
+        return;
+    }
+
+    mesh.bind(commandBuffer);
+    commandBuffer.drawIndexed(mesh.getIndexCount(), 1, 0, 0, index);
+}
+
+template<typename T>
+void InstanceBuffer<T>::drawRange(
+    vk::CommandBuffer commandBuffer, const Engine::Mesh &mesh, uint32_t firstInstance, uint32_t instanceCount
+) {
+    commandBuffer.drawIndexed(mesh.getIndexCount(), instanceCount, 0, 0, firstInstance);
+}
+
 template<typename T>
 bool InstanceBuffer<T>::push(T &&item) {
     if (internalSize >= internalCapacity) {
@@ -78,6 +110,23 @@ void InstanceBuffer<T>::clear() {
     internalSize = 0;
 }
 
+template<typename T>
+void InstanceBuffer<T>::write(uint32_t index, const T *items, uint32_t count) {
+    if (count == 0 || index + count > internalCapacity) {
+        return;
+    }
+
+    std::copy(items, items + count, instances + index);
+    if (modified) {
+        firstModified = std::min(firstModified, index);
+        lastModified = std::max(lastModified, index + count - 1);
+    } else {
+        modified = true;
+        firstModified = index;
+        lastModified = index + count - 1;
+    }
+}
+
 template<typename T>
 void InstanceBuffer<T>::flush() {
     if (!modified) {
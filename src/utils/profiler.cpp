@@ -0,0 +1,364 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <imgui.h>
+
+namespace Profiler {
+
+namespace Internal {
+
+const auto epoch = std::chrono::steady_clock::now();
+
+std::mutex registryLock;
+std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+
+uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+ThreadBuffer &getThreadBuffer() {
+    thread_local ThreadBuffer *buffer = nullptr;
+
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(registryLock);
+        threadBuffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = threadBuffers.back().get();
+        buffer->threadIndex = static_cast<uint32_t>(threadBuffers.size() - 1);
+    }
+
+    return *buffer;
+}
+
+}
+
+// Collected state. Only touched from the main thread
+namespace {
+
+struct CollectedEvent {
+    ZoneEvent event;
+    uint32_t threadIndex;
+};
+
+struct FrameRange {
+    uint64_t start;
+    uint64_t end;
+};
+
+const size_t MaxHistoryEvents = 1 << 18;
+const size_t MaxHistoryFrames = 2048;
+const size_t ZoneSampleCount = 512;
+
+struct ZoneStatistics {
+    // Durations in milliseconds
+    std::array<float, ZoneSampleCount> samples;
+    size_t count { 0 };
+};
+
+std::deque<CollectedEvent> history;
+std::deque<FrameRange> frameHistory;
+std::unordered_map<std::string_view, ZoneStatistics> zones;
+
+uint32_t mainThreadIndex { 0 };
+uint64_t frameStart { 0 };
+bool paused { false };
+
+// The last completed frame shown in the flame view
+std::vector<CollectedEvent> frameEvents;
+FrameRange shownFrame { 0, 0 };
+
+float percentile(std::vector<float> &sorted, float fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    auto index = static_cast<size_t>(fraction * static_cast<float>(sorted.size() - 1) + 0.5f);
+    return sorted[index];
+}
+
+ImU32 colourForZone(const char *name) {
+    auto hash = std::hash<std::string_view>()(name);
+    auto hue = static_cast<float>(hash % 360) / 360.0f;
+
+    float red, green, blue;
+    ImGui::ColorConvertHSVtoRGB(hue, 0.5f, 0.8f, red, green, blue);
+    return ImGui::GetColorU32(ImVec4(red, green, blue, 1.0f));
+}
+
+void writeEscaped(std::ostream &stream, const char *text) {
+    for (auto character = text; *character; ++character) {
+        if (*character == '"' || *character == '\\') {
+            stream << '\\';
+        }
+        stream << *character;
+    }
+}
+
+void drawFlameView() {
+    auto frameDuration = static_cast<double>(shownFrame.end - shownFrame.start);
+    ImGui::Text("Frame: %.3fms", frameDuration / 1e6);
+
+    if (frameDuration <= 0) {
+        return;
+    }
+
+    std::vector<uint32_t> threads;
+    for (auto &collected : frameEvents) {
+        if (std::find(threads.begin(), threads.end(), collected.threadIndex) == threads.end()) {
+            threads.push_back(collected.threadIndex);
+        }
+    }
+
+    // Main thread first
+    std::sort(
+        threads.begin(), threads.end(), [](uint32_t a, uint32_t b) {
+            if ((a == mainThreadIndex) != (b == mainThreadIndex)) {
+                return a == mainThreadIndex;
+            }
+            return a < b;
+        }
+    );
+
+    auto *drawList = ImGui::GetWindowDrawList();
+    auto rowHeight = ImGui::GetTextLineHeightWithSpacing();
+    auto width = std::max(ImGui::GetContentRegionAvail().x, 200.0f);
+    auto scale = static_cast<double>(width) / frameDuration;
+
+    for (auto thread : threads) {
+        if (thread == mainThreadIndex) {
+            ImGui::TextUnformatted("Main thread");
+        } else {
+            ImGui::Text("Thread %u", thread);
+        }
+
+        uint32_t threadDepth = 0;
+        for (auto &collected : frameEvents) {
+            if (collected.threadIndex == thread) {
+                threadDepth = std::max(threadDepth, collected.event.depth);
+            }
+        }
+
+        auto origin = ImGui::GetCursorScreenPos();
+        auto height = rowHeight * static_cast<float>(threadDepth + 1);
+
+        for (auto &collected : frameEvents) {
+            if (collected.threadIndex != thread) {
+                continue;
+            }
+
+            auto &event = collected.event;
+            auto start = std::max(event.start, shownFrame.start) - shownFrame.start;
+            auto end = std::min(event.end, shownFrame.end) - shownFrame.start;
+
+            ImVec2 min(
+                origin.x + static_cast<float>(static_cast<double>(start) * scale),
+                origin.y + rowHeight * static_cast<float>(event.depth)
+            );
+            ImVec2 max(
+                std::max(origin.x + static_cast<float>(static_cast<double>(end) * scale), min.x + 1),
+                min.y + rowHeight - 1
+            );
+
+            drawList->AddRectFilled(min, max, colourForZone(event.name));
+
+            auto textSize = ImGui::CalcTextSize(event.name);
+            if (textSize.x < max.x - min.x - 4) {
+                drawList->AddText(ImVec2(min.x + 2, min.y), IM_COL32(0, 0, 0, 255), event.name);
+            }
+
+            if (ImGui::IsMouseHoveringRect(min, max)) {
+                ImGui::SetTooltip(
+                    "%s\n%.3fms", event.name, static_cast<double>(event.end - event.start) / 1e6
+                );
+            }
+        }
+
+        ImGui::Dummy(ImVec2(width, height));
+    }
+}
+
+void drawZoneTable() {
+    if (!ImGui::BeginTable("Zones", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        return;
+    }
+
+    ImGui::TableSetupColumn("Zone");
+    ImGui::TableSetupColumn("p50 (ms)");
+    ImGui::TableSetupColumn("p95 (ms)");
+    ImGui::TableSetupColumn("p99 (ms)");
+    ImGui::TableSetupColumn("max (ms)");
+    ImGui::TableHeadersRow();
+
+    std::vector<std::string_view> names;
+    names.reserve(zones.size());
+    for (auto &pair : zones) {
+        names.push_back(pair.first);
+    }
+    std::sort(names.begin(), names.end());
+
+    std::vector<float> sorted;
+    for (auto &name : names) {
+        auto &zone = zones[name];
+
+        auto sampleCount = std::min(zone.count, ZoneSampleCount);
+        sorted.assign(zone.samples.begin(), zone.samples.begin() + sampleCount);
+        std::sort(sorted.begin(), sorted.end());
+
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(name.data(), name.data() + name.size());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", percentile(sorted, 0.5f));
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", percentile(sorted, 0.95f));
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", percentile(sorted, 0.99f));
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", sorted.empty() ? 0.0f : sorted.back());
+    }
+
+    ImGui::EndTable();
+}
+
+}
+
+void beginFrame() {
+    auto frameEnd = Internal::now();
+    mainThreadIndex = Internal::getThreadBuffer().threadIndex;
+
+    std::vector<CollectedEvent> collected;
+    {
+        std::lock_guard<std::mutex> lock(Internal::registryLock);
+        for (auto &buffer : Internal::threadBuffers) {
+            auto head = buffer->head.load(std::memory_order_acquire);
+
+            // Anything older than the capacity has already been overwritten
+            auto first = buffer->readPosition;
+            if (head - first > Internal::ThreadBufferCapacity) {
+                first = head - Internal::ThreadBufferCapacity;
+            }
+
+            auto copiedStart = collected.size();
+            for (auto position = first; position < head; ++position) {
+                auto &slot = buffer->events[position % Internal::ThreadBufferCapacity];
+                ZoneEvent event {
+                    slot.name.load(std::memory_order_relaxed),
+                    slot.start.load(std::memory_order_relaxed),
+                    slot.end.load(std::memory_order_relaxed),
+                    slot.depth.load(std::memory_order_relaxed)
+                };
+                collected.push_back({ event, buffer->threadIndex });
+            }
+
+            // The owner keeps recording while this copies. Slots it has claimed since may be torn, so drop them
+            std::atomic_thread_fence(std::memory_order_acquire);
+            auto claimed = buffer->claimed.load(std::memory_order_relaxed);
+            if (claimed > first + Internal::ThreadBufferCapacity) {
+                auto overwritten = std::min(claimed - Internal::ThreadBufferCapacity, head) - first;
+                collected.erase(
+                    collected.begin() + static_cast<ptrdiff_t>(copiedStart),
+                    collected.begin() + static_cast<ptrdiff_t>(copiedStart + overwritten)
+                );
+            }
+            buffer->readPosition = head;
+        }
+    }
+
+    for (auto &item : collected) {
+        auto &zone = zones[item.event.name];
+        zone.samples[zone.count % ZoneSampleCount] = static_cast<float>(item.event.end - item.event.start) / 1e6f;
+        ++zone.count;
+
+        history.push_back(item);
+    }
+
+    while (history.size() > MaxHistoryEvents) {
+        history.pop_front();
+    }
+
+    if (frameStart != 0) {
+        frameHistory.push_back({ frameStart, frameEnd });
+        if (frameHistory.size() > MaxHistoryFrames) {
+            frameHistory.pop_front();
+        }
+
+        if (!paused) {
+            shownFrame = { frameStart, frameEnd };
+            frameEvents.clear();
+            for (auto &item : collected) {
+                if (item.event.end > frameStart && item.event.start < frameEnd) {
+                    frameEvents.push_back(item);
+                }
+            }
+        }
+    }
+
+    frameStart = frameEnd;
+}
+
+void drawGUI() {
+    ImGui::Begin("Profiler");
+
+    if (!isEnabled()) {
+        ImGui::TextUnformatted("Zones are not recorded in release builds");
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Checkbox("Pause", &paused);
+    ImGui::SameLine();
+    if (ImGui::Button("Write trace")) {
+        writeChromeTrace("profile.json");
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled("(3 to write a trace)");
+
+    if (ImGui::CollapsingHeader("Last frame", ImGuiTreeNodeFlags_DefaultOpen)) {
+        drawFlameView();
+    }
+
+    if (ImGui::CollapsingHeader("Zones", ImGuiTreeNodeFlags_DefaultOpen)) {
+        drawZoneTable();
+    }
+
+    ImGui::End();
+}
+
+bool writeChromeTrace(const char *path) {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"traceEvents\":[\n";
+
+    file << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << mainThreadIndex
+        << R"(,"args":{"name":"Main thread"}})";
+
+    for (auto &frame : frameHistory) {
+        file << ",\n" << R"({"name":"Frame","ph":"X","pid":1,"tid":)" << mainThreadIndex
+            << ",\"ts\":" << static_cast<double>(frame.start) / 1000
+            << ",\"dur\":" << static_cast<double>(frame.end - frame.start) / 1000 << "}";
+    }
+
+    for (auto &item : history) {
+        file << ",\n" << R"({"name":")";
+        writeEscaped(file, item.event.name);
+        file << R"(","ph":"X","pid":1,"tid":)" << item.threadIndex
+            << ",\"ts\":" << static_cast<double>(item.event.start) / 1000
+            << ",\"dur\":" << static_cast<double>(item.event.end - item.event.start) / 1000 << "}";
+    }
+
+    file << "\n]}\n";
+    return static_cast<bool>(file);
+}
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+
+/**
+ * A scoped zone CPU profiler.
+ * Zones are written to a ring buffer owned by the recording thread so recording never takes a lock.
+ * Once per frame the buffers are drained on the main thread into per zone statistics and a history which can be
+ * viewed in the profiler window or dumped as a Chrome trace (chrome://tracing, Perfetto).
+ *
+ * Zones are only recorded in debug builds, PROFILE_ZONE compiles to nothing when NDEBUG is defined.
+ */
+namespace Profiler {
+
+struct ZoneEvent {
+    // Must be a string with static storage duration
+    const char *name;
+    // Nanoseconds since the profiler started
+    uint64_t start;
+    uint64_t end;
+    uint32_t depth;
+};
+
+namespace Internal {
+
+const size_t ThreadBufferCapacity = 16384;
+
+/**
+ * A ring slot. The fields are atomic because the collector can read a slot while the owning thread reuses it, a torn
+ * read is caught by checking ThreadBuffer::claimed afterwards
+ */
+struct EventSlot {
+    std::atomic<const char *> name { nullptr };
+    std::atomic<uint64_t> start { 0 };
+    std::atomic<uint64_t> end { 0 };
+    std::atomic<uint32_t> depth { 0 };
+};
+
+struct ThreadBuffer {
+    uint32_t threadIndex { 0 };
+    std::array<EventSlot, ThreadBufferCapacity> events;
+    // Events the owning thread has started writing. Slots behind this by a whole ring may be being overwritten
+    std::atomic<uint64_t> claimed { 0 };
+    // Events fully written. Only written by the owning thread
+    std::atomic<uint64_t> head { 0 };
+    // Only used by the owning thread
+    uint32_t depth { 0 };
+    // Only used by the collector
+    uint64_t readPosition { 0 };
+};
+
+ThreadBuffer &getThreadBuffer();
+uint64_t now();
+
+}
+
+class ScopedZone {
+public:
+    explicit ScopedZone(const char *name)
+        : name(name), buffer(Internal::getThreadBuffer()), depth(buffer.depth++), start(Internal::now()) {}
+
+    ~ScopedZone() {
+        auto end = Internal::now();
+        --buffer.depth;
+
+        auto position = buffer.head.load(std::memory_order_relaxed);
+        buffer.claimed.store(position + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        auto &slot = buffer.events[position % Internal::ThreadBufferCapacity];
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.end.store(end, std::memory_order_relaxed);
+        slot.depth.store(depth, std::memory_order_relaxed);
+        buffer.head.store(position + 1, std::memory_order_release);
+    }
+
+    ScopedZone(const ScopedZone &) = delete;
+    ScopedZone &operator=(const ScopedZone &) = delete;
+
+private:
+    const char *name;
+    Internal::ThreadBuffer &buffer;
+    uint32_t depth;
+    uint64_t start;
+};
+
+/**
+ * Drains the thread buffers and starts a new frame. Call once per frame from the main thread.
+ */
+void beginFrame();
+
+/**
+ * Draws the profiler window with the flame view of the last frame and the zone percentiles
+ */
+void drawGUI();
+
+/**
+ * Writes the recorded history in the Chrome trace event format
+ * @return true if the file was written
+ */
+bool writeChromeTrace(const char *path);
+
+constexpr bool isEnabled() {
+#ifdef NDEBUG
+    return false;
+#else
+    return true;
+#endif
+}
+
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef NDEBUG
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_ZONE(name) Profiler::ScopedZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#endif
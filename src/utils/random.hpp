@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * SplitMix64, small and quick to seed, which matters more than quality when every chunk, tile or
+ * cell gets its own sequence
+ */
+class Random {
+public:
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        auto value = (state += 0x9E3779B97F4A7C15ull);
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+    }
+
+    /**
+     * In [0, 1)
+     */
+    float unit() {
+        return static_cast<float>(next() >> 40) / static_cast<float>(1 << 24);
+    }
+
+    float range(float min, float max) {
+        return min + (max - min) * unit();
+    }
+
+private:
+    uint64_t state;
+};
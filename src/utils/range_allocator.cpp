@@ -0,0 +1,84 @@
+#include "range_allocator.hpp"
+#include <cassert>
+#include <iterator>
+
+RangeAllocator::RangeAllocator(uint32_t capacity)
+    : capacity(capacity) {
+    if (capacity > 0) {
+        freeRanges[0] = capacity;
+    }
+}
+
+uint32_t RangeAllocator::getEnd() const {
+    if (freeRanges.empty()) {
+        return capacity;
+    }
+
+    auto &last = *freeRanges.rbegin();
+    if (last.first + last.second == capacity) {
+        return last.first;
+    }
+    return capacity;
+}
+
+float RangeAllocator::getFragmentation() const {
+    auto end = getEnd();
+    if (end == 0) {
+        return 0;
+    }
+
+    return static_cast<float>(end - used) / static_cast<float>(end);
+}
+
+std::optional<uint32_t> RangeAllocator::allocate(uint32_t count) {
+    if (count == 0) {
+        return {};
+    }
+
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        if (it->second < count) {
+            continue;
+        }
+
+        auto start = it->first;
+        auto remaining = it->second - count;
+        freeRanges.erase(it);
+        if (remaining > 0) {
+            freeRanges[start + count] = remaining;
+        }
+
+        used += count;
+        return start;
+    }
+
+    return {};
+}
+
+void RangeAllocator::free(uint32_t start, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    assert(start + count <= capacity);
+    used -= count;
+
+    auto next = freeRanges.lower_bound(start);
+    assert(next == freeRanges.end() || next->first >= start + count);
+
+    // Merge with the free range after
+    if (next != freeRanges.end() && next->first == start + count) {
+        count += next->second;
+        next = freeRanges.erase(next);
+    }
+
+    // And the one before
+    if (next != freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == start) {
+            previous->second += count;
+            return;
+        }
+    }
+
+    freeRanges[start] = count;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+
+/**
+ * Hands out ranges of a fixed size space, such as the elements of a buffer.
+ * Allocation is first fit and freed ranges are merged with their neighbours.
+ */
+class RangeAllocator {
+public:
+    explicit RangeAllocator(uint32_t capacity);
+
+    uint32_t getCapacity() const { return capacity; }
+
+    uint32_t getUsed() const { return used; }
+
+    /**
+     * One past the end of the last allocated range. Nothing after this is in use.
+     */
+    uint32_t getEnd() const;
+
+    /**
+     * The portion of the space up to the end which is free, 0 when everything in use is packed at the start
+     */
+    float getFragmentation() const;
+
+    /**
+     * @return The start of the range or nothing if there is no free range large enough
+     */
+    std::optional<uint32_t> allocate(uint32_t count);
+    void free(uint32_t start, uint32_t count);
+
+private:
+    uint32_t capacity;
+    uint32_t used { 0 };
+
+    // Start to size of every free range
+    std::map<uint32_t, uint32_t> freeRanges;
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/**
+ * A reference to a value in a SlotMap.
+ * The generation is bumped every time a slot is freed so handles to removed values never resolve to whatever
+ * reuses the slot. A default constructed handle is null.
+ */
+template<typename Tag>
+struct SlotHandle {
+    uint32_t index { 0 };
+    uint32_t generation { 0 };
+
+    explicit operator bool() const { return generation != 0; }
+
+    bool operator==(const SlotHandle &other) const {
+        return index == other.index && generation == other.generation;
+    }
+
+    bool operator!=(const SlotHandle &other) const {
+        return !(*this == other);
+    }
+};
+
+namespace std {
+
+template<typename Tag>
+struct hash<SlotHandle<Tag>> {
+    size_t operator()(const SlotHandle<Tag> &handle) const {
+        return hash<uint64_t>()((static_cast<uint64_t>(handle.generation) << 32) | handle.index);
+    }
+};
+
+}
+
+/**
+ * Stores values in one contiguous array addressed by generational handles.
+ * Inserting and removing are O(1) and never move other values, so the slot index of a handle can be used to
+ * address parallel arrays of extra data. Freed slots are reused before the array grows.
+ *
+ * Values are left default constructed in free slots, so T must be default constructible.
+ */
+template<typename T, typename Tag = T>
+class SlotMap {
+public:
+    typedef SlotHandle<Tag> Handle;
+
+    size_t size() const { return count; }
+
+    /**
+     * The number of slots, free or not. Parallel arrays need to be at least this large.
+     */
+    size_t capacity() const { return values.size(); }
+
+    void reserve(size_t slots) {
+        values.reserve(slots);
+        generations.reserve(slots);
+    }
+
+    Handle insert(T value) {
+        uint32_t index;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+            values[index] = std::move(value);
+        } else {
+            index = static_cast<uint32_t>(values.size());
+            values.push_back(std::move(value));
+            generations.push_back(0);
+        }
+
+        // Live slots have odd generations and free slots even ones, so a handle to a free slot never matches
+        ++generations[index];
+        ++count;
+
+        return { index, generations[index] };
+    }
+
+    /**
+     * @return false if the handle was already stale
+     */
+    bool remove(Handle handle) {
+        if (!contains(handle)) {
+            return false;
+        }
+
+        values[handle.index] = T {};
+        ++generations[handle.index];
+        freeSlots.push_back(handle.index);
+        --count;
+
+        return true;
+    }
+
+    bool contains(Handle handle) const {
+        return handle.index < generations.size() && generations[handle.index] == handle.generation;
+    }
+
+    /**
+     * @return The value or nullptr if the handle is stale. The pointer is invalidated by the next insert.
+     */
+    T *get(Handle handle) {
+        return contains(handle) ? &values[handle.index] : nullptr;
+    }
+
+    const T *get(Handle handle) const {
+        return contains(handle) ? &values[handle.index] : nullptr;
+    }
+
+    T &operator[](Handle handle) {
+        assert(contains(handle));
+        return values[handle.index];
+    }
+
+    const T &operator[](Handle handle) const {
+        assert(contains(handle));
+        return values[handle.index];
+    }
+
+    /**
+     * Calls the callback with (handle, value) for every live value in slot order
+     */
+    template<typename Callback>
+    void forEach(Callback &&callback) const {
+        for (uint32_t index = 0; index < values.size(); ++index) {
+            if (generations[index] & 1) {
+                callback(Handle { index, generations[index] }, values[index]);
+            }
+        }
+    }
+
+    void clear() {
+        for (uint32_t index = 0; index < values.size(); ++index) {
+            if (generations[index] & 1) {
+                values[index] = T {};
+                ++generations[index];
+                freeSlots.push_back(index);
+            }
+        }
+        count = 0;
+    }
+
+private:
+    std::vector<T> values;
+    std::vector<uint32_t> generations;
+    std::vector<uint32_t> freeSlots;
+    size_t count { 0 };
+};
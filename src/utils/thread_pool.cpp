@@ -0,0 +1,113 @@
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    if (threadCount == 0) {
+        auto hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    threads.reserve(threadCount);
+    for (uint32_t index = 0; index < threadCount; ++index) {
+        threads.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+ThreadPool &ThreadPool::getShared() {
+    static ThreadPool shared;
+    return shared;
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobAvailable.notify_one();
+}
+
+void ThreadPool::run(std::vector<std::function<void()>> batch) {
+    if (batch.empty()) {
+        return;
+    }
+
+    // Only changed with the lock held, this does not return until it is 0 so the jobs can refer to it
+    size_t remaining = batch.size();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &job : batch) {
+            jobs.push_back(
+                [this, &remaining, job = std::move(job)]() {
+                    job();
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    --remaining;
+                }
+            );
+        }
+    }
+    jobAvailable.notify_all();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (remaining > 0) {
+        if (jobs.empty()) {
+            // Workers notify after every job
+            jobsFinished.wait(lock, [this, &remaining]() { return remaining == 0 || !jobs.empty(); });
+            continue;
+        }
+
+        auto job = std::move(jobs.front());
+        jobs.pop_front();
+        ++activeJobs;
+
+        lock.unlock();
+        job();
+        lock.lock();
+
+        --activeJobs;
+        jobsFinished.notify_all();
+    }
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobsFinished.wait(lock, [this]() { return jobs.empty() && activeJobs == 0; });
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+            // Outstanding jobs are still completed when stopping
+            if (jobs.empty()) {
+                return;
+            }
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            ++activeJobs;
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --activeJobs;
+        }
+        jobsFinished.notify_all();
+    }
+}
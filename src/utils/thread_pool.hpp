@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads which run submitted jobs in the order they were submitted.
+ * Jobs must not touch the render engine, results need to be handed back to the render thread.
+ */
+class ThreadPool {
+public:
+    /**
+     * @param threadCount The number of workers. 0 will use one less than the number of hardware threads
+     */
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * The pool the parts of the application share, rather than each starting a thread per core.
+     * Created on first use and destroyed after main returns, so it outlives everything which submits to it.
+     */
+    static ThreadPool &getShared();
+
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(threads.size()); }
+
+    void submit(std::function<void()> job);
+
+    /**
+     * Runs the jobs and blocks until all of them have finished. The calling thread runs queued jobs while it waits,
+     * so this can be used from inside a job without every worker ending up waiting.
+     */
+    void run(std::vector<std::function<void()>> batch);
+
+    /**
+     * Blocks until every submitted job has finished
+     */
+    void wait();
+
+private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> jobs;
+
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsFinished;
+    uint32_t activeJobs { 0 };
+    bool stopping { false };
+
+    void workerLoop();
+};
@@ -17,26 +17,26 @@ ArcLine::ArcLine(const glm::vec2 &origin, float radius, float start, float end,
 
 void ArcLine::setOrigin(const glm::vec2 &origin) {
     element.p1 = origin;
-    isModified = true;
+    markModified();
 }
 
 void ArcLine::setRadius(float radius) {
     element.f1 = radius;
-    isModified = true;
+    markModified();
 }
 
 void ArcLine::setStartAngle(float startAngle) {
     element.p2.x = std::remainder(startAngle, M_PI * 2);
-    isModified = true;
+    markModified();
 }
 
 void ArcLine::setEndAngle(float endAngle) {
     element.p2.y = std::remainder(endAngle, M_PI * 2);
-    isModified = true;
+    markModified();
 }
 
 void ArcLine::setLineWidth(float size) {
     element.p3.x = size;
-    isModified = true;
+    markModified();
 }
 }
\ No newline at end of file
@@ -15,20 +15,20 @@ Vector::BezierCurve::BezierCurve(const glm::vec2 &start, const glm::vec2 &mid, c
 
 void Vector::BezierCurve::setStart(const glm::vec2 &pos) {
     element.p1 = pos;
-    isModified = true;
+    markModified();
 }
 
 void Vector::BezierCurve::setMid(const glm::vec2 &pos) {
     element.p2 = pos;
-    isModified = true;
+    markModified();
 }
 
 void Vector::BezierCurve::setEnd(const glm::vec2 &pos) {
     element.p3 = pos;
-    isModified = true;
+    markModified();
 }
 
 void Vector::BezierCurve::setLineWidth(float width) {
     element.f1 = width;
-    isModified = true;
+    markModified();
 }
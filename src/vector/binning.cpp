@@ -0,0 +1,162 @@
+#include "binning.hpp"
+#include "common.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Vector {
+
+// Matches AA_BOUNDARY in vector_draw.glsl
+const float AABoundary = 0.01f;
+// Projected bounds are grown by this many pixels to cover rounding
+const float PixelPadding = 1;
+
+glm::vec4 getElementBounds(const Internal::VectorElement &element) {
+    glm::vec2 min;
+    glm::vec2 max;
+    float extent;
+
+    switch (element.type) {
+        case Internal::VectorObjectType::Circle:
+            min = element.p1;
+            max = element.p1;
+            extent = element.f1;
+            break;
+        case Internal::VectorObjectType::Line:
+            min = glm::min(element.p1, element.p2);
+            max = glm::max(element.p1, element.p2);
+            extent = element.f1 / 2;
+            break;
+        case Internal::VectorObjectType::BezierCurve:
+            // The curve is always within the triangle of its control points
+            min = glm::min(glm::min(element.p1, element.p2), element.p3);
+            max = glm::max(glm::max(element.p1, element.p2), element.p3);
+            extent = element.f1 / 2;
+            break;
+        case Internal::VectorObjectType::ArcLine:
+            min = element.p1;
+            max = element.p1;
+            extent = element.f1 + element.p3.x / 2;
+            break;
+        default:
+            // Unknown types draw nothing
+            return { 0, 0, -1, -1 };
+    }
+
+    switch (static_cast<StrokePosition>(element.strokePosition)) {
+        case StrokePosition::Outside:
+            extent += element.strokeWidth;
+            break;
+        case StrokePosition::Center:
+            extent += element.strokeWidth / 2;
+            break;
+        default:
+            break;
+    }
+
+    extent = std::abs(extent) + AABoundary;
+    return { min.x - extent, min.y - extent, max.x + extent, max.y + extent };
+}
+
+glm::vec4 projectBounds(
+    const glm::vec4 &bounds, const glm::mat4 &viewProj, float minHeight, float maxHeight, const glm::vec2 &viewport
+) {
+    glm::vec2 min(std::numeric_limits<float>::max());
+    glm::vec2 max(std::numeric_limits<float>::lowest());
+
+    for (uint32_t corner = 0; corner < 8; ++corner) {
+        glm::vec4 position {
+            (corner & 1) ? bounds.z : bounds.x,
+            (corner & 2) ? bounds.w : bounds.y,
+            (corner & 4) ? maxHeight : minHeight,
+            1
+        };
+
+        auto clip = viewProj * position;
+        if (clip.w <= std::numeric_limits<float>::epsilon()) {
+            // Part of it is behind the camera, where it could end up on screen is unbounded
+            return { 0, 0, viewport.x, viewport.y };
+        }
+
+        auto ndc = glm::vec2(clip) / clip.w;
+        auto pixel = (ndc + 1.0f) * 0.5f * viewport;
+        min = glm::min(min, pixel);
+        max = glm::max(max, pixel);
+    }
+
+    return { min.x - PixelPadding, min.y - PixelPadding, max.x + PixelPadding, max.y + PixelPadding };
+}
+
+TileBinning::TileBinning(uint32_t tileSize)
+    : tileSize(tileSize) {
+}
+
+void TileBinning::bin(const glm::vec2 &viewport, const std::vector<glm::vec4> &screenBounds) {
+    tilesX = static_cast<uint32_t>(std::ceil(std::max(viewport.x, 0.0f) / tileSize));
+    tilesY = static_cast<uint32_t>(std::ceil(std::max(viewport.y, 0.0f) / tileSize));
+
+    auto tileCount = getTileCount();
+    data.assign(tileCount + 1, 0);
+    tileRanges.resize(screenBounds.size());
+
+    auto scale = 1.0f / static_cast<float>(tileSize);
+    auto lastTileX = static_cast<float>(tilesX) - 1;
+    auto lastTileY = static_cast<float>(tilesY) - 1;
+
+    // Count the elements in each tile first
+    for (size_t index = 0; index < screenBounds.size(); ++index) {
+        auto &bounds = screenBounds[index];
+        auto &range = tileRanges[index];
+
+        // Also catches NaN
+        bool visible = bounds.z >= 0 && bounds.w >= 0 && bounds.x < viewport.x && bounds.y < viewport.y &&
+            bounds.x <= bounds.z && bounds.y <= bounds.w;
+        if (!visible || tileCount == 0) {
+            range = { 0, 0, -1, -1 };
+            continue;
+        }
+
+        // Clamped as floats so that huge bounds do not overflow
+        range = {
+            static_cast<int32_t>(std::clamp(std::floor(bounds.x * scale), 0.0f, lastTileX)),
+            static_cast<int32_t>(std::clamp(std::floor(bounds.y * scale), 0.0f, lastTileY)),
+            static_cast<int32_t>(std::clamp(std::floor(bounds.z * scale), 0.0f, lastTileX)),
+            static_cast<int32_t>(std::clamp(std::floor(bounds.w * scale), 0.0f, lastTileY))
+        };
+
+        for (int32_t y = range.y; y <= range.w; ++y) {
+            for (int32_t x = range.x; x <= range.z; ++x) {
+                ++data[y * tilesX + x];
+            }
+        }
+    }
+
+    // Then turn the counts into where each tile starts
+    auto offset = tileCount + 1;
+    for (uint32_t tile = 0; tile < tileCount; ++tile) {
+        auto count = data[tile];
+        data[tile] = offset;
+        offset += count;
+    }
+    data[tileCount] = offset;
+    data.resize(offset);
+
+    // Each start is moved along as its tile is filled
+    for (size_t index = 0; index < screenBounds.size(); ++index) {
+        auto &range = tileRanges[index];
+
+        for (int32_t y = range.y; y <= range.w; ++y) {
+            for (int32_t x = range.x; x <= range.z; ++x) {
+                data[data[y * tilesX + x]++] = static_cast<uint32_t>(index);
+            }
+        }
+    }
+
+    // Which leaves it where the next tile starts, so shift them back
+    for (uint32_t tile = tileCount; tile > 0; --tile) {
+        data[tile] = data[tile - 1];
+    }
+    data[0] = tileCount + 1;
+}
+
+}
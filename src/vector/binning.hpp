@@ -0,0 +1,67 @@
+#pragma once
+
+#include "internal.hpp"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace Vector {
+
+/**
+ * Conservative 2D bounds of everything the element draws, including its stroke and anti-aliasing.
+ * @return min x, min y, max x, max y
+ */
+glm::vec4 getElementBounds(const Internal::VectorElement &element);
+
+/**
+ * Projects 2D bounds lying somewhere between two heights to pixels.
+ * Bounds which reach behind the camera cover the whole viewport.
+ * @return min x, min y, max x, max y in pixels
+ */
+glm::vec4 projectBounds(
+    const glm::vec4 &bounds, const glm::mat4 &viewProj, float minHeight, float maxHeight, const glm::vec2 &viewport
+);
+
+/**
+ * Sorts elements into square tiles of the screen so that each pixel only has to look at the elements which can
+ * touch its tile.
+ * The result is a single array ready to be copied to the GPU. The first tile count + 1 values are offsets into the
+ * same array, the elements of tile t are the indices from data[t] up to data[t + 1]. Each tile lists its elements in
+ * the same order they were given so they blend the same.
+ */
+class TileBinning {
+public:
+    explicit TileBinning(uint32_t tileSize);
+
+    uint32_t getTileSize() const { return tileSize; }
+
+    uint32_t getTilesX() const { return tilesX; }
+
+    uint32_t getTilesY() const { return tilesY; }
+
+    uint32_t getTileCount() const { return tilesX * tilesY; }
+
+    /**
+     * The total number of element indices across every tile
+     */
+    size_t getBinnedCount() const { return data.size() - (getTileCount() + 1); }
+
+    const std::vector<uint32_t> &getData() const { return data; }
+
+    /**
+     * Replaces the bins with the elements covering each tile of the viewport.
+     * @param screenBounds Bounds in pixels of each element, as min x, min y, max x, max y.
+     */
+    void bin(const glm::vec2 &viewport, const std::vector<glm::vec4> &screenBounds);
+
+private:
+    uint32_t tileSize;
+    uint32_t tilesX { 0 };
+    uint32_t tilesY { 0 };
+
+    std::vector<uint32_t> data;
+    // The tiles each element covers, min x, min y, max x, max y. Empty when max < min
+    std::vector<glm::ivec4> tileRanges;
+};
+
+}
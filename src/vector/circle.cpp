@@ -15,12 +15,12 @@ Vector::Circle::Circle(const glm::vec2 &origin, float radius)
 
 void Vector::Circle::setOrigin(const glm::vec2 &origin) {
     element.p1 = origin;
-    isModified = true;
+    markModified();
 }
 
 void Vector::Circle::setRadius(float radius) {
     element.f1 = radius;
-    isModified = true;
+    markModified();
 }
 
 }
@@ -1,4 +1,5 @@
 #include "common.hpp"
+#include "vector_graphics.hpp"
 
 namespace Vector {
 
@@ -8,22 +9,33 @@ Vector::Object::Object(Internal::VectorObjectType type) {
 
 void Vector::Object::setFill(const glm::vec4 &fill) {
     element.fill = fill;
-    isModified = true;
+    markModified();
 }
 
 void Vector::Object::setStroke(const glm::vec4 &stroke) {
     element.stroke = stroke;
-    isModified = true;
+    markModified();
 }
 
 void Vector::Object::setStrokeWidth(float strokeWidth) {
     element.strokeWidth = strokeWidth;
-    isModified = true;
+    markModified();
 }
 
 void Object::setStrokePosition(StrokePosition position) {
     element.strokePosition = static_cast<uint32_t>(position);
+    markModified();
+}
+
+void Object::markModified() {
+    if (isModified) {
+        return;
+    }
+
     isModified = true;
+    if (owner) {
+        owner->linkModified(*this);
+    }
 }
 
 }
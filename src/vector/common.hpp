@@ -4,6 +4,8 @@
 
 namespace Vector {
 
+class VectorGraphics;
+
 enum class StrokePosition : uint32_t {
     Inside,
     Outside,
@@ -29,8 +31,22 @@ public:
     void setStrokePosition(StrokePosition);
 protected:
     Internal::VectorElement element;
+
+    /**
+     * Queues the element to be uploaded on the next update of the owning VectorGraphics
+     */
+    void markModified();
+private:
+    VectorGraphics *owner { nullptr };
+    // Where the element lives in the element buffer, stable until removed
     uint32_t slotIndex { NO_SLOT };
+    // Position in the draw order
+    uint32_t drawIndex { NO_SLOT };
     bool isModified { false };
+
+    // Links in the owner's list of modified objects
+    Object *prevModified { nullptr };
+    Object *nextModified { nullptr };
 };
 
 }
\ No newline at end of file
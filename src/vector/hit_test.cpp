@@ -0,0 +1,454 @@
+#include "hit_test.hpp"
+#include "common.hpp"
+#include <tech-core/shapes/bounding_box.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace Vector {
+
+// These match the defines in vector_draw.glsl
+const float Epsilon = 0.0000001f;
+const float NoMinimum = 100000000;
+const float AABoundaryHalf = 0.01f / 2;
+// Elements over more cells than this are tested by every query rather than listed in each cell
+const int64_t MaxElementCells = 256;
+
+// The distance functions of vector_draw.glsl
+namespace Distance {
+
+float sign(float value) {
+    return static_cast<float>((value > 0) - (value < 0));
+}
+
+float circleDistance(float x, float y, float originX, float originY, float radius) {
+    auto dx = x - originX;
+    auto dy = y - originY;
+    return std::sqrt(dx * dx + dy * dy) - radius;
+}
+
+/**
+ * The distance to the closest point of the segment, which is what the three cases in the shader work out
+ */
+float lineDistance(float x, float y, float startX, float startY, float endX, float endY, float size) {
+    auto directionX = endX - startX;
+    auto directionY = endY - startY;
+    auto toStartX = x - startX;
+    auto toStartY = y - startY;
+
+    auto lengthSquared = directionX * directionX + directionY * directionY;
+    auto t = lengthSquared > 0 ? (toStartX * directionX + toStartY * directionY) / lengthSquared : 0.0f;
+    t = std::clamp(t, 0.0f, 1.0f);
+
+    auto offsetX = toStartX - directionX * t;
+    auto offsetY = toStartY - directionY * t;
+    return std::sqrt(offsetX * offsetX + offsetY * offsetY) - size;
+}
+
+glm::vec2 bezierPoint(const glm::vec2 &start, const glm::vec2 &mid, const glm::vec2 &end, float t) {
+    return (1 - t) * (1 - t) * start + 2 * t * (1 - t) * mid + t * t * end;
+}
+
+float bezierDistance(
+    const glm::vec2 &pos, const glm::vec2 &start, const glm::vec2 &mid, const glm::vec2 &end, float size
+) {
+    auto A = mid - start;
+    auto B = start - 2.0f * mid + end;
+
+    auto startToPos = start - pos;
+    float a = B.x * B.x + B.y * B.y;
+    float b = 3 * (A.x * B.x + A.y * B.y);
+    float c = 2 * (A.x * A.x + A.y * A.y) + startToPos.x * B.x + startToPos.y * B.y;
+    float d = startToPos.x * A.x + startToPos.y * A.y;
+
+    if (std::abs(a) <= Epsilon) {
+        // A straight line
+        return lineDistance(pos.x, pos.y, start.x, start.y, end.x, end.y, size);
+    }
+
+    // Solve the cubic the same way as the shader, including its quirks, so both agree on what is hit
+    float solutions[3];
+    uint32_t solutionCount;
+
+    float z = a;
+    a = b / z;
+    b = c / z;
+    c = d / z;
+
+    float p = b - ((a * a) / 3);
+    float q = (a * ((2 * a * a) - (9 * b)) / 27) + c;
+    float p3 = p * p * p;
+    float D = (q * q) + (4 * p3 / 27);
+    float offset = -a / 3;
+    if (D > Epsilon) {
+        z = std::sqrt(D);
+        float u = (-q + z) / 2;
+        float v = (-q - z) / 2;
+        u = sign(u) * std::cbrt(std::abs(u));
+        v = sign(v) * std::cbrt(std::abs(v));
+        solutions[0] = u + v + offset;
+        solutionCount = 1;
+    } else if (D < -Epsilon) {
+        float u = 2 * std::sqrt(-p / 3);
+        float v = std::acos(-std::sqrt(-27 / p3) * q / 2) / 3;
+        solutions[0] = u * std::cos(v) + offset;
+        solutions[1] = u * std::cos(v + 2 * static_cast<float>(M_PI) / 3) + offset;
+        solutions[2] = u * std::cos(v + 4 * static_cast<float>(M_PI) / 3) + offset;
+        solutionCount = 3;
+    } else {
+        float u = -sign(q) * std::cbrt(std::abs(q) / 2);
+        solutions[0] = 2 * u + offset;
+        solutions[1] = -u + offset;
+        solutionCount = 2;
+    }
+
+    float minDist = NoMinimum;
+    for (uint32_t index = 0; index < solutionCount; ++index) {
+        auto onCurve = bezierPoint(start, mid, end, std::clamp(solutions[index], 0.0f, 1.0f));
+        minDist = std::min(minDist, glm::length(onCurve - pos));
+    }
+
+    // NaN from the solver fails every comparison above
+    if (minDist >= NoMinimum) {
+        return std::min(glm::length(pos - start), glm::length(pos - end)) - size;
+    }
+
+    return minDist - size;
+}
+
+float arclineDistance(
+    const glm::vec2 &pos, const glm::vec2 &origin, float radius, float angleStart, float angleEnd, float size
+) {
+    auto offset = pos - origin;
+    auto angle = std::atan2(offset.y, offset.x);
+
+    bool onArc;
+    if (angleStart > angleEnd) {
+        onArc = angle >= angleStart || angle <= angleEnd;
+    } else {
+        onArc = angle >= angleStart && angle <= angleEnd;
+    }
+
+    auto minDistance = onArc ? std::abs(glm::length(offset) - radius) - size : NoMinimum;
+
+    glm::vec2 startPosition = origin + glm::vec2(std::cos(angleStart), std::sin(angleStart)) * radius;
+    glm::vec2 endPosition = origin + glm::vec2(std::cos(angleEnd), std::sin(angleEnd)) * radius;
+
+    minDistance = std::min(minDistance, circleDistance(pos.x, pos.y, startPosition.x, startPosition.y, size));
+    minDistance = std::min(minDistance, circleDistance(pos.x, pos.y, endPosition.x, endPosition.y, size));
+
+    return minDistance;
+}
+
+}
+
+float getElementDistance(const Internal::VectorElement &element, const glm::vec2 &point) {
+    switch (element.type) {
+        case Internal::VectorObjectType::Circle:
+            return Distance::circleDistance(point.x, point.y, element.p1.x, element.p1.y, element.f1);
+        case Internal::VectorObjectType::Line:
+            return Distance::lineDistance(
+                point.x, point.y, element.p1.x, element.p1.y, element.p2.x, element.p2.y, element.f1 / 2
+            );
+        case Internal::VectorObjectType::BezierCurve:
+            return Distance::bezierDistance(point, element.p1, element.p2, element.p3, element.f1 / 2);
+        case Internal::VectorObjectType::ArcLine:
+            return Distance::arclineDistance(
+                point, element.p1, element.f1, element.p2.x, element.p2.y, element.p3.x / 2
+            );
+        default:
+            return NoMinimum;
+    }
+}
+
+bool isVisibleAtDistance(const Internal::VectorElement &element, float distance) {
+    // Where the fill ends and where the stroke ends
+    float inner;
+    float outer;
+    switch (static_cast<StrokePosition>(element.strokePosition)) {
+        case StrokePosition::Outside:
+            inner = 0;
+            outer = element.strokeWidth;
+            break;
+        case StrokePosition::Center:
+            inner = -element.strokeWidth / 2;
+            outer = element.strokeWidth / 2;
+            break;
+        default:
+            inner = -element.strokeWidth;
+            outer = 0;
+            break;
+    }
+
+    if (distance >= outer + AABoundaryHalf) {
+        return false;
+    }
+
+    if (distance < inner - AABoundaryHalf || element.strokeWidth <= 0) {
+        return element.fill.a > 0;
+    }
+
+    return element.stroke.a > 0;
+}
+
+ElementBatch::ElementBatch(Internal::VectorObjectType type)
+    : type(type) {
+}
+
+void ElementBatch::clear() {
+    x1.clear();
+    y1.clear();
+    x2.clear();
+    y2.clear();
+    x3.clear();
+    y3.clear();
+    f1.clear();
+}
+
+void ElementBatch::add(const Internal::VectorElement &element) {
+    x1.push_back(element.p1.x);
+    y1.push_back(element.p1.y);
+    x2.push_back(element.p2.x);
+    y2.push_back(element.p2.y);
+    x3.push_back(element.p3.x);
+    y3.push_back(element.p3.y);
+    f1.push_back(element.f1);
+}
+
+void ElementBatch::getDistances(const glm::vec2 &point, float *distances) const {
+    auto count = size();
+    switch (type) {
+        case Internal::VectorObjectType::Circle:
+            for (size_t index = 0; index < count; ++index) {
+                distances[index] = Distance::circleDistance(point.x, point.y, x1[index], y1[index], f1[index]);
+            }
+            break;
+        case Internal::VectorObjectType::Line:
+            for (size_t index = 0; index < count; ++index) {
+                distances[index] = Distance::lineDistance(
+                    point.x, point.y, x1[index], y1[index], x2[index], y2[index], f1[index] / 2
+                );
+            }
+            break;
+        case Internal::VectorObjectType::BezierCurve:
+            for (size_t index = 0; index < count; ++index) {
+                distances[index] = Distance::bezierDistance(
+                    point, { x1[index], y1[index] }, { x2[index], y2[index] }, { x3[index], y3[index] }, f1[index] / 2
+                );
+            }
+            break;
+        case Internal::VectorObjectType::ArcLine:
+            for (size_t index = 0; index < count; ++index) {
+                distances[index] = Distance::arclineDistance(
+                    point, { x1[index], y1[index] }, f1[index], x2[index], y2[index], x3[index] / 2
+                );
+            }
+            break;
+        default:
+            std::fill(distances, distances + count, NoMinimum);
+            break;
+    }
+}
+
+ShapeIndex::ShapeIndex(float cellSize)
+    : cellSize(cellSize), inverseCellSize(1 / cellSize) {
+}
+
+void ShapeIndex::insert(uint32_t slot, const glm::vec4 &bounds) {
+    if (slot >= records.size()) {
+        records.resize(slot + 1);
+    }
+
+    auto &record = records[slot];
+    bool empty = !(bounds.x <= bounds.z && bounds.y <= bounds.w);
+    auto minCell = cellFor({ bounds.x, bounds.y });
+    auto maxCell = cellFor({ bounds.z, bounds.w });
+    if (empty) {
+        minCell = { 0, 0 };
+        maxCell = { -1, -1 };
+    }
+
+    if (!record.inIndex) {
+        record.inIndex = true;
+        ++count;
+    } else if (minCell == record.minCell && maxCell == record.maxCell) {
+        record.bounds = bounds;
+        return;
+    } else {
+        removeFromCells(slot);
+    }
+
+    record.bounds = bounds;
+    record.minCell = minCell;
+    record.maxCell = maxCell;
+    record.oversized = !empty &&
+        (static_cast<int64_t>(maxCell.x) - minCell.x + 1) * (static_cast<int64_t>(maxCell.y) - minCell.y + 1) >
+            MaxElementCells;
+    addToCells(slot);
+}
+
+void ShapeIndex::remove(uint32_t slot) {
+    if (slot >= records.size() || !records[slot].inIndex) {
+        return;
+    }
+
+    removeFromCells(slot);
+    records[slot].inIndex = false;
+    --count;
+}
+
+void ShapeIndex::findAtPoint(const glm::vec2 &point, std::vector<uint32_t> &slots) const {
+    findInRect(point, point, slots);
+}
+
+void ShapeIndex::findInRect(const glm::vec2 &min, const glm::vec2 &max, std::vector<uint32_t> &slots) const {
+    slots.clear();
+
+    auto minCell = cellFor(min);
+    auto maxCell = cellFor(max);
+
+    // Walking the occupied cells is cheaper than the empty ones in a big rectangle
+    auto rectCells =
+        (static_cast<int64_t>(maxCell.x) - minCell.x + 1) * (static_cast<int64_t>(maxCell.y) - minCell.y + 1);
+    bool walkOccupied = rectCells > static_cast<int64_t>(cells.size());
+
+    ++currentQuery;
+    auto visitCell = [&](const std::vector<uint32_t> &cellSlots) {
+        for (auto slot : cellSlots) {
+            auto &record = records[slot];
+            if (record.queryStamp == currentQuery) {
+                continue;
+            }
+            record.queryStamp = currentQuery;
+
+            // Cells are coarse, make sure the bounds actually overlap
+            auto &bounds = record.bounds;
+            if (bounds.x <= max.x && bounds.z >= min.x && bounds.y <= max.y && bounds.w >= min.y) {
+                slots.push_back(slot);
+            }
+        }
+    };
+
+    visitCell(oversized);
+
+    if (walkOccupied) {
+        for (auto &pair : cells) {
+            glm::ivec2 cell { static_cast<int32_t>(pair.first >> 32), static_cast<int32_t>(pair.first & 0xFFFFFFFF) };
+            if (cell.x >= minCell.x && cell.x <= maxCell.x && cell.y >= minCell.y && cell.y <= maxCell.y) {
+                visitCell(pair.second);
+            }
+        }
+    } else {
+        for (auto y = minCell.y; y <= maxCell.y; ++y) {
+            for (auto x = minCell.x; x <= maxCell.x; ++x) {
+                auto it = cells.find(makeKey(x, y));
+                if (it != cells.end()) {
+                    visitCell(it->second);
+                }
+            }
+        }
+    }
+}
+
+void ShapeIndex::findInFrustum(
+    const Engine::Frustum &frustum, float minHeight, float maxHeight, std::vector<uint32_t> &slots
+) const {
+    slots.clear();
+
+    for (auto slot : oversized) {
+        auto &bounds = records[slot].bounds;
+        Engine::BoundingBox elementBounds(bounds.x, bounds.y, minHeight, bounds.z, bounds.w, maxHeight);
+        if (elementBounds.intersects(frustum)) {
+            slots.push_back(slot);
+        }
+    }
+
+    ++currentQuery;
+    for (auto &pair : cells) {
+        glm::vec2 cellMin {
+            static_cast<float>(static_cast<int32_t>(pair.first >> 32)) * cellSize,
+            static_cast<float>(static_cast<int32_t>(pair.first & 0xFFFFFFFF)) * cellSize
+        };
+
+        Engine::BoundingBox cellBounds(
+            cellMin.x, cellMin.y, minHeight, cellMin.x + cellSize, cellMin.y + cellSize, maxHeight
+        );
+        if (!cellBounds.intersects(frustum)) {
+            continue;
+        }
+
+        for (auto slot : pair.second) {
+            auto &record = records[slot];
+            if (record.queryStamp == currentQuery) {
+                continue;
+            }
+            record.queryStamp = currentQuery;
+
+            auto &bounds = record.bounds;
+            Engine::BoundingBox elementBounds(bounds.x, bounds.y, minHeight, bounds.z, bounds.w, maxHeight);
+            if (elementBounds.intersects(frustum)) {
+                slots.push_back(slot);
+            }
+        }
+    }
+}
+
+glm::ivec2 ShapeIndex::cellFor(const glm::vec2 &position) const {
+    // Clamped so that huge bounds do not overflow
+    auto limit = static_cast<float>(1 << 30);
+    return {
+        static_cast<int32_t>(std::clamp(std::floor(position.x * inverseCellSize), -limit, limit)),
+        static_cast<int32_t>(std::clamp(std::floor(position.y * inverseCellSize), -limit, limit))
+    };
+}
+
+uint64_t ShapeIndex::makeKey(int32_t x, int32_t y) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+}
+
+void ShapeIndex::addToCells(uint32_t slot) {
+    auto &record = records[slot];
+    if (record.oversized) {
+        oversized.push_back(slot);
+        return;
+    }
+
+    for (auto y = record.minCell.y; y <= record.maxCell.y; ++y) {
+        for (auto x = record.minCell.x; x <= record.maxCell.x; ++x) {
+            cells[makeKey(x, y)].push_back(slot);
+        }
+    }
+}
+
+void ShapeIndex::removeFromCells(uint32_t slot) {
+    auto &record = records[slot];
+    if (record.oversized) {
+        auto it = std::find(oversized.begin(), oversized.end(), slot);
+        if (it != oversized.end()) {
+            *it = oversized.back();
+            oversized.pop_back();
+        }
+        return;
+    }
+
+    for (auto y = record.minCell.y; y <= record.maxCell.y; ++y) {
+        for (auto x = record.minCell.x; x <= record.maxCell.x; ++x) {
+            auto it = cells.find(makeKey(x, y));
+            if (it == cells.end()) {
+                continue;
+            }
+
+            auto &slots = it->second;
+            auto slotIt = std::find(slots.begin(), slots.end(), slot);
+            if (slotIt != slots.end()) {
+                *slotIt = slots.back();
+                slots.pop_back();
+            }
+
+            if (slots.empty()) {
+                cells.erase(it);
+            }
+        }
+    }
+}
+
+}
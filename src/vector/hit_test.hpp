@@ -0,0 +1,124 @@
+#pragma once
+
+#include "internal.hpp"
+#include <tech-core/shapes/frustum.hpp>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Vector {
+
+/**
+ * Signed distance from the point to the edge of the element, negative inside.
+ * Matches the distance functions in vector_draw.glsl.
+ */
+float getElementDistance(const Internal::VectorElement &element, const glm::vec2 &point);
+
+/**
+ * Whether the element draws anything visible at the given distance from its edge, following fillOrStroke in
+ * vector_draw.glsl
+ */
+bool isVisibleAtDistance(const Internal::VectorElement &element, float distance);
+
+/**
+ * Elements of a single type stored as separate arrays, so the distance from a point to all of them is found in one
+ * loop. Circles and lines need no branches and vectorise.
+ */
+class ElementBatch {
+public:
+    explicit ElementBatch(Internal::VectorObjectType type);
+
+    Internal::VectorObjectType getType() const { return type; }
+
+    size_t size() const { return f1.size(); }
+
+    void clear();
+    /**
+     * Adds an element, which must be of the type of the batch
+     */
+    void add(const Internal::VectorElement &element);
+
+    /**
+     * Writes the distance from the point to each element in the order they were added
+     */
+    void getDistances(const glm::vec2 &point, float *distances) const;
+
+private:
+    Internal::VectorObjectType type;
+
+    std::vector<float> x1;
+    std::vector<float> y1;
+    std::vector<float> x2;
+    std::vector<float> y2;
+    std::vector<float> x3;
+    std::vector<float> y3;
+    std::vector<float> f1;
+};
+
+/**
+ * Indexes the bounds of elements in a uniform grid, by the slot they occupy in the element buffer.
+ * An element is listed in every cell its bounds overlap, unless that is too many cells. Those elements are kept in a
+ * list which every query tests.
+ */
+class ShapeIndex {
+public:
+    explicit ShapeIndex(float cellSize);
+
+    size_t size() const { return count; }
+
+    /**
+     * Adds the slot, or moves it if it is already in the index
+     * @param bounds min x, min y, max x, max y. Empty bounds are kept out of every cell
+     */
+    void insert(uint32_t slot, const glm::vec4 &bounds);
+    void remove(uint32_t slot);
+
+    /**
+     * Finds the slots with bounds containing the point
+     */
+    void findAtPoint(const glm::vec2 &point, std::vector<uint32_t> &slots) const;
+
+    /**
+     * Finds the slots with bounds overlapping the rectangle
+     */
+    void findInRect(const glm::vec2 &min, const glm::vec2 &max, std::vector<uint32_t> &slots) const;
+
+    /**
+     * Finds the slots with bounds which may be visible, treating each element as a box over the height range
+     */
+    void findInFrustum(
+        const Engine::Frustum &frustum, float minHeight, float maxHeight, std::vector<uint32_t> &slots
+    ) const;
+
+private:
+    struct Record {
+        bool inIndex { false };
+        glm::vec4 bounds;
+        glm::ivec2 minCell;
+        glm::ivec2 maxCell;
+        bool oversized { false };
+        // Prevents an element spanning several cells from being reported more than once per query
+        mutable uint32_t queryStamp { 0 };
+    };
+
+    float cellSize;
+    float inverseCellSize;
+
+    std::vector<Record> records;
+    size_t count { 0 };
+    // Slots overlapping each cell
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+    // Slots with bounds over too many cells to list in each
+    std::vector<uint32_t> oversized;
+
+    mutable uint32_t currentQuery { 0 };
+
+    glm::ivec2 cellFor(const glm::vec2 &position) const;
+    static uint64_t makeKey(int32_t x, int32_t y);
+
+    void addToCells(uint32_t slot);
+    void removeFromCells(uint32_t slot);
+};
+
+}
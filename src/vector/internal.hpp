@@ -2,7 +2,6 @@
 
 #include <glm/glm.hpp>
 
-#define MAX_ELEMENTS 100
 #define NO_SLOT 0xFFFFFFFF
 
 namespace Internal {
@@ -42,9 +41,4 @@ struct VectorElement {
     alignas(4) uint32_t strokePosition { 0 };
 };
 
-struct VectorElementGroup {
-    VectorElement elements[MAX_ELEMENTS];
-    alignas(4) uint32_t count { 0 };
-};
-
 }
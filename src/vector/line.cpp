@@ -14,15 +14,15 @@ Vector::Line::Line(const glm::vec2 &start, const glm::vec2 &end, float size)
 
 void Vector::Line::setStart(const glm::vec2 &pos) {
     element.p1 = pos;
-    isModified = true;
+    markModified();
 }
 
 void Vector::Line::setEnd(const glm::vec2 &pos) {
     element.p2 = pos;
-    isModified = true;
+    markModified();
 }
 
 void Vector::Line::setSize(float size) {
     element.f1 = size;
-    isModified = true;
+    markModified();
 }
@@ -1,95 +1,408 @@
 #include "vector_graphics.hpp"
+#include "../utils/profiler.hpp"
 #include <tech-core/camera.hpp>
 #include <tech-core/buffer.hpp>
 #include <tech-core/engine.hpp>
+#include <algorithm>
+#include <cstring>
 
 namespace Vector {
 
+// Size of the screen tiles in pixels
+const uint32_t TileSize = 32;
+const uint32_t InitialElementCapacity = 256;
+const uint32_t InitialBinCapacity = 16384;
+// Updates to keep replaced buffers for, covering every frame in flight
+const uint32_t RetireUpdates = 4;
+// Unmodified slots between modified ones which are still flushed as one range
+const uint32_t MaxFlushGap = 2;
+// Size of the cells in the shape index, in the units of the elements
+const float IndexCellSize = 64;
+
 VectorGraphics::VectorGraphics(Engine::RenderEngine &engine, bool only2D)
-    : use2DOnly(only2D) {
+    : engine(engine), use2DOnly(only2D), index(IndexCellSize), binning(TileSize) {
     uniformBuffer = engine.getBufferManager().aquire(
         sizeof(VGUniformBuffer), vk::BufferUsageFlagBits::eUniformBuffer, vk::MemoryUsage::eCPUToGPU
     );
     uniformBuffer->map(reinterpret_cast<void **>(&uniformMapped));
+    uniformMapped->tileSize = TileSize;
+    uniformMapped->tilesX = 0;
 
-    vectorUniformBuffer = engine.getBufferManager().aquire(
-        sizeof(Internal::VectorElementGroup), vk::BufferUsageFlagBits::eUniformBuffer, vk::MemoryUsage::eCPUToGPU
-    );
-    vectorUniformBuffer->map(reinterpret_cast<void **>(&mappedElements));
-    mappedElements->count = 0;
+    for (auto type : {
+        Internal::VectorObjectType::Circle, Internal::VectorObjectType::Line,
+        Internal::VectorObjectType::BezierCurve, Internal::VectorObjectType::ArcLine
+    }) {
+        queryBatches.emplace_back(type);
+    }
+    batchSlots.resize(queryBatches.size());
 
-    effect = engine.createEffect("Vector Markers")
-        .withShader("assets/shaders/post_processing/vector_draw.spv")
-        .bindUniformBuffer(0, 2, uniformBuffer)
-        .bindUniformBuffer(0, 3, vectorUniformBuffer)
-        .withShaderConstant(0, use2DOnly)
-        .build();
+    growElements(InitialElementCapacity);
+    growBins(InitialBinCapacity);
+    buildEffect();
 }
 
 VectorGraphics::~VectorGraphics() {
+    // Objects may outlive this, stop them reporting changes to it
+    for (auto &object : objects) {
+        object->owner = nullptr;
+        object->slotIndex = NO_SLOT;
+        object->drawIndex = NO_SLOT;
+        object->prevModified = nullptr;
+        object->nextModified = nullptr;
+    }
+
     uniformBuffer->unmap();
-    vectorUniformBuffer->unmap();
+    elementBuffer->unmap();
+    binBuffer->unmap();
+}
+
+void VectorGraphics::setHeightRange(float min, float max) {
+    minHeight = min;
+    maxHeight = max;
 }
 
 void VectorGraphics::update(Engine::RenderEngine &engine) {
+    PROFILE_ZONE("VectorGraphics::update");
+
+    ++updateCount;
+    retired.erase(
+        std::remove_if(
+            retired.begin(), retired.end(), [this](const RetiredBuffer &retiredBuffer) {
+                return retiredBuffer.releaseUpdate <= updateCount;
+            }
+        ),
+        retired.end()
+    );
+
     auto bounds = engine.getScreenBounds();
+    glm::vec2 viewport { bounds.width(), bounds.height() };
+    glm::mat4 viewProj;
     if (!use2DOnly) {
         const auto *camUniform = engine.getCamera()->getUBO();
-        auto invViewProj = glm::inverse(camUniform->proj * camUniform->view);
+        viewProj = camUniform->proj * camUniform->view;
 
-        uniformMapped->inverseViewProj = invViewProj;
+        uniformMapped->inverseViewProj = glm::inverse(viewProj);
     }
 
-    uniformMapped->viewport = { bounds.width(), bounds.height() };
+    uniformMapped->viewport = viewport;
 
-    for (auto &object : objects) {
-        if (object->isModified) {
-            setElement(object->slotIndex, *object);
-            object->isModified = false;
+    uploadModified();
+
+    {
+        PROFILE_ZONE("VectorGraphics::bin");
+
+        if (use2DOnly) {
+            index.findInRect({ 0, 0 }, viewport, visibleSlots);
+        } else {
+            index.findInFrustum(engine.getCamera()->getFrustum(), minHeight, maxHeight, visibleSlots);
+        }
+        // The index has no order, overlapping elements must blend the same every frame
+        sortByDrawOrder(visibleSlots);
+
+        screenBounds.resize(visibleSlots.size());
+        for (size_t visible = 0; visible < visibleSlots.size(); ++visible) {
+            auto &elementBound = elementBounds[visibleSlots[visible]];
+            if (use2DOnly) {
+                // Positions are already in pixels
+                screenBounds[visible] = elementBound;
+            } else {
+                screenBounds[visible] = projectBounds(elementBound, viewProj, minHeight, maxHeight, viewport);
+            }
+        }
+
+        binning.bin(viewport, screenBounds);
+    }
+
+    uploadBins();
+    uniformMapped->tilesX = binning.getTilesX();
+}
+
+void VectorGraphics::uploadModified() {
+    modifiedSlots.clear();
+
+    auto *object = firstModified;
+    while (object) {
+        auto *next = object->nextModified;
+
+        setElement(object->slotIndex, *object);
+        modifiedSlots.push_back(object->slotIndex);
+
+        object->isModified = false;
+        object->prevModified = nullptr;
+        object->nextModified = nullptr;
+        object = next;
+    }
+    firstModified = nullptr;
+
+    // Flush runs of neighbouring slots together, small gaps are cheaper to flush than to split over
+    std::sort(modifiedSlots.begin(), modifiedSlots.end());
+    size_t index = 0;
+    while (index < modifiedSlots.size()) {
+        auto first = modifiedSlots[index];
+        auto last = first;
+        ++index;
+
+        while (index < modifiedSlots.size() && modifiedSlots[index] <= last + MaxFlushGap + 1) {
+            last = modifiedSlots[index];
+            ++index;
         }
+
+        elementBuffer->flushRange(
+            first * sizeof(Internal::VectorElement), (last - first + 1) * sizeof(Internal::VectorElement)
+        );
     }
 }
 
-void VectorGraphics::setElement(uint32_t index, Vector::Object &object) {
-    mappedElements->elements[index] = object.element;
+void VectorGraphics::uploadBins() {
+    auto &binData = binning.getData();
+    if (binData.size() > binCapacity) {
+        auto capacity = binCapacity;
+        while (capacity < binData.size()) {
+            capacity *= 2;
+        }
+
+        growBins(capacity);
+        buildEffect();
+    }
+
+    // The bins hold positions in the visible list, the shader needs slots
+    auto offsetCount = binning.getTileCount() + 1;
+    std::memcpy(mappedBins, binData.data(), offsetCount * sizeof(uint32_t));
+    for (size_t index = offsetCount; index < binData.size(); ++index) {
+        mappedBins[index] = visibleSlots[binData[index]];
+    }
+
+    binBuffer->flushRange(0, binData.size() * sizeof(uint32_t));
+}
+
+void VectorGraphics::setElement(uint32_t slot, Vector::Object &object) {
+    mappedElements[slot] = object.element;
+    updateBounds(slot, object);
+}
+
+void VectorGraphics::updateBounds(uint32_t slot, Vector::Object &object) {
+    elementBounds[slot] = getElementBounds(object.element);
+    index.insert(slot, elementBounds[slot]);
+}
+
+void VectorGraphics::updatePendingBounds() {
+    // Queries should see changes made since the last update
+    for (auto *object = firstModified; object; object = object->nextModified) {
+        updateBounds(object->slotIndex, *object);
+    }
+}
+
+void VectorGraphics::sortByDrawOrder(std::vector<uint32_t> &slots) const {
+    std::sort(
+        slots.begin(), slots.end(), [this](uint32_t a, uint32_t b) {
+            return slotObjects[a]->drawIndex < slotObjects[b]->drawIndex;
+        }
+    );
+}
+
+std::shared_ptr<Vector::Object> VectorGraphics::pick(const glm::vec2 &point, float tolerance) {
+    PROFILE_ZONE("VectorGraphics::pick");
+
+    updatePendingBounds();
+    index.findInRect(point - tolerance, point + tolerance, querySlots);
+
+    for (size_t type = 0; type < queryBatches.size(); ++type) {
+        queryBatches[type].clear();
+        batchSlots[type].clear();
+    }
+
+    for (auto slot : querySlots) {
+        auto &element = slotObjects[slot]->element;
+        auto type = static_cast<size_t>(element.type);
+        if (type < queryBatches.size()) {
+            queryBatches[type].add(element);
+            batchSlots[type].push_back(slot);
+        }
+    }
+
+    Object *best = nullptr;
+    for (size_t type = 0; type < queryBatches.size(); ++type) {
+        auto &batch = queryBatches[type];
+        queryDistances.resize(batch.size());
+        batch.getDistances(point, queryDistances.data());
+
+        for (size_t item = 0; item < batch.size(); ++item) {
+            auto *object = slotObjects[batchSlots[type][item]];
+            if (best && best->drawIndex > object->drawIndex) {
+                continue;
+            }
+
+            // Anything within the tolerance is treated as if it were on the closest point
+            auto distance = queryDistances[item];
+            if (distance > 0) {
+                distance = std::max(distance - tolerance, 0.0f);
+            }
+
+            if (isVisibleAtDistance(object->element, distance)) {
+                best = object;
+            }
+        }
+    }
+
+    if (!best) {
+        return {};
+    }
+
+    return objects[best->drawIndex];
+}
+
+void VectorGraphics::findInRect(
+    const glm::vec2 &min, const glm::vec2 &max, std::vector<std::shared_ptr<Vector::Object>> &found
+) {
+    updatePendingBounds();
+    index.findInRect(min, max, querySlots);
+    sortByDrawOrder(querySlots);
+
+    found.clear();
+    for (auto slot : querySlots) {
+        found.push_back(objects[slotObjects[slot]->drawIndex]);
+    }
 }
 
 bool VectorGraphics::addObject(const std::shared_ptr<Vector::Object> &object) {
-    if (objects.size() >= MAX_ELEMENTS) {
+    if (object->owner) {
         return false;
     }
 
-    object->slotIndex = objects.size();
+    object->owner = this;
+    object->slotIndex = allocateSlot();
+    object->drawIndex = objects.size();
     objects.emplace_back(object);
+    slotObjects[object->slotIndex] = object.get();
 
-    setElement(object->slotIndex, *object);
-    mappedElements->count = objects.size();
+    // Changes made before it was added were not tracked
+    object->isModified = false;
+    object->markModified();
     return true;
 }
 
 bool VectorGraphics::removeObject(const std::shared_ptr<Vector::Object> &object) {
-    if (object->slotIndex == NO_SLOT) {
+    if (object->owner != this) {
         return false;
     }
 
-    if (object->slotIndex < objects.size() - 1) {
-        for (auto index = object->slotIndex + 1; index < objects.size(); ++index) {
-            --objects[index]->slotIndex;
-            objects[index - 1] = objects[index];
-        }
-
-        std::memmove(
-            &mappedElements->elements[object->slotIndex],
-            &mappedElements->elements[object->slotIndex + 1],
-            sizeof(Internal::VectorElement) * (objects.size() - object->slotIndex - 1)
-        );
+    if (object->isModified) {
+        unlinkModified(*object);
+        object->isModified = false;
     }
 
+    // Fill the gap in the draw order with the last object
+    auto drawIndex = object->drawIndex;
+    if (drawIndex != objects.size() - 1) {
+        objects[drawIndex] = std::move(objects.back());
+        objects[drawIndex]->drawIndex = drawIndex;
+    }
     objects.pop_back();
-    mappedElements->count = objects.size();
 
+    index.remove(object->slotIndex);
+    slotObjects[object->slotIndex] = nullptr;
+    freeSlots.push_back(object->slotIndex);
+
+    object->owner = nullptr;
     object->slotIndex = NO_SLOT;
+    object->drawIndex = NO_SLOT;
     return true;
 }
 
-}
\ No newline at end of file
+uint32_t VectorGraphics::allocateSlot() {
+    if (!freeSlots.empty()) {
+        auto slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+
+    if (slotCount >= elementCapacity) {
+        growElements(elementCapacity * 2);
+        buildEffect();
+    }
+
+    elementBounds.emplace_back();
+    slotObjects.push_back(nullptr);
+    return slotCount++;
+}
+
+void VectorGraphics::linkModified(Object &object) {
+    object.prevModified = nullptr;
+    object.nextModified = firstModified;
+    if (firstModified) {
+        firstModified->prevModified = &object;
+    }
+    firstModified = &object;
+}
+
+void VectorGraphics::unlinkModified(Object &object) {
+    if (object.prevModified) {
+        object.prevModified->nextModified = object.nextModified;
+    } else {
+        firstModified = object.nextModified;
+    }
+
+    if (object.nextModified) {
+        object.nextModified->prevModified = object.prevModified;
+    }
+
+    object.prevModified = nullptr;
+    object.nextModified = nullptr;
+}
+
+void VectorGraphics::growElements(uint32_t capacity) {
+    auto buffer = engine.getBufferManager().aquire(
+        capacity * sizeof(Internal::VectorElement), vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryUsage::eCPUToGPU
+    );
+
+    Internal::VectorElement *mapped;
+    buffer->map(reinterpret_cast<void **>(&mapped));
+    if (elementBuffer) {
+        std::memcpy(mapped, mappedElements, slotCount * sizeof(Internal::VectorElement));
+        buffer->flushRange(0, slotCount * sizeof(Internal::VectorElement));
+        retire(std::move(elementBuffer));
+    }
+
+    elementBuffer = std::move(buffer);
+    mappedElements = mapped;
+    elementCapacity = capacity;
+}
+
+void VectorGraphics::growBins(uint32_t capacity) {
+    auto buffer = engine.getBufferManager().aquire(
+        capacity * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryUsage::eCPUToGPU
+    );
+
+    uint32_t *mapped;
+    buffer->map(reinterpret_cast<void **>(&mapped));
+    if (binBuffer) {
+        retire(std::move(binBuffer));
+    } else {
+        // Nothing is drawn until the first update
+        std::memset(mapped, 0, capacity * sizeof(uint32_t));
+        buffer->flushRange(0, capacity * sizeof(uint32_t));
+    }
+
+    binBuffer = std::move(buffer);
+    mappedBins = mapped;
+    binCapacity = capacity;
+}
+
+void VectorGraphics::retire(std::shared_ptr<Engine::Buffer> buffer) {
+    buffer->unmap();
+    retired.push_back({ std::move(buffer), updateCount + RetireUpdates });
+}
+
+void VectorGraphics::buildEffect() {
+    // Effects are bound to the buffers they were built with, so growing a buffer needs a new one
+    effect = engine.createEffect("Vector Markers")
+        .withShader("assets/shaders/post_processing/vector_draw.spv")
+        .bindUniformBuffer(0, 2, uniformBuffer)
+        .bindStorageBuffer(0, 3, elementBuffer)
+        .bindStorageBuffer(0, 4, binBuffer)
+        .withShaderConstant(0, use2DOnly)
+        .build();
+}
+
+}
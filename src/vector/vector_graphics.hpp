@@ -1,6 +1,8 @@
 #pragma once
 
 #include "common.hpp"
+#include "binning.hpp"
+#include "hit_test.hpp"
 
 #include <tech-core/forward.hpp>
 #include <glm/glm.hpp>
@@ -9,10 +11,28 @@
 
 namespace Vector {
 
+/**
+ * Draws vector objects over the scene as a post processing effect.
+ * Elements live in a storage buffer which grows as objects are added. Every update the screen bounds of each element
+ * are binned into tiles so that each pixel only evaluates the elements which can reach it.
+ * Each object keeps its slot in the buffer until it is removed, freed slots are reused. Objects are drawn in the order
+ * they were added, except that removing one moves the last object into its place.
+ * The bounds of every element are kept in a ShapeIndex, which skips elements off screen and answers hit tests.
+ */
 class VectorGraphics {
+    friend class Object;
+
     struct VGUniformBuffer {
         glm::mat4 inverseViewProj;
         glm::vec2 viewport;
+        uint32_t tileSize;
+        uint32_t tilesX;
+    };
+
+    // Buffers replaced by growing, kept until the frames which may use them are done
+    struct RetiredBuffer {
+        std::shared_ptr<Engine::Buffer> buffer;
+        uint32_t releaseUpdate;
     };
 
 public:
@@ -20,24 +40,96 @@ public:
     ~VectorGraphics();
     void update(Engine::RenderEngine &);
 
+    /**
+     * The range of heights in the world that objects can be drawn on, used to find where they are on screen.
+     * Only used when drawing in 3D.
+     */
+    void setHeightRange(float min, float max);
+
+    size_t getObjectCount() const { return objects.size(); }
+
+    const TileBinning &getBinning() const { return binning; }
+
+    /**
+     * The number of elements which were on screen in the last update
+     */
+    size_t getVisibleCount() const { return visibleSlots.size(); }
+
+    /**
+     * Finds the top most object which draws something at the point, or within the tolerance of where it would.
+     * Points are in the same space as the objects, pixels in 2D and world XY otherwise.
+     */
+    std::shared_ptr<Vector::Object> pick(const glm::vec2 &point, float tolerance = 0);
+
+    /**
+     * Finds the objects with bounds overlapping the rectangle, in draw order
+     */
+    void findInRect(const glm::vec2 &min, const glm::vec2 &max, std::vector<std::shared_ptr<Vector::Object>> &found);
+
     bool addObject(const std::shared_ptr<Vector::Object> &object);
     template<typename T, typename...Args>
     std::shared_ptr<T> addObject(Args ...args);
 
     bool removeObject(const std::shared_ptr<Vector::Object> &object);
 private:
+    Engine::RenderEngine &engine;
     bool use2DOnly { false };
+    float minHeight { 0 };
+    float maxHeight { 0 };
 
     std::shared_ptr<Engine::Effect> effect;
     std::shared_ptr<Engine::Buffer> uniformBuffer;
-    std::shared_ptr<Engine::Buffer> vectorUniformBuffer;
+    std::shared_ptr<Engine::Buffer> elementBuffer;
+    std::shared_ptr<Engine::Buffer> binBuffer;
 
     VGUniformBuffer *uniformMapped { nullptr };
-    Internal::VectorElementGroup *mappedElements { nullptr };
+    Internal::VectorElement *mappedElements { nullptr };
+    uint32_t *mappedBins { nullptr };
+    uint32_t elementCapacity { 0 };
+    uint32_t binCapacity { 0 };
 
+    // In draw order
     std::vector<std::shared_ptr<Vector::Object>> objects;
+    // The object in each slot, null for free slots
+    std::vector<Object *> slotObjects;
+    uint32_t slotCount { 0 };
+    std::vector<uint32_t> freeSlots;
+
+    // Objects to upload on the next update
+    Object *firstModified { nullptr };
+    std::vector<uint32_t> modifiedSlots;
+
+    // Per slot, in world space
+    std::vector<glm::vec4> elementBounds;
+    ShapeIndex index;
+    // Slots of the elements which may be on screen, in draw order
+    std::vector<uint32_t> visibleSlots;
+    // Parallel to visibleSlots
+    std::vector<glm::vec4> screenBounds;
+    TileBinning binning;
 
-    void setElement(uint32_t index, Vector::Object &);
+    // Reused by hit tests, one batch for each type of element
+    std::vector<uint32_t> querySlots;
+    std::vector<ElementBatch> queryBatches;
+    std::vector<std::vector<uint32_t>> batchSlots;
+    std::vector<float> queryDistances;
+
+    std::vector<RetiredBuffer> retired;
+    uint32_t updateCount { 0 };
+
+    void setElement(uint32_t slot, Vector::Object &);
+    void updateBounds(uint32_t slot, Vector::Object &);
+    void updatePendingBounds();
+    void sortByDrawOrder(std::vector<uint32_t> &slots) const;
+    uint32_t allocateSlot();
+    void linkModified(Object &);
+    void unlinkModified(Object &);
+    void uploadModified();
+    void uploadBins();
+    void growElements(uint32_t capacity);
+    void growBins(uint32_t capacity);
+    void retire(std::shared_ptr<Engine::Buffer> buffer);
+    void buildEffect();
 };
 
 template<typename T, typename... Args>
@@ -50,4 +142,4 @@ std::shared_ptr<T> VectorGraphics::addObject(Args... args) {
     }
 }
 
-}
\ No newline at end of file
+}
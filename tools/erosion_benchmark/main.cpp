@@ -0,0 +1,110 @@
+#include "../../src/erosion/eroder.hpp"
+#include <glm/glm.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+const uint32_t MapSize = 2048;
+const uint64_t DropletCount = 2000000;
+const float ElevationRange = 1024;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Rolling hills with some noise on top so droplets have somewhere to go
+ */
+std::vector<float> makeHeights() {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> noise(-1, 1);
+    std::vector<float> heights(MapSize * MapSize);
+
+    for (uint32_t y = 0; y < MapSize; ++y) {
+        for (uint32_t x = 0; x < MapSize; ++x) {
+            auto hills = std::sin(static_cast<float>(x) * 0.007f) * std::cos(static_cast<float>(y) * 0.009f) +
+                0.3f * std::sin(static_cast<float>(x + y) * 0.031f);
+            heights[x + y * MapSize] = (hills * 0.4f + 0.5f) * ElevationRange + noise(random);
+        }
+    }
+
+    return heights;
+}
+
+struct Result {
+    std::vector<float> heights;
+    double hydraulicSeconds;
+    double thermalSeconds;
+};
+
+Result run(uint32_t threadCount, const std::vector<float> &original) {
+    Erosion::Eroder eroder(threadCount);
+    Result result { original, 0, 0 };
+
+    Erosion::HeightGrid grid { result.heights.data(), MapSize, MapSize };
+    Erosion::Bounds region { { 0, 0 }, { MapSize, MapSize } };
+
+    auto start = Clock::now();
+    eroder.erodeHydraulic(grid, region, DropletCount, 42, {});
+    result.hydraulicSeconds = secondsSince(start);
+
+    start = Clock::now();
+    eroder.relaxThermal(grid, region, {});
+    result.thermalSeconds = secondsSince(start);
+
+    return result;
+}
+
+int main() {
+    auto original = makeHeights();
+    std::cout << DropletCount << " droplets and " << Erosion::ThermalSettings {}.iterations
+        << " thermal iterations on " << MapSize << "x" << MapSize << std::endl;
+
+    std::vector<uint32_t> threadCounts { 1 };
+    auto hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (uint32_t count = 2; count < hardwareThreads; count *= 2) {
+        threadCounts.push_back(count);
+    }
+    if (hardwareThreads > 1) {
+        threadCounts.push_back(hardwareThreads);
+    }
+
+    bool passed = true;
+    Result single;
+
+    for (auto threadCount : threadCounts) {
+        auto result = run(threadCount, original);
+        auto rate = static_cast<double>(DropletCount) / result.hydraulicSeconds;
+
+        std::cout << threadCount << " threads: " << rate / 1e6 << "M droplets/s";
+        if (threadCount == 1) {
+            single = std::move(result);
+            std::cout << ", thermal " << single.thermalSeconds * 1000 << "ms" << std::endl;
+            continue;
+        }
+
+        std::cout << " (" << single.hydraulicSeconds / result.hydraulicSeconds << "x), thermal "
+            << result.thermalSeconds * 1000 << "ms (" << single.thermalSeconds / result.thermalSeconds << "x)";
+
+        // The tiles are what make it deterministic, any difference means two of them touched the same pixels
+        bool same = std::memcmp(result.heights.data(), single.heights.data(), single.heights.size() * sizeof(float))
+            == 0;
+        std::cout << (same ? "" : ", DIFFERS from 1 thread") << std::endl;
+        passed = passed && same;
+    }
+
+    double moved = 0;
+    for (size_t index = 0; index < original.size(); ++index) {
+        moved += std::abs(single.heights[index] - original[index]);
+    }
+    std::cout << "Mean change in height: " << moved / static_cast<double>(original.size()) << std::endl;
+    std::cout << "Same result on every thread count: " << (passed ? "ok" : "FAILED") << std::endl;
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+#include "../../src/heightmap_sampler.hpp"
+#include <glm/glm.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+const uint32_t MapSize = 2048;
+const uint32_t CheckCount = 200000;
+// Every benchmark looks up at least this many samples in total
+const uint32_t BenchmarkSamples = 4000000;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+// Results are written here so the samples are not optimised away
+volatile float Sink;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Rolling hills with some noise on top so neighbouring pixels differ
+ */
+std::vector<uint16_t> makeBitmap(std::mt19937 &random) {
+    std::uniform_int_distribution<int32_t> noise(-200, 200);
+    std::vector<uint16_t> bitmap(MapSize * MapSize);
+
+    for (uint32_t y = 0; y < MapSize; ++y) {
+        for (uint32_t x = 0; x < MapSize; ++x) {
+            auto hills = std::sin(static_cast<float>(x) * 0.01f) * std::cos(static_cast<float>(y) * 0.013f);
+            auto value = 32768 + static_cast<int32_t>(hills * 30000) + noise(random);
+            bitmap[x + y * MapSize] = static_cast<uint16_t>(std::clamp(value, 0, 65535));
+        }
+    }
+
+    return bitmap;
+}
+
+/**
+ * Points anywhere in and around the heightmap, with some exactly on pixels and edges
+ */
+std::vector<glm::vec2> makeCoords(std::mt19937 &random, uint32_t count) {
+    std::uniform_real_distribution<float> position(-16, MapSize + 16);
+    std::uniform_int_distribution<uint32_t> pixel(0, MapSize - 1);
+    std::uniform_int_distribution<uint32_t> kind(0, 9);
+
+    std::vector<glm::vec2> coords(count);
+    for (auto &coord : coords) {
+        switch (kind(random)) {
+            case 0:
+                coord = { static_cast<float>(pixel(random)), static_cast<float>(pixel(random)) };
+                break;
+            case 1:
+                coord = { static_cast<float>(MapSize - 1), position(random) };
+                break;
+            case 2:
+                coord = { position(random), static_cast<float>(MapSize - 1) };
+                break;
+            default:
+                coord = { position(random), position(random) };
+                break;
+        }
+    }
+    coords.push_back({ std::numeric_limits<float>::quiet_NaN(), 10 });
+
+    return coords;
+}
+
+bool same(float a, float b) {
+    return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+bool checkBatches(const HeightmapSampler &sampler, const std::vector<glm::vec2> &coords) {
+    std::vector<float> heights(coords.size());
+    std::vector<glm::vec3> normals(coords.size());
+    std::vector<float> slopes(coords.size());
+
+    sampler.getHeightsAt(coords, heights);
+    sampler.getNormalsAt(coords, normals);
+    sampler.getSlopesAt(coords, slopes);
+
+    for (size_t index = 0; index < coords.size(); ++index) {
+        auto &coord = coords[index];
+        auto normal = sampler.getNormalAt(coord.x, coord.y);
+
+        if (
+            !same(heights[index], sampler.getHeightAt(coord.x, coord.y)) ||
+                !same(normals[index].x, normal.x) || !same(normals[index].y, normal.y) ||
+                !same(normals[index].z, normal.z) || !same(slopes[index], sampler.getSlopeAt(coord.x, coord.y))
+            ) {
+            std::cerr << "Batch differs from single samples at " << coord.x << "," << coord.y << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Prints the samples per second looked up one at a time and in batches of each size
+ */
+template<typename Single, typename Batch>
+void benchmark(const char *name, const std::vector<glm::vec2> &coords, Single single, Batch batch) {
+    std::cout << name << std::endl;
+
+    for (uint32_t batchSize : { 1u, 1000u, 1000000u }) {
+        std::vector<float> output(batchSize * 3);
+        auto repeats = std::max(1u, BenchmarkSamples / batchSize);
+        float sink = 0;
+
+        auto start = Clock::now();
+        for (uint32_t repeat = 0; repeat < repeats; ++repeat) {
+            auto first = (repeat * batchSize) % (coords.size() - batchSize);
+            for (uint32_t index = 0; index < batchSize; ++index) {
+                sink += single(coords[first + index]);
+            }
+        }
+        auto singleRate = static_cast<double>(repeats) * batchSize / secondsSince(start);
+
+        start = Clock::now();
+        for (uint32_t repeat = 0; repeat < repeats; ++repeat) {
+            auto first = (repeat * batchSize) % (coords.size() - batchSize);
+            batch(std::span<const glm::vec2>(&coords[first], batchSize), output.data());
+            sink += output[0];
+        }
+        auto batchRate = static_cast<double>(repeats) * batchSize / secondsSince(start);
+
+        std::cout << "  " << batchSize << " points: " << singleRate / 1e6 << "M/s single, " << batchRate / 1e6
+            << "M/s batched (" << batchRate / singleRate << "x)" << std::endl;
+        Sink = sink;
+    }
+}
+
+/**
+ * Walks across the heightmap in short straight runs, like rays, grids and roads sample it
+ */
+std::vector<glm::vec2> makeWalks(std::mt19937 &random, uint32_t count) {
+    std::uniform_real_distribution<float> position(0, MapSize);
+    std::uniform_real_distribution<float> angle(0, 6.2831853f);
+    const uint32_t RunLength = 500;
+
+    std::vector<glm::vec2> coords;
+    coords.reserve(count);
+    while (coords.size() < count) {
+        glm::vec2 point { position(random), position(random) };
+        auto direction = angle(random);
+        glm::vec2 step { std::cos(direction) * 0.7f, std::sin(direction) * 0.7f };
+
+        for (uint32_t index = 0; index < RunLength && coords.size() < count; ++index) {
+            coords.push_back(point);
+            point += step;
+        }
+    }
+
+    return coords;
+}
+
+int main() {
+    std::mt19937 random(1234);
+    auto bitmap = makeBitmap(random);
+    HeightmapSampler sampler(bitmap.data(), MapSize, MapSize, -50, 974);
+
+    auto checkCoords = makeCoords(random, CheckCount);
+    bool passed = checkBatches(sampler, checkCoords);
+    std::cout << "Batches match single samples: " << (passed ? "ok" : "FAILED") << std::endl;
+
+    auto coords = makeWalks(random, 2000000);
+    benchmark(
+        "Heights", coords,
+        [&sampler](const glm::vec2 &coord) { return sampler.getHeightAt(coord.x, coord.y); },
+        [&sampler](std::span<const glm::vec2> batch, float *output) {
+            sampler.getHeightsAt(batch, { output, batch.size() });
+        }
+    );
+    benchmark(
+        "Normals", coords,
+        [&sampler](const glm::vec2 &coord) { return sampler.getNormalAt(coord.x, coord.y).z; },
+        [&sampler](std::span<const glm::vec2> batch, float *output) {
+            sampler.getNormalsAt(batch, { reinterpret_cast<glm::vec3 *>(output), batch.size() });
+        }
+    );
+    benchmark(
+        "Slopes", coords,
+        [&sampler](const glm::vec2 &coord) { return sampler.getSlopeAt(coord.x, coord.y); },
+        [&sampler](std::span<const glm::vec2> batch, float *output) {
+            sampler.getSlopesAt(batch, { output, batch.size() });
+        }
+    );
+
+    return passed ? 0 : 1;
+}
@@ -1,4 +1,8 @@
+#include "../../src/erosion/eroder.hpp"
 #include <PerlinNoise.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <vector>
 #include <iostream>
 
@@ -8,8 +12,50 @@
 
 const uint32_t width = 4096;
 const uint32_t height = 4096;
+// Matches the default elevation range of the heightmap, so the erosion settings mean the same as for the brush
+const float elevationRange = 1024;
+const float defaultDropletsPerPixel = 0.25f;
+
+/**
+ * Wears the noise down with droplets and lets the steepest slopes settle
+ */
+void erode(std::vector<uint32_t> &pixels, uint64_t dropletCount) {
+    std::vector<float> heights(width * height);
+    for (auto i = 0; i < width * height; ++i) {
+        heights[i] = static_cast<float>(pixels[i] & 0xFFFF) / 65535.0f * elevationRange;
+    }
+
+    Erosion::Eroder eroder;
+    Erosion::HeightGrid grid { heights.data(), width, height };
+    Erosion::Bounds region { { 0, 0 }, { width, height } };
+    std::cout << "Eroding with " << dropletCount << " droplets on " << eroder.getThreadCount() << " threads"
+        << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    eroder.erodeHydraulic(grid, region, dropletCount, 123456, {});
+    std::chrono::duration<double> hydraulicTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    eroder.relaxThermal(grid, region, {});
+    std::chrono::duration<double> thermalTime = std::chrono::steady_clock::now() - start;
+
+    std::cout << " Hydraulic: " << hydraulicTime.count() << "s, "
+        << static_cast<double>(dropletCount) / hydraulicTime.count() / 1e6 << "M droplets/s" << std::endl;
+    std::cout << " Thermal: " << thermalTime.count() << "s" << std::endl;
+
+    for (auto i = 0; i < width * height; ++i) {
+        auto value = std::clamp(heights[i] / elevationRange * 65535.0f + 0.5f, 0.0f, 65535.0f);
+        pixels[i] = static_cast<uint32_t>(value) | 0xFF000000;
+    }
+}
+
+int main(int argc, char **argv) {
+    // The number of droplets can be given, 0 skips erosion
+    uint64_t dropletCount = static_cast<uint64_t>(width * height * defaultDropletsPerPixel);
+    if (argc > 1) {
+        dropletCount = std::strtoull(argv[1], nullptr, 10);
+    }
 
-int main() {
     std::cout << "Generating height map image" << std::endl;
     std::cout << " Width: " << width << std::endl;
     std::cout << " Height: " << height << std::endl;
@@ -35,8 +81,12 @@ int main() {
 
     std::cout << "Finished generating height map" << std::endl;
 
+    if (dropletCount > 0) {
+        erode(pixels, dropletCount);
+        std::cout << "Finished eroding height map" << std::endl;
+    }
+
     stbi_write_png("heightmap.png", width, height, 4, pixels.data(), sizeof(uint32_t) * width);
     std::cout << "Wrote heightmap to heightmap.png" << std::endl;
     return 0;
 }
-
@@ -0,0 +1,305 @@
+#include "../../src/node/spatial_hash.hpp"
+#include "../../src/node/graph.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Matches the cell size and search radius used by the node tool
+const float CellSize = 32;
+const float QueryRadius = 20;
+// Average distance between nodes
+const float NodeSpacing = 20;
+
+const uint32_t IndexedQueries = 100000;
+const uint32_t LinearQueries = 200;
+
+const uint32_t RemovedNodes = 1000;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void benchmarkSpatialHash(uint32_t nodeCount) {
+    std::mt19937 random(1234);
+    auto extent = std::sqrt(static_cast<float>(nodeCount)) * NodeSpacing;
+    std::uniform_real_distribution<float> coordinate(0, extent);
+
+    std::vector<glm::vec3> positions(nodeCount);
+    for (auto &position : positions) {
+        position = { coordinate(random), coordinate(random), 0 };
+    }
+
+    std::vector<glm::vec3> queries(IndexedQueries);
+    for (auto &query : queries) {
+        query = { coordinate(random), coordinate(random), 0 };
+    }
+
+    auto start = Clock::now();
+    Nodes::SpatialHash<uint32_t> index(CellSize);
+    for (uint32_t node = 0; node < nodeCount; ++node) {
+        index.insert(node, positions[node]);
+    }
+    auto buildTime = secondsSince(start);
+
+    size_t found = 0;
+    start = Clock::now();
+    for (auto &query : queries) {
+        index.query(
+            query, QueryRadius, [&found](const auto &, float) {
+                ++found;
+                return false;
+            }
+        );
+    }
+    auto indexedTime = secondsSince(start) / IndexedQueries;
+
+    // The previous implementation, a full scan with a sqrt per node
+    size_t linearFound = 0;
+    start = Clock::now();
+    for (uint32_t query = 0; query < LinearQueries; ++query) {
+        for (auto &position : positions) {
+            if (glm::length(queries[query] - position) < QueryRadius) {
+                ++linearFound;
+            }
+        }
+    }
+    auto linearTime = secondsSince(start) / LinearQueries;
+
+    start = Clock::now();
+    for (uint32_t node = 0; node < nodeCount; ++node) {
+        index.move(node, positions[node] + glm::vec3(NodeSpacing, 0, 0));
+    }
+    auto moveTime = secondsSince(start) / nodeCount;
+
+    std::cout << nodeCount << " nodes" << std::endl;
+    std::cout << " Build:        " << buildTime * 1000 << "ms" << std::endl;
+    std::cout << " Query (grid): " << indexedTime * 1e6 << "us, " << static_cast<double>(found) / IndexedQueries
+        << " results on average" << std::endl;
+    std::cout << " Query (scan): " << linearTime * 1e6 << "us, " << static_cast<double>(linearFound) / LinearQueries
+        << " results on average" << std::endl;
+    std::cout << " Move:         " << moveTime * 1e9 << "ns" << std::endl;
+    std::cout << std::endl;
+}
+
+// The previous graph storage: shared nodes holding shared edges, with side tables keyed by pointer
+namespace Legacy {
+
+struct Edge;
+
+struct Node {
+    glm::vec3 position;
+    std::vector<std::shared_ptr<Edge>> edges;
+};
+
+struct Edge {
+    std::shared_ptr<Node> start;
+    std::shared_ptr<Node> end;
+    float length;
+};
+
+struct Graph {
+    std::vector<std::shared_ptr<Node>> nodes;
+    std::unordered_map<const Edge *, uint32_t> edgeObjects;
+
+    void link(const std::shared_ptr<Node> &start, const std::shared_ptr<Node> &end) {
+        auto edge = std::make_shared<Edge>(Edge { start, end, glm::length(end->position - start->position) });
+        start->edges.push_back(edge);
+        end->edges.push_back(edge);
+        edgeObjects.emplace(edge.get(), 0);
+    }
+
+    void removeNode(const std::shared_ptr<Node> &node) {
+        auto it = std::find(nodes.begin(), nodes.end(), node);
+        if (it == nodes.end()) {
+            return;
+        }
+        nodes.erase(it);
+
+        for (auto &edge : node->edges) {
+            auto &other = edge->start == node ? edge->end : edge->start;
+            other->edges.erase(std::find(other->edges.begin(), other->edges.end(), edge));
+            edgeObjects.erase(edge.get());
+        }
+        node->edges.clear();
+    }
+};
+
+}
+
+/**
+ * Builds a grid with roughly the given number of edges, each node linked to its right and upper neighbours
+ */
+void benchmarkGraph(uint32_t edgeCount) {
+    auto side = static_cast<uint32_t>(std::sqrt(static_cast<float>(edgeCount) / 2)) + 1;
+    auto nodeCount = side * side;
+
+    std::vector<glm::vec3> positions(nodeCount);
+    for (uint32_t y = 0; y < side; ++y) {
+        for (uint32_t x = 0; x < side; ++x) {
+            positions[y * side + x] = { x * NodeSpacing, y * NodeSpacing, 0 };
+        }
+    }
+
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<uint32_t> nodeDistribution(0, nodeCount - 1);
+    std::vector<uint32_t> removed(RemovedNodes);
+    for (auto &node : removed) {
+        node = nodeDistribution(random);
+    }
+
+    // Handles
+    auto start = Clock::now();
+    Nodes::Graph graph;
+    graph.reserve(nodeCount, side * (side - 1) * 2);
+
+    std::vector<Nodes::NodeId> nodeIds(nodeCount);
+    for (uint32_t node = 0; node < nodeCount; ++node) {
+        nodeIds[node] = graph.addNode(positions[node]);
+    }
+    for (uint32_t y = 0; y < side; ++y) {
+        for (uint32_t x = 0; x < side; ++x) {
+            if (x + 1 < side) {
+                graph.link(nodeIds[y * side + x], nodeIds[y * side + x + 1], 5);
+            }
+            if (y + 1 < side) {
+                graph.link(nodeIds[y * side + x], nodeIds[(y + 1) * side + x], 5);
+            }
+        }
+    }
+    graph.update();
+    auto buildTime = secondsSince(start);
+
+    start = Clock::now();
+    float totalLength = 0;
+    for (auto id : nodeIds) {
+        graph.forEachEdge(
+            id, [&totalLength](Nodes::EdgeId, const Nodes::Edge &edge) {
+                totalLength += edge.getLength();
+            }
+        );
+    }
+    auto traverseTime = secondsSince(start);
+
+    // Breadth first walk, visited flags are parallel to the node slots
+    start = Clock::now();
+    std::vector<bool> visited(nodeCount);
+    std::deque<Nodes::NodeId> open { nodeIds[0] };
+    visited[nodeIds[0].index] = true;
+    uint32_t reached = 0;
+    while (!open.empty()) {
+        auto id = open.front();
+        open.pop_front();
+        ++reached;
+
+        graph.forEachEdge(
+            id, [&](Nodes::EdgeId, const Nodes::Edge &edge) {
+                auto other = edge.getStartNode() == id ? edge.getEndNode() : edge.getStartNode();
+                if (!visited[other.index]) {
+                    visited[other.index] = true;
+                    open.push_back(other);
+                }
+            }
+        );
+    }
+    auto walkTime = secondsSince(start);
+
+    start = Clock::now();
+    for (auto node : removed) {
+        graph.removeNode(nodeIds[node]);
+    }
+    auto removeTime = secondsSince(start) / RemovedNodes;
+
+    // Previous storage. Does not include the spatial indices so it does less work than the graph above
+    start = Clock::now();
+    Legacy::Graph legacy;
+    for (uint32_t node = 0; node < nodeCount; ++node) {
+        legacy.nodes.push_back(std::make_shared<Legacy::Node>(Legacy::Node { positions[node] }));
+    }
+    for (uint32_t y = 0; y < side; ++y) {
+        for (uint32_t x = 0; x < side; ++x) {
+            if (x + 1 < side) {
+                legacy.link(legacy.nodes[y * side + x], legacy.nodes[y * side + x + 1]);
+            }
+            if (y + 1 < side) {
+                legacy.link(legacy.nodes[y * side + x], legacy.nodes[(y + 1) * side + x]);
+            }
+        }
+    }
+    auto legacyBuildTime = secondsSince(start);
+
+    start = Clock::now();
+    float legacyTotalLength = 0;
+    for (auto &node : legacy.nodes) {
+        for (uint32_t index = 0; index < node->edges.size(); ++index) {
+            // Node::getEdge returned a copy of the shared pointer
+            auto edge = node->edges[index];
+            legacyTotalLength += edge->length;
+        }
+    }
+    auto legacyTraverseTime = secondsSince(start);
+
+    start = Clock::now();
+    std::unordered_set<const Legacy::Node *> legacyVisited;
+    std::deque<std::shared_ptr<Legacy::Node>> legacyOpen { legacy.nodes[0] };
+    legacyVisited.insert(legacy.nodes[0].get());
+    uint32_t legacyReached = 0;
+    while (!legacyOpen.empty()) {
+        auto node = legacyOpen.front();
+        legacyOpen.pop_front();
+        ++legacyReached;
+
+        for (uint32_t index = 0; index < node->edges.size(); ++index) {
+            auto edge = node->edges[index];
+            auto other = edge->start == node ? edge->end : edge->start;
+            if (legacyVisited.insert(other.get()).second) {
+                legacyOpen.push_back(other);
+            }
+        }
+    }
+    auto legacyWalkTime = secondsSince(start);
+
+    std::vector<std::shared_ptr<Legacy::Node>> legacyRemoved;
+    for (auto node : removed) {
+        legacyRemoved.push_back(legacy.nodes[node]);
+    }
+
+    start = Clock::now();
+    for (auto &node : legacyRemoved) {
+        legacy.removeNode(node);
+    }
+    auto legacyRemoveTime = secondsSince(start) / RemovedNodes;
+
+    std::cout << side * (side - 1) * 2 << " edges, " << nodeCount << " nodes" << std::endl;
+    std::cout << " Build (handles):          " << buildTime * 1000 << "ms" << std::endl;
+    std::cout << " Build (shared_ptr):       " << legacyBuildTime * 1000 << "ms" << std::endl;
+    std::cout << " Traverse (handles):       " << traverseTime * 1000 << "ms, length " << totalLength << std::endl;
+    std::cout << " Traverse (shared_ptr):    " << legacyTraverseTime * 1000 << "ms, length " << legacyTotalLength
+        << std::endl;
+    std::cout << " BFS (handles):            " << walkTime * 1000 << "ms, " << reached << " nodes" << std::endl;
+    std::cout << " BFS (shared_ptr):         " << legacyWalkTime * 1000 << "ms, " << legacyReached << " nodes"
+        << std::endl;
+    std::cout << " Remove node (handles):    " << removeTime * 1e6 << "us" << std::endl;
+    std::cout << " Remove node (shared_ptr): " << legacyRemoveTime * 1e6 << "us" << std::endl;
+    std::cout << std::endl;
+}
+
+int main() {
+    for (auto nodeCount : { 1000u, 100000u, 1000000u }) {
+        benchmarkSpatialHash(nodeCount);
+    }
+
+    for (auto edgeCount : { 10000u, 1000000u }) {
+        benchmarkGraph(edgeCount);
+    }
+
+    return 0;
+}
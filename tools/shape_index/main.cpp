@@ -0,0 +1,130 @@
+#include "../../src/vector/hit_test.hpp"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+const float CellSize = 64;
+const float WorldSize = 4096;
+const uint32_t SlotCount = 2000;
+const uint32_t Steps = 20000;
+const uint32_t QueriesPerCheck = 50;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Mostly small bounds like node markers and road edges, with some covering huge areas, some unbounded and some empty
+ */
+glm::vec4 randomBounds(std::mt19937 &random) {
+    std::uniform_real_distribution<float> position(-WorldSize / 2, WorldSize / 2);
+    std::uniform_real_distribution<float> small(0, 100);
+    std::uniform_real_distribution<float> huge(WorldSize, 1e9f);
+    std::uniform_int_distribution<uint32_t> kind(0, 19);
+
+    glm::vec2 min { position(random), position(random) };
+    auto infinity = std::numeric_limits<float>::infinity();
+    switch (kind(random)) {
+        case 0:
+            return { min.x - huge(random), min.y - huge(random), min.x + huge(random), min.y + huge(random) };
+        case 1:
+            return { -infinity, min.y, infinity, min.y + small(random) };
+        case 2:
+            return { min.x, min.y, min.x - 1, min.y - 1 };
+        case 3:
+            return { min.x, min.y, min.x + WorldSize / 4, min.y + WorldSize / 4 };
+        default:
+            return { min.x, min.y, min.x + small(random), min.y + small(random) };
+    }
+}
+
+/**
+ * Empty bounds are never found
+ */
+bool overlaps(const glm::vec4 &bounds, const glm::vec2 &min, const glm::vec2 &max) {
+    return bounds.x <= bounds.z && bounds.y <= bounds.w &&
+        bounds.x <= max.x && bounds.z >= min.x && bounds.y <= max.y && bounds.w >= min.y;
+}
+
+/**
+ * Compares rectangle queries against testing the bounds of every slot in the index
+ */
+bool checkQueries(
+    const Vector::ShapeIndex &index, const std::vector<glm::vec4> &bounds, const std::vector<bool> &inIndex,
+    std::mt19937 &random
+) {
+    std::uniform_real_distribution<float> position(-WorldSize, WorldSize);
+    std::uniform_real_distribution<float> size(0, WorldSize / 2);
+    std::vector<uint32_t> actual;
+
+    for (uint32_t query = 0; query < QueriesPerCheck; ++query) {
+        glm::vec2 min { position(random), position(random) };
+        // Points as well as rectangles
+        glm::vec2 max = query % 2 == 0 ? min : min + glm::vec2 { size(random), size(random) };
+
+        std::vector<uint32_t> expected;
+        for (uint32_t slot = 0; slot < bounds.size(); ++slot) {
+            if (inIndex[slot] && overlaps(bounds[slot], min, max)) {
+                expected.push_back(slot);
+            }
+        }
+
+        index.findInRect(min, max, actual);
+        std::sort(actual.begin(), actual.end());
+        if (actual != expected) {
+            std::cerr << "Query at " << min.x << ", " << min.y << " found " << actual.size() << " slots, expected "
+                << expected.size() << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<uint32_t> slotDistribution(0, SlotCount - 1);
+    std::uniform_int_distribution<uint32_t> action(0, 9);
+
+    Vector::ShapeIndex index(CellSize);
+    std::vector<glm::vec4> bounds(SlotCount);
+    std::vector<bool> inIndex(SlotCount, false);
+
+    auto start = Clock::now();
+    bool passed = true;
+    for (uint32_t step = 0; step < Steps && passed; ++step) {
+        auto slot = slotDistribution(random);
+
+        // Inserting again moves the slot
+        if (action(random) < 8) {
+            bounds[slot] = randomBounds(random);
+            index.insert(slot, bounds[slot]);
+            inIndex[slot] = true;
+        } else {
+            index.remove(slot);
+            inIndex[slot] = false;
+        }
+
+        if (step % 100 == 0) {
+            passed = checkQueries(index, bounds, inIndex, random);
+        }
+    }
+
+    auto count = static_cast<size_t>(std::count(inIndex.begin(), inIndex.end(), true));
+    if (passed && index.size() != count) {
+        std::cerr << "Index has " << index.size() << " slots, expected " << count << std::endl;
+        passed = false;
+    }
+
+    std::cout << "Queries: " << (passed ? "ok" : "FAILED") << std::endl;
+    std::cout << Steps << " changes with checks: " << secondsSince(start) * 1000 << "ms" << std::endl;
+
+    return passed ? 0 : 1;
+}
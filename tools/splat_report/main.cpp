@@ -0,0 +1,112 @@
+#include "../../src/splat_tiles.hpp"
+#include <glm/glm.hpp>
+#include <stb_image.h>
+#include <bitset>
+#include <iostream>
+#include <random>
+
+const uint32_t ImageSize = 1024;
+const uint32_t TileSize = 32;
+const uint32_t PageSize = 128;
+const uint32_t StrokeCount = 200;
+const uint32_t QueryCount = 10000;
+
+/**
+ * Paints strokes like someone using the painter tool: a few dabs along a path with one texture at a time
+ */
+void paintStrokes(SplatTiles &tiles, std::mt19937 &random) {
+    std::uniform_real_distribution<float> position(0, ImageSize);
+    std::uniform_real_distribution<float> radius(5, 60);
+    std::uniform_real_distribution<float> unit(0, 1);
+    std::uniform_real_distribution<float> step(-20, 20);
+    std::uniform_int_distribution<int32_t> material(0, SplatTiles::MaterialCount - 1);
+
+    for (uint32_t stroke = 0; stroke < StrokeCount; ++stroke) {
+        glm::vec2 origin { position(random), position(random) };
+        auto strokeRadius = radius(random);
+        auto strokeMaterial = material(random);
+        auto opacity = unit(random);
+        auto hardness = unit(random);
+
+        for (int dab = 0; dab < 10; ++dab) {
+            tiles.paint(origin, strokeRadius, strokeMaterial, opacity, hardness);
+            origin += glm::vec2 { step(random), step(random) };
+        }
+    }
+}
+
+/**
+ * Compares the masks for random regions against combining every tile they touch
+ */
+bool checkMasks(const SplatTiles &tiles, std::mt19937 &random) {
+    std::uniform_real_distribution<float> position(-50, ImageSize + 50);
+
+    for (uint32_t query = 0; query < QueryCount; ++query) {
+        glm::vec2 a { position(random), position(random) };
+        glm::vec2 b { position(random), position(random) };
+        auto min = glm::min(a, b);
+        auto max = glm::max(a, b);
+
+        auto last = static_cast<int32_t>(tiles.getTilesPerSide() - 1);
+        auto minTile = glm::clamp(glm::ivec2(glm::floor(min / static_cast<float>(TileSize))), 0, last);
+        auto maxTile = glm::clamp(glm::ivec2(glm::floor(max / static_cast<float>(TileSize))), 0, last);
+
+        uint32_t expected = 0;
+        for (auto y = minTile.y; y <= maxTile.y; ++y) {
+            for (auto x = minTile.x; x <= maxTile.x; ++x) {
+                expected |= tiles.getTileMask(x, y);
+            }
+        }
+
+        // Coarse levels may add materials, but never lose one
+        auto actual = tiles.getMask(min, max);
+        if ((actual & expected) != expected) {
+            std::cerr << "Region " << min.x << "," << min.y << " to " << max.x << "," << max.y << " is missing materials"
+                << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    SplatTiles tiles(ImageSize, TileSize, PageSize);
+    std::mt19937 random(1234);
+
+    if (argc > 1) {
+        int width, height, components;
+        auto *pixels = stbi_load(argv[1], &width, &height, &components, 4);
+        if (!pixels || width != ImageSize || height != ImageSize) {
+            std::cerr << "Expected a " << ImageSize << "x" << ImageSize << " splat map" << std::endl;
+            return 1;
+        }
+
+        tiles.load(pixels);
+        stbi_image_free(pixels);
+    } else {
+        paintStrokes(tiles, random);
+    }
+
+    std::vector<uint32_t> histogram(SplatTiles::MaterialCount + 1);
+    for (uint32_t y = 0; y < tiles.getTilesPerSide(); ++y) {
+        for (uint32_t x = 0; x < tiles.getTilesPerSide(); ++x) {
+            ++histogram[std::bitset<SplatTiles::MaterialCount>(tiles.getTileMask(x, y)).count()];
+        }
+    }
+
+    auto average = tiles.getAverageMaterials();
+    std::cout << "Average textures per tile: " << average << " of " << SplatTiles::MaterialCount << std::endl;
+    for (uint32_t count = 1; count < histogram.size(); ++count) {
+        std::cout << "  " << count << ": " << histogram[count] << " tiles" << std::endl;
+    }
+    std::cout << "Texture fetches saved: " << (1 - average / SplatTiles::MaterialCount) * 100 << "%" << std::endl;
+
+    auto totalPages = tiles.getPagesPerSide() * tiles.getPagesPerSide();
+    std::cout << "Pages painted: " << tiles.getPageCount() << " of " << totalPages << std::endl;
+
+    bool passed = checkMasks(tiles, random);
+    std::cout << "Region masks: " << (passed ? "ok" : "FAILED") << std::endl;
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,247 @@
+#include "../../src/vector/binning.hpp"
+#include "../../src/vector/common.hpp"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+const glm::vec2 Viewport { 1920, 1080 };
+const uint32_t TileSize = 32;
+const uint32_t ElementCount = 10000;
+const uint32_t Repeats = 20;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+bool contains(const glm::vec4 &bounds, const glm::vec2 &point) {
+    return point.x >= bounds.x && point.x <= bounds.z && point.y >= bounds.y && point.y <= bounds.w;
+}
+
+Internal::VectorElement randomElement(std::mt19937 &random, const glm::vec2 &area) {
+    std::uniform_real_distribution<float> x(0, area.x);
+    std::uniform_real_distribution<float> y(0, area.y);
+    std::uniform_real_distribution<float> size(1, 40);
+    // Like node markers and road edges, mostly small and spread out
+    std::uniform_real_distribution<float> offset(-100, 100);
+    std::uniform_int_distribution<uint32_t> type(0, 3);
+    std::uniform_int_distribution<uint32_t> strokePosition(0, 2);
+
+    Internal::VectorElement element;
+    element.type = static_cast<Internal::VectorObjectType>(type(random));
+    element.f1 = size(random);
+    element.p1 = { x(random), y(random) };
+    element.p2 = element.p1 + glm::vec2 { offset(random), offset(random) };
+    element.p3 = element.p1 + glm::vec2 { offset(random), offset(random) };
+    element.strokeWidth = size(random) / 4;
+    element.strokePosition = strokePosition(random);
+
+    if (element.type == Internal::VectorObjectType::ArcLine) {
+        element.p2 = { -1, 2 };
+        element.p3.x = size(random);
+    }
+
+    return element;
+}
+
+/**
+ * Points on the outer edge of what the element draws, following the distance functions in vector_draw.glsl
+ */
+std::vector<glm::vec2> samplePoints(const Internal::VectorElement &element) {
+    std::vector<glm::vec2> points;
+
+    float stroke = 0;
+    if (element.strokePosition == static_cast<uint32_t>(Vector::StrokePosition::Outside)) {
+        stroke = element.strokeWidth;
+    } else if (element.strokePosition == static_cast<uint32_t>(Vector::StrokePosition::Center)) {
+        stroke = element.strokeWidth / 2;
+    }
+
+    auto around = [&](const glm::vec2 &centre, float radius) {
+        for (int step = 0; step < 32; ++step) {
+            float angle = static_cast<float>(step) / 32 * 2 * static_cast<float>(M_PI);
+            points.push_back(centre + glm::vec2(std::cos(angle), std::sin(angle)) * radius);
+        }
+    };
+
+    switch (element.type) {
+        case Internal::VectorObjectType::Circle:
+            around(element.p1, element.f1 + stroke);
+            break;
+        case Internal::VectorObjectType::Line:
+            for (int step = 0; step <= 8; ++step) {
+                around(glm::mix(element.p1, element.p2, static_cast<float>(step) / 8), element.f1 / 2 + stroke);
+            }
+            break;
+        case Internal::VectorObjectType::BezierCurve:
+            for (int step = 0; step <= 16; ++step) {
+                float t = static_cast<float>(step) / 16;
+                auto point = (1 - t) * (1 - t) * element.p1 + 2 * t * (1 - t) * element.p2 + t * t * element.p3;
+                around(point, element.f1 / 2 + stroke);
+            }
+            break;
+        case Internal::VectorObjectType::ArcLine:
+            for (int step = 0; step <= 16; ++step) {
+                float angle = glm::mix(element.p2.x, element.p2.y, static_cast<float>(step) / 16);
+                auto point = element.p1 + glm::vec2(std::cos(angle), std::sin(angle)) * element.f1;
+                around(point, element.p3.x / 2 + stroke);
+            }
+            break;
+    }
+
+    return points;
+}
+
+bool checkElementBounds(std::mt19937 &random) {
+    for (uint32_t index = 0; index < ElementCount; ++index) {
+        auto element = randomElement(random, Viewport);
+        auto bounds = Vector::getElementBounds(element);
+
+        for (auto &point : samplePoints(element)) {
+            if (!contains(bounds, point)) {
+                std::cerr << "Element " << index << " of type " << static_cast<uint32_t>(element.type)
+                    << " draws outside its bounds" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool checkProjection(std::mt19937 &random) {
+    auto proj = glm::perspective(glm::radians(90.0f), Viewport.x / Viewport.y, 1.0f, 10000.0f);
+    auto view = glm::lookAt(glm::vec3 { 0, -300, 500 }, glm::vec3 { 0, 200, 0 }, glm::vec3 { 0, 0, 1 });
+    auto viewProj = proj * view;
+
+    std::uniform_real_distribution<float> position(-1000, 1000);
+    std::uniform_real_distribution<float> size(1, 100);
+    std::uniform_real_distribution<float> unit(0, 1);
+    const float minHeight = 0;
+    const float maxHeight = 200;
+
+    for (uint32_t index = 0; index < ElementCount; ++index) {
+        glm::vec2 min { position(random), position(random) };
+        glm::vec4 bounds { min.x, min.y, min.x + size(random), min.y + size(random) };
+        auto projected = Vector::projectBounds(bounds, viewProj, minHeight, maxHeight, Viewport);
+
+        for (int sample = 0; sample < 16; ++sample) {
+            glm::vec4 point {
+                glm::mix(bounds.x, bounds.z, unit(random)),
+                glm::mix(bounds.y, bounds.w, unit(random)),
+                glm::mix(minHeight, maxHeight, unit(random)),
+                1
+            };
+
+            auto clip = viewProj * point;
+            if (clip.w <= 0) {
+                continue;
+            }
+
+            auto pixel = (glm::vec2(clip) / clip.w + 1.0f) * 0.5f * Viewport;
+            bool onScreen = pixel.x >= 0 && pixel.y >= 0 && pixel.x < Viewport.x && pixel.y < Viewport.y;
+            if (onScreen && !contains(projected, pixel)) {
+                std::cerr << "Projected bounds " << index << " do not contain a point inside them" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Compares the bins against testing every element against every tile
+ */
+bool checkBins(const Vector::TileBinning &binning, const std::vector<glm::vec4> &screenBounds) {
+    auto &data = binning.getData();
+    auto tileSize = static_cast<float>(binning.getTileSize());
+
+    if (data[0] != binning.getTileCount() + 1 || data[binning.getTileCount()] != data.size()) {
+        std::cerr << "Tile offsets do not cover the data" << std::endl;
+        return false;
+    }
+
+    for (uint32_t y = 0; y < binning.getTilesY(); ++y) {
+        for (uint32_t x = 0; x < binning.getTilesX(); ++x) {
+            auto tile = y * binning.getTilesX() + x;
+            glm::vec2 tileMin { x * tileSize, y * tileSize };
+            glm::vec2 tileMax = tileMin + tileSize;
+
+            std::vector<uint32_t> expected;
+            for (uint32_t index = 0; index < screenBounds.size(); ++index) {
+                auto &bounds = screenBounds[index];
+                // Only the visible part of the bounds counts, edge tiles take everything past the edge
+                bool overlaps = bounds.x <= bounds.z && bounds.y <= bounds.w &&
+                    bounds.z >= 0 && bounds.w >= 0 && bounds.x < Viewport.x && bounds.y < Viewport.y &&
+                    (bounds.x < tileMax.x || x == binning.getTilesX() - 1) && (bounds.z >= tileMin.x || x == 0) &&
+                    (bounds.y < tileMax.y || y == binning.getTilesY() - 1) && (bounds.w >= tileMin.y || y == 0);
+                if (overlaps) {
+                    expected.push_back(index);
+                }
+            }
+
+            std::vector<uint32_t> actual(data.begin() + data[tile], data.begin() + data[tile + 1]);
+            if (actual != expected) {
+                std::cerr << "Tile " << x << ", " << y << " has " << actual.size() << " elements, expected "
+                    << expected.size() << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    std::mt19937 random(1234);
+    bool passed = true;
+
+    passed &= checkElementBounds(random);
+    std::cout << "Element bounds: " << (passed ? "ok" : "FAILED") << std::endl;
+
+    bool projectionPassed = checkProjection(random);
+    std::cout << "Projected bounds: " << (projectionPassed ? "ok" : "FAILED") << std::endl;
+    passed &= projectionPassed;
+
+    std::vector<glm::vec4> screenBounds;
+    for (uint32_t index = 0; index < ElementCount; ++index) {
+        // Some past the edges of the screen
+        screenBounds.push_back(Vector::getElementBounds(randomElement(random, Viewport * 1.1f - 50.0f)));
+    }
+
+    Vector::TileBinning binning(TileSize);
+    binning.bin(Viewport, screenBounds);
+
+    // A few small cases where mistakes are easy to read
+    std::vector<glm::vec4> smallBounds {
+        { -10, -10, -1, -1 },
+        { 0, 0, 0, 0 },
+        { 31, 31, 32, 32 },
+        { 1900, 1060, 3000, 3000 },
+        { 10, 10, 5, 5 },
+    };
+    Vector::TileBinning smallBinning(TileSize);
+    smallBinning.bin(Viewport, smallBounds);
+
+    bool binsPassed = checkBins(binning, screenBounds) && checkBins(smallBinning, smallBounds);
+    std::cout << "Bins: " << (binsPassed ? "ok" : "FAILED") << std::endl;
+    passed &= binsPassed;
+
+    auto start = Clock::now();
+    for (uint32_t repeat = 0; repeat < Repeats; ++repeat) {
+        binning.bin(Viewport, screenBounds);
+    }
+    auto binTime = secondsSince(start) / Repeats;
+
+    std::cout << ElementCount << " elements into " << binning.getTileCount() << " tiles: " << binTime * 1000 << "ms, "
+        << static_cast<double>(binning.getBinnedCount()) / binning.getTileCount() << " elements per tile on average"
+        << std::endl;
+
+    return passed ? 0 : 1;
+}